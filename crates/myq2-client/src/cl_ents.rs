@@ -8,7 +8,7 @@ use crate::client::*;
 use myq2_common::q_shared::*;
 use rayon::prelude::*;
 use myq2_common::qcommon::{
-    SizeBuf, UPDATE_BACKUP, SVC_PLAYERINFO, SVC_PACKETENTITIES, MAX_PROJECTILES,
+    SizeBuf, UPDATE_BACKUP, SVC_PLAYERINFO, SVC_PACKETENTITIES, SVC_PACKETENTITIES_BITS, MAX_PROJECTILES,
     U_ORIGIN1, U_ORIGIN2, U_ORIGIN3, U_ANGLE1, U_ANGLE2, U_ANGLE3,
     U_FRAME8, U_FRAME16, U_EVENT, U_REMOVE, U_MOREBITS1, U_MOREBITS2, U_MOREBITS3,
     U_NUMBER16, U_MODEL, U_MODEL2, U_MODEL3, U_MODEL4,
@@ -19,11 +19,12 @@ use myq2_common::qcommon::{
     PS_KICKANGLES, PS_BLEND, PS_FOV, PS_WEAPONINDEX, PS_WEAPONFRAME, PS_RDFLAGS,
 };
 use myq2_common::common::{
-    com_printf, com_dprintf,
+    com_printf, com_dprintf, com_error,
     msg_read_byte, msg_read_short, msg_read_long,
     msg_read_char, msg_read_coord, msg_read_angle, msg_read_angle16,
     msg_read_pos, msg_read_data,
 };
+use myq2_common::msg_bits::PackedEntityReader;
 
 // =========================================================================
 // Global state
@@ -243,7 +244,8 @@ pub fn cl_parse_delta(
 }
 
 /// CL_DeltaEntity — Parses deltas from the given base and adds the resulting
-/// entity to the current frame.
+/// entity to the current frame. With `packed`, the delta is read from the
+/// bit stream of svc_packetentities_bits rather than by `bits`.
 pub fn cl_delta_entity(
     frame: &mut Frame,
     newnum: i32,
@@ -252,12 +254,16 @@ pub fn cl_delta_entity(
     cl: &mut ClientState,
     ent_state: &mut ClientEntState,
     net_message: &mut SizeBuf,
+    packed: Option<&mut PackedEntityReader>,
 ) {
     let state_idx = (cl.parse_entities & (MAX_PARSE_ENTITIES as i32 - 1)) as usize;
     cl.parse_entities += 1;
     frame.num_entities += 1;
 
-    cl_parse_delta(old, &mut ent_state.cl_parse_entities[state_idx], newnum, bits, net_message);
+    match packed {
+        Some(reader) => reader.read_delta(net_message, old, &mut ent_state.cl_parse_entities[state_idx], newnum),
+        None => cl_parse_delta(old, &mut ent_state.cl_parse_entities[state_idx], newnum, bits, net_message),
+    }
 
     let state = ent_state.cl_parse_entities[state_idx].clone();
     let ent = &mut ent_state.cl_entities[newnum as usize];
@@ -394,7 +400,8 @@ pub fn cl_delta_entity(
 }
 
 /// CL_ParsePacketEntities — An svc_packetentities has just been parsed,
-/// deal with the rest of the data stream.
+/// deal with the rest of the data stream. Returns false if the entity list
+/// cannot be read, leaving the rest of the message unreadable too.
 pub fn cl_parse_packet_entities(
     oldframe: Option<&Frame>,
     newframe: &mut Frame,
@@ -402,10 +409,24 @@ pub fn cl_parse_packet_entities(
     ent_state: &mut ClientEntState,
     net_message: &mut SizeBuf,
     cl_shownet_value: f32,
-) {
+    packed: bool,
+) -> bool {
     newframe.parse_entities = cl.parse_entities;
     newframe.num_entities = 0;
 
+    // svc_packetentities_bits: the same list as one bit stream
+    let mut packed = if packed {
+        match PackedEntityReader::begin(net_message) {
+            Some(reader) => Some(reader),
+            None => {
+                com_error(ERR_DROP, "CL_ParsePacketEntities: unknown entity profile");
+                return false;
+            }
+        }
+    } else {
+        None
+    };
+
     // delta from the entities present in oldframe
     let mut oldindex: i32 = 0;
     let mut oldstate: EntityState;
@@ -428,7 +449,16 @@ pub fn cl_parse_packet_entities(
 
     loop {
         let mut bits: i32 = 0;
-        let newnum = cl_parse_entity_bits(net_message, &mut bits);
+        let newnum = match packed.as_mut() {
+            Some(reader) => {
+                let (number, remove) = reader.read_number(net_message);
+                if remove {
+                    bits = U_REMOVE;
+                }
+                number
+            }
+            None => cl_parse_entity_bits(net_message, &mut bits),
+        };
         if newnum >= MAX_EDICTS as i32 {
             panic!("CL_ParsePacketEntities: bad number:{}", newnum);
         }
@@ -447,7 +477,7 @@ pub fn cl_parse_packet_entities(
                 com_dprintf(&format!("   unchanged: {}\n", oldnum));
             }
             let os = oldstate.clone();
-            cl_delta_entity(newframe, oldnum, &os, 0, cl, ent_state, net_message);
+            cl_delta_entity(newframe, oldnum, &os, 0, cl, ent_state, net_message, None);
 
             oldindex += 1;
 
@@ -495,7 +525,7 @@ pub fn cl_parse_packet_entities(
                 com_dprintf(&format!("   delta: {}\n", newnum));
             }
             let os = oldstate.clone();
-            cl_delta_entity(newframe, newnum, &os, bits, cl, ent_state, net_message);
+            cl_delta_entity(newframe, newnum, &os, bits, cl, ent_state, net_message, packed.as_mut());
 
             oldindex += 1;
 
@@ -519,7 +549,7 @@ pub fn cl_parse_packet_entities(
                 com_dprintf(&format!("   baseline: {}\n", newnum));
             }
             let baseline = ent_state.cl_entities[newnum as usize].baseline.clone();
-            cl_delta_entity(newframe, newnum, &baseline, bits, cl, ent_state, net_message);
+            cl_delta_entity(newframe, newnum, &baseline, bits, cl, ent_state, net_message, packed.as_mut());
             continue;
         }
     }
@@ -530,7 +560,7 @@ pub fn cl_parse_packet_entities(
             com_dprintf(&format!("   unchanged: {}\n", oldnum));
         }
         let os = oldstate.clone();
-        cl_delta_entity(newframe, oldnum, &os, 0, cl, ent_state, net_message);
+        cl_delta_entity(newframe, oldnum, &os, 0, cl, ent_state, net_message, None);
 
         oldindex += 1;
 
@@ -546,6 +576,7 @@ pub fn cl_parse_packet_entities(
             oldnum = 99999;
         }
     }
+    true
 }
 
 /// CL_ParsePlayerstate
@@ -720,7 +751,8 @@ pub fn cl_fire_entity_events(
     }
 }
 
-/// CL_ParseFrame
+/// CL_ParseFrame — Returns false if the frame could not be read; the
+/// connection has to be dropped.
 pub fn cl_parse_frame(
     cl: &mut ClientState,
     cls: &mut ClientStatic,
@@ -729,7 +761,7 @@ pub fn cl_parse_frame(
     cl_shownet_value: f32,
     svc_strings: &[&str; 256],
     callbacks: &mut dyn ClientCallbacks,
-) {
+) -> bool {
     cl.frame = Frame::default();
 
     cl.frame.serverframe = msg_read_long(net_message);
@@ -801,14 +833,17 @@ pub fn cl_parse_frame(
     // read packet entities
     let cmd = msg_read_byte(net_message);
     callbacks.shownet(svc_strings[cmd as usize]);
-    if cmd != SVC_PACKETENTITIES {
+    if cmd != SVC_PACKETENTITIES && cmd != SVC_PACKETENTITIES_BITS {
         panic!("CL_ParseFrame: not packetentities");
     }
     // SAFETY: We need both &mut cl.frame and &mut cl simultaneously.
     // This is safe because cl_parse_packet_entities only modifies cl.frame
     // and cl.parse_entities / cl_parse_entities array, which don't overlap.
     let cl_ptr = cl as *mut ClientState;
-    cl_parse_packet_entities(old.as_ref(), &mut cl.frame, unsafe { &mut *cl_ptr }, ent_state, net_message, cl_shownet_value);
+    if !cl_parse_packet_entities(old.as_ref(), &mut cl.frame, unsafe { &mut *cl_ptr }, ent_state, net_message, cl_shownet_value, cmd == SVC_PACKETENTITIES_BITS) {
+        cl.frame.valid = false;
+        return false;
+    }
 
     // save the frame off in the backup array for later delta comparisons
     let idx = (cl.frame.serverframe as usize) & (UPDATE_BACKUP as usize - 1);
@@ -880,6 +915,7 @@ pub fn cl_parse_frame(
         // Also track in network stats
         cl.smoothing.network_stats.packets_lost += 1;
     }
+    true
 }
 
 // =========================================================================
@@ -2945,6 +2981,8 @@ pub fn cl_add_projectiles_with_prediction(
 mod tests {
     use super::*;
     use crate::client::CEntity;
+    use myq2_common::common::{msg_write_byte, msg_write_delta_entity, msg_write_short};
+    use myq2_common::msg_bits::{EntityQuant, PackedEntityWriter};
 
     // -------------------------------------------------------
     // Helper: create a CEntity with velocity data
@@ -3575,4 +3613,322 @@ mod tests {
         assert!(result_positive_nudge[0] > result_no_nudge[0],
             "timenudge should shift lerp: nudged={} base={}", result_positive_nudge[0], result_no_nudge[0]);
     }
+
+    // -------------------------------------------------------
+    // svc_packetentities against svc_packetentities_bits
+    // -------------------------------------------------------
+
+    const MAXCLIENTS: i32 = 4;
+
+    struct Lcg(u32);
+
+    impl Lcg {
+        fn next(&mut self) -> u32 {
+            self.0 = self.0.wrapping_mul(1664525).wrapping_add(1013904223);
+            self.0
+        }
+        fn below(&mut self, n: u32) -> u32 {
+            ((self.next() >> 8) as u64 * n as u64 >> 24) as u32
+        }
+        fn range(&mut self, lo: f32, hi: f32) -> f32 {
+            lo + (hi - lo) * self.below(1 << 20) as f32 / (1 << 20) as f32
+        }
+        fn chance(&mut self, percent: u32) -> bool {
+            self.below(100) < percent
+        }
+    }
+
+    /// Change some fields of `s` the way a game frame might, with the odd
+    /// value outside what the byte format carries exactly.
+    fn mutate(rng: &mut Lcg, s: &mut EntityState) {
+        if rng.chance(70) {
+            for i in 0..3 {
+                s.origin[i] += rng.range(-24.0, 24.0);
+            }
+        }
+        if rng.chance(5) {
+            s.origin = [rng.range(-5000.0, 5000.0), rng.range(-5000.0, 5000.0), rng.range(-5000.0, 5000.0)];
+        }
+        if rng.chance(40) {
+            s.angles[rng.below(3) as usize] = rng.range(-720.0, 720.0);
+        }
+        if rng.chance(50) {
+            s.frame = match rng.below(4) {
+                0 => rng.below(70000) as i32 - 10,
+                _ => s.frame + 1,
+            };
+        }
+        let wide = |rng: &mut Lcg| match rng.below(4) {
+            0 => rng.below(256) as i32,
+            1 => rng.below(0x10000) as i32,
+            2 => rng.next() as i32,
+            _ => -(rng.below(70000) as i32),
+        };
+        if rng.chance(10) {
+            s.skinnum = wide(rng);
+        }
+        if rng.chance(10) {
+            s.effects = wide(rng) as u32;
+        }
+        if rng.chance(10) {
+            s.renderfx = wide(rng) | if rng.chance(30) { RF_BEAM } else { 0 };
+        }
+        if rng.chance(5) {
+            s.solid = wide(rng);
+        }
+        if rng.chance(10) {
+            s.modelindex = rng.below(300) as i32;
+            s.modelindex2 = rng.below(300) as i32;
+        }
+        if rng.chance(5) {
+            s.modelindex3 = rng.below(300) as i32;
+            s.modelindex4 = rng.below(300) as i32;
+        }
+        if rng.chance(10) {
+            s.sound = rng.below(300) as i32;
+        }
+        s.event = if rng.chance(15) { rng.below(300) as i32 } else { 0 };
+        s.old_origin = if rng.chance(50) {
+            [rng.range(-5000.0, 5000.0), rng.range(-5000.0, 5000.0), rng.range(-5000.0, 5000.0)]
+        } else {
+            s.origin
+        };
+    }
+
+    /// SV_EmitPacketEntities over two sorted entity lists.
+    fn emit(from: &[EntityState], to: &[EntityState], baselines: &[EntityState], quant: Option<EntityQuant>) -> SizeBuf {
+        let mut msg = SizeBuf::new(65536);
+        let mut packed = quant.map(|q| PackedEntityWriter::new(&mut msg, q));
+        let (mut oldindex, mut newindex) = (0, 0);
+        while newindex < to.len() || oldindex < from.len() {
+            let newnum = to.get(newindex).map_or(9999, |s| s.number);
+            let oldnum = from.get(oldindex).map_or(9999, |s| s.number);
+            if newnum <= oldnum {
+                let (base, force, newentity) = if newnum == oldnum {
+                    oldindex += 1;
+                    (&from[oldindex - 1], false, newnum <= MAXCLIENTS)
+                } else {
+                    (&baselines[newnum as usize], true, true)
+                };
+                match packed.as_mut() {
+                    Some(p) => p.delta(base, &to[newindex], force, newentity),
+                    None => msg_write_delta_entity(base, &to[newindex], &mut msg, force, newentity),
+                }
+                newindex += 1;
+            } else {
+                match packed.as_mut() {
+                    Some(p) => p.remove(oldnum),
+                    None => {
+                        let bits = U_REMOVE | if oldnum >= 256 { U_NUMBER16 | U_MOREBITS1 } else { 0 };
+                        msg_write_byte(&mut msg, bits & 255);
+                        if bits & U_MOREBITS1 != 0 {
+                            msg_write_byte(&mut msg, bits >> 8);
+                            msg_write_short(&mut msg, oldnum);
+                        } else {
+                            msg_write_byte(&mut msg, oldnum);
+                        }
+                    }
+                }
+                oldindex += 1;
+            }
+        }
+        match packed {
+            Some(p) => p.finish(&mut msg),
+            None => msg_write_short(&mut msg, 0),
+        }
+        msg
+    }
+
+    /// CL_ParsePacketEntities against the previous frame's decoded list.
+    fn parse(msg: &mut SizeBuf, from: &[EntityState], baselines: &[EntityState], packed: bool) -> Vec<EntityState> {
+        msg.readcount = 0;
+        let mut reader = packed.then(|| PackedEntityReader::begin(msg).expect("test streams use a known profile"));
+        let mut out = Vec::new();
+        let mut old = from.iter().peekable();
+        loop {
+            let mut bits = 0;
+            let newnum = match reader.as_mut() {
+                Some(r) => {
+                    let (number, remove) = r.read_number(msg);
+                    if remove {
+                        bits = U_REMOVE;
+                    }
+                    number
+                }
+                None => cl_parse_entity_bits(msg, &mut bits),
+            };
+            assert!(msg.readcount <= msg.cursize, "end of message");
+            while let Some(s) = old.next_if(|s| newnum == 0 || s.number < newnum) {
+                let mut unchanged = EntityState::default();
+                cl_parse_delta(s, &mut unchanged, s.number, 0, msg);
+                out.push(unchanged);
+            }
+            if newnum == 0 {
+                break;
+            }
+            if bits & U_REMOVE != 0 {
+                assert_eq!(old.next().map(|s| s.number), Some(newnum));
+                continue;
+            }
+            let base = old.next_if(|s| s.number == newnum).unwrap_or(&baselines[newnum as usize]).clone();
+            let mut state = EntityState::default();
+            match reader.as_mut() {
+                Some(r) => r.read_delta(msg, &base, &mut state, newnum),
+                None => cl_parse_delta(&base, &mut state, newnum, bits, msg),
+            }
+            out.push(state);
+        }
+        assert_eq!(msg.readcount, msg.cursize);
+        out
+    }
+
+    fn state_fields(s: &EntityState) -> [u32; 21] {
+        [
+            s.number as u32, s.origin[0].to_bits(), s.origin[1].to_bits(), s.origin[2].to_bits(),
+            s.angles[0].to_bits(), s.angles[1].to_bits(), s.angles[2].to_bits(),
+            s.old_origin[0].to_bits(), s.old_origin[1].to_bits(), s.old_origin[2].to_bits(),
+            s.modelindex as u32, s.modelindex2 as u32, s.modelindex3 as u32, s.modelindex4 as u32,
+            s.frame as u32, s.skinnum as u32, s.effects, s.renderfx as u32, s.solid as u32,
+            s.sound as u32, s.event as u32,
+        ]
+    }
+
+    /// Run `frames` frames of a changing entity set through both formats;
+    /// returns the byte sizes of the two encodings.
+    fn stream_frames(seed: u32, frames: usize, quant: EntityQuant) -> (usize, usize) {
+        let mut rng = Lcg(seed);
+        let mut world: Vec<EntityState> = (0..MAX_EDICTS).map(|n| {
+            let mut s = EntityState::default();
+            s.number = n as i32;
+            mutate(&mut rng, &mut s);
+            s
+        }).collect();
+
+        // svc_spawnbaseline always uses the byte format
+        let baselines: Vec<EntityState> = world.iter().map(|s| if rng.chance(50) { s.clone() } else { EntityState::default() }).collect();
+        let client_baselines: Vec<EntityState> = baselines.iter().map(|b| {
+            let mut msg = SizeBuf::new(256);
+            let null = EntityState::default();
+            if b.number == 0 {
+                return null;
+            }
+            msg_write_delta_entity(&null, b, &mut msg, true, true);
+            let mut bits = 0;
+            let number = cl_parse_entity_bits(&mut msg, &mut bits);
+            let mut s = EntityState::default();
+            cl_parse_delta(&null, &mut s, number, bits, &mut msg);
+            s
+        }).collect();
+
+        let (mut sent, mut old_client, mut new_client) = (Vec::new(), Vec::new(), Vec::new());
+        let (mut old_bytes, mut new_bytes) = (0, 0);
+        for _ in 0..frames {
+            for s in world.iter_mut().skip(1) {
+                if rng.chance(60) {
+                    mutate(&mut rng, s);
+                }
+            }
+            let visible: Vec<EntityState> = world.iter().skip(1).filter(|_| rng.chance(30)).cloned().collect();
+
+            let mut old_msg = emit(&sent, &visible, &baselines, None);
+            let mut new_msg = emit(&sent, &visible, &baselines, Some(quant));
+            old_bytes += old_msg.cursize as usize;
+            new_bytes += new_msg.cursize as usize;
+
+            old_client = parse(&mut old_msg, &old_client, &client_baselines, false);
+            new_client = parse(&mut new_msg, &new_client, &client_baselines, true);
+            assert_eq!(old_client.len(), visible.len());
+            assert_eq!(new_client.len(), visible.len());
+            for (a, b) in old_client.iter().zip(&new_client) {
+                let (fa, fb) = (state_fields(a), state_fields(b));
+                if quant == EntityQuant::Standard {
+                    assert_eq!(fa, fb, "entity {} decodes differently", a.number);
+                    continue;
+                }
+                // 16-bit angles: within the 8-bit step of the byte format
+                assert_eq!((&fa[..4], &fa[7..]), (&fb[..4], &fb[7..]), "entity {} decodes differently", a.number);
+                for i in 0..3 {
+                    let d = (a.angles[i] - b.angles[i]).rem_euclid(360.0);
+                    assert!(d.min(360.0 - d) <= 360.0 / 256.0 + 0.001, "entity {} angle {}: {} vs {}", a.number, i, a.angles[i], b.angles[i]);
+                }
+            }
+            sent = visible;
+        }
+        (old_bytes, new_bytes)
+    }
+
+    #[test]
+    fn test_packed_entities_fuzz() {
+        for seed in 0..8 {
+            let (old_bytes, new_bytes) = stream_frames(seed * 7919 + 1, 40, EntityQuant::Standard);
+            assert!(new_bytes < old_bytes, "bit format larger: {} vs {}", new_bytes, old_bytes);
+            stream_frames(seed * 104729 + 3, 40, EntityQuant::Precise);
+        }
+    }
+
+    #[test]
+    fn test_packed_entities_unknown_profile() {
+        // a bad profile byte drops the frame instead of panicking
+        let mut msg = SizeBuf::new(64);
+        msg_write_byte(&mut msg, 99);
+        msg_write_short(&mut msg, 0);
+        let mut frame = Frame::default();
+        let mut cl = ClientState::default();
+        let mut ent_state = ClientEntState::new();
+        assert!(!cl_parse_packet_entities(None, &mut frame, &mut cl, &mut ent_state, &mut msg, 0.0, true));
+        assert_eq!(frame.num_entities, 0);
+    }
+
+    /// Usage: cargo test -p myq2-client --release report_packet_entities -- --ignored --nocapture
+    ///
+    /// Encodes and decodes a stream of busy frames (~300 visible entities,
+    /// most moving) in both formats and prints size and time per frame.
+    #[test]
+    #[ignore]
+    fn report_packet_entities() {
+        let mut rng = Lcg(12345);
+        let mut world: Vec<EntityState> = (0..MAX_EDICTS).map(|n| {
+            let mut s = EntityState::default();
+            s.number = n as i32;
+            mutate(&mut rng, &mut s);
+            s
+        }).collect();
+        let baselines = vec![EntityState::default(); MAX_EDICTS];
+        let frames: Vec<Vec<EntityState>> = (0..200).map(|_| {
+            for s in world.iter_mut().skip(1) {
+                if rng.chance(60) {
+                    mutate(&mut rng, s);
+                }
+            }
+            world.iter().skip(1).filter(|_| rng.chance(30)).cloned().collect()
+        }).collect();
+
+        for (name, quant) in [("bytes", None), ("bits/standard", Some(EntityQuant::Standard)), ("bits/precise", Some(EntityQuant::Precise))] {
+            let rounds = 20;
+            let mut bytes = 0;
+            let mut encode = std::time::Duration::ZERO;
+            let mut decode = std::time::Duration::ZERO;
+            for _ in 0..rounds {
+                let mut client = Vec::new();
+                for (i, frame) in frames.iter().enumerate() {
+                    let from = if i == 0 { &[][..] } else { &frames[i - 1][..] };
+                    let start = std::time::Instant::now();
+                    let mut msg = emit(from, frame, &baselines, quant);
+                    encode += start.elapsed();
+                    bytes += msg.cursize as usize;
+                    let start = std::time::Instant::now();
+                    client = parse(&mut msg, &client, &baselines, quant.is_some());
+                    decode += start.elapsed();
+                }
+            }
+            let n = (rounds * frames.len()) as f64;
+            println!(
+                "{:14} {:7.1} bytes/frame, encode {:6.2} us/frame, decode {:6.2} us/frame",
+                name,
+                bytes as f64 / n,
+                encode.as_secs_f64() * 1e6 / n,
+                decode.as_secs_f64() * 1e6 / n
+            );
+        }
+    }
 }
@@ -5,7 +5,7 @@
 // Licensed under the GNU General Public License v2+
 
 use std::fs::File;
-use std::io::{Write, BufWriter};
+use std::io::{Read, Write, BufWriter};
 use std::sync::{Arc, Mutex, LazyLock};
 
 use myq2_common::q_shared::*;
@@ -574,7 +574,8 @@ fn cl_send_cmd() {
     // Clean up old predicted weapon effects
     cl.smoothing.weapon_prediction.cleanup(cls.realtime);
 }
-fn cl_parse_server_message() {
+/// Returns false if the connection has to be dropped.
+fn cl_parse_server_message() -> bool {
     let mut cl = CL.lock().unwrap();
     let mut cls = CLS.lock().unwrap();
     let mut con = PARSE_CON.lock().unwrap();
@@ -603,7 +604,7 @@ fn cl_parse_server_message() {
         &mut cl_entities,
         cl_shownet_value,
         &mut ctx,
-    );
+    )
 }
 fn cl_parse_clientinfo(player: i32) {
     let mut cl = CL.lock().unwrap();
@@ -849,8 +850,6 @@ pub fn cl_stopdemo() {
 /// Read a message from the demo file.
 /// Returns true if a message was read, false if end of demo.
 fn cl_read_demo_message() -> bool {
-    use std::io::Read;
-
     let mut playback = crate::cl_demo::DEMO_PLAYBACK.lock().unwrap();
 
     if !playback.playing {
@@ -897,35 +896,15 @@ fn cl_read_demo_message() -> bool {
         return false;
     }
 
-    if msg_len <= 0 || msg_len > MAX_MSGLEN as i32 {
+    // Read the message data into NET_MESSAGE
+    let result = demo_read_block(reader, msg_len, &mut NET_MESSAGE.lock().unwrap());
+    if let Err(error) = result {
         drop(playback);
         cl_stopdemo();
-        com_printf("Demo message length out of range.\n");
+        com_printf(error);
         return false;
     }
 
-    // Read the message data into NET_MESSAGE
-    {
-        let mut net_msg = NET_MESSAGE.lock().unwrap();
-        let msg_len_usize = msg_len as usize;
-
-        // Ensure buffer is large enough
-        if net_msg.data.len() < msg_len_usize {
-            net_msg.data.resize(msg_len_usize + 16, 0);
-        }
-
-        if reader.read_exact(&mut net_msg.data[..msg_len_usize]).is_err() {
-            drop(playback);
-            drop(net_msg);
-            cl_stopdemo();
-            com_printf("Error reading demo message.\n");
-            return false;
-        }
-
-        net_msg.cursize = msg_len;
-        net_msg.readcount = 0;
-    }
-
     // Update playback time from the frame if present
     // (This is a simplified version - the full version would parse the frame)
 
@@ -1120,7 +1099,8 @@ fn cl_browser_sort_f() {
 // ============================================================
 
 // PROTOCOL_VERSION and CLC_* come from qcommon
-use myq2_common::qcommon::{PROTOCOL_VERSION, CLC_STRINGCMD};
+use myq2_common::qcommon::{PROTOCOL_VERSION, PROTOCOL_Q2PRO, CLC_STRINGCMD};
+use myq2_common::msg_bits::EntityQuant;
 const PORT_SERVER: u16 = myq2_common::qcommon::PORT_SERVER as u16;
 
 const NS_CLIENT: i32 = 0;
@@ -1389,6 +1369,10 @@ fn dedicated_value() -> bool { myq2_common::cvar::cvar_variable_value("dedicated
 fn host_speeds_value() -> bool { myq2_common::cvar::cvar_variable_value("host_speeds") != 0.0 }
 fn log_stats_value() -> bool { myq2_common::cvar::cvar_variable_value("log_stats") != 0.0 }
 fn cl_autorecord_value() -> bool { myq2_common::cvar::cvar_variable_value("cl_autorecord") != 0.0 }
+fn cl_entity_profile_value() -> EntityQuant {
+    let profile = myq2_common::cvar::cvar_variable_value("cl_entity_profile") as i32;
+    EntityQuant::from_i32(profile.clamp(EntityQuant::Standard as i32, EntityQuant::BEST as i32)).unwrap_or(EntityQuant::Standard)
+}
 
 /// Generate an automatic demo filename with timestamp.
 /// Format: demo_YYYYMMDD_HHMMSS.dm2
@@ -1476,6 +1460,32 @@ pub fn cl_write_demo_message() {
 // R1Q2/Q2Pro -z flag support for compressed demo recording
 // ============================================================
 
+/// Largest demo block: a protocol 36 frame is recorded as reassembled from
+/// its fragments, so it may exceed MAX_MSGLEN.
+const MAX_DEMO_MSGLEN: usize = myq2_common::net_chan::MAX_FRAGMENTED_MSGLEN;
+
+/// Read the data of a demo block of `msg_len` bytes (the length already
+/// read) into `net_msg`, growing its buffer as needed.
+fn demo_read_block(reader: &mut impl Read, msg_len: i32, net_msg: &mut SizeBuf) -> Result<(), &'static str> {
+    if msg_len <= 0 || msg_len > MAX_DEMO_MSGLEN as i32 {
+        return Err("Demo message length out of range.\n");
+    }
+    let msg_len_usize = msg_len as usize;
+
+    // Ensure buffer is large enough
+    if net_msg.data.len() < msg_len_usize {
+        net_msg.data.resize(msg_len_usize + 16, 0);
+    }
+
+    if reader.read_exact(&mut net_msg.data[..msg_len_usize]).is_err() {
+        return Err("Error reading demo message.\n");
+    }
+
+    net_msg.cursize = msg_len;
+    net_msg.readcount = 0;
+    Ok(())
+}
+
 /// Write a demo message block, optionally with compression.
 /// Format: 4-byte length (negative if compressed) + data
 fn demo_write_message(data: &[u8]) {
@@ -1483,26 +1493,32 @@ fn demo_write_message(data: &[u8]) {
     let compressed = *DEMO_COMPRESSED.lock().unwrap();
 
     if let Some(ref mut file) = *demo_file {
-        if compressed && data.len() > 100 {
-            // Try to compress the data
-            if let Some(compressed_data) = myq2_common::compression::compress_packet(data) {
-                // Write negative length to indicate compression, followed by original length
-                let compressed_len = compressed_data.len() as i32;
-                let original_len = data.len() as i32;
-
-                // Format: -compressed_len (4 bytes) + original_len (4 bytes) + compressed_data
-                let _ = file.write_all(&(-compressed_len).to_le_bytes());
-                let _ = file.write_all(&original_len.to_le_bytes());
-                let _ = file.write_all(&compressed_data);
-                return;
-            }
-        }
+        demo_write_block(file, data, compressed);
+    }
+}
 
-        // Write uncompressed (or compression not beneficial)
-        let len = little_long(data.len() as i32);
-        let _ = file.write_all(&len.to_le_bytes());
-        let _ = file.write_all(data);
+/// Write one demo block to `file`: the length and the data, compressed when
+/// that pays off.
+fn demo_write_block(file: &mut impl Write, data: &[u8], compressed: bool) {
+    if compressed && data.len() > 100 {
+        // Try to compress the data
+        if let Some(compressed_data) = myq2_common::compression::compress_packet(data) {
+            // Write negative length to indicate compression, followed by original length
+            let compressed_len = compressed_data.len() as i32;
+            let original_len = data.len() as i32;
+
+            // Format: -compressed_len (4 bytes) + original_len (4 bytes) + compressed_data
+            let _ = file.write_all(&(-compressed_len).to_le_bytes());
+            let _ = file.write_all(&original_len.to_le_bytes());
+            let _ = file.write_all(&compressed_data);
+            return;
+        }
     }
+
+    // Write uncompressed (or compression not beneficial)
+    let len = little_long(data.len() as i32);
+    let _ = file.write_all(&len.to_le_bytes());
+    let _ = file.write_all(data);
 }
 
 // ============================================================
@@ -2108,11 +2124,18 @@ pub fn cl_send_connect_packet() {
         NS_CLIENT,
         adr,
         &format!(
-            "connect {} {} {} \"{}\"\n",
+            "connect {} {} {} \"{}\"{}\n",
             server_protocol,
             port,
             challenge,
-            cvar_userinfo()
+            cvar_userinfo(),
+            // offer the windowed reliable netchan (see net_chan.rs) and
+            // bit-packed packet entities (see msg_bits.rs)
+            if server_protocol >= PROTOCOL_Q2PRO {
+                format!(" nc=1 be={}", cl_entity_profile_value() as i32)
+            } else {
+                String::new()
+            }
         ),
     );
 }
@@ -2740,6 +2763,13 @@ pub fn cl_connectionless_packet() {
         let net_from = NET_FROM.lock().unwrap();
         let qport = cls.quake_port;
         netchan_setup(NS_CLIENT, &mut cls.netchan, net_from.clone(), qport);
+        if (1..cmd_argc()).any(|i| cmd_argv(i) == "nc=1") {
+            // the server took the windowed netchan, which only exists on
+            // protocol 36, so the channel is framed for it from the start
+            let protocol = cls.server_protocol;
+            myq2_common::net_chan::netchan_set_protocol(&mut cls.netchan, protocol);
+            myq2_common::net_chan::netchan_set_windowed(&mut cls.netchan, true);
+        }
         msg_write_char(&mut cls.netchan.message, CLC_STRINGCMD.into());
         msg_write_string(&mut cls.netchan.message, "new");
         cls.state = crate::client::ConnState::Connected;
@@ -2845,9 +2875,9 @@ pub fn cl_read_packets() {
         if cls.demo_playing {
             drop(cls);
             // Read from demo file instead of network
-            if cl_read_demo_message() {
-                // Parse the demo message just like a network message
-                cl_parse_server_message();
+            // Parse the demo message just like a network message
+            if cl_read_demo_message() && !cl_parse_server_message() {
+                cl_stopdemo();
             }
             return;
         }
@@ -2916,7 +2946,10 @@ pub fn cl_read_packets() {
             }
         }
 
-        cl_parse_server_message();
+        if !cl_parse_server_message() {
+            cl_disconnect();
+            return;
+        }
     }
 
     // check timeout
@@ -3587,6 +3620,10 @@ pub fn cl_init_local() {
     // HTTP download cvars (R1Q2-style)
     cvar_get("cl_http_downloads", "1", CVAR_ARCHIVE);  // enabled by default
 
+    // Bit-packed packet entities profile offered at connect
+    // 1=standard (byte-format precision), 2=precise (16-bit angles)
+    cvar_get("cl_entity_profile", "1", CVAR_ARCHIVE);
+
     // Network smoothing cvars (R1Q2/Q2Pro feature)
     *CL_TIMENUDGE.lock().unwrap() = cvar_get("cl_timenudge", "0", CVAR_ARCHIVE);
     *CL_EXTRAPOLATE.lock().unwrap() = cvar_get("cl_extrapolate", "1", CVAR_ARCHIVE);
@@ -4699,12 +4736,37 @@ mod tests {
 
     #[test]
     fn test_demo_message_length_validation() {
-        // Valid lengths are > 0 and <= MAX_MSGLEN
-        assert!(1 > 0 && 1 <= MAX_MSGLEN as i32);
-        assert!(MAX_MSGLEN as i32 > 0 && MAX_MSGLEN as i32 <= MAX_MSGLEN as i32);
-        assert!(!(0 > 0)); // 0 is invalid
-        assert!(!(-1 > 0)); // -1 is end marker
-        assert!(!(MAX_MSGLEN as i32 + 1 <= MAX_MSGLEN as i32)); // too big
+        // Valid lengths are > 0 and <= MAX_DEMO_MSGLEN
+        let mut msg = SizeBuf::new(MAX_MSGLEN as i32);
+        let data = vec![0u8; MAX_DEMO_MSGLEN + 1];
+        assert!(demo_read_block(&mut &data[..], 0, &mut msg).is_err()); // 0 is invalid
+        assert!(demo_read_block(&mut &data[..], -1, &mut msg).is_err()); // -1 is end marker
+        assert!(demo_read_block(&mut &data[..], MAX_DEMO_MSGLEN as i32 + 1, &mut msg).is_err()); // too big
+        assert!(demo_read_block(&mut &data[..], MAX_DEMO_MSGLEN as i32, &mut msg).is_ok());
+    }
+
+    #[test]
+    fn test_demo_oversized_frame_round_trip() {
+        // a reassembled protocol 36 frame larger than MAX_MSGLEN is recorded
+        // as one block and plays back whole
+        let frame: Vec<u8> = (0..MAX_MSGLEN * 3 + 17).map(|i| (i * 7 % 251) as u8).collect();
+        let mut demo = Vec::new();
+        demo_write_block(&mut demo, &frame, false);
+        demo_write_block(&mut demo, b"next", false);
+        demo.extend_from_slice(&(-1i32).to_le_bytes());
+
+        let mut reader = &demo[..];
+        let mut msg = SizeBuf::new(MAX_MSGLEN as i32);
+        for expected in [&frame[..], b"next"] {
+            let mut len = [0u8; 4];
+            reader.read_exact(&mut len).unwrap();
+            demo_read_block(&mut reader, i32::from_le_bytes(len), &mut msg).unwrap();
+            assert_eq!(&msg.data[..msg.cursize as usize], expected);
+            assert_eq!(msg.readcount, 0);
+        }
+        let mut len = [0u8; 4];
+        reader.read_exact(&mut len).unwrap();
+        assert_eq!(i32::from_le_bytes(len), -1);
     }
 
     // -------------------------------------------------------
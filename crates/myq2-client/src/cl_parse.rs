@@ -1066,7 +1066,8 @@ pub use crate::console_types::Console;
 
 /// Helper to parse a single command from a decompressed zpacket.
 /// This handles the same commands as the main cl_parse_server_message loop
-/// but operates on a separate message buffer.
+/// but operates on a separate message buffer. Returns false if the
+/// connection has to be dropped.
 fn cl_parse_decompressed_cmd(
     cmd: i32,
     cl: &mut ClientState,
@@ -1076,7 +1077,7 @@ fn cl_parse_decompressed_cmd(
     cl_entities: &mut [CEntity],
     cl_shownet_value: f32,
     ctx: &mut ParseContext,
-) {
+) -> bool {
     if cl_shownet_value >= 2.0 {
         let cmd_usize = cmd as usize;
         if cmd_usize >= SVC_STRINGS.len() {
@@ -1183,7 +1184,7 @@ fn cl_parse_decompressed_cmd(
                 sound: ctx.sound,
                 cl_time: cl.time as f32,
             };
-            crate::cl_ents::cl_parse_frame(
+            if !crate::cl_ents::cl_parse_frame(
                 cl,
                 cls,
                 ctx.ent_state,
@@ -1191,7 +1192,9 @@ fn cl_parse_decompressed_cmd(
                 cl_shownet_value,
                 &svc_strs,
                 &mut frame_cb,
-            );
+            ) {
+                return false;
+            }
 
             // Clear projectiles for new frame (see main dispatch for full comment)
             crate::cl_ents::cl_clear_projectiles(ctx.proj_state);
@@ -1234,9 +1237,11 @@ fn cl_parse_decompressed_cmd(
             com_error(ERR_DROP, &format!("CL_ParseServerMessage: Illegible server message {} in zpacket\n", cmd));
         }
     }
+    true
 }
 
-/// Parse the entire server message.
+/// Parse the entire server message. Returns false if the connection has to
+/// be dropped.
 pub fn cl_parse_server_message(
     cl: &mut ClientState,
     cls: &mut ClientStatic,
@@ -1245,7 +1250,7 @@ pub fn cl_parse_server_message(
     cl_entities: &mut [CEntity],
     cl_shownet_value: f32,
     ctx: &mut ParseContext,
-) {
+) -> bool {
     if cl_shownet_value == 1.0 {
         com_printf(&format!("{} ", net_message.cursize));
     } else if cl_shownet_value >= 2.0 {
@@ -1380,7 +1385,7 @@ pub fn cl_parse_server_message(
                     sound: ctx.sound,
                     cl_time: cl.time as f32,
                 };
-                crate::cl_ents::cl_parse_frame(
+                if !crate::cl_ents::cl_parse_frame(
                     cl,
                     cls,
                     ctx.ent_state,
@@ -1388,7 +1393,9 @@ pub fn cl_parse_server_message(
                     cl_shownet_value,
                     &svc_strs,
                     &mut frame_cb,
-                );
+                ) {
+                    return false;
+                }
 
                 // Clear projectiles for new frame and parse if protocol supports it.
                 // In vanilla Q2 this was #if 0'd (the compact projectile protocol was
@@ -1467,7 +1474,7 @@ pub fn cl_parse_server_message(
 
                     // Process inner command - delegate to individual handlers
                     // Note: We handle the most common message types here
-                    cl_parse_decompressed_cmd(
+                    if !cl_parse_decompressed_cmd(
                         inner_cmd,
                         cl,
                         cls,
@@ -1476,7 +1483,9 @@ pub fn cl_parse_server_message(
                         cl_entities,
                         cl_shownet_value,
                         ctx,
-                    );
+                    ) {
+                        return false;
+                    }
                 }
             }
 
@@ -1498,6 +1507,7 @@ pub fn cl_parse_server_message(
     if cls.demo_recording && !cls.demo_waiting {
         cl_write_demo_message();
     }
+    true
 }
 
 // ============================================================
@@ -1736,4 +1746,52 @@ mod tests {
         let stripped = com_strip_extension(name);
         assert_eq!(stripped, "textures/e1u1.wall");
     }
+
+    // -------------------------------------------------------
+    // cl_parse_server_message drop tests
+    // -------------------------------------------------------
+
+    #[test]
+    fn test_unknown_entity_profile_drops_connection() {
+        use myq2_common::common::{msg_write_long, msg_write_short};
+        use myq2_common::qcommon::{SVC_PACKETENTITIES_BITS, SVC_PLAYERINFO};
+
+        let mut msg = SizeBuf::new(64);
+        msg_write_byte(&mut msg, SvcOps::Frame as i32);
+        msg_write_long(&mut msg, 1); // serverframe
+        msg_write_long(&mut msg, 0); // uncompressed
+        msg_write_byte(&mut msg, 0); // surpresscount
+        msg_write_byte(&mut msg, 0); // no areabits
+        msg_write_byte(&mut msg, SVC_PLAYERINFO);
+        msg_write_short(&mut msg, 0);
+        msg_write_long(&mut msg, 0); // no stats
+        msg_write_byte(&mut msg, SVC_PACKETENTITIES_BITS);
+        msg_write_byte(&mut msg, 99); // no such profile
+        msg_write_short(&mut msg, 0);
+        // nothing after the frame may be parsed
+        msg_write_byte(&mut msg, SvcOps::Layout as i32);
+        msg_write_string(&mut msg, "after");
+
+        let mut cl = ClientState::default();
+        let mut cls = ClientStatic::default();
+        cls.state = ConnState::Connected;
+        let mut con = Console::default();
+        let mut cl_entities = vec![CEntity::default(); 4];
+        let (mut scr, mut fx, mut tent) = (ScrState::default(), ClFxState::new(), TEntState::default());
+        let (mut ent_state, mut sound) = (crate::cl_ents::ClientEntState::default(), SoundState::default());
+        let mut proj_state = crate::cl_ents::ProjectileState::default();
+        let mut ctx = ParseContext {
+            scr: &mut scr,
+            fx: &mut fx,
+            tent: &mut tent,
+            ent_state: &mut ent_state,
+            sound: &mut sound,
+            proj_state: &mut proj_state,
+        };
+
+        assert!(!cl_parse_server_message(&mut cl, &mut cls, &mut con, &mut msg, &mut cl_entities, 0.0, &mut ctx));
+        assert!(!cl.frame.valid);
+        assert_eq!(cls.state, ConnState::Connected);
+        assert!(cl.layout.is_empty());
+    }
 }
@@ -1,6 +1,10 @@
-// anorms.rs — Pre-computed vertex normals for MD2 models
+// anorms.rs — Pre-computed vertex normals for MD2 models, and the
+// direction lookup MSG_WriteDir quantizes against them
 // Converted from: myq2-original/client/anorms.h
 
+use std::sync::OnceLock;
+
+use crate::q_shared::Vec3;
 use crate::qcommon::NUMVERTEXNORMALS;
 
 #[rustfmt::skip]
@@ -168,3 +172,235 @@ pub const BYTEDIRS: [[f32; 3]; NUMVERTEXNORMALS] = [
     [-0.587785, -0.425325, -0.688191],
     [-0.688191, -0.587785, -0.425325],
 ];
+
+// ============================================================
+// Direction quantization
+// ============================================================
+//
+// MSG_WriteDir picks the BYTEDIRS entry with the largest dot product. Rather
+// than test all 162, directions are folded onto an octahedron and unwrapped
+// to a DIR_GRID x DIR_GRID square; each cell keeps the few normals that can
+// win anywhere inside it, and only those are tested, in the same order and
+// with the same comparison as the full search, so the index is identical.
+
+/// Cells per side of the octahedral lookup.
+const DIR_GRID: usize = 64;
+
+/// Extra angle (radians) allowed when collecting a cell's candidates, far
+/// above float rounding in the dot products and the unnormalized table.
+const DIR_SLACK: f64 = 0.002;
+
+struct DirLookup {
+    /// Start of each cell's candidates; one extra entry closes the last cell.
+    offsets: Vec<u16>,
+    /// Candidate normals per cell, ascending.
+    candidates: Vec<u8>,
+}
+
+static DIR_LOOKUP: OnceLock<DirLookup> = OnceLock::new();
+
+fn dot(dir: &Vec3, i: usize) -> f32 {
+    dir[0] * BYTEDIRS[i][0] + dir[1] * BYTEDIRS[i][1] + dir[2] * BYTEDIRS[i][2]
+}
+
+/// The original MSG_WriteDir search over `indices`.
+fn search(dir: &Vec3, indices: impl Iterator<Item = usize>) -> u8 {
+    let mut best = 0;
+    let mut bestd: f32 = 0.0;
+    for i in indices {
+        let d = dot(dir, i);
+        if d > bestd {
+            bestd = d;
+            best = i;
+        }
+    }
+    best as u8
+}
+
+/// Octahedral square coordinates of a direction, each in [-1, 1].
+fn oct_encode(dir: &Vec3, l1: f32) -> (f32, f32) {
+    let (u, v) = (dir[0] / l1, dir[1] / l1);
+    if dir[2] >= 0.0 {
+        (u, v)
+    } else {
+        (
+            (1.0 - v.abs()) * if u >= 0.0 { 1.0 } else { -1.0 },
+            (1.0 - u.abs()) * if v >= 0.0 { 1.0 } else { -1.0 },
+        )
+    }
+}
+
+fn oct_decode(u: f64, v: f64) -> [f64; 3] {
+    let z = 1.0 - u.abs() - v.abs();
+    let (x, y) = if z >= 0.0 {
+        (u, v)
+    } else {
+        ((1.0 - v.abs()) * u.signum(), (1.0 - u.abs()) * v.signum())
+    };
+    let len = (x * x + y * y + z * z).sqrt();
+    [x / len, y / len, z / len]
+}
+
+fn oct_cell(u: f32) -> usize {
+    (((u + 1.0) * (DIR_GRID as f32 / 2.0)) as usize).min(DIR_GRID - 1)
+}
+
+fn angle(a: &[f64; 3], b: &[f64; 3]) -> f64 {
+    (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]).clamp(-1.0, 1.0).acos()
+}
+
+impl DirLookup {
+    fn build() -> Self {
+        let normals: Vec<[f64; 3]> = BYTEDIRS
+            .iter()
+            .map(|n| {
+                let len = (n[0] as f64).hypot(n[1] as f64).hypot(n[2] as f64);
+                [n[0] as f64 / len, n[1] as f64 / len, n[2] as f64 / len]
+            })
+            .collect();
+        let step = 2.0 / DIR_GRID as f64;
+        const SAMPLES: usize = 9;
+
+        let mut offsets = Vec::with_capacity(DIR_GRID * DIR_GRID + 1);
+        let mut candidates = Vec::new();
+        for cy in 0..DIR_GRID {
+            for cx in 0..DIR_GRID {
+                let (u0, v0) = (cx as f64 * step - 1.0, cy as f64 * step - 1.0);
+                let center = oct_decode(u0 + step / 2.0, v0 + step / 2.0);
+
+                // bounding cone of the cell, from its edges and interior
+                let mut radius: f64 = 0.0;
+                for sy in 0..SAMPLES {
+                    for sx in 0..SAMPLES {
+                        let t = step / (SAMPLES - 1) as f64;
+                        let p = oct_decode(u0 + sx as f64 * t, v0 + sy as f64 * t);
+                        radius = radius.max(angle(&center, &p));
+                    }
+                }
+                radius = radius * 1.1 + DIR_SLACK;
+
+                // a normal can win somewhere in the cone only if it is
+                // within 2 * radius of the nearest normal to the center
+                let angles: Vec<f64> = normals.iter().map(|n| angle(&center, n)).collect();
+                let nearest = angles.iter().cloned().fold(f64::INFINITY, f64::min);
+                offsets.push(candidates.len() as u16);
+                candidates.extend((0..NUMVERTEXNORMALS).filter(|&i| angles[i] <= nearest + 2.0 * radius).map(|i| i as u8));
+            }
+        }
+        offsets.push(candidates.len() as u16);
+        assert!(candidates.len() < u16::MAX as usize);
+        Self { offsets, candidates }
+    }
+
+    fn index(&self, dir: &Vec3) -> u8 {
+        let l1 = dir[0].abs() + dir[1].abs() + dir[2].abs();
+        // zero, denormal, huge and NaN vectors: the dot products round or
+        // overflow in ways the lookup does not model
+        if !(1e-18..1e18).contains(&l1) {
+            return search(dir, 0..NUMVERTEXNORMALS);
+        }
+        let (u, v) = oct_encode(dir, l1);
+        let cell = oct_cell(v) * DIR_GRID + oct_cell(u);
+        let cands = &self.candidates[self.offsets[cell] as usize..self.offsets[cell + 1] as usize];
+        search(dir, cands.iter().map(|&i| i as usize))
+    }
+}
+
+fn dir_lookup() -> &'static DirLookup {
+    DIR_LOOKUP.get_or_init(DirLookup::build)
+}
+
+/// Index of the BYTEDIRS entry nearest to `dir`, as MSG_WriteDir sends it.
+pub fn dir_to_byte(dir: &Vec3) -> u8 {
+    dir_lookup().index(dir)
+}
+
+/// dir_to_byte over a slice, for effects that quantize many normals.
+pub fn dirs_to_bytes(dirs: &[Vec3], out: &mut [u8]) {
+    assert_eq!(dirs.len(), out.len(), "dirs_to_bytes: length mismatch");
+    let lookup = dir_lookup();
+    for (dir, byte) in dirs.iter().zip(out.iter_mut()) {
+        *byte = lookup.index(dir);
+    }
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn brute(dir: &Vec3) -> u8 {
+        search(dir, 0..NUMVERTEXNORMALS)
+    }
+
+    fn check(dir: Vec3) {
+        for scale in [1.0, 1e-6, 1e6] {
+            let d = [dir[0] * scale, dir[1] * scale, dir[2] * scale];
+            assert_eq!(dir_to_byte(&d), brute(&d), "dir {:?}", d);
+        }
+    }
+
+    #[test]
+    fn test_dir_lookup_sphere() {
+        // Fibonacci sphere
+        let n = 20_000;
+        let golden = std::f64::consts::PI * (3.0 - 5f64.sqrt());
+        for i in 0..n {
+            let z = 1.0 - (i as f64 + 0.5) * 2.0 / n as f64;
+            let r = (1.0 - z * z).sqrt();
+            let phi = i as f64 * golden;
+            check([(r * phi.cos()) as f32, (r * phi.sin()) as f32, z as f32]);
+        }
+    }
+
+    #[test]
+    fn test_dir_lookup_cells() {
+        // a fine grid over the octahedral square hits every cell, its edges
+        // and the fold lines
+        let n = 4 * DIR_GRID;
+        for y in 0..=n {
+            for x in 0..=n {
+                let d = oct_decode(x as f64 * 2.0 / n as f64 - 1.0, y as f64 * 2.0 / n as f64 - 1.0);
+                check([d[0] as f32, d[1] as f32, d[2] as f32]);
+            }
+        }
+    }
+
+    #[test]
+    fn test_dir_lookup_special() {
+        for n in BYTEDIRS.iter() {
+            check(*n);
+            check([-n[0], -n[1], -n[2]]);
+        }
+        for axis in 0..3 {
+            for sign in [1.0, -1.0] {
+                let mut d = [0.0; 3];
+                d[axis] = sign;
+                check(d);
+            }
+        }
+        for d in [[0.0; 3], [f32::NAN, 0.0, 1.0], [f32::INFINITY, 0.0, 0.0], [1e-30, 0.0, 0.0], [3e38, 3e38, 0.0]] {
+            assert_eq!(dir_to_byte(&d), brute(&d), "dir {:?}", d);
+        }
+    }
+
+    #[test]
+    fn test_dirs_to_bytes() {
+        let dirs: Vec<Vec3> = (0..50).map(|i| [(i as f32).sin(), (i as f32 * 0.7).cos(), i as f32 * 0.01 - 0.2]).collect();
+        let mut out = vec![0u8; dirs.len()];
+        dirs_to_bytes(&dirs, &mut out);
+        for (d, b) in dirs.iter().zip(&out) {
+            assert_eq!(*b, brute(d));
+        }
+    }
+
+    #[test]
+    fn test_dir_lookup_candidates() {
+        let lookup = dir_lookup();
+        let average = lookup.candidates.len() as f64 / (DIR_GRID * DIR_GRID) as f64;
+        assert!(average < 8.0, "{} candidates per cell", average);
+    }
+}
@@ -110,7 +110,7 @@ pub fn z_free<T>(_ptr: T) {
 // Bytedirs table — 162 pre-computed vertex normals for MD2 models
 // ============================================================
 
-pub use crate::anorms::BYTEDIRS;
+pub use crate::anorms::{BYTEDIRS, dir_to_byte, dirs_to_bytes};
 
 // ============================================================
 // SizeBuf operations
@@ -253,19 +253,9 @@ pub fn msg_write_delta_usercmd(buf: &mut SizeBuf, from: &UserCmd, cmd: &UserCmd)
     msg_write_byte(buf, cmd.lightlevel as i32);
 }
 
+/// Sends the index of the nearest BYTEDIRS entry; see anorms::dir_to_byte.
 pub fn msg_write_dir(sb: &mut SizeBuf, dir: &Vec3) {
-    let mut best = 0;
-    let mut bestd: f32 = 0.0;
-
-    for i in 0..NUMVERTEXNORMALS {
-        let d = dir[0] * BYTEDIRS[i][0] + dir[1] * BYTEDIRS[i][1] + dir[2] * BYTEDIRS[i][2];
-        if d > bestd {
-            bestd = d;
-            best = i;
-        }
-    }
-
-    msg_write_byte(sb, best as i32);
+    msg_write_byte(sb, dir_to_byte(dir) as i32);
 }
 
 // ============================================================
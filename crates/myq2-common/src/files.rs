@@ -94,6 +94,19 @@ pub struct SearchPath {
     pub pack: Option<Pack>,
 }
 
+/// Where a file resolves on the search path and when that source last
+/// changed, for keying caches of data derived from the file.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct FileStamp {
+    /// Loose file path, or the pak/zip holding the file.
+    pub source: String,
+    /// Offset of the file within `source` (0 for loose files).
+    pub offset: u64,
+    pub length: u64,
+    /// Modification time of `source` in seconds since the epoch (0 if unknown).
+    pub mtime: u64,
+}
+
 /// Result of opening a file through the virtual filesystem.
 pub struct FsOpenResult {
     pub file: File,
@@ -330,6 +343,46 @@ impl FsContext {
         Some(result.length)
     }
 
+    /// Resolves `filename` like `fopen_file` without opening it and returns
+    /// its source, size and modification time.
+    pub fn file_stamp(&self, filename: &str) -> Option<FileStamp> {
+        fn stamp(source: &str, offset: u64, length: Option<u64>) -> Option<FileStamp> {
+            let meta = fs::metadata(source).ok()?;
+            let mtime = meta
+                .modified()
+                .ok()
+                .and_then(|t| t.duration_since(std::time::UNIX_EPOCH).ok())
+                .map_or(0, |d| d.as_secs());
+            Some(FileStamp {
+                source: source.to_string(),
+                offset,
+                length: length.unwrap_or(meta.len()),
+                mtime,
+            })
+        }
+
+        for link in &self.links {
+            if filename.starts_with(&link.from) {
+                let netpath = format!("{}{}", link.to, &filename[link.from.len()..]);
+                return stamp(&netpath, 0, None);
+            }
+        }
+
+        for sp in &self.search_paths {
+            if let Some(ref pack) = sp.pack {
+                if let Some(pf) = pack.find_file(filename) {
+                    return stamp(&pack.filename, pf.filepos as u64, Some(pf.filelen as u64));
+                }
+            } else {
+                let netpath = format!("{}/{}", sp.filename, filename);
+                if Path::new(&netpath).is_file() {
+                    return stamp(&netpath, 0, None);
+                }
+            }
+        }
+        None
+    }
+
     // ============================================================
     // FS_LoadPackFile
     // ============================================================
@@ -872,6 +925,10 @@ pub fn fs_load_file_ex(name: &str) -> (Option<Vec<u8>>, bool) {
     }
 }
 
+pub fn fs_file_stamp(name: &str) -> Option<FileStamp> {
+    FS_CTX.lock().unwrap().as_ref().and_then(|c| c.file_stamp(name))
+}
+
 pub fn fs_file_length(name: &str) -> Option<i32> {
     FS_CTX.lock().unwrap().as_mut().and_then(|c| c.file_length(name))
 }
@@ -1118,4 +1175,34 @@ mod tests {
         assert_eq!(ctx.next_path(Some("dir1")), Some("dir2"));
         assert_eq!(ctx.next_path(Some("dir2")), None);
     }
+
+    #[test]
+    fn test_file_stamp_loose_and_pak() {
+        let dir = std::env::temp_dir().join("myq2_test_file_stamp");
+        let _ = fs::remove_dir_all(&dir);
+        fs::create_dir_all(dir.join("textures")).unwrap();
+        fs::write(dir.join("textures/a.tga"), [1u8; 37]).unwrap();
+        let dirname = dir.to_string_lossy().replace('\\', "/");
+
+        let mut ctx = FsContext::new();
+        ctx.search_paths.push(SearchPath {
+            pack: Some(Pack::new(
+                "no_such.pak".to_string(),
+                vec![PackFile { name: "textures/b.tga".to_string(), filepos: 100, filelen: 50 }],
+            )),
+            filename: String::new(),
+        });
+        ctx.search_paths.push(SearchPath { filename: dirname.clone(), pack: None });
+
+        let stamp = ctx.file_stamp("textures/a.tga").unwrap();
+        assert_eq!(stamp.source, format!("{}/textures/a.tga", dirname));
+        assert_eq!((stamp.offset, stamp.length), (0, 37));
+        assert!(stamp.mtime > 0);
+
+        // pak entries are stamped by the archive, which must exist
+        assert_eq!(ctx.file_stamp("textures/b.tga"), None);
+        assert_eq!(ctx.file_stamp("textures/c.tga"), None);
+
+        let _ = fs::remove_dir_all(&dir);
+    }
 }
@@ -20,6 +20,7 @@ pub mod qcommon;
 pub mod cmd;
 pub mod cvar;
 pub mod common;
+pub mod msg_bits;
 mod anorms;
 pub mod net_chan;
 pub mod files;
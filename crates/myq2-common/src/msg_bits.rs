@@ -0,0 +1,531 @@
+// msg_bits.rs — Bit-packed entity deltas
+//
+// Protocol extension negotiated with "be=<profile>" in the connect string.
+// A server that accepts it sends svc_packetentities_bits instead of
+// svc_packetentities: the opcode, a profile byte, then one bit stream for
+// the whole entity list, padded to a byte at the end. Per entity:
+//
+//   number gap from the previous entity (0 ends the list), remove:1
+//   changed: origin angles frame event :4, more:1, and if more
+//            models skin effects renderfx solid sound oldorigin :7
+//   origin     axis mask:3, per axis the change of the 1/8 unit coordinate
+//   angles     axis mask:3, per axis the angle at the profile's precision
+//   frame      change from the previous frame
+//   models     mask:4, per model 8 bits
+//   oldorigin  per axis, relative to the new origin
+//
+// Numbers are sent as a unary width class followed by that many bits
+// (`BitWriter::write_classes`); signed changes are zigzagged first, so an
+// entity moving a few units costs a handful of bits per axis rather than a
+// short. Values are quantized exactly as MSG_WriteDeltaEntity does, so the
+// standard profile decodes to the same entity_state_t as the byte format;
+// the precise profile sends 16-bit angles.
+
+use crate::common::{msg_read_byte, msg_write_byte};
+use crate::q_shared::{EntityState, MAX_EDICTS, RF_BEAM};
+use crate::qcommon::SizeBuf;
+
+/// Width classes of an entity number gap.
+const NUMBER_CLASSES: [u32; 3] = [3, 6, 10];
+/// Width classes of a zigzagged change in a 1/8 unit coordinate.
+const COORD_CLASSES: [u32; 4] = [4, 8, 12, 16];
+/// Width classes of a zigzagged frame change.
+const FRAME_CLASSES: [u32; 4] = [2, 6, 16, 32];
+const SKIN_CLASSES: [u32; 4] = [4, 8, 16, 32];
+const FLAG_CLASSES: [u32; 3] = [8, 16, 32];
+
+// ============================================================
+// Bit writer / reader
+// ============================================================
+
+/// Accumulates a bit stream, least significant bit first, to be appended to
+/// a SizeBuf in one piece.
+#[derive(Debug, Default)]
+pub struct BitWriter {
+    bytes: Vec<u8>,
+    acc: u64,
+    count: u32,
+}
+
+impl BitWriter {
+    pub fn new() -> Self {
+        Self { bytes: Vec::with_capacity(256), ..Self::default() }
+    }
+
+    /// Write the low `bits` bits of `value` (at most 32).
+    pub fn write(&mut self, value: u32, bits: u32) {
+        if bits == 0 {
+            return;
+        }
+        self.acc |= (value as u64 & ((1u64 << bits) - 1)) << self.count;
+        self.count += bits;
+        if self.count >= 32 {
+            self.bytes.extend_from_slice(&(self.acc as u32).to_le_bytes());
+            self.acc >>= 32;
+            self.count -= 32;
+        }
+    }
+
+    /// Write `value` in the narrowest of `classes` that holds it, preceded by
+    /// the class index in unary (n ones, then a zero unless n is the last).
+    pub fn write_classes(&mut self, value: u32, classes: &[u32]) {
+        let last = classes.len() - 1;
+        let class = classes
+            .iter()
+            .position(|&bits| bits >= 32 || value >> bits == 0)
+            .unwrap_or(last);
+        debug_assert!(classes[class] >= 32 || value >> classes[class] == 0);
+        if class < last {
+            self.write((1 << class) - 1, class as u32 + 1);
+        } else {
+            self.write((1 << last) - 1, last as u32);
+        }
+        self.write(value, classes[class]);
+    }
+
+    /// Bits written so far.
+    pub fn bit_len(&self) -> usize {
+        self.bytes.len() * 8 + self.count as usize
+    }
+
+    /// Pad to a byte and append the stream to `msg`.
+    pub fn finish(mut self, msg: &mut SizeBuf) {
+        let tail = self.acc.to_le_bytes();
+        self.bytes.extend_from_slice(&tail[..self.count.div_ceil(8) as usize]);
+        msg.write(&self.bytes);
+    }
+}
+
+/// Reads a bit stream from a SizeBuf starting at its readcount. Every read
+/// leaves msg.readcount just past the last byte touched, so the usual
+/// `readcount > cursize` check catches a truncated stream, and after the
+/// last read the message continues at the next byte.
+#[derive(Debug, Clone, Copy)]
+pub struct BitReader {
+    pos: usize,
+}
+
+impl BitReader {
+    pub fn begin(msg: &SizeBuf) -> Self {
+        Self { pos: msg.readcount as usize * 8 }
+    }
+
+    /// Read `bits` bits (at most 32); past the end of the message reads 0.
+    pub fn read(&mut self, msg: &mut SizeBuf, bits: u32) -> u32 {
+        let value = self.peek(msg, bits);
+        self.skip(msg, bits);
+        value
+    }
+
+    fn peek(&self, msg: &SizeBuf, bits: u32) -> u32 {
+        let byte = self.pos / 8;
+        let len = msg.cursize.max(0) as usize;
+        // at most 39 bits span five bytes; gather them in one word
+        let window = if byte + 8 <= len {
+            u64::from_le_bytes(msg.data[byte..byte + 8].try_into().unwrap())
+        } else {
+            let mut w = 0u64;
+            for i in byte..len.min(byte + 8) {
+                w |= (msg.data[i] as u64) << ((i - byte) * 8);
+            }
+            w
+        };
+        ((window >> (self.pos % 8)) & ((1u64 << bits) - 1)) as u32
+    }
+
+    fn skip(&mut self, msg: &mut SizeBuf, bits: u32) {
+        self.pos += bits as usize;
+        msg.readcount = self.pos.div_ceil(8) as i32;
+    }
+
+    /// Read a value written with `BitWriter::write_classes`.
+    pub fn read_classes(&mut self, msg: &mut SizeBuf, classes: &[u32]) -> u32 {
+        let last = classes.len() - 1;
+        let class = (self.peek(msg, last as u32).trailing_ones() as usize).min(last);
+        self.skip(msg, class as u32 + (class < last) as u32);
+        self.read(msg, classes[class])
+    }
+}
+
+/// Flags as a bit field, the first flag in the lowest bit.
+fn flag_bits(flags: &[bool]) -> u32 {
+    flags.iter().rev().fold(0, |acc, &f| acc << 1 | f as u32)
+}
+
+fn bit_flags<const N: usize>(bits: u32) -> [bool; N] {
+    std::array::from_fn(|i| bits >> i & 1 != 0)
+}
+
+fn zigzag(v: i32) -> u32 {
+    ((v << 1) ^ (v >> 31)) as u32
+}
+
+fn unzigzag(v: u32) -> i32 {
+    (v >> 1) as i32 ^ -((v & 1) as i32)
+}
+
+// ============================================================
+// Quantization
+// ============================================================
+
+/// Quantization profile of the bit-packed format, sent as the byte after
+/// svc_packetentities_bits and offered as "be=<profile>" at connect.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum EntityQuant {
+    /// Same precision as svc_packetentities: 8-bit angles
+    Standard = 1,
+    /// 16-bit angles
+    Precise = 2,
+}
+
+impl EntityQuant {
+    /// The best profile this build understands; the server caps requests
+    /// to it and cl_entity_profile is clamped to it.
+    pub const BEST: EntityQuant = EntityQuant::Precise;
+
+    pub fn from_i32(profile: i32) -> Option<Self> {
+        match profile {
+            1 => Some(EntityQuant::Standard),
+            2 => Some(EntityQuant::Precise),
+            _ => None,
+        }
+    }
+
+    fn angle_bits(self) -> u32 {
+        match self {
+            EntityQuant::Standard => 8,
+            EntityQuant::Precise => 16,
+        }
+    }
+
+    /// MSG_WriteAngle / MSG_WriteAngle16 quantization.
+    fn angle(self, f: f32) -> u32 {
+        match self {
+            EntityQuant::Standard => ((f * 256.0 / 360.0) as i32 & 255) as u32,
+            EntityQuant::Precise => ((f * 65536.0 / 360.0) as i32 & 65535) as u32,
+        }
+    }
+
+    /// MSG_ReadAngle / MSG_ReadAngle16.
+    fn unangle(self, q: u32) -> f32 {
+        match self {
+            EntityQuant::Standard => q as u8 as i8 as f32 * (360.0 / 256.0),
+            EntityQuant::Precise => q as u16 as i16 as f32 * (360.0 / 65536.0),
+        }
+    }
+}
+
+// What svc_packetentities delivers for each field, as the client reads it
+// back; the bit format sends these values so both decode alike.
+
+/// MSG_WriteCoord: 1/8 unit in a short.
+fn q_coord(f: f32) -> i16 {
+    (f * 8.0) as i32 as i16
+}
+
+fn q_frame(frame: i32) -> i32 {
+    if frame < 256 { frame & 255 } else { frame as i16 as i32 }
+}
+
+fn q_skin(skin: i32) -> i32 {
+    if (skin as u32) < 0x10000 { skin as i16 as i32 } else { skin }
+}
+
+// ============================================================
+// Entity lists
+// ============================================================
+
+/// Writes one svc_packetentities_bits entity list.
+pub struct PackedEntityWriter {
+    pub bits: BitWriter,
+    quant: EntityQuant,
+    last_number: i32,
+}
+
+impl PackedEntityWriter {
+    /// Start a list; the caller has written svc_packetentities_bits.
+    pub fn new(msg: &mut SizeBuf, quant: EntityQuant) -> Self {
+        msg_write_byte(msg, quant as i32);
+        Self { bits: BitWriter::new(), quant, last_number: 0 }
+    }
+
+    fn number(&mut self, number: i32, remove: bool) {
+        assert!(number > self.last_number, "entity numbers out of order");
+        assert!((number as usize) < MAX_EDICTS, "Entity number >= MAX_EDICTS");
+        self.bits.write_classes((number - self.last_number) as u32, &NUMBER_CLASSES);
+        self.bits.write(remove as u32, 1);
+        self.last_number = number;
+    }
+
+    /// The entity of `number` in the old frame is gone.
+    pub fn remove(&mut self, number: i32) {
+        self.number(number, true);
+    }
+
+    /// MSG_WriteDeltaEntity: writes nothing if nothing changed and `force`
+    /// is false.
+    pub fn delta(&mut self, from: &EntityState, to: &EntityState, force: bool, newentity: bool) {
+        assert!(to.number != 0, "Unset entity number");
+        let quant = self.quant;
+
+        let coord_from = from.origin.map(q_coord);
+        let coord_to = to.origin.map(q_coord);
+        let origin: [bool; 3] = std::array::from_fn(|i| coord_to[i] != coord_from[i]);
+        let angles: [bool; 3] = std::array::from_fn(|i| quant.angle(to.angles[i]) != quant.angle(from.angles[i]));
+        let models_from = [from.modelindex, from.modelindex2, from.modelindex3, from.modelindex4];
+        let models_to = [to.modelindex, to.modelindex2, to.modelindex3, to.modelindex4];
+        let models: [bool; 4] = std::array::from_fn(|i| models_to[i] & 255 != models_from[i] & 255);
+
+        let frame = q_frame(to.frame) != q_frame(from.frame);
+        let event = to.event != 0;
+        let skin = q_skin(to.skinnum) != q_skin(from.skinnum);
+        let effects = to.effects != from.effects;
+        let renderfx = to.renderfx != from.renderfx;
+        let solid = to.solid as i16 != from.solid as i16;
+        let sound = to.sound & 255 != from.sound & 255;
+        let oldorigin = newentity || (to.renderfx & RF_BEAM != 0);
+
+        let common = [origin.contains(&true), angles.contains(&true), frame, event];
+        let more = [models.contains(&true), skin, effects, renderfx, solid, sound, oldorigin];
+        let any_more = more.contains(&true);
+        if !force && !any_more && !common.contains(&true) {
+            return;
+        }
+
+        self.number(to.number, false);
+        let w = &mut self.bits;
+        w.write(flag_bits(&common) | (any_more as u32) << 4, 5);
+        if any_more {
+            w.write(flag_bits(&more), 7);
+        }
+
+        if common[0] {
+            w.write(flag_bits(&origin), 3);
+            for i in (0..3).filter(|&i| origin[i]) {
+                w.write_classes(zigzag(coord_to[i].wrapping_sub(coord_from[i]) as i32), &COORD_CLASSES);
+            }
+        }
+        if common[1] {
+            w.write(flag_bits(&angles), 3);
+            for i in (0..3).filter(|&i| angles[i]) {
+                w.write(quant.angle(to.angles[i]), quant.angle_bits());
+            }
+        }
+        if frame {
+            w.write_classes(zigzag(q_frame(to.frame).wrapping_sub(q_frame(from.frame))), &FRAME_CLASSES);
+        }
+        if event {
+            w.write(to.event as u32, 8);
+        }
+        if !any_more {
+            return;
+        }
+
+        if more[0] {
+            w.write(flag_bits(&models), 4);
+            for i in (0..4).filter(|&i| models[i]) {
+                w.write(models_to[i] as u32, 8);
+            }
+        }
+        if skin {
+            w.write_classes(q_skin(to.skinnum) as u32, &SKIN_CLASSES);
+        }
+        if effects {
+            w.write_classes(to.effects, &FLAG_CLASSES);
+        }
+        if renderfx {
+            w.write_classes(to.renderfx as u32, &FLAG_CLASSES);
+        }
+        if solid {
+            w.write(to.solid as u32, 16);
+        }
+        if sound {
+            w.write(to.sound as u32, 8);
+        }
+        if oldorigin {
+            for i in 0..3 {
+                let d = q_coord(to.old_origin[i]).wrapping_sub(coord_to[i]);
+                w.write_classes(zigzag(d as i32), &COORD_CLASSES);
+            }
+        }
+    }
+
+    /// End the list and append it to `msg`.
+    pub fn finish(mut self, msg: &mut SizeBuf) {
+        self.bits.write_classes(0, &NUMBER_CLASSES);
+        self.bits.finish(msg);
+    }
+}
+
+/// Reads one svc_packetentities_bits entity list.
+pub struct PackedEntityReader {
+    pub bits: BitReader,
+    quant: EntityQuant,
+    last_number: i32,
+}
+
+impl PackedEntityReader {
+    /// Start a list after the svc_packetentities_bits opcode; None if the
+    /// profile is not one this build knows.
+    pub fn begin(msg: &mut SizeBuf) -> Option<Self> {
+        let quant = EntityQuant::from_i32(msg_read_byte(msg))?;
+        Some(Self { bits: BitReader::begin(msg), quant, last_number: 0 })
+    }
+
+    /// The next entity number (0 at the end of the list) and whether the
+    /// entity is removed.
+    pub fn read_number(&mut self, msg: &mut SizeBuf) -> (i32, bool) {
+        let gap = self.bits.read_classes(msg, &NUMBER_CLASSES) as i32;
+        if gap == 0 {
+            return (0, false);
+        }
+        self.last_number += gap;
+        (self.last_number, self.bits.read(msg, 1) != 0)
+    }
+
+    /// CL_ParseDelta for the bit format.
+    pub fn read_delta(&mut self, msg: &mut SizeBuf, from: &EntityState, to: &mut EntityState, number: i32) {
+        let quant = self.quant;
+        let r = &mut self.bits;
+
+        *to = from.clone();
+        to.old_origin = from.origin;
+        to.number = number;
+
+        let head = r.read(msg, 5);
+        let common: [bool; 4] = bit_flags(head);
+        let more: [bool; 7] = bit_flags(if head & 16 != 0 { r.read(msg, 7) } else { 0 });
+
+        if common[0] {
+            let axes: [bool; 3] = bit_flags(r.read(msg, 3));
+            for i in (0..3).filter(|&i| axes[i]) {
+                let d = unzigzag(r.read_classes(msg, &COORD_CLASSES)) as i16;
+                to.origin[i] = q_coord(from.origin[i]).wrapping_add(d) as f32 * (1.0 / 8.0);
+            }
+        }
+        if common[1] {
+            let axes: [bool; 3] = bit_flags(r.read(msg, 3));
+            for i in (0..3).filter(|&i| axes[i]) {
+                to.angles[i] = quant.unangle(r.read(msg, quant.angle_bits()));
+            }
+        }
+        if common[2] {
+            to.frame = from.frame.wrapping_add(unzigzag(r.read_classes(msg, &FRAME_CLASSES)));
+        }
+        to.event = if common[3] { r.read(msg, 8) as i32 } else { 0 };
+
+        if more[0] {
+            let which: [bool; 4] = bit_flags(r.read(msg, 4));
+            let models = [&mut to.modelindex, &mut to.modelindex2, &mut to.modelindex3, &mut to.modelindex4];
+            for (model, _) in models.into_iter().zip(which).filter(|(_, on)| *on) {
+                *model = r.read(msg, 8) as i32;
+            }
+        }
+        if more[1] {
+            to.skinnum = r.read_classes(msg, &SKIN_CLASSES) as i32;
+        }
+        if more[2] {
+            to.effects = r.read_classes(msg, &FLAG_CLASSES);
+        }
+        if more[3] {
+            to.renderfx = r.read_classes(msg, &FLAG_CLASSES) as i32;
+        }
+        if more[4] {
+            to.solid = r.read(msg, 16) as u16 as i16 as i32;
+        }
+        if more[5] {
+            to.sound = r.read(msg, 8) as i32;
+        }
+        if more[6] {
+            let base = to.origin.map(q_coord);
+            for i in 0..3 {
+                let d = unzigzag(r.read_classes(msg, &COORD_CLASSES)) as i16;
+                to.old_origin[i] = base[i].wrapping_add(d) as f32 * (1.0 / 8.0);
+            }
+        }
+    }
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bits_round_trip() {
+        let mut w = BitWriter::new();
+        let values: Vec<(u32, u32)> = (0..200u32).map(|i| (i.wrapping_mul(2654435761), 1 + i % 32)).collect();
+        for &(v, n) in &values {
+            w.write(v, n);
+            w.write_classes(v >> (32 - n), &FRAME_CLASSES);
+        }
+        let mut msg = SizeBuf::new(4096);
+        msg_write_byte(&mut msg, 0x55);
+        w.finish(&mut msg);
+        msg_write_byte(&mut msg, 0x77);
+
+        msg.readcount = 1;
+        let mut r = BitReader::begin(&msg);
+        for &(v, n) in &values {
+            let mask = if n == 32 { !0 } else { (1 << n) - 1 };
+            assert_eq!(r.read(&mut msg, n), v & mask);
+            assert_eq!(r.read_classes(&mut msg, &FRAME_CLASSES), v >> (32 - n));
+        }
+        // the stream ends padded to a byte; what follows is intact
+        assert_eq!(msg_read_byte(&mut msg), 0x77);
+        assert_eq!(msg.readcount, msg.cursize);
+
+        // reading past the end flags the message as overrun
+        let mut r = BitReader::begin(&msg);
+        assert_eq!(r.read(&mut msg, 1), 0);
+        assert!(msg.readcount > msg.cursize);
+    }
+
+    #[test]
+    fn test_zigzag() {
+        for v in [0, 1, -1, 2, -2, 4095, -4096, i32::MAX, i32::MIN] {
+            assert_eq!(unzigzag(zigzag(v)), v);
+        }
+        assert_eq!(zigzag(-1), 1);
+        assert_eq!(zigzag(1), 2);
+    }
+
+    #[test]
+    fn test_precise_angles() {
+        let mut from = EntityState::default();
+        from.number = 300;
+        let mut to = from.clone();
+        to.angles = [12.3, -170.2, 359.0];
+        to.origin = [100.0, -2000.5, 64.125];
+        to.frame = 5;
+
+        let mut msg = SizeBuf::new(256);
+        let mut w = PackedEntityWriter::new(&mut msg, EntityQuant::Precise);
+        w.delta(&from, &to, false, false);
+        w.finish(&mut msg);
+
+        let mut r = PackedEntityReader::begin(&mut msg).unwrap();
+        assert_eq!(r.read_number(&mut msg), (300, false));
+        let mut got = EntityState::default();
+        r.read_delta(&mut msg, &from, &mut got, 300);
+        assert_eq!(r.read_number(&mut msg), (0, false));
+        assert_eq!(msg.readcount, msg.cursize);
+
+        assert_eq!(got.origin, to.origin);
+        assert_eq!(got.frame, 5);
+        for i in 0..3 {
+            let err = (got.angles[i] - to.angles[i] + 540.0).rem_euclid(360.0) - 180.0;
+            assert!(err.abs() < 360.0 / 65536.0, "angle {} off by {}", i, err);
+        }
+    }
+
+    #[test]
+    fn test_unknown_profile() {
+        let mut msg = SizeBuf::new(16);
+        msg_write_byte(&mut msg, 9);
+        assert!(PackedEntityReader::begin(&mut msg).is_none());
+    }
+}
@@ -3,26 +3,75 @@
 //
 // Handles reliable and unreliable message delivery over UDP.
 // See the original source for the full protocol description.
+//
+// Fragmentation (protocol 36): when the reliable and unreliable data of one
+// transmit do not fit in MAX_MSGLEN, the payload is split into
+// MAX_FRAGMENT_SIZE pieces sent under the same sequence number with
+// FRAGMENT_BIT set. After the usual header (and qport), each piece carries
+//
+//   offset:u16  -- byte offset of the piece; bit 15 set if more follow
+//
+// and the piece itself fills the rest of the packet. Netchan_Process
+// collects the pieces of a sequence in any order and hands the whole
+// datagram on once every piece is in; if one is lost the sequence is never
+// completed and is superseded by the next, exactly like a dropped
+// unfragmented packet, and the reliable part is resent as usual.
+//
+// Windowed reliable ("nc=1" in the connect string, protocol 36 only): the
+// reliable bits are repurposed. Bit 31 of the sequence means reliable
+// segments follow, bit 31 of the ack means an ack block follows:
+//
+//   ack block:  next:u16  mask:u32  -- all segments before `next` arrived;
+//                                      bit n of mask: segment next+1+n held
+//   segments:   count:u8, then count * (sequence:u16 length:u16 data)
+//
+// and the unreliable part fills the rest. Every transmit may start a new
+// segment from `message` while fewer than RELIABLE_WINDOW are unacked, so
+// reliable data no longer waits a round trip per message. A segment is
+// resent once a packet at or after the one carrying it has been acked
+// without acking the segment. Netchan_Process hands segments on in order,
+// ahead of the unreliable part, so callers see an ordinary packet.
 
 use crate::common::{
     msg_begin_reading, msg_read_byte, msg_read_long, msg_read_short,
     msg_write_byte, msg_write_long, msg_write_short,
 };
-use crate::qcommon::{NetAdr, NetChan, NetSrc, SizeBuf, MAX_MSGLEN, PROTOCOL_R1Q2, PROTOCOL_Q2PRO};
+use crate::qcommon::{
+    FragmentState, NetAdr, NetChan, NetSrc, ReliableSegment, ReliableWindow, SizeBuf, MAX_MSGLEN,
+    PROTOCOL_R1Q2, PROTOCOL_Q2PRO, RELIABLE_WINDOW,
+};
 
 // Q2Pro (protocol 36) fragmentation constants
 /// Bit 30 of the sequence number indicates a fragmented packet
 pub const FRAGMENT_BIT: u32 = 1 << 30;
 /// Maximum fragment size (conservative to fit within UDP MTU)
 pub const MAX_FRAGMENT_SIZE: usize = 1280;
+/// Largest payload (reliable + unreliable) a fragmented datagram may carry.
+pub const MAX_FRAGMENTED_MSGLEN: usize = 16384;
+/// Bit 15 of the fragment offset: more fragments follow this one.
+const FRAGMENT_MORE: u16 = 0x8000;
 
 /// Check if the last reliable message has been acknowledged.
 pub fn netchan_can_reliable(chan: &NetChan) -> bool {
+    if chan.windowed {
+        return chan.window.outgoing.len() < RELIABLE_WINDOW;
+    }
     chan.reliable_length == 0
 }
 
+/// Whether an outgoing segment has to go out with the next packet: it was
+/// never sent, or the packet it went in has been acked without it.
+fn netchan_segment_due(chan: &NetChan, seg: &ReliableSegment) -> bool {
+    seg.last_sent == 0 || seg.last_sent <= chan.incoming_acknowledged
+}
+
 /// Determine if we need to send a reliable message.
 pub fn netchan_need_reliable(chan: &NetChan) -> bool {
+    if chan.windowed {
+        return chan.window.outgoing.iter().any(|seg| netchan_segment_due(chan, seg))
+            || (chan.message.cursize > 0 && netchan_can_reliable(chan));
+    }
+
     // If the remote side dropped the last reliable message, resend it
     if chan.incoming_acknowledged > chan.last_reliable_sequence
         && chan.incoming_reliable_acknowledged != chan.reliable_sequence
@@ -53,12 +102,36 @@ pub fn netchan_setup(sock: NetSrc, chan: &mut NetChan, adr: NetAdr, qport: i32,
     // Protocol is set separately after negotiation via netchan_set_protocol
 }
 
+/// Whether the channel may split datagrams larger than MAX_MSGLEN.
+pub fn netchan_can_fragment(chan: &NetChan) -> bool {
+    chan.protocol >= PROTOCOL_Q2PRO
+}
+
+/// Largest unreliable payload that can go out with a transmit without being
+/// dumped, even when a full reliable message (and its window framing) rides
+/// along.
+pub fn netchan_max_datagram(chan: &NetChan) -> usize {
+    if netchan_can_fragment(chan) {
+        MAX_FRAGMENTED_MSGLEN - MAX_MSGLEN
+    } else {
+        MAX_MSGLEN
+    }
+}
+
 /// Set the negotiated protocol version for the channel.
 /// This affects features like 1-byte qport (protocol 35+).
 pub fn netchan_set_protocol(chan: &mut NetChan, protocol: i32) {
     chan.protocol = protocol;
 }
 
+/// Switch the channel to windowed reliable mode, as negotiated at connect.
+/// Only valid on fragmenting channels, since several segments may share a
+/// datagram; must be done before anything reliable is sent.
+pub fn netchan_set_windowed(chan: &mut NetChan, windowed: bool) {
+    chan.windowed = windowed && netchan_can_fragment(chan);
+    chan.window = ReliableWindow::new();
+}
+
 /// Build a packet for transmission and send it via NET_SendPacket.
 ///
 /// Handles reliable message retransmission and copies unreliable data
@@ -95,11 +168,43 @@ pub fn netchan_transmit_with_dup(
     // Clamp dup_count to reasonable range
     let dup_count = dup_count.clamp(0, 2);
 
+    let packets = netchan_build_packets(chan, data, curtime, qport_value);
+
+    // Send original packet(s)
+    for packet in &packets {
+        crate::net::net_send_packet(chan.sock, packet, &chan.remote_address);
+    }
+
+    // Send duplicate packets with small delays to avoid burst loss
+    for _i in 0..dup_count {
+        // Small delay between duplicates (50-100 microseconds) to spread across time
+        // This helps when packet loss occurs in bursts
+        std::thread::sleep(std::time::Duration::from_micros(50));
+        for packet in &packets {
+            crate::net::net_send_packet(chan.sock, packet, &chan.remote_address);
+        }
+    }
+}
+
+/// Build the datagram for one transmit: a single packet, or on a fragmenting
+/// channel as many fragments as the payload needs, all under one sequence.
+///
+/// Advances the channel's sequencing exactly as one Netchan_Transmit does.
+pub fn netchan_build_packets(
+    chan: &mut NetChan,
+    data: &[u8],
+    curtime: i32,
+    qport_value: i32,
+) -> Vec<Vec<u8>> {
     // Check for message overflow
     if chan.message.overflowed && !chan.message.allow_overflow {
         panic!("Outgoing message overflow");
     }
 
+    if chan.windowed {
+        return netchan_build_windowed(chan, data, curtime, qport_value);
+    }
+
     let send_reliable = netchan_need_reliable(chan);
 
     // If the reliable transmit buffer is empty and we have pending reliable data,
@@ -121,53 +226,211 @@ pub fn netchan_transmit_with_dup(
     let w2 = ((chan.incoming_sequence as u32) & !(1u32 << 31))
         | ((chan.incoming_reliable_sequence as u32) << 31);
 
+    netchan_write_header(chan, &mut send, w1, w2, curtime, qport_value);
+
+    let reliable_len = if send_reliable { chan.reliable_length as usize } else { 0 };
+    if send_reliable {
+        chan.last_reliable_sequence = chan.outgoing_sequence;
+    }
+
+    netchan_finish_packets(chan, send, &chan.reliable_buf[..reliable_len], data)
+}
+
+/// Write the sequence words (and qport) of an outgoing packet and advance
+/// the outgoing sequence.
+fn netchan_write_header(chan: &mut NetChan, send: &mut SizeBuf, w1: u32, w2: u32, curtime: i32, qport_value: i32) {
     chan.outgoing_sequence += 1;
     chan.last_sent = curtime;
 
-    msg_write_long(&mut send, w1 as i32);
-    msg_write_long(&mut send, w2 as i32);
+    msg_write_long(send, w1 as i32);
+    msg_write_long(send, w2 as i32);
 
     // Send the qport if we are a client
     // Protocol 35+ uses 1-byte qport for bandwidth savings
     if matches!(chan.sock, NetSrc::Client) {
         if chan.protocol >= PROTOCOL_R1Q2 {
             // R1Q2/Q2Pro: 1-byte qport
-            msg_write_byte(&mut send, qport_value & 0xFF);
+            msg_write_byte(send, qport_value & 0xFF);
         } else {
             // Original protocol: 2-byte qport
-            msg_write_short(&mut send, qport_value);
+            msg_write_short(send, qport_value);
         }
     }
+}
 
-    // Copy the reliable message to the packet first
-    if send_reliable {
-        let reliable_len = chan.reliable_length as usize;
-        send.write(&chan.reliable_buf[..reliable_len]);
-        chan.last_reliable_sequence = chan.outgoing_sequence;
-    }
-
-    // Add the unreliable part if space is available
-    let remaining = (send.maxsize - send.cursize) as usize;
-    if remaining >= data.len() {
+/// Append the reliable and unreliable parts to the header in `send`,
+/// fragmenting if needed, and return the packets to send.
+fn netchan_finish_packets(chan: &NetChan, mut send: SizeBuf, reliable: &[u8], data: &[u8]) -> Vec<Vec<u8>> {
+    let header_len = send.cursize as usize;
+    if header_len + reliable.len() + data.len() > MAX_MSGLEN && netchan_can_fragment(chan) {
+        // The unreliable part goes if even fragments cannot carry it
+        let data = if reliable.len() + data.len() <= MAX_FRAGMENTED_MSGLEN {
+            data
+        } else {
+            crate::common::com_printf("Netchan_Transmit: dumped unreliable\n");
+            &[]
+        };
+        if header_len + reliable.len() + data.len() > MAX_MSGLEN {
+            let mut header = send.data[..header_len].to_vec();
+            header[3] |= (FRAGMENT_BIT >> 24) as u8;
+
+            let mut payload = Vec::with_capacity(reliable.len() + data.len());
+            payload.extend_from_slice(reliable);
+            payload.extend_from_slice(data);
+
+            let count = payload.len().div_ceil(MAX_FRAGMENT_SIZE);
+            return payload
+                .chunks(MAX_FRAGMENT_SIZE)
+                .enumerate()
+                .map(|(i, piece)| {
+                    let mut word = (i * MAX_FRAGMENT_SIZE) as u16;
+                    if i + 1 < count {
+                        word |= FRAGMENT_MORE;
+                    }
+                    let mut packet = Vec::with_capacity(header_len + 2 + piece.len());
+                    packet.extend_from_slice(&header);
+                    packet.extend_from_slice(&word.to_le_bytes());
+                    packet.extend_from_slice(piece);
+                    packet
+                })
+                .collect();
+        }
+        send.write(reliable);
         send.write(data);
     } else {
-        crate::common::com_printf("Netchan_Transmit: dumped unreliable\n");
+        // Copy the reliable message to the packet first
+        send.write(reliable);
+
+        // Add the unreliable part if space is available
+        let remaining = (send.maxsize - send.cursize) as usize;
+        if remaining >= data.len() {
+            send.write(data);
+        } else {
+            crate::common::com_printf("Netchan_Transmit: dumped unreliable\n");
+        }
     }
 
-    // Send the datagram
     let cursize = send.cursize as usize;
-    let packet_data = &send.data[..cursize];
+    vec![send.data[..cursize].to_vec()]
+}
 
-    // Send original packet
-    crate::net::net_send_packet(chan.sock, packet_data, &chan.remote_address);
+/// Netchan_Transmit for a windowed channel: queue `message` as a new segment
+/// if the window has room, then send the ack block, whichever segments are
+/// due (oldest first, as many as fit beside the unreliable part) and `data`.
+fn netchan_build_windowed(chan: &mut NetChan, data: &[u8], curtime: i32, qport_value: i32) -> Vec<Vec<u8>> {
+    if chan.message.cursize > 0 && netchan_can_reliable(chan) {
+        let len = chan.message.cursize as usize;
+        let sequence = chan.window.next_sequence;
+        chan.window.next_sequence = sequence.wrapping_add(1);
+        chan.window.outgoing.push(ReliableSegment {
+            sequence,
+            data: chan.message.data[..len].to_vec(),
+            last_sent: 0,
+        });
+        chan.message.cursize = 0;
+    }
 
-    // Send duplicate packets with small delays to avoid burst loss
-    for _i in 0..dup_count {
-        // Small delay between duplicates (50-100 microseconds) to spread across time
-        // This helps when packet loss occurs in bursts
-        std::thread::sleep(std::time::Duration::from_micros(50));
-        crate::net::net_send_packet(chan.sock, packet_data, &chan.remote_address);
+    let mut reliable = Vec::new();
+    let send_ack = chan.window.ack_pending;
+    if send_ack {
+        let w = &chan.window;
+        let mask = (0..32u32).fold(0u32, |mask, n| {
+            let slot = w.incoming_sequence.wrapping_add(1 + n) as usize % RELIABLE_WINDOW;
+            mask | ((w.held[slot].is_some() as u32) << n)
+        });
+        reliable.extend_from_slice(&(w.incoming_sequence as u16).to_le_bytes());
+        reliable.extend_from_slice(&mask.to_le_bytes());
     }
+
+    let packet = chan.outgoing_sequence;
+    let mut room = MAX_FRAGMENTED_MSGLEN.saturating_sub(reliable.len() + 1 + data.len());
+    let count_at = reliable.len();
+    let mut count = 0u8;
+    reliable.push(0);
+    for i in 0..chan.window.outgoing.len() {
+        let seg = &chan.window.outgoing[i];
+        if !netchan_segment_due(chan, seg) {
+            continue;
+        }
+        let size = 4 + seg.data.len();
+        if size > room && count > 0 {
+            break;
+        }
+        room = room.saturating_sub(size);
+        reliable.extend_from_slice(&(seg.sequence as u16).to_le_bytes());
+        reliable.extend_from_slice(&(seg.data.len() as u16).to_le_bytes());
+        reliable.extend_from_slice(&seg.data);
+        chan.window.outgoing[i].last_sent = packet;
+        count += 1;
+    }
+    if count > 0 {
+        reliable[count_at] = count;
+    } else {
+        reliable.pop();
+    }
+
+    let w1 = ((chan.outgoing_sequence as u32) & !(1u32 << 31)) | (((count > 0) as u32) << 31);
+    let w2 = ((chan.incoming_sequence as u32) & !(1u32 << 31)) | ((send_ack as u32) << 31);
+    // one ack per arrival: if it is lost, the segments come again and are
+    // acked again
+    chan.window.ack_pending = false;
+
+    let mut send = SizeBuf::new(MAX_MSGLEN as i32);
+    netchan_write_header(chan, &mut send, w1, w2, curtime, qport_value);
+    netchan_finish_packets(chan, send, &reliable, data)
+}
+
+/// Add one received fragment of `sequence` to `frag`. Returns true once the
+/// datagram is complete, leaving it in `frag.buffer`.
+fn netchan_add_fragment(frag: &mut FragmentState, sequence: i32, word: u16, piece: &[u8]) -> bool {
+    let offset = (word & !FRAGMENT_MORE) as usize;
+    let more = word & FRAGMENT_MORE != 0;
+
+    // A new sequence supersedes whatever was being collected
+    if !frag.in_progress || frag.sequence != sequence {
+        frag.reset();
+        frag.in_progress = true;
+        frag.sequence = sequence;
+    }
+
+    let index = offset / MAX_FRAGMENT_SIZE;
+    let end = offset + piece.len();
+    let bad = offset % MAX_FRAGMENT_SIZE != 0
+        || index >= 64
+        || piece.is_empty()
+        || piece.len() > MAX_FRAGMENT_SIZE
+        || (more && piece.len() != MAX_FRAGMENT_SIZE)
+        || end > MAX_FRAGMENTED_MSGLEN
+        || (frag.total_size > 0 && end > frag.total_size as usize)
+        // a last piece must end where any earlier last piece did, with
+        // nothing received beyond it
+        || (!more && frag.total_size > 0 && end != frag.total_size as usize)
+        || (!more && (frag.received >> index) >> 1 != 0);
+    if bad {
+        crate::common::com_dprintf(&format!(
+            "Netchan_Process: bad fragment (offset {}, length {})\n",
+            offset,
+            piece.len()
+        ));
+        frag.reset();
+        return false;
+    }
+
+    if frag.received & (1u64 << index) != 0 {
+        return false; // duplicate
+    }
+
+    if frag.buffer.len() < end {
+        frag.buffer.resize(end, 0);
+    }
+    frag.buffer[offset..end].copy_from_slice(piece);
+    frag.received |= 1u64 << index;
+    frag.current_offset += piece.len() as i32;
+    if !more {
+        frag.total_size = end as i32;
+    }
+
+    frag.total_size > 0 && frag.current_offset == frag.total_size
 }
 
 /// Process an incoming packet. Returns true if the packet is valid and should
@@ -223,82 +486,59 @@ pub fn netchan_process(chan: &mut NetChan, msg: &mut SizeBuf, curtime: i32) -> b
 
     // Handle Q2Pro fragmentation
     if fragmented {
-        // Read fragment header: offset (short), length (short)
-        let fragment_offset = msg_read_short(msg) as usize;
-        let fragment_length = msg_read_short(msg) as usize;
-
-        // Sanity checks
-        if fragment_length == 0 || fragment_length > MAX_FRAGMENT_SIZE {
-            crate::common::com_dprintf(&format!(
-                "Netchan_Process: bad fragment length {}\n",
-                fragment_length
-            ));
+        let header_len = msg.readcount as usize;
+        let word = msg_read_short(msg) as u16;
+        let start = msg.readcount as usize;
+        let end = msg.cursize as usize;
+        if start > end {
+            crate::common::com_dprintf("Netchan_Process: truncated fragment\n");
             return false;
         }
 
-        // Check if this is a new fragmented sequence
-        if !chan.fragment_in.in_progress || chan.fragment_in.sequence != sequence as i32 {
-            // Start a new fragmented message
-            chan.fragment_in.reset();
-            chan.fragment_in.in_progress = true;
-            chan.fragment_in.sequence = sequence as i32;
-        }
-
-        // Validate fragment offset
-        if fragment_offset != chan.fragment_in.current_offset as usize {
-            crate::common::com_dprintf(&format!(
-                "Netchan_Process: fragment out of order (expected {}, got {})\n",
-                chan.fragment_in.current_offset, fragment_offset
-            ));
-            chan.fragment_in.reset();
+        if !netchan_add_fragment(&mut chan.fragment_in, sequence as i32, word, &msg.data[start..end]) {
+            // More fragments expected - don't process yet
             return false;
         }
 
-        // Read the fragment data
-        let data_start = msg.readcount as usize;
-        let data_end = data_start + fragment_length;
-        if data_end > msg.data.len() {
-            crate::common::com_dprintf("Netchan_Process: fragment overflows packet\n");
-            chan.fragment_in.reset();
-            return false;
+        // Put the whole datagram back behind the original header, so the
+        // caller (and demo recording) sees an ordinary packet
+        let complete_data = std::mem::take(&mut chan.fragment_in.buffer);
+        let total = header_len + complete_data.len();
+        if msg.data.len() < total {
+            msg.data.resize(total, 0);
         }
+        msg.data[header_len..total].copy_from_slice(&complete_data);
+        msg.data[3] &= !((FRAGMENT_BIT >> 24) as u8);
+        msg.maxsize = msg.maxsize.max(total as i32);
+        msg.cursize = total as i32;
+        msg.readcount = header_len as i32;
+
+        // reset, keeping the allocation for the next one
+        chan.fragment_in.reset();
+        chan.fragment_in.buffer = complete_data;
+        chan.fragment_in.buffer.clear();
+    }
 
-        // Append to fragment buffer
-        chan.fragment_in.buffer.extend_from_slice(&msg.data[data_start..data_end]);
-        chan.fragment_in.current_offset += fragment_length as i32;
-
-        // Check if this is the last fragment (data less than max fragment size)
-        if fragment_length < MAX_FRAGMENT_SIZE {
-            // Fragment complete - copy to message buffer
-            chan.fragment_in.in_progress = false;
-            let complete_data = std::mem::take(&mut chan.fragment_in.buffer);
-
-            // Replace msg content with the complete defragmented message
-            msg.data.clear();
-            msg.data.extend_from_slice(&complete_data);
-            msg.cursize = complete_data.len() as i32;
-            msg.readcount = 0;
-
-            chan.fragment_in.reset();
-        } else {
-            // More fragments expected - don't process yet
+    if chan.windowed {
+        if !netchan_window_receive(chan, msg, reliable_ack != 0, reliable_message != 0) {
+            crate::common::com_dprintf("Netchan_Process: bad reliable window\n");
             return false;
         }
-    }
-
-    // If the current outgoing reliable message has been acknowledged,
-    // clear the buffer
-    if reliable_ack == chan.reliable_sequence as u32 {
+    } else if reliable_ack == chan.reliable_sequence as u32 {
+        // If the current outgoing reliable message has been acknowledged,
+        // clear the buffer
         chan.reliable_length = 0;
     }
 
     // Update sequence tracking
     chan.incoming_sequence = sequence as i32;
     chan.incoming_acknowledged = sequence_ack as i32;
-    chan.incoming_reliable_acknowledged = reliable_ack as i32;
 
-    if reliable_message != 0 {
-        chan.incoming_reliable_sequence ^= 1;
+    if !chan.windowed {
+        chan.incoming_reliable_acknowledged = reliable_ack as i32;
+        if reliable_message != 0 {
+            chan.incoming_reliable_sequence ^= 1;
+        }
     }
 
     chan.last_received = curtime;
@@ -306,6 +546,82 @@ pub fn netchan_process(chan: &mut NetChan, msg: &mut SizeBuf, curtime: i32) -> b
     true
 }
 
+/// Read the ack block and reliable segments of a windowed packet, drop the
+/// outgoing segments it acknowledges, and rewrite `msg` to hold whatever
+/// reliable data can now be delivered in order, followed by the unreliable
+/// part. Returns false (changing nothing) if the framing is malformed.
+fn netchan_window_receive(chan: &mut NetChan, msg: &mut SizeBuf, has_ack: bool, has_segments: bool) -> bool {
+    let header_len = msg.readcount as usize;
+    if !has_ack && !has_segments {
+        return true;
+    }
+
+    let ack = if has_ack {
+        let next = msg_read_short(msg) as u16;
+        let mask = msg_read_long(msg) as u32;
+        Some((next, mask))
+    } else {
+        None
+    };
+
+    let mut segments = Vec::new();
+    if has_segments {
+        let count = msg_read_byte(msg);
+        for _ in 0..count.max(0) {
+            let sequence = msg_read_short(msg) as u16;
+            let length = msg_read_short(msg) as u16;
+            segments.push((sequence, msg.readcount as usize, length as usize));
+            msg.readcount += length as i32;
+        }
+    }
+    if msg.readcount > msg.cursize {
+        return false;
+    }
+
+    let w = &mut chan.window;
+
+    // Outgoing segments the remote side has, in order or held
+    if let Some((next, mask)) = ack {
+        let next = w.next_sequence.wrapping_sub((w.next_sequence as u16).wrapping_sub(next) as u32);
+        w.outgoing.retain(|seg| {
+            let ahead = seg.sequence.wrapping_sub(next) as i32;
+            ahead >= 0 && (ahead == 0 || ahead > 32 || mask & (1 << (ahead - 1)) == 0)
+        });
+    }
+
+    // Incoming segments: hold anything new inside the window
+    for &(sequence, start, length) in &segments {
+        let ahead = sequence.wrapping_sub(w.incoming_sequence as u16) as i16;
+        w.ack_pending = true;
+        if ahead < 0 || ahead as usize >= RELIABLE_WINDOW {
+            continue; // delivered already; the ack going out covers it
+        }
+        let slot = w.incoming_sequence.wrapping_add(ahead as u32) as usize % RELIABLE_WINDOW;
+        if w.held[slot].is_none() {
+            w.held[slot] = Some(msg.data[start..start + length].to_vec());
+        }
+    }
+
+    // Deliver the run that is now complete ahead of the unreliable part
+    let mut payload = Vec::new();
+    while let Some(data) = w.held[w.incoming_sequence as usize % RELIABLE_WINDOW].take() {
+        payload.extend_from_slice(&data);
+        w.incoming_sequence = w.incoming_sequence.wrapping_add(1);
+    }
+    payload.extend_from_slice(&msg.data[msg.readcount as usize..msg.cursize as usize]);
+
+    // (the framing has to go: demo recording writes the packet as received)
+    let total = header_len + payload.len();
+    if msg.data.len() < total {
+        msg.data.resize(total, 0);
+    }
+    msg.data[header_len..total].copy_from_slice(&payload);
+    msg.maxsize = msg.maxsize.max(total as i32);
+    msg.cursize = total as i32;
+    msg.readcount = header_len as i32;
+    true
+}
+
 /// Build an out-of-band packet (sequence = -1) and return its bytes.
 pub fn netchan_out_of_band_data(data: &[u8]) -> Vec<u8> {
     let mut send = SizeBuf::new(MAX_MSGLEN as i32);
@@ -373,6 +689,292 @@ mod tests {
         assert_eq!(&packet[4..], b"hello");
     }
 
+    fn make_chan(sock: NetSrc, protocol: i32) -> NetChan {
+        let mut chan = NetChan::new();
+        netchan_setup(sock, &mut chan, NetAdr::default(), 12345, 0);
+        netchan_set_protocol(&mut chan, protocol);
+        chan
+    }
+
+    /// Hand `packet` to `chan` as NET_GetPacket would; the payload if accepted.
+    fn receive(chan: &mut NetChan, packet: &[u8], curtime: i32) -> Option<Vec<u8>> {
+        assert!(packet.len() <= MAX_MSGLEN);
+        let mut msg = SizeBuf::new(MAX_MSGLEN as i32);
+        msg.data[..packet.len()].copy_from_slice(packet);
+        msg.cursize = packet.len() as i32;
+        if netchan_process(chan, &mut msg, curtime) {
+            Some(msg.data[msg.readcount as usize..msg.cursize as usize].to_vec())
+        } else {
+            None
+        }
+    }
+
+    fn frame_bytes(tick: u32, len: usize) -> Vec<u8> {
+        let mut frame = vec![0xBB, tick as u8, (tick >> 8) as u8];
+        frame.extend((0..len.saturating_sub(3)).map(|i| (i as u32 * 31 + tick * 7) as u8));
+        frame
+    }
+
+    #[test]
+    fn test_large_datagram_fragments() {
+        let mut server = make_chan(NetSrc::Server, PROTOCOL_Q2PRO);
+        let mut client = make_chan(NetSrc::Client, PROTOCOL_Q2PRO);
+        let frame = frame_bytes(1, 5000);
+
+        let packets = netchan_build_packets(&mut server, &frame, 0, 0);
+        assert_eq!(packets.len(), 4);
+        assert!(packets.iter().all(|p| p.len() <= MAX_MSGLEN));
+
+        // out of order, with a duplicate: only the last new piece completes it
+        assert_eq!(receive(&mut client, &packets[2], 0), None);
+        assert_eq!(receive(&mut client, &packets[3], 0), None);
+        assert_eq!(receive(&mut client, &packets[3], 0), None);
+        assert_eq!(receive(&mut client, &packets[0], 0), None);
+        assert_eq!(receive(&mut client, &packets[1], 0), Some(frame));
+
+        // late copies of a delivered sequence are stale
+        assert_eq!(receive(&mut client, &packets[0], 0), None);
+        assert_eq!(client.incoming_sequence, 1);
+    }
+
+    #[test]
+    fn test_no_fragmentation_before_q2pro() {
+        let mut server = make_chan(NetSrc::Server, PROTOCOL_R1Q2);
+        let packets = netchan_build_packets(&mut server, &frame_bytes(1, 5000), 0, 0);
+        assert_eq!(packets.len(), 1);
+        assert_eq!(packets[0].len(), 8); // unreliable dumped
+        assert_eq!(netchan_max_datagram(&server), MAX_MSGLEN);
+    }
+
+    #[test]
+    fn test_fragment_loss_loopback() {
+        let mut server = make_chan(NetSrc::Server, PROTOCOL_Q2PRO);
+        let mut client = make_chan(NetSrc::Client, PROTOCOL_Q2PRO);
+        let mut seed = 0x1234_5678u32;
+        let mut lose = |rate: u32| {
+            seed = seed.wrapping_mul(1664525).wrapping_add(1013904223);
+            (seed >> 16) % 100 < rate
+        };
+
+        let mut next_reliable = 0u16;
+        let mut expect_reliable = 0u16;
+        let mut frames = 0;
+        let ticks = 400;
+
+        for tick in 0..ticks + 50 {
+            // lossy for `ticks` server frames, then clean so reliables drain
+            let loss = if tick < ticks { 15 } else { 0 };
+
+            if tick < ticks && tick % 5 == 0 && server.message.cursize + 20 < server.message.maxsize {
+                let mut rel = vec![0xAA, next_reliable as u8, (next_reliable >> 8) as u8];
+                rel.extend((0..17).map(|i| (i + next_reliable as usize) as u8));
+                server.message.write(&rel);
+                next_reliable += 1;
+            }
+
+            let frame = frame_bytes(tick, 300 + (tick as usize * 997) % 9000);
+            let mut packets = netchan_build_packets(&mut server, &frame, tick as i32, 0);
+            if tick % 2 == 1 {
+                packets.reverse();
+            }
+            for p in packets.iter().filter(|_| !lose(loss)) {
+                let Some(payload) = receive(&mut client, p, tick as i32) else { continue };
+
+                // reliable records first, in order and exactly once
+                let mut at = 0;
+                while payload.get(at) == Some(&0xAA) {
+                    let n = u16::from_le_bytes([payload[at + 1], payload[at + 2]]);
+                    assert_eq!(n, expect_reliable, "reliable out of order");
+                    expect_reliable += 1;
+                    at += 20;
+                }
+                let got = &payload[at..];
+                let t = u16::from_le_bytes([got[1], got[2]]) as u32;
+                assert_eq!(t, tick, "frame from another tick");
+                assert_eq!(got, &frame[..], "frame {} corrupted", tick);
+                frames += 1;
+            }
+
+            // the client answers every frame; its packets can be lost too
+            for p in netchan_build_packets(&mut client, &[], tick as i32, 12345) {
+                if !lose(loss) {
+                    receive(&mut server, &p, tick as i32);
+                }
+            }
+        }
+
+        assert_eq!(expect_reliable, next_reliable, "reliables not all delivered");
+        assert!(frames > ticks / 2, "only {} of {} frames arrived", frames, ticks);
+    }
+
+    fn make_windowed(sock: NetSrc) -> NetChan {
+        let mut chan = make_chan(sock, PROTOCOL_Q2PRO);
+        netchan_set_windowed(&mut chan, true);
+        chan
+    }
+
+    #[test]
+    fn test_window_selective_ack() {
+        let mut server = make_windowed(NetSrc::Server);
+        let mut client = make_windowed(NetSrc::Client);
+
+        // three reliable messages go out back to back, none waiting for an ack
+        let mut packets = Vec::new();
+        for text in [b"one", b"two", b"six"] {
+            assert!(netchan_can_reliable(&server));
+            server.message.write(text);
+            packets.extend(netchan_build_packets(&mut server, b"frame", 0, 0));
+        }
+        assert_eq!(packets.len(), 3);
+        assert_eq!(server.window.outgoing.len(), 3);
+
+        // the first is lost: the others are held back, not delivered early
+        assert_eq!(receive(&mut client, &packets[1], 0).as_deref(), Some(&b"frame"[..]));
+        assert_eq!(receive(&mut client, &packets[2], 0).as_deref(), Some(&b"frame"[..]));
+
+        // the selective ack leaves only the lost one, which is due again
+        for p in netchan_build_packets(&mut client, &[], 0, 12345) {
+            receive(&mut server, &p, 0);
+        }
+        assert_eq!(server.window.outgoing.len(), 1);
+        assert_eq!(server.window.outgoing[0].data, b"one");
+        assert!(netchan_need_reliable(&server));
+
+        let resend = netchan_build_packets(&mut server, b"frame", 0, 0);
+        assert_eq!(receive(&mut client, &resend[0], 0).as_deref(), Some(&b"onetwosixframe"[..]));
+
+        // a repeat of a delivered segment is not delivered twice
+        server.window.outgoing[0].last_sent = 0;
+        let again = netchan_build_packets(&mut server, b"frame", 0, 0);
+        assert_eq!(receive(&mut client, &again[0], 0).as_deref(), Some(&b"frame"[..]));
+        for p in netchan_build_packets(&mut client, &[], 0, 12345) {
+            receive(&mut server, &p, 0);
+        }
+        assert!(server.window.outgoing.is_empty());
+    }
+
+    #[test]
+    fn test_window_ack_sent_once() {
+        let mut server = make_windowed(NetSrc::Server);
+        let mut client = make_windowed(NetSrc::Client);
+
+        server.message.write(b"one");
+        let packets = netchan_build_packets(&mut server, b"frame", 0, 0);
+        receive(&mut client, &packets[0], 0);
+        assert!(client.window.ack_pending);
+
+        // the ack goes out with the next packet only
+        let acked = netchan_build_packets(&mut client, &[], 0, 12345);
+        let idle = netchan_build_packets(&mut client, &[], 0, 12345);
+        assert!(!client.window.ack_pending);
+        assert_eq!(acked[0].len(), idle[0].len() + 6);
+
+        // a repeat of the segment (the ack was lost) is acked again
+        server.window.outgoing[0].last_sent = 0;
+        let again = netchan_build_packets(&mut server, b"frame", 0, 0);
+        receive(&mut client, &again[0], 0);
+        assert!(client.window.ack_pending);
+        receive(&mut server, &acked[0], 0);
+        assert!(server.window.outgoing.is_empty());
+    }
+
+    #[test]
+    fn test_window_needs_fragmentation() {
+        let mut chan = make_chan(NetSrc::Server, PROTOCOL_R1Q2);
+        netchan_set_windowed(&mut chan, true);
+        assert!(!chan.windowed);
+    }
+
+    /// Stream 1000-byte reliable records from a server to a client over a
+    /// link delaying packets `latency` ticks each way and losing `loss`
+    /// percent, both sides sending every tick. Records are queued whenever
+    /// `message` has room for one. Returns the records delivered in the first
+    /// `ticks` ticks; afterwards the link runs clean until everything is in.
+    fn stream_reliable(windowed: bool, latency: u32, loss: u32, ticks: u32) -> u32 {
+        const RECORD: usize = 1000;
+        let mut server = make_chan(NetSrc::Server, PROTOCOL_Q2PRO);
+        let mut client = make_chan(NetSrc::Client, PROTOCOL_Q2PRO);
+        netchan_set_windowed(&mut server, windowed);
+        netchan_set_windowed(&mut client, windowed);
+
+        let mut seed = 0x9e37_79b9u32;
+        let mut lose = |rate: u32| {
+            seed = seed.wrapping_mul(1664525).wrapping_add(1013904223);
+            (seed >> 16) % 100 < rate
+        };
+        let mut to_client = std::collections::VecDeque::new();
+        let mut to_server = std::collections::VecDeque::new();
+
+        let (mut queued, mut delivered, mut measured) = (0u16, 0u16, 0u32);
+        for tick in 0..ticks + 100 * (latency + 1) {
+            let producing = tick < ticks;
+            let loss = if producing { loss } else { 0 };
+            if tick == ticks {
+                measured = delivered as u32;
+            }
+
+            while to_server.front().is_some_and(|(at, _)| *at <= tick) {
+                let (_, p): (u32, Vec<u8>) = to_server.pop_front().unwrap();
+                receive(&mut server, &p, tick as i32);
+            }
+            if producing && server.message.cursize as usize + RECORD <= server.message.maxsize as usize {
+                let mut record = vec![0xAA; RECORD];
+                record[1..3].copy_from_slice(&queued.to_le_bytes());
+                server.message.write(&record);
+                queued += 1;
+            }
+            for p in netchan_build_packets(&mut server, &frame_bytes(tick, 100), tick as i32, 0) {
+                if !lose(loss) {
+                    to_client.push_back((tick + latency, p));
+                }
+            }
+
+            while to_client.front().is_some_and(|(at, _)| *at <= tick) {
+                let (_, p) = to_client.pop_front().unwrap();
+                let Some(payload) = receive(&mut client, &p, tick as i32) else { continue };
+                let mut at = 0;
+                while payload.get(at) == Some(&0xAA) {
+                    let n = u16::from_le_bytes([payload[at + 1], payload[at + 2]]);
+                    assert_eq!(n, delivered, "reliable out of order");
+                    delivered += 1;
+                    at += RECORD;
+                }
+                assert_eq!(payload.len() - at, 100, "frame corrupted");
+                assert_eq!(payload[at], 0xBB);
+            }
+            for p in netchan_build_packets(&mut client, &[], tick as i32, 12345) {
+                if !lose(loss) {
+                    to_server.push_back((tick + latency, p));
+                }
+            }
+        }
+
+        assert_eq!(delivered, queued, "reliables not all delivered");
+        measured
+    }
+
+    #[test]
+    fn test_window_throughput_latency() {
+        // 25 ms ticks, 400 of them: 10 seconds of streaming
+        let ticks = 400;
+        for latency in [1, 2, 4, 8] {
+            let single = stream_reliable(false, latency, 0, ticks);
+            let window = stream_reliable(true, latency, 0, ticks);
+            let lossy = stream_reliable(true, latency, 10, ticks);
+            println!(
+                "one-way {:3} ms: {:6} B/s single, {:6} B/s windowed, {:6} B/s windowed at 10% loss",
+                latency * 25,
+                single * 100,
+                window * 100,
+                lossy * 100
+            );
+            // a record per round trip against a record per tick
+            assert!(single <= ticks / (2 * latency) + 1);
+            assert!(window >= ticks - 2 * latency - 1);
+            assert!(lossy > single);
+        }
+    }
+
     #[test]
     fn test_transmit_basic() {
         let mut chan = make_test_chan();
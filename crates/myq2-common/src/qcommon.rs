@@ -315,12 +315,14 @@ pub struct FragmentState {
     pub in_progress: bool,
     /// Sequence number of the fragmented packet
     pub sequence: i32,
-    /// Current offset into the fragmented data
+    /// Bytes received so far
     pub current_offset: i32,
-    /// Total size of the complete message
+    /// Total size of the complete message (0 until the last fragment arrives)
     pub total_size: i32,
     /// Buffer for accumulating fragmented data
     pub buffer: Vec<u8>,
+    /// Bit n set once the fragment at n * MAX_FRAGMENT_SIZE is in
+    pub received: u64,
 }
 
 impl FragmentState {
@@ -331,6 +333,7 @@ impl FragmentState {
             current_offset: 0,
             total_size: 0,
             buffer: Vec::with_capacity(MAX_MSGLEN_R1Q2),
+            received: 0,
         }
     }
 
@@ -341,6 +344,53 @@ impl FragmentState {
         self.current_offset = 0;
         self.total_size = 0;
         self.buffer.clear();
+        self.received = 0;
+    }
+}
+
+/// Reliable segments a windowed channel may have in flight.
+pub const RELIABLE_WINDOW: usize = 32;
+
+/// One outgoing reliable segment: the contents of `NetChan::message` at the
+/// transmit that queued it.
+#[derive(Debug, Clone, Default)]
+pub struct ReliableSegment {
+    pub sequence: u32,
+    pub data: Vec<u8>,
+    /// Packet sequence it last went out in (0 = not sent yet)
+    pub last_sent: i32,
+}
+
+/// Windowed reliable state ("nc=1" negotiated at connect).
+#[derive(Debug, Clone)]
+pub struct ReliableWindow {
+    /// Unacknowledged outgoing segments, oldest first
+    pub outgoing: Vec<ReliableSegment>,
+    /// Sequence for the next outgoing segment
+    pub next_sequence: u32,
+    /// Next incoming segment to deliver; everything before it has been
+    pub incoming_sequence: u32,
+    /// Segments received ahead of `incoming_sequence`, by sequence % RELIABLE_WINDOW
+    pub held: Vec<Option<Vec<u8>>>,
+    /// True once a segment has arrived, until the next packet carries the ack
+    pub ack_pending: bool,
+}
+
+impl ReliableWindow {
+    pub fn new() -> Self {
+        Self {
+            outgoing: Vec::with_capacity(RELIABLE_WINDOW),
+            next_sequence: 0,
+            incoming_sequence: 0,
+            held: vec![None; RELIABLE_WINDOW],
+            ack_pending: false,
+        }
+    }
+}
+
+impl Default for ReliableWindow {
+    fn default() -> Self {
+        Self::new()
     }
 }
 
@@ -375,6 +425,11 @@ pub struct NetChan {
     pub fragment_in: FragmentState,
     /// Outgoing fragment state for sending large packets
     pub fragment_out: FragmentState,
+
+    /// Windowed reliable mode: several reliable messages in flight, acked
+    /// selectively, instead of the single reliable bit
+    pub windowed: bool,
+    pub window: ReliableWindow,
 }
 
 impl NetChan {
@@ -400,6 +455,8 @@ impl NetChan {
             reliable_buf: [0u8; MAX_MSGLEN - 16],
             fragment_in: FragmentState::new(),
             fragment_out: FragmentState::new(),
+            windowed: false,
+            window: ReliableWindow::new(),
         }
     }
 }
@@ -441,6 +498,9 @@ pub const SVC_FRAME: i32 = 20;
 pub const SVC_ZPACKET: i32 = 21;
 /// Compressed download chunk - includes uncompressed size
 pub const SVC_ZDOWNLOAD: i32 = 22;
+/// Packet entities as one bit stream (see msg_bits.rs), negotiated with
+/// "be=<profile>" at connect
+pub const SVC_PACKETENTITIES_BITS: i32 = 23;
 
 // ============================================================
 // Memory tags (for Z_TagMalloc)
@@ -19,14 +19,29 @@ pub mod vulkan;
 pub mod vk_bindings;
 pub mod vk_model_types;
 pub mod vk_local;
+pub mod vk_glstate;
 pub mod qvk;
 pub mod vk_model;
+pub mod vk_mesh_simd;
+pub mod vk_mesh_edges;
 pub mod vk_image;
+pub mod vk_image_simd;
+pub mod vk_particle_simd;
+pub mod vk_registry;
+pub mod vk_texcache;
 pub mod vk_draw;
 pub mod vk_light;
+pub mod vk_light_simd;
+pub mod vk_lightmap_atlas;
 pub mod vk_warp;
+pub mod vk_warp_simd;
+pub mod vk_refl;
 pub mod vk_rsurf;
+pub mod vk_sort;
+pub mod vk_world_cull;
 pub mod vk_rmain;
 pub mod vk_rmisc;
+pub mod vk_capture;
 pub mod platform;
+pub mod simd;
 pub mod modern;
@@ -1,10 +1,12 @@
 //! BSP world geometry management
 //!
-//! Batches BSP surfaces into VBOs grouped by texture.
-//! Uses parallel processing for batch construction.
+//! The whole world is uploaded once at map load into one static vertex
+//! buffer. The index buffer is laid out sorted by (texture, lightmap page), so
+//! every batch is one contiguous index range. Each frame the visible surfaces
+//! are gathered into a CPU index list in that same order, which gives one
+//! draw per (texture, lightmap) pair and minimal binds.
 
 use super::{VertexBuffer, IndexBuffer, VertexArray};
-use rayon::prelude::*;
 
 /// Vertex format for BSP world surfaces.
 ///
@@ -47,12 +49,16 @@ pub struct SurfaceDrawInfo {
     pub lightmap_id: u32,
     /// Surface flags (SURF_DRAWTURB, SURF_FLOWING, etc.).
     pub flags: u32,
+    /// Index of the source surface in the world model.
+    pub surface: u32,
 }
 
-/// A batch of surfaces sharing the same texture.
+/// A batch of surfaces sharing the same texture and lightmap page.
 pub struct TextureBatch {
     /// Diffuse texture ID.
     pub texture_id: u32,
+    /// Lightmap texture ID (or layer in texture array).
+    pub lightmap_id: u32,
     /// First index in the global index buffer.
     pub first_index: u32,
     /// Number of indices in this batch.
@@ -61,6 +67,51 @@ pub struct TextureBatch {
     pub surfaces: Vec<usize>,
 }
 
+/// One draw of this frame's visible world geometry.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct FrameBatch {
+    /// Diffuse texture ID.
+    pub texture_id: u32,
+    /// Lightmap texture ID (or layer in texture array).
+    pub lightmap_id: u32,
+    /// First index in the frame index list.
+    pub first_index: u32,
+    /// Number of indices to draw.
+    pub index_count: u32,
+}
+
+/// Draw-call and state-change counters for one world pass (r_speeds).
+///
+/// Filled by `build_frame`, so they are available without a GPU.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct WorldDrawStats {
+    /// Visible surfaces submitted.
+    pub surfaces: u32,
+    /// Draw calls issued (one per frame batch).
+    pub draw_calls: u32,
+    /// Diffuse texture binds.
+    pub texture_binds: u32,
+    /// Lightmap binds.
+    pub lightmap_binds: u32,
+    /// Indices drawn.
+    pub indices: u32,
+}
+
+impl WorldDrawStats {
+    pub const fn new() -> Self {
+        Self {
+            surfaces: 0,
+            draw_calls: 0,
+            texture_binds: 0,
+            lightmap_binds: 0,
+            indices: 0,
+        }
+    }
+}
+
+/// Sentinel for world surfaces with no geometry in the buffer.
+const NO_SURFACE: u32 = u32::MAX;
+
 /// Manages BSP world geometry.
 pub struct BspGeometryManager {
     /// Vertex buffer containing all BSP vertices.
@@ -69,10 +120,26 @@ pub struct BspGeometryManager {
     ibo: IndexBuffer,
     /// VAO configuration.
     vao: VertexArray,
-    /// Per-surface metadata.
+    /// Per-surface metadata, sorted by (texture, lightmap, world surface).
     surfaces: Vec<SurfaceDrawInfo>,
-    /// Batches grouped by texture.
+    /// Batches grouped by texture and lightmap page.
     batches: Vec<TextureBatch>,
+    /// CPU copy of the index buffer (source for the frame index list).
+    indices: Vec<u32>,
+    /// World surface number -> first entry in `surfaces` (or NO_SURFACE).
+    surface_first: Vec<u32>,
+    /// World surface number -> number of entries in `surfaces`.
+    surface_count: Vec<u16>,
+    /// Entry in `surfaces` -> owning batch.
+    surface_batch: Vec<u32>,
+    /// Scratch: visible entries in `surfaces`, sorted into batch order.
+    frame_draws: Vec<u32>,
+    /// This frame's index list.
+    frame_indices: Vec<u32>,
+    /// This frame's draws.
+    frame_batches: Vec<FrameBatch>,
+    /// Counters for the last `build_frame`.
+    frame_stats: WorldDrawStats,
     /// Total vertex count.
     vertex_count: u32,
     /// Total index count.
@@ -90,6 +157,14 @@ impl BspGeometryManager {
             vao: VertexArray::new(),
             surfaces: Vec::new(),
             batches: Vec::new(),
+            indices: Vec::new(),
+            surface_first: Vec::new(),
+            surface_count: Vec::new(),
+            surface_batch: Vec::new(),
+            frame_draws: Vec::new(),
+            frame_indices: Vec::new(),
+            frame_batches: Vec::new(),
+            frame_stats: WorldDrawStats::new(),
             vertex_count: 0,
             index_count: 0,
             initialized: false,
@@ -98,21 +173,19 @@ impl BspGeometryManager {
 
     /// Build geometry from BSP surfaces.
     ///
-    /// This should be called at level load time.
+    /// `indices` may be in any order; it is rewritten so each (texture,
+    /// lightmap) batch occupies one contiguous range. This should be called
+    /// at level load time.
     pub fn build(&mut self, vertices: &[BspVertex], indices: &[u32], surfaces: Vec<SurfaceDrawInfo>) {
+        self.sort_surfaces(indices, surfaces);
+
         // Upload vertex data
         self.vbo.upload(vertices, 0);
         self.vertex_count = vertices.len() as u32;
 
         // Upload index data
-        self.ibo.upload_u32(indices, 0);
-        self.index_count = indices.len() as u32;
-
-        // Store surface info
-        self.surfaces = surfaces;
-
-        // Build texture batches
-        self.build_batches();
+        self.ibo.upload_u32(&self.indices, 0);
+        self.index_count = self.indices.len() as u32;
 
         // Configure VAO
         self.setup_vao();
@@ -120,55 +193,116 @@ impl BspGeometryManager {
         self.initialized = true;
     }
 
-    /// Group surfaces into batches by texture.
-    ///
-    /// Uses parallel processing to calculate index ranges for each batch.
-    fn build_batches(&mut self) {
-        use std::collections::HashMap;
-
-        // Phase 1: Group surfaces by texture ID (sequential HashMap insertion)
-        let mut batch_map: HashMap<u32, Vec<usize>> = HashMap::new();
-        for (i, surface) in self.surfaces.iter().enumerate() {
-            batch_map
-                .entry(surface.texture_id)
-                .or_insert_with(Vec::new)
-                .push(i);
+    /// Reorder surfaces and their indices by (texture, lightmap, world
+    /// surface), then build the batches and the world surface lookup.
+    fn sort_surfaces(&mut self, indices: &[u32], mut surfaces: Vec<SurfaceDrawInfo>) {
+        surfaces.sort_by_key(|s| (s.texture_id, s.lightmap_id, s.surface));
+
+        self.indices.clear();
+        self.indices.reserve(indices.len());
+        self.batches.clear();
+        self.surface_batch.clear();
+        self.surface_batch.reserve(surfaces.len());
+
+        let num_world = surfaces.iter().map(|s| s.surface as usize + 1).max().unwrap_or(0);
+        self.surface_first.clear();
+        self.surface_first.resize(num_world, NO_SURFACE);
+        self.surface_count.clear();
+        self.surface_count.resize(num_world, 0);
+
+        for (i, surf) in surfaces.iter_mut().enumerate() {
+            let src = surf.first_index as usize..(surf.first_index + surf.index_count) as usize;
+            surf.first_index = self.indices.len() as u32;
+            self.indices.extend_from_slice(&indices[src]);
+
+            let new_batch = match self.batches.last() {
+                Some(b) => b.texture_id != surf.texture_id || b.lightmap_id != surf.lightmap_id,
+                None => true,
+            };
+            if new_batch {
+                self.batches.push(TextureBatch {
+                    texture_id: surf.texture_id,
+                    lightmap_id: surf.lightmap_id,
+                    first_index: surf.first_index,
+                    index_count: 0,
+                    surfaces: Vec::new(),
+                });
+            }
+            let batch = self.batches.last_mut().unwrap();
+            batch.index_count += surf.index_count;
+            batch.surfaces.push(i);
+            self.surface_batch.push(self.batches.len() as u32 - 1);
+
+            // A surface's polys share its texture and lightmap, so they are
+            // adjacent after the sort.
+            let w = surf.surface as usize;
+            if self.surface_first[w] == NO_SURFACE {
+                self.surface_first[w] = i as u32;
+            }
+            self.surface_count[w] += 1;
         }
 
-        // Phase 2: Calculate batch index ranges in parallel
-        // Collect into Vec first so we can process in parallel
-        let batch_entries: Vec<_> = batch_map.into_iter().collect();
-
-        // Reference to surfaces for parallel closure
-        let surfaces = &self.surfaces;
-
-        // Process each texture group in parallel
-        let mut batches: Vec<TextureBatch> = batch_entries
-            .into_par_iter()
-            .map(|(texture_id, surface_indices)| {
-                // Calculate first index and count for this batch
-                let (first_index, last_index) = surface_indices
-                    .iter()
-                    .fold((u32::MAX, 0u32), |(first, last), &si| {
-                        let surf = &surfaces[si];
-                        (
-                            first.min(surf.first_index),
-                            last.max(surf.first_index + surf.index_count),
-                        )
-                    });
-
-                TextureBatch {
-                    texture_id,
-                    first_index,
-                    index_count: last_index.saturating_sub(first_index),
-                    surfaces: surface_indices,
+        self.surfaces = surfaces;
+    }
+
+    /// Gather the geometry of the visible world surfaces (world surface
+    /// numbers, any order, no duplicates) into this frame's index list and
+    /// draw batches. Returns the counters for the pass.
+    pub fn build_frame(&mut self, visible: &[u32]) -> WorldDrawStats {
+        self.frame_draws.clear();
+        self.frame_indices.clear();
+        self.frame_batches.clear();
+
+        let mut stats = WorldDrawStats::new();
+        for &w in visible {
+            let Some(&first) = self.surface_first.get(w as usize) else {
+                continue;
+            };
+            if first == NO_SURFACE {
+                continue;
+            }
+            let count = self.surface_count[w as usize] as u32;
+            self.frame_draws.extend(first..first + count);
+            stats.surfaces += 1;
+        }
+
+        // Entries are stored in batch order, so sorting them by position
+        // sorts by (texture, lightmap).
+        self.frame_draws.sort_unstable();
+
+        let mut cur_batch = NO_SURFACE;
+        let mut cur_texture = NO_SURFACE;
+        let mut cur_lightmap = NO_SURFACE;
+        for &d in &self.frame_draws {
+            let surf = &self.surfaces[d as usize];
+            let batch = self.surface_batch[d as usize];
+            if batch != cur_batch {
+                cur_batch = batch;
+                if surf.texture_id != cur_texture {
+                    cur_texture = surf.texture_id;
+                    stats.texture_binds += 1;
+                }
+                if surf.lightmap_id != cur_lightmap {
+                    cur_lightmap = surf.lightmap_id;
+                    stats.lightmap_binds += 1;
                 }
-            })
-            .collect();
+                self.frame_batches.push(FrameBatch {
+                    texture_id: surf.texture_id,
+                    lightmap_id: surf.lightmap_id,
+                    first_index: self.frame_indices.len() as u32,
+                    index_count: 0,
+                });
+            }
+
+            let src = surf.first_index as usize..(surf.first_index + surf.index_count) as usize;
+            self.frame_indices.extend_from_slice(&self.indices[src]);
+            self.frame_batches.last_mut().unwrap().index_count += surf.index_count;
+        }
 
-        // Sort batches by texture ID for consistent rendering order
-        batches.sort_by_key(|b| b.texture_id);
-        self.batches = batches;
+        stats.draw_calls = self.frame_batches.len() as u32;
+        stats.indices = self.frame_indices.len() as u32;
+        self.frame_stats = stats;
+        stats
     }
 
     /// Configure the VAO with vertex attributes.
@@ -204,6 +338,21 @@ impl BspGeometryManager {
         &self.surfaces
     }
 
+    /// This frame's draws (valid after `build_frame`).
+    pub fn frame_batches(&self) -> &[FrameBatch] {
+        &self.frame_batches
+    }
+
+    /// This frame's index list (valid after `build_frame`).
+    pub fn frame_indices(&self) -> &[u32] {
+        &self.frame_indices
+    }
+
+    /// Counters from the last `build_frame`.
+    pub fn frame_stats(&self) -> WorldDrawStats {
+        self.frame_stats
+    }
+
     /// Check if geometry has been built.
     pub fn is_initialized(&self) -> bool {
         self.initialized
@@ -228,6 +377,14 @@ impl BspGeometryManager {
     pub fn clear(&mut self) {
         self.surfaces.clear();
         self.batches.clear();
+        self.indices.clear();
+        self.surface_first.clear();
+        self.surface_count.clear();
+        self.surface_batch.clear();
+        self.frame_draws.clear();
+        self.frame_indices.clear();
+        self.frame_batches.clear();
+        self.frame_stats = WorldDrawStats::new();
         self.vertex_count = 0;
         self.index_count = 0;
         self.initialized = false;
@@ -239,3 +396,102 @@ impl Default for BspGeometryManager {
         Self::new()
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// One quad (two triangles, fan order) per surface: (world surface, texture, lightmap).
+    fn quads(defs: &[(u32, u32, u32)]) -> (Vec<u32>, Vec<SurfaceDrawInfo>) {
+        let mut indices = Vec::new();
+        let mut infos = Vec::new();
+        for (n, &(surface, texture_id, lightmap_id)) in defs.iter().enumerate() {
+            let base = n as u32 * 4;
+            let first_index = indices.len() as u32;
+            indices.extend_from_slice(&[base, base + 1, base + 2, base, base + 2, base + 3]);
+            infos.push(SurfaceDrawInfo {
+                first_index,
+                index_count: 6,
+                texture_id,
+                lightmap_id,
+                flags: 0,
+                surface,
+            });
+        }
+        (indices, infos)
+    }
+
+    fn manager(defs: &[(u32, u32, u32)]) -> BspGeometryManager {
+        let (indices, infos) = quads(defs);
+        let mut m = BspGeometryManager::new();
+        m.sort_surfaces(&indices, infos);
+        m
+    }
+
+    #[test]
+    fn test_batches_are_contiguous_per_texture_and_lightmap() {
+        let m = manager(&[(0, 5, 1), (1, 3, 1), (2, 5, 2), (3, 3, 1), (4, 5, 1)]);
+        let keys: Vec<_> = m.batches().iter().map(|b| (b.texture_id, b.lightmap_id)).collect();
+        assert_eq!(keys, vec![(3, 1), (5, 1), (5, 2)]);
+
+        let mut next = 0;
+        for b in m.batches() {
+            assert_eq!(b.first_index, next);
+            assert_eq!(b.index_count, 6 * b.surfaces.len() as u32);
+            next += b.index_count;
+        }
+        assert_eq!(next, 30);
+    }
+
+    #[test]
+    fn test_sort_keeps_each_surface_geometry() {
+        let defs = [(0, 9, 0), (1, 2, 0), (2, 4, 1)];
+        let m = manager(&defs);
+        for s in m.surfaces() {
+            let base = s.surface * 4;
+            let range = s.first_index as usize..(s.first_index + s.index_count) as usize;
+            assert_eq!(&m.indices[range], &[base, base + 1, base + 2, base, base + 2, base + 3]);
+        }
+    }
+
+    #[test]
+    fn test_build_frame_groups_visible_surfaces() {
+        let mut m = manager(&[(0, 5, 1), (1, 3, 1), (2, 5, 2), (3, 3, 1), (4, 5, 1)]);
+        let stats = m.build_frame(&[4, 2, 1, 0]);
+
+        let draws: Vec<_> = m.frame_batches().iter().map(|b| (b.texture_id, b.lightmap_id, b.index_count)).collect();
+        assert_eq!(draws, vec![(3, 1, 6), (5, 1, 12), (5, 2, 6)]);
+        assert_eq!(stats.surfaces, 4);
+        assert_eq!(stats.draw_calls, 3);
+        assert_eq!(stats.texture_binds, 2);
+        assert_eq!(stats.lightmap_binds, 2);
+        assert_eq!(stats.indices, 24);
+        assert_eq!(m.frame_indices().len(), 24);
+        assert_eq!(m.frame_stats(), stats);
+    }
+
+    #[test]
+    fn test_build_frame_skips_unknown_and_geometryless_surfaces() {
+        let mut m = manager(&[(0, 1, 1), (3, 1, 1)]);
+        let stats = m.build_frame(&[1, 2, 3, 99]);
+        assert_eq!(stats.surfaces, 1);
+        assert_eq!(stats.draw_calls, 1);
+        assert_eq!(m.frame_indices(), &[4, 5, 6, 4, 6, 7]);
+    }
+
+    #[test]
+    fn test_build_frame_multiple_polys_per_surface() {
+        let mut m = manager(&[(0, 1, 1), (0, 1, 1), (1, 2, 1)]);
+        let stats = m.build_frame(&[0]);
+        assert_eq!(stats.surfaces, 1);
+        assert_eq!(stats.indices, 12);
+        assert_eq!(stats.draw_calls, 1);
+    }
+
+    #[test]
+    fn test_build_frame_empty() {
+        let mut m = manager(&[(0, 1, 1)]);
+        assert_eq!(m.build_frame(&[]), WorldDrawStats::new());
+        assert!(m.frame_batches().is_empty());
+    }
+}
@@ -1,9 +1,20 @@
 //! 2D drawing geometry
 //!
 //! Batched rendering for console, menus, and HUD elements.
+//!
+//! Console text, layouts, the inventory and menus issue hundreds of small
+//! quads a frame, interleaving the conchars font, scrap-atlas pics and fills.
+//! Quads are queued into one batch per (texture, blend) rather than per run:
+//! a quad joins an earlier batch of its texture when nothing queued since
+//! overlaps it, so painter's order is kept. Batches are only closed when the
+//! queue is flushed (end of frame, or a texture whose contents are about to
+//! change).
 
 use super::{VertexBuffer, VertexArray};
 
+/// How many open batches a quad may move back past to join its texture.
+const MAX_LOOKBACK: usize = 16;
+
 /// Vertex format for 2D drawing.
 #[repr(C)]
 #[derive(Clone, Copy, Debug, Default)]
@@ -33,7 +44,7 @@ impl Draw2DVertex {
 /// A batch of 2D draw calls with the same texture.
 #[derive(Clone)]
 pub struct Draw2DBatch {
-    /// Texture ID for this batch.
+    /// Texture ID for this batch (0 draws untextured).
     pub texture: u32,
     /// First vertex in the buffer.
     pub first_vertex: u32,
@@ -60,22 +71,57 @@ impl Default for BlendMode {
     }
 }
 
+/// Per-frame 2D batching counters, for r_speeds.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct Draw2DStats {
+    /// Quads queued.
+    pub quads: u32,
+    /// Batches drawn (one draw call each).
+    pub batches: u32,
+    /// Flushes that drew something.
+    pub flushes: u32,
+}
+
+impl Draw2DStats {
+    pub const fn new() -> Self {
+        Self { quads: 0, batches: 0, flushes: 0 }
+    }
+}
+
+/// A batch still accepting quads.
+#[derive(Clone, Copy)]
+struct OpenBatch {
+    texture: u32,
+    blend: BlendMode,
+    /// Screen rectangle covering the batch's quads (x0, y0, x1, y1).
+    bounds: [f32; 4],
+    quads: u32,
+}
+
+fn overlaps(a: &[f32; 4], b: &[f32; 4]) -> bool {
+    a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3]
+}
+
 /// Manages batched 2D drawing.
 pub struct Draw2DManager {
     /// Dynamic VBO for batched quads.
     vbo: VertexBuffer,
     /// VAO configuration.
     vao: VertexArray,
-    /// Staging buffer for vertices.
+    /// Queued quads, in submission order, and the open batch each joined.
+    quads: Vec<[Draw2DVertex; 6]>,
+    quad_batch: Vec<u32>,
+    /// Open batches, in draw order.
+    open: Vec<OpenBatch>,
+    /// Vertices flushed since begin_frame, grouped by batch. A flush appends
+    /// behind the earlier ones, whose draws still read them.
     vertices: Vec<Draw2DVertex>,
-    /// Batches to draw.
+    /// Batches of the last flush.
     batches: Vec<Draw2DBatch>,
-    /// Current texture.
-    current_texture: u32,
-    /// Current blend mode.
-    current_blend: BlendMode,
     /// Character texture ID.
     char_texture: u32,
+    /// Counters since begin_frame.
+    stats: Draw2DStats,
 }
 
 impl Draw2DManager {
@@ -84,11 +130,13 @@ impl Draw2DManager {
         let mut manager = Self {
             vbo: VertexBuffer::new(),
             vao: VertexArray::new(),
+            quads: Vec::with_capacity(1024),
+            quad_batch: Vec::with_capacity(1024),
+            open: Vec::with_capacity(64),
             vertices: Vec::with_capacity(4096),
             batches: Vec::with_capacity(64),
-            current_texture: 0,
-            current_blend: BlendMode::Alpha,
             char_texture: 0,
+            stats: Draw2DStats::new(),
         };
 
         manager.setup_vao();
@@ -118,30 +166,33 @@ impl Draw2DManager {
 
     /// Clear for new frame.
     pub fn begin_frame(&mut self) {
+        self.quads.clear();
+        self.quad_batch.clear();
+        self.open.clear();
         self.vertices.clear();
         self.batches.clear();
-        self.current_texture = 0;
-        self.current_blend = BlendMode::Alpha;
+        self.stats = Draw2DStats::new();
     }
 
-    /// Flush current batch if texture changed.
-    fn flush_if_changed(&mut self, texture: u32, blend: BlendMode) {
-        if texture != self.current_texture || blend != self.current_blend {
-            if !self.vertices.is_empty() && self.current_texture != 0 {
-                let start = self.batches.last().map(|b| b.first_vertex + b.vertex_count).unwrap_or(0);
-                let count = self.vertices.len() as u32 - start;
-                if count > 0 {
-                    self.batches.push(Draw2DBatch {
-                        texture: self.current_texture,
-                        first_vertex: start,
-                        vertex_count: count,
-                        blend_mode: self.current_blend,
-                    });
-                }
+    /// Pick the open batch for a quad: the newest batch with the same state
+    /// that no later batch overlaps, or a new batch at the end.
+    fn batch_for(&mut self, texture: u32, blend: BlendMode, rect: [f32; 4]) -> u32 {
+        for (i, b) in self.open.iter_mut().enumerate().rev().take(MAX_LOOKBACK) {
+            if b.texture == texture && b.blend == blend {
+                b.bounds = [
+                    b.bounds[0].min(rect[0]), b.bounds[1].min(rect[1]),
+                    b.bounds[2].max(rect[2]), b.bounds[3].max(rect[3]),
+                ];
+                b.quads += 1;
+                return i as u32;
+            }
+            if overlaps(&b.bounds, &rect) {
+                // moving the quad before this batch would change what is on top
+                break;
             }
-            self.current_texture = texture;
-            self.current_blend = blend;
         }
+        self.open.push(OpenBatch { texture, blend, bounds: rect, quads: 1 });
+        self.open.len() as u32 - 1
     }
 
     /// Add a quad to the batch.
@@ -159,18 +210,22 @@ impl Draw2DManager {
         texture: u32,
         blend: BlendMode,
     ) {
-        self.flush_if_changed(texture, blend);
+        let rect = [x.min(x + w), y.min(y + h), x.max(x + w), y.max(y + h)];
+        let batch = self.batch_for(texture, blend, rect);
+        self.stats.quads += 1;
 
         // Two triangles forming a quad
         // Triangle 1: bottom-left, top-left, top-right
-        self.vertices.push(Draw2DVertex::new([x, y + h], [s1, t2], color));
-        self.vertices.push(Draw2DVertex::new([x, y], [s1, t1], color));
-        self.vertices.push(Draw2DVertex::new([x + w, y], [s2, t1], color));
-
         // Triangle 2: bottom-left, top-right, bottom-right
-        self.vertices.push(Draw2DVertex::new([x, y + h], [s1, t2], color));
-        self.vertices.push(Draw2DVertex::new([x + w, y], [s2, t1], color));
-        self.vertices.push(Draw2DVertex::new([x + w, y + h], [s2, t2], color));
+        self.quads.push([
+            Draw2DVertex::new([x, y + h], [s1, t2], color),
+            Draw2DVertex::new([x, y], [s1, t1], color),
+            Draw2DVertex::new([x + w, y], [s2, t1], color),
+            Draw2DVertex::new([x, y + h], [s1, t2], color),
+            Draw2DVertex::new([x + w, y], [s2, t1], color),
+            Draw2DVertex::new([x + w, y + h], [s2, t2], color),
+        ]);
+        self.quad_batch.push(batch);
     }
 
     /// Draw a character from the console font.
@@ -215,26 +270,55 @@ impl Draw2DManager {
         );
     }
 
-    /// Upload and flush all batches.
+    /// Whether any queued quad samples `texture`.
+    pub fn uses_texture(&self, texture: u32) -> bool {
+        self.open.iter().any(|b| b.texture == texture)
+    }
+
+    /// Close the open batches: group the queued quads by batch (stable, so
+    /// each batch keeps submission order), upload them and make them
+    /// available through `batches()`. The queue is empty afterwards.
     pub fn flush(&mut self) {
-        if self.vertices.is_empty() {
+        self.batches.clear();
+        if self.quads.is_empty() {
             return;
         }
 
-        // Finalize current batch
-        let start = self.batches.last().map(|b| b.first_vertex + b.vertex_count).unwrap_or(0);
-        let count = self.vertices.len() as u32 - start;
-        if count > 0 && self.current_texture != 0 {
+        let base = self.vertices.len();
+        let mut next: Vec<u32> = Vec::with_capacity(self.open.len());
+        let mut first = (base / 6) as u32;
+        for b in &self.open {
+            next.push(first);
             self.batches.push(Draw2DBatch {
-                texture: self.current_texture,
-                first_vertex: start,
-                vertex_count: count,
-                blend_mode: self.current_blend,
+                texture: b.texture,
+                first_vertex: first * 6,
+                vertex_count: b.quads * 6,
+                blend_mode: b.blend,
             });
+            first += b.quads;
+        }
+        self.vertices.resize(base + self.quads.len() * 6, Draw2DVertex::default());
+        for (quad, &batch) in self.quads.iter().zip(&self.quad_batch) {
+            let slot = next[batch as usize] as usize;
+            next[batch as usize] += 1;
+            self.vertices[slot * 6..slot * 6 + 6].copy_from_slice(quad);
         }
 
-        // Upload vertex data via SDL3 GPU transfer buffer
-        self.vbo.upload(&self.vertices, 0);
+        self.quads.clear();
+        self.quad_batch.clear();
+        self.open.clear();
+        self.stats.batches += self.batches.len() as u32;
+        self.stats.flushes += 1;
+
+        // Upload vertex data via staging buffer: only this flush's vertices
+        // while the buffer has room behind the earlier ones, otherwise the
+        // whole frame into a larger buffer
+        let end = self.vertices.len() * Draw2DVertex::SIZE;
+        if base > 0 && end <= self.vbo.size() as usize {
+            self.vbo.update(base * Draw2DVertex::SIZE, &self.vertices[base..]);
+        } else {
+            self.vbo.upload(&self.vertices, 0);
+        }
     }
 
     /// Bind for rendering.
@@ -247,10 +331,16 @@ impl Draw2DManager {
         &self.vbo
     }
 
-    /// Get batches for rendering.
+    /// Get the batches of the last flush, in draw order. Their vertices are
+    /// offset past those of earlier flushes this frame.
     pub fn batches(&self) -> &[Draw2DBatch] {
         &self.batches
     }
+
+    /// Counters since begin_frame.
+    pub fn stats(&self) -> Draw2DStats {
+        self.stats
+    }
 }
 
 impl Default for Draw2DManager {
@@ -258,3 +348,86 @@ impl Default for Draw2DManager {
         Self::new()
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const FONT: u32 = 1;
+    const SCRAP: u32 = 2;
+
+    fn batches(m: &Draw2DManager) -> Vec<(u32, u32, u32)> {
+        m.batches().iter().map(|b| (b.texture, b.first_vertex, b.vertex_count)).collect()
+    }
+
+    fn pic(m: &mut Draw2DManager, x: f32, y: f32, texture: u32) {
+        m.push_quad(x, y, 24.0, 24.0, 0.0, 0.0, 1.0, 1.0, [1.0; 4], texture, BlendMode::Alpha);
+    }
+
+    #[test]
+    fn test_interleaved_textures_merge() {
+        let mut m = Draw2DManager::new();
+        m.set_char_texture(FONT);
+        m.begin_frame();
+        // HUD: icon, number, icon, number ... side by side
+        for i in 0..4 {
+            pic(&mut m, i as f32 * 64.0, 200.0, SCRAP);
+            m.draw_char(i * 64 + 32, 208, b'0' + i as u8);
+        }
+        m.flush();
+
+        assert_eq!(batches(&m), vec![(SCRAP, 0, 24), (FONT, 24, 24)]);
+        // each batch keeps submission order
+        assert_eq!(m.vertices[6].position[0], 64.0);
+        assert_eq!(m.vertices[30].position[0], 96.0);
+        assert_eq!(m.stats(), Draw2DStats { quads: 8, batches: 2, flushes: 1 });
+    }
+
+    #[test]
+    fn test_overlap_keeps_order() {
+        let mut m = Draw2DManager::new();
+        m.set_char_texture(FONT);
+        m.begin_frame();
+        m.draw_char(0, 0, b'a');
+        m.draw_fill(0, 0, 64, 8, [0.0, 0.0, 0.0, 0.5]); // covers the 'a'
+        m.draw_char(100, 0, b'b'); // clear of the fill: joins the first batch
+        m.draw_char(4, 4, b'c'); // under the fill's rectangle: must stay on top
+        m.flush();
+        assert_eq!(batches(&m), vec![(FONT, 0, 12), (0, 12, 6), (FONT, 18, 6)]);
+
+        // the queue is empty after a flush; counters run until begin_frame
+        m.flush();
+        assert!(m.batches().is_empty());
+        pic(&mut m, 0.0, 0.0, SCRAP);
+        assert!(m.uses_texture(SCRAP) && !m.uses_texture(FONT));
+        m.flush();
+        assert_eq!(m.stats(), Draw2DStats { quads: 5, batches: 4, flushes: 2 });
+    }
+
+    #[test]
+    fn test_flushes_append_within_frame() {
+        let mut m = Draw2DManager::new();
+        m.set_char_texture(FONT);
+        m.begin_frame();
+        m.draw_char(0, 0, b'a');
+        pic(&mut m, 50.0, 0.0, SCRAP);
+        m.flush();
+        // a cinematic frame replaces the texture mid-frame
+        pic(&mut m, 50.0, 50.0, SCRAP);
+        m.draw_char(8, 0, b'b');
+        m.flush();
+
+        // the second flush draws from behind the first, which stays intact
+        assert_eq!(batches(&m), vec![(SCRAP, 12, 6), (FONT, 18, 6)]);
+        assert_eq!(m.vertices.len(), 24);
+        assert_eq!(m.vertices[0].position[0], 0.0);
+        assert_eq!(m.vertices[7].position[0], 50.0);
+        assert_eq!(m.vertices[13].position[1], 50.0);
+        assert_eq!(m.vertices[19].position[0], 8.0);
+
+        m.begin_frame();
+        pic(&mut m, 0.0, 0.0, SCRAP);
+        m.flush();
+        assert_eq!(batches(&m), vec![(SCRAP, 0, 6)]);
+    }
+}
@@ -9,7 +9,7 @@ mod particles;
 mod draw2d;
 
 pub use vbo::{VertexBuffer, IndexBuffer, IndexFormat, VertexArray};
-pub use bsp::{BspGeometryManager, BspVertex, SurfaceDrawInfo};
+pub use bsp::{BspGeometryManager, BspVertex, SurfaceDrawInfo, FrameBatch, WorldDrawStats};
 pub use alias::{AliasModelManager, AliasModelBuffers, AliasInstance, InstancedAliasBatch, InstancedAliasRenderer};
-pub use particles::ParticleManager;
-pub use draw2d::{Draw2DManager, BlendMode};
+pub use particles::{ParticleManager, ParticleBatch};
+pub use draw2d::{Draw2DManager, Draw2DStats, BlendMode};
@@ -1,40 +1,57 @@
 //! Particle system geometry
 //!
-//! Manages particle rendering via instanced billboard quads.
-
-use super::{VertexBuffer, VertexArray};
-
-/// Per-particle instance data.
-#[repr(C)]
-#[derive(Clone, Copy, Debug, Default)]
-pub struct ParticleInstance {
-    /// Particle origin in world space.
-    pub origin: [f32; 3],
-    /// Particle color (RGBA).
-    pub color: [f32; 4],
-    /// Particle size.
-    pub size: f32,
+//! Particles are binned by type and expanded into camera-facing quads on the
+//! CPU (vk_particle_simd), all streamed through one vertex buffer. Each type
+//! is a contiguous batch, so the frame takes one draw per particle type.
+
+use super::{IndexBuffer, VertexBuffer, VertexArray};
+use crate::simd::SimdLevel;
+use crate::vk_local::PT_MAX;
+use crate::vk_particle_simd::{
+    expand_billboards, quad_indices, Billboard, ParticleVertex, INDICES_PER_PARTICLE, VERTS_PER_PARTICLE,
+};
+
+/// A particle waiting for this frame's build.
+#[derive(Clone, Copy, Debug)]
+struct StagedParticle {
+    origin: [f32; 3],
+    /// RGBA8.
+    color: u32,
+    particle_type: usize,
 }
 
-impl ParticleInstance {
-    /// Size in bytes.
-    pub const SIZE: usize = std::mem::size_of::<Self>();
+/// A run of particles of one type.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct ParticleBatch {
+    /// PT_* type, selecting the particle texture.
+    pub particle_type: usize,
+    /// First index in the index buffer.
+    pub first_index: u32,
+    /// Number of indices.
+    pub index_count: u32,
 }
 
 /// Manages particle rendering.
 pub struct ParticleManager {
-    /// Static unit quad VBO.
-    quad_vbo: VertexBuffer,
-    /// Dynamic instance data VBO.
-    instance_vbo: VertexBuffer,
+    /// Streamed billboard vertices.
+    vbo: VertexBuffer,
+    /// Static quad indices, grown as needed.
+    ibo: IndexBuffer,
+    /// Particles the index buffer covers.
+    ibo_particles: usize,
     /// VAO configuration.
     vao: VertexArray,
-    /// Current particle count.
-    count: usize,
     /// Maximum particles.
     capacity: usize,
-    /// Staging buffer.
-    staging: Vec<ParticleInstance>,
+    /// Particles added this frame, in submission order.
+    staging: Vec<StagedParticle>,
+    /// Type-ordered origins ([x, y, z, 0]) and colours fed to the expansion.
+    origins: Vec<[f32; 4]>,
+    colors: Vec<u32>,
+    /// Expanded vertices.
+    vertices: Vec<ParticleVertex>,
+    /// Batches to draw, one per type present.
+    batches: Vec<ParticleBatch>,
 }
 
 impl ParticleManager {
@@ -49,47 +66,32 @@ impl ParticleManager {
     /// Create with specified capacity.
     pub fn with_capacity(capacity: usize) -> Self {
         let mut manager = Self {
-            quad_vbo: VertexBuffer::new(),
-            instance_vbo: VertexBuffer::new(),
+            vbo: VertexBuffer::new(),
+            ibo: IndexBuffer::new(),
+            ibo_particles: 0,
             vao: VertexArray::new(),
-            count: 0,
             capacity,
             staging: Vec::with_capacity(capacity),
+            origins: Vec::with_capacity(capacity),
+            colors: Vec::with_capacity(capacity),
+            vertices: Vec::with_capacity(capacity * VERTS_PER_PARTICLE),
+            batches: Vec::with_capacity(PT_MAX),
         };
 
-        manager.setup_quad();
         manager.setup_vao();
 
         manager
     }
 
-    /// Create the unit quad VBO.
-    fn setup_quad(&mut self) {
-        // Billboard quad offsets: 4 vertices forming a quad
-        // Layout: x, y (offsets from center)
-        let quad_vertices: [f32; 8] = [
-            -1.0, -1.0,  // Bottom-left
-            -1.0,  1.0,  // Top-left
-             1.0,  1.0,  // Top-right
-             1.0, -1.0,  // Bottom-right
-        ];
-
-        self.quad_vbo.upload(&quad_vertices, 0);
-    }
-
     /// Configure the vertex layout descriptors.
     fn setup_vao(&mut self) {
         self.vao.bind();
+        self.vbo.bind();
 
-        // Quad vertex attribute (location 0): vec2
-        self.quad_vbo.bind();
-        self.vao.set_attribute_float(0, 2, 8, 0);
-
-        // Instance attributes
-        self.instance_vbo.bind();
-        self.vao.set_attribute_float(1, 3, ParticleInstance::SIZE as i32, 0);  // origin
-        self.vao.set_attribute_float(2, 4, ParticleInstance::SIZE as i32, 12); // color
-        self.vao.set_attribute_float(3, 1, ParticleInstance::SIZE as i32, 28); // size
+        let stride = ParticleVertex::SIZE as i32;
+        self.vao.set_attribute_float(0, 3, stride, 0);  // position
+        self.vao.set_attribute_float(1, 2, stride, 12); // texcoord
+        self.vao.set_attribute_ubyte(2, 4, stride, 20); // color
 
         VertexArray::unbind();
         VertexBuffer::unbind();
@@ -98,25 +100,65 @@ impl ParticleManager {
     /// Clear staging buffer for new frame.
     pub fn begin_frame(&mut self) {
         self.staging.clear();
-        self.count = 0;
+        self.batches.clear();
     }
 
-    /// Add a particle to the staging buffer.
-    pub fn add(&mut self, origin: [f32; 3], color: [f32; 4], size: f32) {
+    /// Add a particle to the staging buffer. `color` is RGBA8.
+    pub fn add(&mut self, origin: [f32; 3], color: u32, particle_type: usize) {
         if self.staging.len() < self.capacity {
-            self.staging.push(ParticleInstance { origin, color, size });
+            let particle_type = particle_type.min(PT_MAX - 1);
+            self.staging.push(StagedParticle { origin, color, particle_type });
         }
     }
 
-    /// Upload staged particles to GPU.
+    /// Bin the staged particles by type and expand them into billboards.
+    pub fn build(&mut self, view: &Billboard, level: SimdLevel) {
+        self.batches.clear();
+        let n = self.staging.len();
+
+        // counting sort by type, stable within a type
+        let mut counts = [0usize; PT_MAX];
+        for p in &self.staging {
+            counts[p.particle_type] += 1;
+        }
+        let mut next = [0usize; PT_MAX];
+        let mut first = 0;
+        for (t, &count) in counts.iter().enumerate() {
+            next[t] = first;
+            if count > 0 {
+                self.batches.push(ParticleBatch {
+                    particle_type: t,
+                    first_index: (first * INDICES_PER_PARTICLE) as u32,
+                    index_count: (count * INDICES_PER_PARTICLE) as u32,
+                });
+            }
+            first += count;
+        }
+        self.origins.resize(n, [0.0; 4]);
+        self.colors.resize(n, 0);
+        for p in &self.staging {
+            let slot = next[p.particle_type];
+            next[p.particle_type] += 1;
+            self.origins[slot] = [p.origin[0], p.origin[1], p.origin[2], 0.0];
+            self.colors[slot] = p.color;
+        }
+
+        self.vertices.resize(n * VERTS_PER_PARTICLE, ParticleVertex::default());
+        expand_billboards(&self.origins, &self.colors, view, &mut self.vertices, level);
+    }
+
+    /// Upload the built vertices to the GPU.
     pub fn upload(&mut self) {
-        if self.staging.is_empty() {
-            self.count = 0;
+        if self.vertices.is_empty() {
             return;
         }
 
-        self.instance_vbo.upload(&self.staging, 0);
-        self.count = self.staging.len();
+        self.vbo.upload(&self.vertices, 0);
+        let particles = self.vertices.len() / VERTS_PER_PARTICLE;
+        if particles > self.ibo_particles {
+            self.ibo_particles = particles.next_power_of_two().min(self.capacity.max(particles));
+            self.ibo.upload_u32(&quad_indices(self.ibo_particles), 0);
+        }
     }
 
     /// Bind for rendering.
@@ -124,26 +166,24 @@ impl ParticleManager {
         self.vao.bind();
     }
 
-    /// Draw all particles. In SDL3 GPU mode, this is a no-op —
-    /// the render path issues draw commands via command buffers.
-    pub fn draw(&self) {
-        // Draw commands are issued by the render path via command buffers.
-        // This method is kept for API compatibility during transition.
+    /// Get the vertex buffer for render pass binding.
+    pub fn vertex_buffer(&self) -> &VertexBuffer {
+        &self.vbo
     }
 
-    /// Get the quad VBO for render pass binding.
-    pub fn quad_buffer(&self) -> &VertexBuffer {
-        &self.quad_vbo
+    /// Get the index buffer for render pass binding.
+    pub fn index_buffer(&self) -> &IndexBuffer {
+        &self.ibo
     }
 
-    /// Get the instance VBO for render pass binding.
-    pub fn instance_buffer(&self) -> &VertexBuffer {
-        &self.instance_vbo
+    /// Get batches for rendering, in type order.
+    pub fn batches(&self) -> &[ParticleBatch] {
+        &self.batches
     }
 
     /// Get current particle count.
     pub fn count(&self) -> usize {
-        self.count
+        self.staging.len()
     }
 }
 
@@ -152,3 +192,41 @@ impl Default for ParticleManager {
         Self::new()
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::vk_local::{PT_BLOOD, PT_DEFAULT, PT_SMOKE};
+
+    #[test]
+    fn test_build_bins_by_type() {
+        let view = Billboard {
+            view_origin: [0.0; 3],
+            right: [0.0, -1.0, 0.0],
+            up: [0.0, 0.0, 1.0],
+            size: 1.0,
+            min_size: 2.0,
+            max_size: 40.0,
+        };
+        let mut m = ParticleManager::with_capacity(5);
+        m.begin_frame();
+        m.add([1.0, 0.0, 0.0], 0xA, PT_SMOKE);
+        m.add([2.0, 0.0, 0.0], 0xB, PT_DEFAULT);
+        m.add([3.0, 0.0, 0.0], 0xC, PT_SMOKE);
+        m.add([4.0, 0.0, 0.0], 0xD, PT_BLOOD);
+        m.add([5.0, 0.0, 0.0], 0xE, 99); // clamped to the last type
+        m.add([6.0, 0.0, 0.0], 0xF, PT_DEFAULT); // over capacity
+        m.build(&view, SimdLevel::Scalar);
+
+        assert_eq!(m.count(), 5);
+        let batches: Vec<_> = m.batches().iter().map(|b| (b.particle_type, b.first_index, b.index_count)).collect();
+        assert_eq!(batches, vec![(PT_DEFAULT, 0, 6), (PT_SMOKE, 6, 12), (PT_BLOOD, 18, 12)]);
+        let order: Vec<u32> = m.vertices.chunks(VERTS_PER_PARTICLE).map(|q| q[0].color).collect();
+        assert_eq!(order, vec![0xB, 0xA, 0xC, 0xD, 0xE]);
+        assert_eq!(m.vertices[VERTS_PER_PARTICLE].position[0], 1.0);
+
+        m.begin_frame();
+        m.build(&view, SimdLevel::Scalar);
+        assert!(m.batches().is_empty() && m.vertices.is_empty());
+    }
+}
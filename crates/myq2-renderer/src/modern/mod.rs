@@ -49,7 +49,7 @@ pub trait RenderPath {
     /// Called at the start of each 3D rendering pass.
     fn begin_frame(&mut self, params: &FrameParams);
 
-    /// Called at the end of each 3D rendering pass.
+    /// Called once the 2D pass is drawn over the view: post-process and present.
     fn end_frame(&mut self);
 
     // ========== World Rendering ==========
@@ -57,8 +57,9 @@ pub trait RenderPath {
     /// Draw the BSP world geometry.
     fn draw_world(&mut self);
 
-    /// Draw alpha-blended world surfaces (water, glass, etc.).
-    fn draw_alpha_surfaces(&mut self);
+    /// Draw alpha-blended world surfaces (water, glass, etc.), given as world
+    /// surface numbers already in back-to-front order.
+    fn draw_alpha_surfaces(&mut self, surfaces: &[u32]);
 
     /// Blend lightmaps onto world surfaces.
     fn blend_lightmaps(&mut self);
@@ -6,7 +6,10 @@
 use ash::vk;
 use super::{RenderError, RenderPath, FrameParams, ParticleData};
 use super::shader::{ShaderManager, ShaderType, PerFrameUniforms, PerObjectUniforms, UniformBuffer};
-use super::geometry::{BspGeometryManager, AliasModelManager, ParticleManager, Draw2DManager, BlendMode};
+use super::geometry::{
+    BspGeometryManager, AliasModelManager, ParticleManager, Draw2DManager, BlendMode, WorldDrawStats,
+    VertexBuffer, IndexBuffer,
+};
 use super::texture::LightmapArray;
 use super::framebuffer::{WaterFbo, PostProcessor};
 use crate::vk_rmain::EntityLocal;
@@ -29,6 +32,13 @@ pub struct ModernRenderPath {
     lightmap_array: LightmapArray,
     /// Water effect FBOs.
     water_fbo: WaterFbo,
+    /// Water positions and fan indices (vk_warp::WATER_MESH), static per map.
+    water_positions: VertexBuffer,
+    water_indices: IndexBuffer,
+    /// Warped water texture coordinates, streamed each frame.
+    water_texcoords: VertexBuffer,
+    /// WATER_MESH generation the static water buffers hold.
+    water_generation: Option<u32>,
     /// Post-processor.
     post_processor: Option<PostProcessor>,
     /// Per-frame uniform buffer.
@@ -74,6 +84,10 @@ impl ModernRenderPath {
             draw2d: Draw2DManager::new(),
             lightmap_array: LightmapArray::new(),
             water_fbo: WaterFbo::default(),
+            water_positions: VertexBuffer::new(),
+            water_indices: IndexBuffer::new(),
+            water_texcoords: VertexBuffer::new(),
+            water_generation: None,
             post_processor: None,
             per_frame_ubo: None,
             per_object_ubo: None,
@@ -222,6 +236,51 @@ impl ModernRenderPath {
         ]
     }
 
+    /// Compute the matrix reflecting world space through the plane
+    /// `normal . x = dist`.
+    fn compute_reflection_matrix(normal: &[f32; 3], dist: f32) -> [f32; 16] {
+        let [a, b, c] = *normal;
+        let d = 2.0 * dist;
+        // Column-major: I - 2nn^T, translated by 2 * dist * n
+        [
+            1.0 - 2.0 * a * a, -2.0 * a * b,      -2.0 * a * c,      0.0,
+            -2.0 * a * b,      1.0 - 2.0 * b * b, -2.0 * b * c,      0.0,
+            -2.0 * a * c,      -2.0 * b * c,      1.0 - 2.0 * c * c, 0.0,
+            d * a,             d * b,             d * c,             1.0,
+        ]
+    }
+
+    /// Replace the near plane of perspective projection `proj` with the
+    /// view-space clip plane `clip` (a, b, c, d for ax + by + cz + d = 0,
+    /// keeping the positive side), so geometry behind a mirror is clipped
+    /// without a user clip distance.
+    fn apply_oblique_near_plane(proj: &mut [f32; 16], clip: &[f32; 4]) {
+        // the clip-space corner opposite the plane, taken back to view space
+        let q = [
+            (clip[0].signum() + proj[8]) / proj[0],
+            (clip[1].signum() + proj[9]) / proj[5],
+            -1.0,
+            (1.0 + proj[10]) / proj[14],
+        ];
+        let scale = 2.0 / (clip[0] * q[0] + clip[1] * q[1] + clip[2] * q[2] + clip[3] * q[3]);
+        // third row = scaled plane - fourth row
+        proj[2] = clip[0] * scale;
+        proj[6] = clip[1] * scale;
+        proj[10] = clip[2] * scale + 1.0;
+        proj[14] = clip[3] * scale;
+    }
+
+    /// Transform the world-space plane `normal . x = dist` into the space of
+    /// the rigid (possibly mirrored) view matrix `view`, as (a, b, c, d).
+    fn view_space_plane(view: &[f32; 16], normal: &[f32; 3], dist: f32) -> [f32; 4] {
+        let n = [
+            view[0] * normal[0] + view[4] * normal[1] + view[8] * normal[2],
+            view[1] * normal[0] + view[5] * normal[1] + view[9] * normal[2],
+            view[2] * normal[0] + view[6] * normal[1] + view[10] * normal[2],
+        ];
+        [n[0], n[1], n[2], -dist - (n[0] * view[12] + n[1] * view[13] + n[2] * view[14])]
+    }
+
     /// Multiply two 4x4 column-major matrices: result = a * b.
     pub fn mat4_multiply(a: &[f32; 16], b: &[f32; 16]) -> [f32; 16] {
         let mut result = [0.0f32; 16];
@@ -637,6 +696,56 @@ mod tests {
         }
     }
 
+    // ---------------------------------------------------------
+    //  Reflection matrices
+    // ---------------------------------------------------------
+
+    fn transform(m: &[f32; 16], p: [f32; 4]) -> [f32; 4] {
+        std::array::from_fn(|r| (0..4).map(|k| m[k * 4 + r] * p[k]).sum())
+    }
+
+    #[test]
+    fn test_reflection_matrix_mirrors_points() {
+        let m = ModernRenderPath::compute_reflection_matrix(&[0.0, 0.0, 1.0], 16.0);
+        let p = transform(&m, [5.0, 6.0, 40.0, 1.0]);
+        assert!(approx_eq(p[0], 5.0, 1e-5) && approx_eq(p[1], 6.0, 1e-5) && approx_eq(p[2], -8.0, 1e-5));
+
+        let h = std::f32::consts::FRAC_1_SQRT_2;
+        let m = ModernRenderPath::compute_reflection_matrix(&[h, 0.0, h], 10.0);
+        let twice = ModernRenderPath::mat4_multiply(&m, &m);
+        #[rustfmt::skip]
+        let identity: [f32; 16] = [
+            1.0, 0.0, 0.0, 0.0,
+            0.0, 1.0, 0.0, 0.0,
+            0.0, 0.0, 1.0, 0.0,
+            0.0, 0.0, 0.0, 1.0,
+        ];
+        assert!(mat_approx_eq(&twice, &identity, 1e-5));
+    }
+
+    #[test]
+    fn test_oblique_near_plane_clips_at_water() {
+        let normal = [0.0, 0.0, 1.0];
+        let dist = 32.0;
+        let view = ModernRenderPath::compute_view_matrix(&[0.0, 0.0, 96.0], &[30.0, 45.0, 0.0]);
+        let mirrored = ModernRenderPath::mat4_multiply(&view, &ModernRenderPath::compute_reflection_matrix(&normal, dist));
+        let clip = ModernRenderPath::view_space_plane(&mirrored, &normal, dist);
+        let mut proj = ModernRenderPath::compute_projection_matrix(90.0, 73.74, 4.0, 4096.0);
+        ModernRenderPath::apply_oblique_near_plane(&mut proj, &clip);
+        let mvp = ModernRenderPath::mat4_multiply(&proj, &mirrored);
+
+        let ndc_z = |p: [f32; 3]| {
+            let c = transform(&mvp, [p[0], p[1], p[2], 1.0]);
+            c[2] / c[3]
+        };
+        // points on the water land on the near plane, points above it inside
+        for p in [[100.0, 80.0, 32.0], [150.0, 120.0, 32.0], [90.0, 110.0, 32.0]] {
+            assert!(approx_eq(ndc_z(p), -1.0, 1e-3), "{:?} -> {}", p, ndc_z(p));
+        }
+        let above = ndc_z([100.0, 80.0, 64.0]);
+        assert!(above > -1.0 && above < 1.0, "{}", above);
+    }
+
     // ---------------------------------------------------------
     //  ModernRenderPath::new defaults
     // ---------------------------------------------------------
@@ -723,7 +832,11 @@ impl RenderPath for ModernRenderPath {
             return;
         }
 
-        self.frame_in_progress = false;
+        // a second view before vk_imp_end_frame (stereo, timerefresh)
+        // presents the first rather than acquiring another image over it
+        if self.frame_in_progress {
+            self.end_frame();
+        }
         self.current_command_buffer = None;
 
         // Update dimensions if changed
@@ -844,17 +957,21 @@ impl RenderPath for ModernRenderPath {
             return;
         }
 
-        // Upload and draw particles
-        self.particles.upload();
+        // Build, upload and draw particles: one draw per particle type
         if self.particles.count() > 0 {
+            let view = crate::vk_particle_simd::Billboard {
+                view_origin: self.frame_uniforms.view_origin,
+                right: self.frame_uniforms.view_right,
+                up: self.frame_uniforms.view_up,
+                size: 1.0,
+                min_size: 2.0,
+                max_size: 40.0,
+            };
+            self.particles.build(&view, crate::simd::level());
+            self.particles.upload();
             if let Some(ref mut shaders) = self.shaders {
                 if let Some(shader) = shaders.get_mut(ShaderType::Particle) {
                     shader.bind();
-                    shader.set_vec3_array("u_ViewUp", &self.frame_uniforms.view_up);
-                    shader.set_vec3_array("u_ViewRight", &self.frame_uniforms.view_right);
-                    shader.set_vec3_array("u_ViewOrigin", &self.frame_uniforms.view_origin);
-                    shader.set_float("u_MinSize", 2.0);
-                    shader.set_float("u_MaxSize", 40.0);
                     shader.set_float("u_OverbrightScale", 1.0);
                     // Set view-projection via uniform
                     let vp_flat: [f32; 16] = {
@@ -868,7 +985,11 @@ impl RenderPath for ModernRenderPath {
                     };
                     shader.set_mat4("u_ViewProjection", &vp_flat);
                     self.particles.bind();
-                    self.particles.draw();
+                    shader.set_sampler("u_ParticleTexture", 0);
+                    // Submission is still stubbed: when render passes are
+                    // wired up, each of particles.batches() binds its
+                    // type's R_PARTICLETEXTURE and issues one vkCmdDrawIndexed
+                    // of its index range. Until then nothing is drawn.
                     super::shader::ShaderProgram::unbind();
                 }
             }
@@ -876,6 +997,10 @@ impl RenderPath for ModernRenderPath {
 
         // Flush 2D drawing
         self.flush_2d_internal();
+        // SAFETY: single-threaded engine access pattern
+        unsafe {
+            crate::vk_draw::DRAW2D_STATS = self.draw2d.stats();
+        }
 
         // Apply post-processing pipeline (SSAO -> Bloom -> FSR -> FXAA -> Polyblend+Gamma)
         if let (Some(ref pp), Some(ref mut shaders)) = (&self.post_processor, &mut self.shaders) {
@@ -907,6 +1032,12 @@ impl RenderPath for ModernRenderPath {
             pp.apply_post_processing(shaders, &proj_flat, 4.0, 4096.0, polyblend, gamma);
         }
 
+        // Screenshots and frame dumps see the frame as presented, 2D included
+        // SAFETY: single-threaded engine access pattern
+        unsafe {
+            crate::vk_capture::r_capture_frame();
+        }
+
         // ========== Vulkan: End command buffer, submit, and present ==========
         // SAFETY: Single-threaded engine, Vulkan objects are valid
         unsafe {
@@ -962,106 +1093,21 @@ impl RenderPath for ModernRenderPath {
             return;
         }
 
-        let shaders = match &mut self.shaders {
-            Some(s) => s,
-            None => return,
-        };
-
-        let shader = match shaders.get_mut(ShaderType::World) {
-            Some(s) => s,
-            None => return,
-        };
-
-        shader.bind();
-
-        // Set model-view-projection (identity model for world)
-        let mvp_flat: [f32; 16] = {
-            let vp = &self.frame_uniforms.view_projection;
-            [
-                vp[0][0], vp[0][1], vp[0][2], vp[0][3],
-                vp[1][0], vp[1][1], vp[1][2], vp[1][3],
-                vp[2][0], vp[2][1], vp[2][2], vp[2][3],
-                vp[3][0], vp[3][1], vp[3][2], vp[3][3],
-            ]
-        };
-        shader.set_mat4("u_ModelViewProjection", &mvp_flat);
-        shader.set_float("u_ScrollOffset", 0.0);
-
-        // Bind lightmap array to texture unit 1
-        self.lightmap_array.bind(1);
-        shader.set_sampler("u_LightmapTexture", 1);
-        shader.set_float("u_OverbrightScale", 1.0);
-        // SAFETY: single-threaded engine access pattern
-        let fullbright = unsafe { crate::vk_rmain::R_FULLBRIGHT.value != 0.0 };
-        shader.set_int("u_Fullbright", if fullbright { 1 } else { 0 });
-
-        // Saturate lighting: clamp lightmap to [0,1] to prevent overbright
         // SAFETY: single-threaded engine access pattern
-        let saturate = unsafe { crate::vk_rmain::VK_SATURATELIGHTING.value != 0.0 };
-        shader.set_int("u_SaturateLighting", if saturate { 1 } else { 0 });
-
-        // Detail texture: overlay high-frequency surface detail on non-underwater surfaces
-        let (detail_enabled, detail_scale) = unsafe {
-            let val = crate::vk_rmain::R_DETAILTEXTURE.value as i32;
-            if val >= 1 && val <= 8 {
-                (true, 8.0_f32) // Scale factor for detail UV frequency
-            } else {
-                (false, 1.0)
-            }
-        };
-        shader.set_int("u_EnableDetail", if detail_enabled { 1 } else { 0 });
-        shader.set_float("u_DetailScale", detail_scale);
-
-        // Caustic overlay: animated pattern on underwater surfaces
-        let caustics_enabled = unsafe { crate::vk_rmain::R_CAUSTICS.value != 0.0 };
-        shader.set_int("u_EnableCaustics", if caustics_enabled { 1 } else { 0 });
-        shader.set_float("u_CausticScroll", self.frame_uniforms.time / 30.0);
-
-        // Default: surface is not underwater (overridden per-batch when batching is wired)
-        shader.set_int("u_IsUnderwater", 0);
-
-        // Lightmap-only debug view (vk_lightmap cvar)
-        // SAFETY: single-threaded engine access pattern
-        let lightmap_only = unsafe { crate::vk_rmain::VK_LIGHTMAP.value != 0.0 };
-        shader.set_int("u_LightmapOnly", if lightmap_only { 1 } else { 0 });
-
-        // Wireframe debug view (vk_showtris cvar) — toggle polygon mode via EDS3
-        // SAFETY: single-threaded engine access pattern
-        let wireframe = unsafe { crate::vk_rmain::VK_SHOWTRIS.value != 0.0 };
-        if wireframe {
-            if let (Some(cmd), Some(ref ds3)) = (self.current_command_buffer, &self.dynamic_state3) {
-                ds3.set_polygon_mode(cmd, vk::PolygonMode::LINE);
-            }
-        }
-
-        self.bsp_geometry.bind();
-
-        for batch in self.bsp_geometry.batches() {
-            shader.set_sampler("u_DiffuseTexture", 0);
-
-            // Draw call issued by Vulkan render pass in future.
-            // Currently a no-op — actual draw_indexed will happen through
-            // vkCmdDrawIndexed when render passes are wired up.
-            // When wired, per-batch u_IsUnderwater will be set from
-            // batch surface flags (SURF_UNDERWATER).
-            let _ = batch;
-        }
-
-        // Restore fill mode after wireframe drawing
-        if wireframe {
-            if let (Some(cmd), Some(ref ds3)) = (self.current_command_buffer, &self.dynamic_state3) {
-                ds3.set_polygon_mode(cmd, vk::PolygonMode::FILL);
-            }
+        unsafe {
+            let visible = &*std::ptr::addr_of!(crate::vk_rsurf::R_VISIBLE_SURFACES);
+            crate::vk_rsurf::WORLD_DRAW_STATS = self.draw_world_surfaces(visible);
         }
-
-        super::geometry::VertexArray::unbind();
-        super::shader::ShaderProgram::unbind();
     }
 
-    fn draw_alpha_surfaces(&mut self) {
-        // Alpha surfaces would be drawn here with blending enabled.
-        // In Vulkan, blend state is part of the pipeline object.
-        // Until BSP geometry tracks alpha-flagged surfaces separately, this is a no-op.
+    fn draw_alpha_surfaces(&mut self, surfaces: &[u32]) {
+        // Alpha surfaces would be drawn here with blending enabled, in the
+        // order given (vk_sort has merged them back to front with the
+        // translucent entities). In Vulkan, blend state is part of the
+        // pipeline object. Until there is a blended world pipeline,
+        // SURF_TRANS33/66 surfaces stay in the world buffer and draw_world
+        // draws them unblended, so this is a no-op.
+        let _ = surfaces;
     }
 
     fn blend_lightmaps(&mut self) {
@@ -1097,14 +1143,12 @@ impl RenderPath for ModernRenderPath {
     }
 
     fn draw_particles(&mut self, particles: &[ParticleData]) {
-        // Convert particle data and stage for instanced rendering
+        // Stage particles; they are binned by type and expanded at end_frame
         for p in particles {
-            // Convert palette color index to RGBA using d_8to24table
+            // Palette colour from d_8to24table with the particle's alpha
             let color_u32 = unsafe { crate::vk_image::d_8to24table[p.color & 0xFF] };
-            let r = (color_u32 & 0xFF) as f32 / 255.0;
-            let g = ((color_u32 >> 8) & 0xFF) as f32 / 255.0;
-            let b = ((color_u32 >> 16) & 0xFF) as f32 / 255.0;
-            self.particles.add(p.origin, [r, g, b, p.alpha], 1.0);
+            let alpha = (p.alpha.clamp(0.0, 1.0) * 255.0) as u32;
+            self.particles.add(p.origin, (color_u32 & 0x00FF_FFFF) | (alpha << 24), p.particle_type);
         }
     }
 
@@ -1115,7 +1159,9 @@ impl RenderPath for ModernRenderPath {
 
     fn draw_sky(&mut self) {
         // Sky rendering: would bind the sky shader, set the sky cubemap texture,
-        // and draw the skybox geometry with rotation applied.
+        // and draw the skybox geometry with rotation applied, limited to the
+        // faces vk_warp::r_visible_sky_faces reports for the view cluster.
+        // Not submitted until render passes are wired up.
     }
 
     fn draw_char(&mut self, x: i32, y: i32, num: i32) {
@@ -1244,6 +1290,12 @@ impl RenderPath for ModernRenderPath {
                 self.create_cinematic_texture();
             }
 
+            // Quads still queued with the previous frame's contents must be
+            // drawn before the texture is overwritten
+            if self.draw2d.uses_texture(self.cinematic_texture_id) {
+                self.flush_2d_internal();
+            }
+
             // Upload image data via staging buffer
             self.upload_cinematic_data(&image32);
 
@@ -1266,12 +1318,218 @@ impl RenderPath for ModernRenderPath {
 }
 
 impl ModernRenderPath {
+    /// Draw the given world surfaces with the current view-projection,
+    /// gathered into (texture, lightmap) sorted batches.
+    fn draw_world_surfaces(&mut self, visible: &[u32]) -> WorldDrawStats {
+        let stats = self.bsp_geometry.build_frame(visible);
+
+        let shaders = match &mut self.shaders {
+            Some(s) => s,
+            None => return stats,
+        };
+
+        let shader = match shaders.get_mut(ShaderType::World) {
+            Some(s) => s,
+            None => return stats,
+        };
+
+        shader.bind();
+
+        // Set model-view-projection (identity model for world)
+        let mvp_flat: [f32; 16] = {
+            let vp = &self.frame_uniforms.view_projection;
+            [
+                vp[0][0], vp[0][1], vp[0][2], vp[0][3],
+                vp[1][0], vp[1][1], vp[1][2], vp[1][3],
+                vp[2][0], vp[2][1], vp[2][2], vp[2][3],
+                vp[3][0], vp[3][1], vp[3][2], vp[3][3],
+            ]
+        };
+        shader.set_mat4("u_ModelViewProjection", &mvp_flat);
+        shader.set_float("u_ScrollOffset", 0.0);
+
+        // Bind lightmap array to texture unit 1
+        self.lightmap_array.bind(1);
+        shader.set_sampler("u_LightmapTexture", 1);
+        shader.set_float("u_OverbrightScale", 1.0);
+        // SAFETY: single-threaded engine access pattern
+        let fullbright = unsafe { crate::vk_rmain::R_FULLBRIGHT.value != 0.0 };
+        shader.set_int("u_Fullbright", if fullbright { 1 } else { 0 });
+
+        // Saturate lighting: clamp lightmap to [0,1] to prevent overbright
+        // SAFETY: single-threaded engine access pattern
+        let saturate = unsafe { crate::vk_rmain::VK_SATURATELIGHTING.value != 0.0 };
+        shader.set_int("u_SaturateLighting", if saturate { 1 } else { 0 });
+
+        // Detail texture: overlay high-frequency surface detail on non-underwater surfaces
+        let (detail_enabled, detail_scale) = unsafe {
+            let val = crate::vk_rmain::R_DETAILTEXTURE.value as i32;
+            if val >= 1 && val <= 8 {
+                (true, 8.0_f32) // Scale factor for detail UV frequency
+            } else {
+                (false, 1.0)
+            }
+        };
+        shader.set_int("u_EnableDetail", if detail_enabled { 1 } else { 0 });
+        shader.set_float("u_DetailScale", detail_scale);
+
+        // Caustic overlay: animated pattern on underwater surfaces
+        let caustics_enabled = unsafe { crate::vk_rmain::R_CAUSTICS.value != 0.0 };
+        shader.set_int("u_EnableCaustics", if caustics_enabled { 1 } else { 0 });
+        shader.set_float("u_CausticScroll", self.frame_uniforms.time / 30.0);
+
+        // Default: surface is not underwater (overridden per-batch when batching is wired)
+        shader.set_int("u_IsUnderwater", 0);
+
+        // Lightmap-only debug view (vk_lightmap cvar)
+        // SAFETY: single-threaded engine access pattern
+        let lightmap_only = unsafe { crate::vk_rmain::VK_LIGHTMAP.value != 0.0 };
+        shader.set_int("u_LightmapOnly", if lightmap_only { 1 } else { 0 });
+
+        // Wireframe debug view (vk_showtris cvar) — toggle polygon mode via EDS3
+        // SAFETY: single-threaded engine access pattern
+        let wireframe = unsafe { crate::vk_rmain::VK_SHOWTRIS.value != 0.0 };
+        if wireframe {
+            if let (Some(cmd), Some(ref ds3)) = (self.current_command_buffer, &self.dynamic_state3) {
+                ds3.set_polygon_mode(cmd, vk::PolygonMode::LINE);
+            }
+        }
+
+        self.bsp_geometry.bind();
+
+        for batch in self.bsp_geometry.frame_batches() {
+            shader.set_sampler("u_DiffuseTexture", 0);
+
+            // Draw call issued by Vulkan render pass in future.
+            // Currently a no-op — actual draw_indexed of the batch's range
+            // of frame_indices() will happen through vkCmdDrawIndexed when
+            // render passes are wired up.
+            // When wired, per-batch u_IsUnderwater will be set from
+            // batch surface flags (SURF_UNDERWATER).
+            let _ = batch;
+        }
+
+        // Restore fill mode after wireframe drawing
+        if wireframe {
+            if let (Some(cmd), Some(ref ds3)) = (self.current_command_buffer, &self.dynamic_state3) {
+                ds3.set_polygon_mode(cmd, vk::PolygonMode::FILL);
+            }
+        }
+
+        super::geometry::VertexArray::unbind();
+        super::shader::ShaderProgram::unbind();
+
+        stats
+    }
+
+    /// Render this frame's reflection views (vk_refl) into the water
+    /// reflection target, each with the view mirrored through its plane and
+    /// the water as the near plane. Call after begin_frame, before the main
+    /// world pass.
+    pub fn draw_reflections(
+        &mut self,
+        enabled: bool,
+        views: &[crate::vk_refl::ReflectionView],
+        entities: &[EntityLocal],
+    ) {
+        self.water_fbo.set_enabled(enabled, self.width, self.height);
+        if !enabled || !self.frame_in_progress || !self.bsp_geometry.is_initialized() || views.is_empty() {
+            return;
+        }
+
+        let main_view = self.frame_uniforms.view_matrix;
+        let main_proj = self.frame_uniforms.projection_matrix;
+        let main_vp = self.frame_uniforms.view_projection;
+        let main_origin = self.frame_uniforms.view_origin;
+        let flatten = |m: &[[f32; 4]; 4]| -> [f32; 16] { std::array::from_fn(|i| m[i / 4][i % 4]) };
+        let view = flatten(&main_view);
+        let proj = flatten(&main_proj);
+
+        for v in views {
+            let mirrored = Self::mat4_multiply(&view, &Self::compute_reflection_matrix(&v.normal, v.dist));
+            let mut clipped = proj;
+            Self::apply_oblique_near_plane(&mut clipped, &Self::view_space_plane(&mirrored, &v.normal, v.dist));
+
+            self.frame_uniforms.view_matrix = Self::to_mat4x4(&mirrored);
+            self.frame_uniforms.projection_matrix = Self::to_mat4x4(&clipped);
+            self.frame_uniforms.view_projection = Self::to_mat4x4(&Self::mat4_multiply(&clipped, &mirrored));
+            self.frame_uniforms.view_origin = v.vieworg;
+
+            // Mirroring flips triangle winding. There are no reflection
+            // pipelines yet; when draws are recorded here they have to cull
+            // front faces instead of back faces.
+            self.water_fbo.bind_reflection();
+            self.draw_world_surfaces(&v.surfaces);
+            for &i in &v.entities {
+                let Some(entity) = entities.get(i) else { continue };
+                // SAFETY: entity models are valid for the frame (vk_refl skips nulls)
+                match unsafe { &(*entity.model).r#type } {
+                    crate::vk_model_types::ModType::Alias => self.draw_alias_model(entity),
+                    crate::vk_model_types::ModType::Brush => self.draw_brush_model(entity),
+                    crate::vk_model_types::ModType::Sprite => self.draw_sprite_model(entity),
+                    _ => {}
+                }
+            }
+            self.water_fbo.unbind();
+        }
+
+        self.frame_uniforms.view_matrix = main_view;
+        self.frame_uniforms.projection_matrix = main_proj;
+        self.frame_uniforms.view_projection = main_vp;
+        self.frame_uniforms.view_origin = main_origin;
+    }
+
+    /// Draw this frame's visible water surfaces from the cached water mesh.
+    /// Positions and indices are uploaded once per map; only the warped
+    /// texture coordinates (vk_warp::r_warp_water) are streamed per frame.
+    pub fn draw_water(&mut self) {
+        if !self.initialized || !self.frame_in_progress {
+            return;
+        }
+
+        // SAFETY: single-threaded engine access pattern
+        let mesh = unsafe { &*std::ptr::addr_of!(crate::vk_warp::WATER_MESH) };
+        if mesh.is_empty() {
+            return;
+        }
+        if self.water_generation != Some(mesh.generation) {
+            self.water_positions.upload(&mesh.positions, 0);
+            self.water_indices.upload_u32(&mesh.indices, 0);
+            self.water_generation = Some(mesh.generation);
+        }
+        if mesh.draws.is_empty() {
+            return;
+        }
+        self.water_texcoords.upload(&mesh.texcoords, 0);
+
+        let Some(shader) = self.shaders.as_mut().and_then(|s| s.get_mut(ShaderType::Water)) else {
+            return;
+        };
+        shader.bind();
+        let vp = &self.frame_uniforms.view_projection;
+        let mvp_flat: [f32; 16] = std::array::from_fn(|i| vp[i / 4][i % 4]);
+        shader.set_mat4("u_ModelViewProjection", &mvp_flat);
+
+        // Submission is still stubbed: when render passes are wired up,
+        // each of mesh.draws becomes one indexed draw with its surface's
+        // texture and alpha. Until then only the buffers are kept current.
+
+        super::shader::ShaderProgram::unbind();
+    }
+
     /// Internal 2D flush - uploads and draws all batched 2D quads.
     ///
     /// In Vulkan, 2D drawing state (depth off, blend on) is baked into
     /// the pipeline object. Texture binding and draw calls happen through
     /// descriptor sets and command buffers.
     fn flush_2d_internal(&mut self) {
+        // Scrap pics queued this frame may not be on the GPU yet
+        // SAFETY: single-threaded engine, accessing global image state
+        unsafe {
+            if crate::vk_image::scrap_dirty != 0 {
+                crate::vk_image::scrap_upload();
+            }
+        }
         self.draw2d.flush();
 
         let batches_to_draw: Vec<_> = self.draw2d.batches().to_vec();
@@ -0,0 +1,113 @@
+// simd.rs — Runtime SIMD capability detection for CPU-side renderer kernels
+//
+// The hot CPU loops (lightmap building, alias lerp, particle expansion, water
+// warp, image resampling) ship a scalar reference plus x86_64 SSE2/AVX2
+// variants. SSE2 is part of the x86_64 baseline; AVX2 is selected at
+// runtime. Every kernel takes an explicit `SimdLevel` so tests and benchmarks
+// can compare the paths against each other on the same machine.
+
+use std::sync::atomic::{AtomicU8, Ordering};
+
+/// Instruction set used by a CPU kernel.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+pub enum SimdLevel {
+    Scalar = 0,
+    Sse2 = 1,
+    Avx2 = 2,
+}
+
+impl SimdLevel {
+    /// Human-readable name for speed/benchmark output.
+    pub fn name(self) -> &'static str {
+        match self {
+            SimdLevel::Scalar => "scalar",
+            SimdLevel::Sse2 => "sse2",
+            SimdLevel::Avx2 => "avx2",
+        }
+    }
+
+    /// All levels supported by the running CPU, lowest first.
+    pub fn supported() -> Vec<SimdLevel> {
+        let best = detect();
+        [SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2]
+            .into_iter()
+            .filter(|l| *l <= best)
+            .collect()
+    }
+}
+
+const LEVEL_UNSET: u8 = 0xff;
+
+static LEVEL: AtomicU8 = AtomicU8::new(LEVEL_UNSET);
+
+/// Best instruction set available on this CPU (ignores any override).
+pub fn detect() -> SimdLevel {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if is_x86_feature_detected!("avx2") {
+            return SimdLevel::Avx2;
+        }
+        SimdLevel::Sse2
+    }
+    #[cfg(not(target_arch = "x86_64"))]
+    {
+        SimdLevel::Scalar
+    }
+}
+
+/// Instruction set the renderer kernels should use. Detected once, then cached.
+#[inline]
+pub fn level() -> SimdLevel {
+    match LEVEL.load(Ordering::Relaxed) {
+        0 => SimdLevel::Scalar,
+        1 => SimdLevel::Sse2,
+        2 => SimdLevel::Avx2,
+        _ => {
+            let l = detect();
+            LEVEL.store(l as u8, Ordering::Relaxed);
+            l
+        }
+    }
+}
+
+/// Force a lower instruction set (e.g. for A/B timing). Requests above what the
+/// CPU supports are clamped to the detected level.
+pub fn set_level(requested: SimdLevel) {
+    let l = requested.min(detect());
+    LEVEL.store(l as u8, Ordering::Relaxed);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_level_ordering() {
+        assert!(SimdLevel::Scalar < SimdLevel::Sse2);
+        assert!(SimdLevel::Sse2 < SimdLevel::Avx2);
+    }
+
+    #[test]
+    fn test_supported_includes_scalar_and_detected() {
+        let s = SimdLevel::supported();
+        assert_eq!(s[0], SimdLevel::Scalar);
+        assert_eq!(*s.last().unwrap(), detect());
+    }
+
+    #[test]
+    fn test_set_level_clamps_to_detected() {
+        set_level(SimdLevel::Avx2);
+        assert!(level() <= detect());
+        set_level(SimdLevel::Scalar);
+        assert_eq!(level(), SimdLevel::Scalar);
+        set_level(detect());
+        assert_eq!(level(), detect());
+    }
+
+    #[test]
+    fn test_names() {
+        assert_eq!(SimdLevel::Scalar.name(), "scalar");
+        assert_eq!(SimdLevel::Sse2.name(), "sse2");
+        assert_eq!(SimdLevel::Avx2.name(), "avx2");
+    }
+}
@@ -0,0 +1,509 @@
+// vk_capture.rs — Asynchronous screenshot and frame-sequence capture
+//
+// vk_screen_shot_f used to read the framebuffer, gamma-correct, flip and
+// compress it on the render thread, which hitches for PNG/JPG at high
+// resolutions. Capture now only copies the pixels: the frame is handed to a
+// small pool of encoder threads through a bounded queue and written from
+// there. Results (and the pixel buffers, for reuse) come back through
+// channels that the render thread drains once a frame.
+//
+// Frame dumps (vk_capture 1) submit every rendered frame without ever
+// blocking: when the encoders fall behind and the queue is full the frame is
+// dropped and counted. Single screenshots wait for a slot instead.
+//
+// The encoder half (encode_frame) is a pure function of the pixel buffer.
+
+use std::collections::HashSet;
+use std::path::{Path, PathBuf};
+use std::thread::JoinHandle;
+
+use crossbeam::channel::{bounded, unbounded, Receiver, Sender, TrySendError};
+
+use crate::vk_rmain::vid_printf;
+use myq2_common::q_shared::PRINT_ALL;
+
+/// Jobs waiting for an encoder before frame dumps start dropping.
+pub const CAPTURE_QUEUE_DEPTH: usize = 8;
+
+/// Output image format.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CaptureFormat {
+    Tga,
+    Png,
+    Jpg,
+}
+
+impl CaptureFormat {
+    /// Parse a vk_screenshot_format / vk_capture_format value; TGA otherwise.
+    pub fn from_name(name: &str) -> Self {
+        match name.to_ascii_lowercase().as_str() {
+            "png" => CaptureFormat::Png,
+            "jpg" | "jpeg" => CaptureFormat::Jpg,
+            _ => CaptureFormat::Tga,
+        }
+    }
+
+    pub fn extension(self) -> &'static str {
+        match self {
+            CaptureFormat::Tga => "tga",
+            CaptureFormat::Png => "png",
+            CaptureFormat::Jpg => "jpg",
+        }
+    }
+}
+
+/// Encoder settings.
+#[derive(Debug, Clone, Copy)]
+pub struct EncodeOptions {
+    pub format: CaptureFormat,
+    /// JPEG quality, 1-100.
+    pub quality: u8,
+    /// Trade PNG size for speed (frame dumps).
+    pub fast: bool,
+    /// Gamma ramp to bake in, when hardware gamma is in use.
+    pub gamma: Option<[u8; 256]>,
+}
+
+/// A captured frame: RGB8 rows, bottom row first, as read back.
+pub struct CaptureFrame {
+    pub pixels: Vec<u8>,
+    pub width: u32,
+    pub height: u32,
+}
+
+/// Encode a frame into file contents.
+pub fn encode_frame(frame: &CaptureFrame, options: &EncodeOptions) -> Result<Vec<u8>, String> {
+    let (width, height) = (frame.width as usize, frame.height as usize);
+    let row = width * 3;
+    if width == 0 || height == 0 || frame.pixels.len() < row * height {
+        return Err(format!("bad frame {}x{} ({} bytes)", width, height, frame.pixels.len()));
+    }
+    let ramp = |v: u8| options.gamma.as_ref().map_or(v, |g| g[v as usize]);
+
+    match options.format {
+        CaptureFormat::Tga => {
+            if width > 0xffff || height > 0xffff {
+                return Err(format!("{}x{} is too large for TGA", width, height));
+            }
+            // TGA's default origin is bottom-left, so rows stay in readback order
+            let mut out = vec![0u8; 18 + row * height];
+            out[2] = 2; // uncompressed type
+            out[12..14].copy_from_slice(&(width as u16).to_le_bytes());
+            out[14..16].copy_from_slice(&(height as u16).to_le_bytes());
+            out[16] = 24; // pixel size
+            for (dst, src) in out[18..].chunks_exact_mut(3).zip(frame.pixels.chunks_exact(3)) {
+                dst[0] = ramp(src[2]);
+                dst[1] = ramp(src[1]);
+                dst[2] = ramp(src[0]);
+            }
+            Ok(out)
+        }
+        CaptureFormat::Png | CaptureFormat::Jpg => {
+            use image::codecs::jpeg::JpegEncoder;
+            use image::codecs::png::{CompressionType, FilterType, PngEncoder};
+            use image::{ExtendedColorType, ImageEncoder};
+
+            // flip to top row first
+            let mut rgb = Vec::with_capacity(row * height);
+            for y in (0..height).rev() {
+                rgb.extend(frame.pixels[y * row..(y + 1) * row].iter().map(|&v| ramp(v)));
+            }
+
+            let mut out = Vec::new();
+            let result = if options.format == CaptureFormat::Png {
+                let (compression, filter) = if options.fast {
+                    (CompressionType::Fast, FilterType::Sub)
+                } else {
+                    (CompressionType::Default, FilterType::Adaptive)
+                };
+                PngEncoder::new_with_quality(&mut out, compression, filter)
+                    .write_image(&rgb, frame.width, frame.height, ExtendedColorType::Rgb8)
+            } else {
+                JpegEncoder::new_with_quality(&mut out, options.quality.clamp(1, 100))
+                    .encode(&rgb, frame.width, frame.height, ExtendedColorType::Rgb8)
+            };
+            result.map(|_| out).map_err(|e| e.to_string())
+        }
+    }
+}
+
+/// Gamma ramp matching the hardware gamma, for vk_config.gammaramp.
+pub fn gamma_table(gamma: f32) -> [u8; 256] {
+    let mut table = [0u8; 256];
+    for (i, t) in table.iter_mut().enumerate() {
+        let v = (255.0 * ((i as f64 + 0.5) * 0.0039138943248532289628180039138943).powf(gamma as f64) + 0.5) as i32;
+        *t = v.clamp(0, 255) as u8;
+    }
+    table
+}
+
+// ============================================================
+// Encoder threads
+// ============================================================
+
+/// A frame to encode and write.
+pub struct CaptureJob {
+    pub frame: CaptureFrame,
+    pub options: EncodeOptions,
+    pub path: PathBuf,
+    /// Report the write to the console (screenshots, not dump frames).
+    pub announce: bool,
+}
+
+/// Outcome of one job.
+pub struct CaptureResult {
+    pub path: PathBuf,
+    pub announce: bool,
+    /// Bytes written, or why not.
+    pub written: Result<usize, String>,
+    pub encode_usec: u64,
+}
+
+/// Bounded queue of capture jobs served by encoder threads.
+pub struct CaptureQueue {
+    jobs: Option<Sender<CaptureJob>>,
+    /// Kept so the queue stays connected, and bounded, with no encoders.
+    _queued: Receiver<CaptureJob>,
+    results: Receiver<CaptureResult>,
+    /// Pixel buffers handed back by the encoders.
+    recycled: Receiver<Vec<u8>>,
+    workers: Vec<JoinHandle<()>>,
+    /// Paths submitted but not yet reported, so names are not reused.
+    in_flight: HashSet<PathBuf>,
+}
+
+impl CaptureQueue {
+    /// Start `workers` encoder threads behind a queue of `capacity` jobs.
+    pub fn new(workers: usize, capacity: usize) -> Self {
+        let (job_tx, job_rx) = bounded::<CaptureJob>(capacity);
+        // unbounded so an encoder never waits on a render thread that is not polling
+        let (result_tx, results) = unbounded();
+        let (recycle_tx, recycled) = bounded(capacity + workers);
+
+        let workers = (0..workers)
+            .map(|i| {
+                let jobs = job_rx.clone();
+                let results = result_tx.clone();
+                let recycle: Sender<Vec<u8>> = recycle_tx.clone();
+                std::thread::Builder::new()
+                    .name(format!("capture{}", i))
+                    .spawn(move || {
+                        for job in jobs.iter() {
+                            let start = std::time::Instant::now();
+                            let written = encode_frame(&job.frame, &job.options).and_then(|bytes| {
+                                std::fs::write(&job.path, &bytes).map(|_| bytes.len()).map_err(|e| e.to_string())
+                            });
+                            let encode_usec = start.elapsed().as_micros() as u64;
+                            let _ = recycle.try_send(job.frame.pixels);
+                            let _ = results.send(CaptureResult { path: job.path, announce: job.announce, written, encode_usec });
+                        }
+                    })
+                    .expect("failed to spawn capture thread")
+            })
+            .collect();
+
+        Self { jobs: Some(job_tx), _queued: job_rx, results, recycled, workers, in_flight: HashSet::new() }
+    }
+
+    /// A pixel buffer of `len` bytes, reusing one an encoder has finished with.
+    pub fn buffer(&self, len: usize) -> Vec<u8> {
+        let mut buf = self.recycled.try_recv().unwrap_or_default();
+        buf.resize(len, 0);
+        buf
+    }
+
+    /// Queue a job without blocking; hands it back when the queue is full.
+    pub fn try_submit(&mut self, job: CaptureJob) -> Result<(), CaptureJob> {
+        let path = job.path.clone();
+        match self.jobs.as_ref().map(|tx| tx.try_send(job)) {
+            Some(Ok(())) => {
+                self.in_flight.insert(path);
+                Ok(())
+            }
+            Some(Err(TrySendError::Full(job))) | Some(Err(TrySendError::Disconnected(job))) => Err(job),
+            None => unreachable!("capture queue used after shutdown"),
+        }
+    }
+
+    /// Queue a job, waiting for a free slot.
+    pub fn submit(&mut self, job: CaptureJob) {
+        let path = job.path.clone();
+        if let Some(tx) = &self.jobs {
+            if tx.send(job).is_ok() {
+                self.in_flight.insert(path);
+            }
+        }
+    }
+
+    /// Whether `path` is queued or being written.
+    pub fn is_pending(&self, path: &Path) -> bool {
+        self.in_flight.contains(path)
+    }
+
+    /// Jobs submitted and not yet reported.
+    pub fn pending(&self) -> usize {
+        self.in_flight.len()
+    }
+
+    /// Collect finished jobs.
+    pub fn poll(&mut self) -> Vec<CaptureResult> {
+        let done: Vec<CaptureResult> = self.results.try_iter().collect();
+        for r in &done {
+            self.in_flight.remove(&r.path);
+        }
+        done
+    }
+
+    /// Finish every queued job and stop the encoders.
+    pub fn shutdown(&mut self) -> Vec<CaptureResult> {
+        self.jobs = None;
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+        self.poll()
+    }
+}
+
+impl Drop for CaptureQueue {
+    fn drop(&mut self) {
+        self.shutdown();
+    }
+}
+
+// ============================================================
+// Renderer glue
+// ============================================================
+
+/// Frame-dump counters for the running sequence.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CaptureStats {
+    pub frames: u32,
+    pub dropped: u32,
+    pub written: u32,
+    pub failed: u32,
+    pub encode_usec: u64,
+}
+
+static mut CAPTURE: Option<CaptureQueue> = None;
+/// Directory of the running frame dump, if one is active.
+static mut DUMP_DIR: Option<PathBuf> = None;
+pub static mut CAPTURE_STATS: CaptureStats = CaptureStats { frames: 0, dropped: 0, written: 0, failed: 0, encode_usec: 0 };
+
+unsafe fn capture_queue() -> &'static mut CaptureQueue {
+    let queue = &mut *std::ptr::addr_of_mut!(CAPTURE);
+    queue.get_or_insert_with(|| {
+        let threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+        CaptureQueue::new((threads / 2).clamp(1, 4), CAPTURE_QUEUE_DEPTH)
+    })
+}
+
+/// Read the current framebuffer into a capture frame.
+unsafe fn read_frame(queue: &CaptureQueue) -> CaptureFrame {
+    let width = crate::vk_rmain::VID.width;
+    let height = crate::vk_rmain::VID.height;
+    let mut pixels = queue.buffer(width as usize * height as usize * 3);
+    crate::vk_rmisc::qvk_read_pixels(0, 0, width, height, &mut pixels);
+    CaptureFrame { pixels, width: width as u32, height: height as u32 }
+}
+
+unsafe fn encode_options(format: CaptureFormat, fast: bool) -> EncodeOptions {
+    let gammaramp = (*std::ptr::addr_of!(crate::vk_rmain::VK_CONFIG)).as_ref().is_some_and(|c| c.gammaramp != 0);
+    EncodeOptions {
+        format,
+        quality: (myq2_common::cvar::cvar_variable_value("vk_screenshot_quality") as i32).clamp(1, 100) as u8,
+        fast,
+        gamma: gammaramp.then(|| gamma_table(crate::vk_rmain::VID_GAMMA.value)),
+    }
+}
+
+fn scrnshot_dir() -> PathBuf {
+    let dir = PathBuf::from(format!("{}/scrnshot", myq2_common::files::fs_gamedir()));
+    let _ = std::fs::create_dir_all(&dir);
+    dir
+}
+
+/// Queue a screenshot (the "screenshot" command).
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_capture_screenshot() {
+    let format = CaptureFormat::from_name(&myq2_common::cvar::cvar_variable_string("vk_screenshot_format"));
+    let dir = scrnshot_dir();
+    let queue = capture_queue();
+
+    // find a file name to save it to
+    let Some(path) = (0..=99)
+        .map(|i| dir.join(format!("quake{:02}.{}", i, format.extension())))
+        .find(|p| !p.exists() && !queue.is_pending(p))
+    else {
+        vid_printf(PRINT_ALL, "SCR_ScreenShot_f: Couldn't create a file\n");
+        return;
+    };
+
+    let frame = read_frame(queue);
+    let options = encode_options(format, false);
+    queue.submit(CaptureJob { frame, options, path, announce: true });
+}
+
+/// Per-frame capture work: report finished writes and, while vk_capture is
+/// set, queue the frame just rendered. Never waits on the encoders.
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_capture_frame() {
+    let dumping = myq2_common::cvar::cvar_variable_value("vk_capture") != 0.0;
+    let dump_dir = &mut *std::ptr::addr_of_mut!(DUMP_DIR);
+    if (*std::ptr::addr_of!(CAPTURE)).is_none() && !dumping {
+        return;
+    }
+    let queue = capture_queue();
+
+    for r in queue.poll() {
+        let name = r.path.file_name().map_or_else(String::new, |n| n.to_string_lossy().into_owned());
+        match &r.written {
+            Ok(_) if r.announce => vid_printf(PRINT_ALL, &format!("Wrote {}\n", name)),
+            Ok(_) => CAPTURE_STATS.written += 1,
+            Err(e) => {
+                CAPTURE_STATS.failed += 1;
+                vid_printf(PRINT_ALL, &format!("Could not write {}: {}\n", name, e));
+            }
+        }
+        if !r.announce {
+            CAPTURE_STATS.encode_usec += r.encode_usec;
+        }
+    }
+
+    if !dumping {
+        if let Some(dir) = dump_dir.take() {
+            let s = &*std::ptr::addr_of!(CAPTURE_STATS);
+            vid_printf(PRINT_ALL, &format!(
+                "Captured {} frames to {} ({} dropped, {} ms/frame encode)\n",
+                s.frames, dir.display(), s.dropped,
+                if s.written > 0 { s.encode_usec / 1000 / s.written as u64 } else { 0 },
+            ));
+        }
+        return;
+    }
+
+    if dump_dir.is_none() {
+        let base = scrnshot_dir();
+        let Some(dir) = (0..=9999).map(|i| base.join(format!("cap{:04}", i))).find(|d| !d.exists()) else {
+            vid_printf(PRINT_ALL, "vk_capture: no free capture directory\n");
+            return;
+        };
+        if std::fs::create_dir_all(&dir).is_err() {
+            vid_printf(PRINT_ALL, &format!("vk_capture: could not create {}\n", dir.display()));
+            return;
+        }
+        vid_printf(PRINT_ALL, &format!("Capturing frames to {}\n", dir.display()));
+        *dump_dir = Some(dir);
+        CAPTURE_STATS = CaptureStats::default();
+    }
+
+    let format = CaptureFormat::from_name(&myq2_common::cvar::cvar_variable_string("vk_capture_format"));
+    let path = dump_dir
+        .as_ref()
+        .unwrap()
+        .join(format!("frame{:06}.{}", CAPTURE_STATS.frames + CAPTURE_STATS.dropped, format.extension()));
+    let job = CaptureJob { frame: read_frame(queue), options: encode_options(format, true), path, announce: false };
+    match queue.try_submit(job) {
+        Ok(()) => CAPTURE_STATS.frames += 1,
+        Err(_) => CAPTURE_STATS.dropped += 1,
+    }
+}
+
+/// Finish pending writes (renderer shutdown).
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_capture_shutdown() {
+    if let Some(mut queue) = (*std::ptr::addr_of_mut!(CAPTURE)).take() {
+        queue.shutdown();
+    }
+    *std::ptr::addr_of_mut!(DUMP_DIR) = None;
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// 3x2 frame, bottom row first: bottom = red green blue, top = greys.
+    fn frame() -> CaptureFrame {
+        let pixels = vec![
+            255, 0, 0, 0, 255, 0, 0, 0, 255, //
+            10, 10, 10, 20, 20, 20, 30, 30, 30,
+        ];
+        CaptureFrame { pixels, width: 3, height: 2 }
+    }
+
+    fn options(format: CaptureFormat) -> EncodeOptions {
+        EncodeOptions { format, quality: 90, fast: false, gamma: None }
+    }
+
+    #[test]
+    fn test_encode_tga() {
+        let mut gamma = [0u8; 256];
+        for (i, g) in gamma.iter_mut().enumerate() {
+            *g = 255 - i as u8;
+        }
+        let out = encode_frame(&frame(), &EncodeOptions { gamma: Some(gamma), ..options(CaptureFormat::Tga) }).unwrap();
+        assert_eq!(out.len(), 18 + 18);
+        assert_eq!((out[2], out[12], out[14], out[16]), (2, 3, 2, 24));
+        // bottom row first, BGR, through the ramp
+        assert_eq!(&out[18..24], &[255, 255, 0, 255, 0, 255]);
+        assert_eq!(&out[27..30], &[245, 245, 245]);
+
+        let short = CaptureFrame { pixels: vec![0; 5], width: 3, height: 2 };
+        assert!(encode_frame(&short, &options(CaptureFormat::Tga)).is_err());
+    }
+
+    #[test]
+    fn test_encode_png_round_trip() {
+        for fast in [false, true] {
+            let out = encode_frame(&frame(), &EncodeOptions { fast, ..options(CaptureFormat::Png) }).unwrap();
+            let img = image::load_from_memory(&out).unwrap().to_rgb8();
+            assert_eq!(img.dimensions(), (3, 2));
+            // top row first in the file
+            assert_eq!(img.get_pixel(0, 0).0, [10, 10, 10]);
+            assert_eq!(img.get_pixel(2, 1).0, [0, 0, 255]);
+        }
+        let jpg = encode_frame(&frame(), &options(CaptureFormat::Jpg)).unwrap();
+        assert_eq!(image::load_from_memory(&jpg).unwrap().to_rgb8().dimensions(), (3, 2));
+    }
+
+    #[test]
+    fn test_queue_drops_when_full() {
+        let dir = std::env::temp_dir().join(format!("myq2_capture_{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let job = |i: usize| CaptureJob {
+            frame: frame(),
+            options: options(CaptureFormat::Tga),
+            path: dir.join(format!("frame{}.tga", i)),
+            announce: false,
+        };
+
+        // no encoders: the queue fills and hands jobs back instead of blocking
+        let mut stalled = CaptureQueue::new(0, 2);
+        assert!(stalled.try_submit(job(0)).is_ok());
+        assert!(stalled.try_submit(job(1)).is_ok());
+        assert_eq!(stalled.try_submit(job(2)).err().map(|j| j.path), Some(dir.join("frame2.tga")));
+        assert!(stalled.is_pending(&dir.join("frame0.tga")) && stalled.pending() == 2);
+        drop(stalled);
+
+        let mut queue = CaptureQueue::new(2, 4);
+        for i in 0..4 {
+            queue.submit(job(i));
+        }
+        let results = queue.shutdown();
+        assert_eq!(results.len(), 4);
+        assert!(results.iter().all(|r| r.written == Ok(36)));
+        assert_eq!(queue.pending(), 0);
+        assert_eq!(std::fs::read(dir.join("frame3.tga")).unwrap().len(), 36);
+        assert_eq!(queue.buffer(18).len(), 18);
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+}
@@ -16,6 +16,9 @@ use myq2_common::q_shared::{MAX_QPATH, PRINT_ALL};
 
 static mut draw_chars: *mut Image = std::ptr::null_mut();
 
+/// 2D batching counters of the last completed frame (r_speeds).
+pub static mut DRAW2D_STATS: crate::modern::geometry::Draw2DStats = crate::modern::geometry::Draw2DStats::new();
+
 extern "C" {
     // These are defined in vk_image
 }
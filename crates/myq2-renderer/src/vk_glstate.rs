@@ -0,0 +1,391 @@
+// vk_glstate.rs — Redundant GL state filter
+//
+// vk_bind, vk_mbind, vk_tex_env and vk_select_texture each remember a little
+// state (bound texture and env mode per TMU, current TMU), but everything else
+// went to the driver unconditionally: R_SetupGL, R_SetGL2D and the 2D reset in
+// R_BeginFrame re-disable depth test, culling and blending every frame, reset
+// the colour to white, and so on. GlStateCache mirrors the fixed-function
+// state the qvk_* wrappers in vk_local can change and tells them whether a
+// call would change anything; the ones that would not are dropped.
+//
+// Every call is counted as issued or filtered per kind, whether or not vk_log
+// is routing the issued ones into gl.log, so the savings can be measured with
+// the no-op bindings and no driver at all. Counts run from one R_BeginFrame
+// to the next; the previous frame's totals are in GL_STATE_STATS.
+//
+// Unknown state always goes through. Reset to what a fresh context holds
+// (only the active unit, TEXTURE0, is known) whenever the context is created.
+
+use crate::vk_local::{
+    VK_COMBINE_ALPHA_EXT, VK_COMBINE_RGB_EXT, VK_RGB_SCALE_ARB, VK_SOURCE0_ALPHA_EXT,
+    VK_SOURCE0_RGB_EXT, VK_SOURCE1_ALPHA_EXT, VK_SOURCE1_RGB_EXT, VK_TEXTURE0, VK_TEXTURE_2D,
+    VK_TEXTURE_ENV, VK_TEXTURE_ENV_MODE,
+};
+
+/// Texture units tracked; binds and env changes on higher units pass through.
+pub const MAX_TMUS: usize = 4;
+
+/// Capabilities whose enable bit is global rather than per texture unit.
+const GLOBAL_CAPS: [u32; 8] = [
+    0x0BE2, // GL_BLEND
+    0x0B71, // GL_DEPTH_TEST
+    0x0B44, // GL_CULL_FACE
+    0x0BC0, // GL_ALPHA_TEST
+    0x0C11, // GL_SCISSOR_TEST
+    0x0B90, // GL_STENCIL_TEST
+    0x0B60, // GL_FOG
+    0x8037, // GL_POLYGON_OFFSET_FILL
+];
+
+/// Texture environment parameters, including the combine-mode ones.
+const TEXENV_PARAMS: [u32; 8] = [
+    VK_TEXTURE_ENV_MODE,
+    VK_COMBINE_RGB_EXT,
+    VK_COMBINE_ALPHA_EXT,
+    VK_SOURCE0_RGB_EXT,
+    VK_SOURCE1_RGB_EXT,
+    VK_SOURCE0_ALPHA_EXT,
+    VK_SOURCE1_ALPHA_EXT,
+    VK_RGB_SCALE_ARB,
+];
+
+/// The state-setting calls that go through the filter.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StateCall {
+    Enable,
+    Disable,
+    Color,
+    DepthFunc,
+    AlphaFunc,
+    CullFace,
+    TexEnv,
+    ActiveTexture,
+    ClientActiveTexture,
+    BindTexture,
+}
+
+pub const STATE_CALLS: usize = 10;
+
+impl StateCall {
+    pub const ALL: [StateCall; STATE_CALLS] = [
+        StateCall::Enable,
+        StateCall::Disable,
+        StateCall::Color,
+        StateCall::DepthFunc,
+        StateCall::AlphaFunc,
+        StateCall::CullFace,
+        StateCall::TexEnv,
+        StateCall::ActiveTexture,
+        StateCall::ClientActiveTexture,
+        StateCall::BindTexture,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            StateCall::Enable => "glEnable",
+            StateCall::Disable => "glDisable",
+            StateCall::Color => "glColor",
+            StateCall::DepthFunc => "glDepthFunc",
+            StateCall::AlphaFunc => "glAlphaFunc",
+            StateCall::CullFace => "glCullFace",
+            StateCall::TexEnv => "glTexEnv",
+            StateCall::ActiveTexture => "glActiveTexture",
+            StateCall::ClientActiveTexture => "glClientActiveTexture",
+            StateCall::BindTexture => "glBindTexture",
+        }
+    }
+}
+
+/// Issued/filtered call counts for one frame, indexed by StateCall.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct GlStateStats {
+    pub issued: [u32; STATE_CALLS],
+    pub filtered: [u32; STATE_CALLS],
+}
+
+impl GlStateStats {
+    pub const fn new() -> Self {
+        Self { issued: [0; STATE_CALLS], filtered: [0; STATE_CALLS] }
+    }
+
+    pub fn total_issued(&self) -> u32 {
+        self.issued.iter().sum()
+    }
+
+    pub fn total_filtered(&self) -> u32 {
+        self.filtered.iter().sum()
+    }
+}
+
+/// Shadow copy of the fixed-function state; `None` means not known.
+#[derive(Debug, Clone)]
+pub struct GlStateCache {
+    caps: [Option<bool>; GLOBAL_CAPS.len()],
+    texture_2d: [Option<bool>; MAX_TMUS],
+    /// Bit patterns, so -0.0 is not taken for 0.0.
+    color: Option<[u32; 4]>,
+    depth_func: Option<u32>,
+    alpha_func: Option<(u32, u32)>,
+    cull_face: Option<u32>,
+    active_tmu: Option<usize>,
+    client_active: Option<u32>,
+    /// Values stored as f32 bits; glTexEnvi and glTexEnvf set the same state.
+    texenv: [[Option<u32>; TEXENV_PARAMS.len()]; MAX_TMUS],
+    bound: [Option<u32>; MAX_TMUS],
+    /// Counts since the last new_frame().
+    pub stats: GlStateStats,
+}
+
+impl GlStateCache {
+    /// State as known right after context creation.
+    pub const fn new() -> Self {
+        Self {
+            caps: [None; GLOBAL_CAPS.len()],
+            texture_2d: [None; MAX_TMUS],
+            color: None,
+            depth_func: None,
+            alpha_func: None,
+            cull_face: None,
+            active_tmu: Some(0),
+            client_active: None,
+            texenv: [[None; TEXENV_PARAMS.len()]; MAX_TMUS],
+            bound: [None; MAX_TMUS],
+            stats: GlStateStats::new(),
+        }
+    }
+
+    /// Finish a frame: return its counts and start the next one at zero.
+    pub fn new_frame(&mut self) -> GlStateStats {
+        std::mem::take(&mut self.stats)
+    }
+
+    /// Record `call`; true when it must be sent to GL.
+    fn count(&mut self, call: StateCall, issue: bool) -> bool {
+        if issue {
+            self.stats.issued[call as usize] += 1;
+        } else {
+            self.stats.filtered[call as usize] += 1;
+        }
+        issue
+    }
+
+    /// Store `value` in `slot`; true when it differs from what was there.
+    fn update<T: PartialEq + Copy>(slot: &mut Option<T>, value: T) -> bool {
+        if *slot == Some(value) {
+            return false;
+        }
+        *slot = Some(value);
+        true
+    }
+
+    fn cap_slot(&mut self, cap: u32) -> Option<&mut Option<bool>> {
+        if cap == VK_TEXTURE_2D {
+            let tmu = self.active_tmu?;
+            return Some(&mut self.texture_2d[tmu]);
+        }
+        let i = GLOBAL_CAPS.iter().position(|&c| c == cap)?;
+        Some(&mut self.caps[i])
+    }
+
+    fn set_cap(&mut self, cap: u32, on: bool) -> bool {
+        let call = if on { StateCall::Enable } else { StateCall::Disable };
+        let issue = match self.cap_slot(cap) {
+            Some(slot) => Self::update(slot, on),
+            None => true,
+        };
+        self.count(call, issue)
+    }
+
+    pub fn enable(&mut self, cap: u32) -> bool {
+        self.set_cap(cap, true)
+    }
+
+    pub fn disable(&mut self, cap: u32) -> bool {
+        self.set_cap(cap, false)
+    }
+
+    pub fn color(&mut self, r: f32, g: f32, b: f32, a: f32) -> bool {
+        let issue = Self::update(&mut self.color, [r.to_bits(), g.to_bits(), b.to_bits(), a.to_bits()]);
+        self.count(StateCall::Color, issue)
+    }
+
+    pub fn depth_func(&mut self, func: u32) -> bool {
+        let issue = Self::update(&mut self.depth_func, func);
+        self.count(StateCall::DepthFunc, issue)
+    }
+
+    pub fn alpha_func(&mut self, func: u32, ref_val: f32) -> bool {
+        let issue = Self::update(&mut self.alpha_func, (func, ref_val.to_bits()));
+        self.count(StateCall::AlphaFunc, issue)
+    }
+
+    pub fn cull_face(&mut self, mode: u32) -> bool {
+        let issue = Self::update(&mut self.cull_face, mode);
+        self.count(StateCall::CullFace, issue)
+    }
+
+    pub fn tex_env(&mut self, target: u32, pname: u32, param: f32) -> bool {
+        let slot = match (target, self.active_tmu, TEXENV_PARAMS.iter().position(|&p| p == pname)) {
+            (VK_TEXTURE_ENV, Some(tmu), Some(i)) => Some(&mut self.texenv[tmu][i]),
+            _ => None,
+        };
+        let issue = match slot {
+            Some(slot) => Self::update(slot, param.to_bits()),
+            None => true,
+        };
+        self.count(StateCall::TexEnv, issue)
+    }
+
+    pub fn active_texture(&mut self, texture: u32) -> bool {
+        let tmu = texture.wrapping_sub(VK_TEXTURE0) as usize;
+        let issue = if tmu < MAX_TMUS {
+            Self::update(&mut self.active_tmu, tmu)
+        } else {
+            // untracked unit: nothing per-unit is known until we return
+            self.active_tmu = None;
+            true
+        };
+        self.count(StateCall::ActiveTexture, issue)
+    }
+
+    pub fn client_active_texture(&mut self, texture: u32) -> bool {
+        let issue = Self::update(&mut self.client_active, texture);
+        self.count(StateCall::ClientActiveTexture, issue)
+    }
+
+    pub fn bind_texture(&mut self, target: u32, texture: u32) -> bool {
+        let issue = match (target, self.active_tmu) {
+            (VK_TEXTURE_2D, Some(tmu)) => Self::update(&mut self.bound[tmu], texture),
+            _ => true,
+        };
+        self.count(StateCall::BindTexture, issue)
+    }
+
+    /// A texture was deleted; GL rebinds 0 wherever it was bound.
+    pub fn forget_texture(&mut self, texture: u32) {
+        for b in self.bound.iter_mut() {
+            if *b == Some(texture) {
+                *b = Some(0);
+            }
+        }
+    }
+}
+
+impl Default for GlStateCache {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+pub static mut GL_STATE: GlStateCache = GlStateCache::new();
+
+/// Counts for the last complete frame (R_BeginFrame to R_BeginFrame).
+pub static mut GL_STATE_STATS: GlStateStats = GlStateStats::new();
+
+/// The filter the qvk_* wrappers consult.
+///
+/// # Safety
+/// Render thread only, like the rest of the GL state.
+pub unsafe fn gl_state() -> &'static mut GlStateCache {
+    &mut *std::ptr::addr_of_mut!(GL_STATE)
+}
+
+/// Forget all tracked state; call after creating the GL context.
+pub unsafe fn gl_state_reset() {
+    let stats = gl_state().stats;
+    *gl_state() = GlStateCache::new();
+    gl_state().stats = stats;
+}
+
+/// Close out the frame's counts into GL_STATE_STATS.
+pub unsafe fn gl_state_new_frame() {
+    GL_STATE_STATS = gl_state().new_frame();
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const BLEND: u32 = 0x0BE2;
+    const DEPTH_TEST: u32 = 0x0B71;
+
+    #[test]
+    fn test_redundant_calls_filtered() {
+        let mut gl = GlStateCache::new();
+        // nothing is known yet, so the first of each goes through
+        assert!(gl.disable(BLEND));
+        assert!(gl.enable(DEPTH_TEST));
+        assert!(gl.color(1.0, 1.0, 1.0, 1.0));
+
+        // R_SetGL2D / R_BeginFrame style repeats
+        assert!(!gl.disable(BLEND));
+        assert!(!gl.enable(DEPTH_TEST));
+        assert!(!gl.color(1.0, 1.0, 1.0, 1.0));
+
+        // real changes still go out
+        assert!(gl.enable(BLEND));
+        assert!(gl.disable(DEPTH_TEST));
+        assert!(gl.color(1.0, 1.0, 1.0, 0.5));
+
+        let stats = gl.new_frame();
+        assert_eq!(stats.total_issued(), 6);
+        assert_eq!(stats.total_filtered(), 3);
+        assert_eq!(stats.filtered[StateCall::Disable as usize], 1);
+        assert_eq!(gl.stats, GlStateStats::new());
+    }
+
+    #[test]
+    fn test_per_unit_state() {
+        let mut gl = GlStateCache::new();
+        assert!(gl.bind_texture(VK_TEXTURE_2D, 5));
+        assert!(gl.tex_env(VK_TEXTURE_ENV, VK_TEXTURE_ENV_MODE, 0x1E01 as f32));
+        assert!(gl.enable(VK_TEXTURE_2D));
+
+        assert!(!gl.active_texture(VK_TEXTURE0));
+        assert!(gl.active_texture(VK_TEXTURE0 + 1));
+        // unit 1 has its own binding, env and enable
+        assert!(gl.bind_texture(VK_TEXTURE_2D, 5));
+        assert!(gl.tex_env(VK_TEXTURE_ENV, VK_TEXTURE_ENV_MODE, 0x1E01 as f32));
+        assert!(gl.enable(VK_TEXTURE_2D));
+        assert!(!gl.bind_texture(VK_TEXTURE_2D, 5));
+
+        // glTexEnvi and glTexEnvf of the same value are the same state
+        assert!(gl.tex_env(VK_TEXTURE_ENV, VK_COMBINE_RGB_EXT, 0x2100 as f32));
+        assert!(!gl.tex_env(VK_TEXTURE_ENV, VK_COMBINE_RGB_EXT, 0x2100_i32 as f32));
+
+        assert!(gl.active_texture(VK_TEXTURE0));
+        assert!(!gl.bind_texture(VK_TEXTURE_2D, 5));
+        assert!(!gl.enable(VK_TEXTURE_2D));
+
+        gl.forget_texture(5);
+        assert!(gl.bind_texture(VK_TEXTURE_2D, 5));
+    }
+
+    #[test]
+    fn test_unknown_state_passes_through() {
+        let mut gl = GlStateCache::new();
+        // untracked caps and parameters are never filtered
+        assert!(gl.enable(0x0B57));
+        assert!(gl.enable(0x0B57));
+        assert!(gl.tex_env(VK_TEXTURE_ENV, 0x8590, 1.0));
+        assert!(gl.tex_env(VK_TEXTURE_ENV, 0x8590, 1.0));
+
+        // on an untracked unit nothing per-unit is cached
+        assert!(gl.active_texture(VK_TEXTURE0 + 6));
+        assert!(gl.bind_texture(VK_TEXTURE_2D, 1));
+        assert!(gl.bind_texture(VK_TEXTURE_2D, 1));
+        assert!(gl.active_texture(VK_TEXTURE0));
+        assert!(gl.bind_texture(VK_TEXTURE_2D, 1));
+
+        // colours compare by bits
+        assert!(gl.color(f32::NAN, 0.0, 0.0, 1.0) && gl.color(0.0, 0.0, 0.0, 1.0));
+        assert!(gl.color(-0.0, 0.0, 0.0, 1.0));
+
+        let stats = gl.new_frame();
+        assert_eq!(stats.total_filtered(), 0);
+    }
+}
@@ -8,6 +8,9 @@ use crate::vk_local::*;
 use crate::vk_rmain::vid_printf;
 use myq2_common::q_shared::{MAX_QPATH, PRINT_ALL, ERR_DROP, q_streq_nocase};
 use myq2_common::common::com_error;
+use crate::simd::SimdLevel;
+use crate::vk_registry::NameIndex;
+use std::collections::HashMap;
 use rayon::prelude::*;
 
 // ============================================================
@@ -42,6 +45,14 @@ pub static mut scrap_texels: [[u8; BLOCK_WIDTH * BLOCK_HEIGHT]; MAX_SCRAPS] = [[
 pub static mut scrap_dirty: i32 = 0; // qboolean
 pub static mut scrap_uploads: i32 = 0;
 
+/// Image name -> gltextures slot.
+static mut IMAGE_INDEX: NameIndex = NameIndex::new();
+
+/// draw_find_pic names as passed (e.g. "i_health") -> resolved image, so
+/// HUD pics skip the path formatting and lookup every frame. Misses are
+/// cached too; cleared whenever images are freed.
+static mut PIC_CACHE: Option<HashMap<Box<str>, *mut Image>> = None;
+
 // ============================================================
 // GL texture mode tables
 // ============================================================
@@ -274,6 +285,10 @@ pub unsafe fn vk_image_list_f() {
         vid_printf(PRINT_ALL, &format!("{} {:3} {:3}: {}\n", type_char, image.upload_width, image.upload_height, name_str));
     }
     vid_printf(PRINT_ALL, &format!("Total texel count (not counting mipmaps): {}\n", texels));
+    let (hits, misses, stores, failed) = crate::vk_texcache::stats();
+    if hits + misses > 0 {
+        vid_printf(PRINT_ALL, &format!("Texture cache: {} hits, {} misses, {} stored, {} failed\n", hits, misses, stores, failed));
+    }
 }
 
 // ============================================================
@@ -390,183 +405,229 @@ pub unsafe fn r_flood_fill_skin(skin: *mut u8, skinwidth: i32, skinheight: i32)
 }
 
 // ============================================================
-// vk_resample_texture
-// ============================================================
-
-static mut p1: *mut u32 = std::ptr::null_mut();
-static mut p2: *mut u32 = std::ptr::null_mut();
+// Upload preparation — the CPU half of vk_upload32
+//
+// Resampling, light scaling and mip generation only read the texels and a
+// snapshot of a few globals (UploadParams), so batch loads run them on
+// worker threads and keep only vk_upload_levels on the main thread.
+// ============================================================
+
+/// Renderer state the CPU half of vk_upload32 depends on.
+#[derive(Clone, Copy)]
+pub struct UploadParams {
+    pub picmip: i32,
+    pub gamma: [u8; 256],
+    /// gammatable[intensitytable[i]]
+    pub intensity_gamma: [u8; 256],
+    pub palette: [u32; 256],
+    /// Mips are generated by the driver (SGIS), so no chain is built.
+    pub hw_mipmap: bool,
+    pub level: SimdLevel,
+}
 
-pub unsafe fn vk_resample_texture(
-    in_data: *const u32, inwidth: i32, inheight: i32,
-    out_data: *mut u32, outwidth: i32, outheight: i32,
-) {
-    // lazy alloc p1, p2
-    // max_tsize should match the maximum texture dimension supported.
-    // 2048 matches the original C code's MAX_TEXTURE_SIZE assumption.
-    let max_sz = 2048;
-    if p1.is_null() {
-        let layout = std::alloc::Layout::from_size_align(max_sz * 4, 4).unwrap();
-        p1 = std::alloc::alloc_zeroed(layout) as *mut u32;
-        p2 = std::alloc::alloc_zeroed(layout) as *mut u32;
+impl UploadParams {
+    /// Snapshot the current gamma, intensity, palette and picmip settings.
+    ///
+    /// # Safety
+    /// Reads renderer globals; call from the main thread.
+    pub unsafe fn current() -> Self {
+        Self {
+            picmip: crate::vk_rmain::VK_PICMIP.value as i32,
+            gamma: gammatable,
+            intensity_gamma: std::array::from_fn(|i| gammatable[intensitytable[i] as usize]),
+            palette: d_8to24table,
+            hw_mipmap: vk_config.sgismipmap != 0,
+            level: crate::simd::level(),
+        }
     }
+}
 
-    let fracstep = ((inwidth as u32).wrapping_mul(0x10000)) / outwidth as u32;
+/// Texels of every level of a texture, ready for upload.
+pub struct UploadLevels {
+    /// Size of level 0.
+    pub width: i32,
+    pub height: i32,
+    /// RGBA texels of each level, largest first.
+    pub levels: LevelStore,
+    pub has_alpha: bool,
+    /// Uploaded as given: already power-of-two and not mipmapped.
+    pub direct: bool,
+}
 
-    let mut frac = fracstep >> 2;
-    for i in 0..outwidth {
-        *p1.offset(i as isize) = 4 * (frac >> 16);
-        frac = frac.wrapping_add(fracstep);
-    }
+/// Backing storage of the upload levels: built in memory, or one entry mapped
+/// from the texture cache (vk_texcache.rs).
+pub enum LevelStore {
+    Owned(Vec<Vec<u8>>),
+    Cached { file: crate::vk_texcache::CacheFile, ranges: Vec<std::ops::Range<usize>> },
+}
 
-    frac = 3 * (fracstep >> 2);
-    for i in 0..outwidth {
-        *p2.offset(i as isize) = 4 * (frac >> 16);
-        frac = frac.wrapping_add(fracstep);
+impl LevelStore {
+    pub fn len(&self) -> usize {
+        match self {
+            LevelStore::Owned(levels) => levels.len(),
+            LevelStore::Cached { ranges, .. } => ranges.len(),
+        }
     }
 
-    let mut out = out_data;
-    for i in 0..outheight {
-        let inrow = in_data.offset((inwidth as isize) * ((i as f32 + 0.25) * inheight as f32 / outheight as f32) as isize);
-        let inrow2 = in_data.offset((inwidth as isize) * ((i as f32 + 0.75) * inheight as f32 / outheight as f32) as isize);
-        for j in 0..outwidth {
-            let pix1 = (inrow as *const u8).offset(*p1.offset(j as isize) as isize);
-            let pix2 = (inrow as *const u8).offset(*p2.offset(j as isize) as isize);
-            let pix3 = (inrow2 as *const u8).offset(*p1.offset(j as isize) as isize);
-            let pix4 = (inrow2 as *const u8).offset(*p2.offset(j as isize) as isize);
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
 
-            let outp = out.offset(j as isize) as *mut u8;
-            *outp.offset(0) = ((*pix1.offset(0) as u32 + *pix2.offset(0) as u32 + *pix3.offset(0) as u32 + *pix4.offset(0) as u32) >> 2) as u8;
-            *outp.offset(1) = ((*pix1.offset(1) as u32 + *pix2.offset(1) as u32 + *pix3.offset(1) as u32 + *pix4.offset(1) as u32) >> 2) as u8;
-            *outp.offset(2) = ((*pix1.offset(2) as u32 + *pix2.offset(2) as u32 + *pix3.offset(2) as u32 + *pix4.offset(2) as u32) >> 2) as u8;
-            *outp.offset(3) = ((*pix1.offset(3) as u32 + *pix2.offset(3) as u32 + *pix3.offset(3) as u32 + *pix4.offset(3) as u32) >> 2) as u8;
+    pub fn get(&self, i: usize) -> Option<&[u8]> {
+        match self {
+            LevelStore::Owned(levels) => levels.get(i).map(|l| l.as_slice()),
+            LevelStore::Cached { file, ranges } => ranges.get(i).map(|r| &file.bytes()[r.clone()]),
         }
-        out = out.offset(outwidth as isize);
+    }
+
+    pub fn iter(&self) -> impl Iterator<Item = &[u8]> {
+        (0..self.len()).map(move |i| &self[i])
     }
 }
 
-// ============================================================
-// vk_light_scale_texture
-// ============================================================
+impl std::ops::Index<usize> for LevelStore {
+    type Output = [u8];
+    fn index(&self, i: usize) -> &[u8] {
+        self.get(i).expect("mip level out of range")
+    }
+}
 
-pub unsafe fn vk_light_scale_texture(in_data: *mut u8, inwidth: i32, inheight: i32, only_gamma: bool, bpp: i32) {
-    let inc: isize = if bpp == 24 { 3 } else { 4 };
-    let c = (inwidth * inheight) as isize;
-    let mut p = in_data;
+impl PartialEq for LevelStore {
+    fn eq(&self, other: &Self) -> bool {
+        self.len() == other.len() && self.iter().zip(other.iter()).all(|(a, b)| a == b)
+    }
+}
 
-    if only_gamma {
-        for _ in 0..c {
-            *p.offset(0) = gammatable[*p.offset(0) as usize];
-            *p.offset(1) = gammatable[*p.offset(1) as usize];
-            *p.offset(2) = gammatable[*p.offset(2) as usize];
-            p = p.offset(inc);
-        }
-    } else {
-        for _ in 0..c {
-            *p.offset(0) = gammatable[intensitytable[*p.offset(0) as usize] as usize];
-            *p.offset(1) = gammatable[intensitytable[*p.offset(1) as usize] as usize];
-            *p.offset(2) = gammatable[intensitytable[*p.offset(2) as usize] as usize];
-            p = p.offset(inc);
-        }
+impl std::fmt::Debug for LevelStore {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_list().entries(self.iter().map(|l| l.len())).finish()
     }
 }
 
-// ============================================================
-// vk_mipmap
-// ============================================================
+/// Power-of-two upload size of a `width` x `height` image, after picmip and
+/// clamping to 2048.
+pub fn upload_size(width: i32, height: i32, mipmap: bool, picmip: i32) -> (i32, i32) {
+    let mut scaled_width = next_power_of_two(width);
+    if picmip != 0 && scaled_width > width && mipmap { scaled_width >>= 1; }
+    let mut scaled_height = next_power_of_two(height);
+    if picmip != 0 && scaled_height > height && mipmap { scaled_height >>= 1; }
 
-pub unsafe fn vk_mip_map(in_data: *mut u8, width: i32, height: i32) {
-    let w = (width << 2) as isize;
-    let h = (height >> 1) as isize;
-    let mut out = in_data;
-    let mut inp = in_data;
+    if mipmap {
+        scaled_width >>= picmip;
+        scaled_height >>= picmip;
+    }
+    (scaled_width.clamp(1, 2048), scaled_height.clamp(1, 2048))
+}
 
-    for _ in 0..h {
-        let mut j: isize = 0;
-        while j < w {
-            *out.offset(0) = ((*inp.offset(0) as u32 + *inp.offset(4) as u32 + *inp.offset(w) as u32 + *inp.offset(w + 4) as u32) >> 2) as u8;
-            *out.offset(1) = ((*inp.offset(1) as u32 + *inp.offset(5) as u32 + *inp.offset(w + 1) as u32 + *inp.offset(w + 5) as u32) >> 2) as u8;
-            *out.offset(2) = ((*inp.offset(2) as u32 + *inp.offset(6) as u32 + *inp.offset(w + 2) as u32 + *inp.offset(w + 6) as u32) >> 2) as u8;
-            *out.offset(3) = ((*inp.offset(3) as u32 + *inp.offset(7) as u32 + *inp.offset(w + 3) as u32 + *inp.offset(w + 7) as u32) >> 2) as u8;
-            out = out.offset(4);
-            inp = inp.offset(8);
-            j += 8;
+/// Expand 8-bit paletted texels to RGBA. Transparent texels (255) take the
+/// colour of an opaque neighbour to avoid dark fringes when filtered.
+pub fn expand_paletted(data: &[u8], width: i32, height: i32, palette: &[u32; 256]) -> Vec<u32> {
+    let s = (width * height) as usize;
+    let width = width as usize;
+    let mut trans = Vec::with_capacity(s);
+    for i in 0..s {
+        let p = data[i] as usize;
+        let mut texel = palette[p];
+        if p == 255 {
+            let replacement = if i > width && data[i - width] != 255 {
+                data[i - width] as usize
+            } else if i < s - width && data[i + width] != 255 {
+                data[i + width] as usize
+            } else if i > 0 && data[i - 1] != 255 {
+                data[i - 1] as usize
+            } else if i < s - 1 && data[i + 1] != 255 {
+                data[i + 1] as usize
+            } else {
+                0
+            };
+            // copy rgb components, keep the transparent alpha
+            texel = (texel & 0xFF00_0000) | (palette[replacement] & 0x00FF_FFFF);
         }
-        inp = inp.offset(w); // skip a row
+        trans.push(texel);
     }
+    trans
 }
 
-// ============================================================
-// vk_upload32 — Returns has_alpha (qboolean as i32)
-// ============================================================
+/// Apply the gamma or intensity+gamma table to the RGB bytes of `texels`
+/// texels spaced `inc` bytes apart.
+fn light_scale_texels(data: &mut [u8], texels: usize, inc: usize, table: &[u8; 256]) {
+    for t in data.chunks_mut(inc).take(texels) {
+        t[0] = table[t[0] as usize];
+        t[1] = table[t[1] as usize];
+        t[2] = table[t[2] as usize];
+    }
+}
 
-pub unsafe fn vk_upload32(
-    data: *const u32, width: i32, height: i32,
-    mipmap: bool, bpp: i32, image: *mut Image,
-) -> i32 {
-    let mut scaled_width = 1i32;
-    while scaled_width < width { scaled_width <<= 1; }
-    if crate::vk_rmain::VK_PICMIP.value != 0.0 && scaled_width > width && mipmap { scaled_width >>= 1; }
+/// Build the upload levels of `width` x `height` RGBA texels (`rgba` holds
+/// 4 bytes per texel). `light_scale` applies intensity and gamma, or gamma
+/// alone for textures without mips.
+pub fn prepare_upload32(
+    rgba: &[u8], width: i32, height: i32,
+    mipmap: bool, bpp: i32, light_scale: bool, params: &UploadParams,
+) -> UploadLevels {
+    let (scaled_width, scaled_height) = upload_size(width, height, mipmap, params.picmip);
+    let rgba = &rgba[..(width * height) as usize * 4];
 
-    let mut scaled_height = 1i32;
-    while scaled_height < height { scaled_height <<= 1; }
-    if crate::vk_rmain::VK_PICMIP.value != 0.0 && scaled_height > height && mipmap { scaled_height >>= 1; }
+    // scan for non-255 alpha
+    let has_alpha = bpp != 24 && crate::vk_image_simd::has_alpha(rgba, params.level);
 
-    if mipmap {
-        scaled_width >>= crate::vk_rmain::VK_PICMIP.value as i32;
-        scaled_height >>= crate::vk_rmain::VK_PICMIP.value as i32;
+    if scaled_width == width && scaled_height == height && !mipmap {
+        return UploadLevels { width, height, levels: LevelStore::Owned(vec![rgba.to_vec()]), has_alpha, direct: true };
     }
 
-    // clamp
-    if scaled_width > 2048 { scaled_width = 2048; }
-    if scaled_width < 1 { scaled_width = 1; }
-    if scaled_height > 2048 { scaled_height = 2048; }
-    if scaled_height < 1 { scaled_height = 1; }
+    let (sw, sh) = (scaled_width as usize, scaled_height as usize);
+    let mut scaled = vec![0u32; sw * sh];
+    if sw == width as usize && sh == height as usize {
+        for (d, s) in scaled.iter_mut().zip(rgba.chunks_exact(4)) {
+            *d = u32::from_le_bytes([s[0], s[1], s[2], s[3]]);
+        }
+    } else {
+        let src: std::borrow::Cow<[u32]> = if rgba.as_ptr().align_offset(4) == 0 {
+            // SAFETY: aligned, and any 4 bytes form a valid u32.
+            std::borrow::Cow::Borrowed(unsafe { std::slice::from_raw_parts(rgba.as_ptr() as *const u32, rgba.len() / 4) })
+        } else {
+            std::borrow::Cow::Owned(rgba.chunks_exact(4).map(|s| u32::from_le_bytes([s[0], s[1], s[2], s[3]])).collect())
+        };
+        crate::vk_image_simd::resample_rgba(&src, width as usize, height as usize, &mut scaled, sw, sh, params.level);
+    }
+    // SAFETY: viewing u32 texels as their bytes.
+    let bytes = unsafe { std::slice::from_raw_parts_mut(scaled.as_mut_ptr() as *mut u8, scaled.len() * 4) };
 
-    // scan for non-255 alpha
-    let mut samples = vk_solid_format;
-    if bpp != 24 {
-        let c = (width * height) as usize;
-        let scan = (data as *const u8).offset(3);
-        for i in 0..c {
-            if *scan.add(i * 4) != 255 {
-                samples = vk_alpha_format;
-                break;
-            }
+    if light_scale {
+        let inc = if bpp == 24 { 3 } else { 4 };
+        let table = if mipmap { &params.intensity_gamma } else { &params.gamma };
+        light_scale_texels(bytes, sw * sh, inc, table);
+    }
+
+    let mut levels = vec![bytes.to_vec()];
+    if mipmap && !params.hw_mipmap {
+        let (mut w, mut h) = (sw, sh);
+        while w > 1 || h > 1 {
+            crate::vk_image_simd::mipmap_rgba(bytes, w, h, params.level);
+            w = (w >> 1).max(1);
+            h = (h >> 1).max(1);
+            levels.push(bytes[..w * h * 4].to_vec());
         }
     }
 
-    let comp = if samples == vk_solid_format { vk_tex_solid_format_val } else { vk_tex_alpha_format_val };
+    UploadLevels { width: scaled_width, height: scaled_height, levels: LevelStore::Owned(levels), has_alpha, direct: false }
+}
 
-    let mut scaled: *mut u32;
-    let mut scaled_needs_free = false;
+// ============================================================
+// vk_upload_levels — the GPU half of vk_upload32; returns has_alpha
+// ============================================================
 
-    if scaled_width == width && scaled_height == height {
-        if !mipmap {
-            qvk_tex_image2d(VK_TEXTURE_2D, 0, comp, scaled_width, scaled_height, 0, VK_RGBA as u32, VK_UNSIGNED_BYTE, data as *const u8);
+pub unsafe fn vk_upload_levels(up: &UploadLevels, mipmap: bool) -> i32 {
+    let comp = if up.has_alpha { vk_tex_alpha_format_val } else { vk_tex_solid_format_val };
 
-            upload_width = scaled_width;
-            upload_height = scaled_height;
-            qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MIN_FILTER, vk_filter_max as f32);
-            qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MAG_FILTER, vk_filter_max as f32);
-            return if samples == vk_alpha_format { 1 } else { 0 };
-        }
-        scaled = data as *mut u32;
-    } else {
-        let layout = std::alloc::Layout::from_size_align((scaled_width * scaled_height * 4) as usize, 4).unwrap();
-        scaled = std::alloc::alloc_zeroed(layout) as *mut u32;
-        scaled_needs_free = true;
-        vk_resample_texture(data, width, height, scaled, scaled_width, scaled_height);
-    }
+    upload_width = up.width;
+    upload_height = up.height;
 
-    if !image.is_null() && (*image).r#type != ImageType::Pic {
-        let name_str = {
-            let img_ref = &*image;
-            let len = img_ref.name.iter().position(|&b| b == 0).unwrap_or(MAX_QPATH);
-            std::str::from_utf8(&img_ref.name[..len]).unwrap_or("")
-        };
-        if !name_str.contains("fx/caustic") {
-            vk_light_scale_texture(scaled as *mut u8, scaled_width, scaled_height, !mipmap, bpp);
-        }
+    if up.direct {
+        qvk_tex_image2d(VK_TEXTURE_2D, 0, comp, up.width, up.height, 0, VK_RGBA as u32, VK_UNSIGNED_BYTE, up.levels[0].as_ptr());
+        qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MIN_FILTER, vk_filter_max as f32);
+        qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MAG_FILTER, vk_filter_max as f32);
+        return up.has_alpha as i32;
     }
 
     if vk_config.sgismipmap != 0 {
@@ -587,35 +648,32 @@ pub unsafe fn vk_upload32(
         qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
     }
 
-    qvk_tex_image2d(VK_TEXTURE_2D, 0, comp, scaled_width, scaled_height, 0, VK_RGBA as u32, VK_UNSIGNED_BYTE, scaled as *const u8);
-
-    if mipmap && vk_config.sgismipmap == 0 {
-        let mut miplevel = 0i32;
-        let mut sw = scaled_width;
-        let mut sh = scaled_height;
-        while sw > 1 || sh > 1 {
-            vk_mip_map(scaled as *mut u8, sw, sh);
-            sw >>= 1;
-            sh >>= 1;
-            if sw < 1 { sw = 1; }
-            if sh < 1 { sh = 1; }
-            miplevel += 1;
-            qvk_tex_image2d(VK_TEXTURE_2D, miplevel, comp, sw, sh, 0, VK_RGBA as u32, VK_UNSIGNED_BYTE, scaled as *const u8);
-        }
+    let (mut sw, mut sh) = (up.width, up.height);
+    for (miplevel, texels) in up.levels.iter().enumerate() {
+        qvk_tex_image2d(VK_TEXTURE_2D, miplevel as i32, comp, sw, sh, 0, VK_RGBA as u32, VK_UNSIGNED_BYTE, texels.as_ptr());
+        sw = (sw >> 1).max(1);
+        sh = (sh >> 1).max(1);
     }
 
-    upload_width = scaled_width;
-    upload_height = scaled_height;
-
     qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MIN_FILTER, if mipmap { vk_filter_min as f32 } else { vk_filter_max as f32 });
     qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MAG_FILTER, vk_filter_max as f32);
 
-    if scaled_needs_free {
-        let layout = std::alloc::Layout::from_size_align((scaled_width * scaled_height * 4) as usize, 4).unwrap();
-        std::alloc::dealloc(scaled as *mut u8, layout);
-    }
+    up.has_alpha as i32
+}
+
+// ============================================================
+// vk_upload32 — Returns has_alpha (qboolean as i32)
+// ============================================================
 
-    if samples == vk_alpha_format { 1 } else { 0 }
+pub unsafe fn vk_upload32(
+    data: *const u32, width: i32, height: i32,
+    mipmap: bool, bpp: i32, image: *mut Image,
+) -> i32 {
+    let light_scale = !image.is_null() && (*image).r#type != ImageType::Pic
+        && !get_image_name(image).contains("fx/caustic");
+    let rgba = std::slice::from_raw_parts(data as *const u8, (width * height) as usize * 4);
+    let up = prepare_upload32(rgba, width, height, mipmap, bpp, light_scale, &UploadParams::current());
+    vk_upload_levels(&up, mipmap)
 }
 
 // ============================================================
@@ -626,39 +684,9 @@ pub unsafe fn vk_upload8(
     data: *const u8, width: i32, height: i32,
     mipmap: bool, image: *mut Image,
 ) -> i32 {
-    let s = (width * height) as usize;
-    let layout = std::alloc::Layout::from_size_align(s * 4, 4).unwrap();
-    let trans = std::alloc::alloc_zeroed(layout) as *mut u32;
-
-    for i in 0..s {
-        let p = *data.add(i) as usize;
-        *trans.add(i) = d_8to24table[p];
-
-        if p == 255 {
-            // transparent — scan around for another color to avoid alpha fringes
-            let replacement = if i > width as usize && *data.add(i - width as usize) != 255 {
-                *data.add(i - width as usize) as usize
-            } else if i < s - width as usize && *data.add(i + width as usize) != 255 {
-                *data.add(i + width as usize) as usize
-            } else if i > 0 && *data.add(i - 1) != 255 {
-                *data.add(i - 1) as usize
-            } else if i < s - 1 && *data.add(i + 1) != 255 {
-                *data.add(i + 1) as usize
-            } else {
-                0
-            };
-            // copy rgb components
-            let src = &d_8to24table[replacement] as *const u32 as *const u8;
-            let dst = trans.add(i) as *mut u8;
-            *dst.offset(0) = *src.offset(0);
-            *dst.offset(1) = *src.offset(1);
-            *dst.offset(2) = *src.offset(2);
-        }
-    }
-
-    let result = vk_upload32(trans, width, height, mipmap, 8, image);
-    std::alloc::dealloc(trans as *mut u8, layout);
-    result
+    let pixels = std::slice::from_raw_parts(data, (width * height) as usize);
+    let trans = expand_paletted(pixels, width, height, &d_8to24table);
+    vk_upload32(trans.as_ptr(), width, height, mipmap, 8, image)
 }
 
 // ============================================================
@@ -684,6 +712,22 @@ pub unsafe fn vk_load_pic(
     name: &str, pic: *const u8,
     width: i32, height: i32,
     img_type: ImageType, bits: i32,
+) -> *mut Image {
+    vk_load_pic_levels(name, pic, width, height, img_type, bits, None)
+}
+
+/// Upload a texture prepared by prepare_texture.
+pub unsafe fn vk_load_prepared(tex: &PreparedTexture) -> *mut Image {
+    let t = &tex.texture;
+    vk_load_pic_levels(&t.name, t.pixels.as_ptr(), t.width, t.height, t.img_type, t.bits, tex.upload.as_ref())
+}
+
+/// vk_load_pic, optionally with the upload levels already built.
+unsafe fn vk_load_pic_levels(
+    name: &str, pic: *const u8,
+    width: i32, height: i32,
+    img_type: ImageType, bits: i32,
+    prepared: Option<&UploadLevels>,
 ) -> *mut Image {
     // find a free image_t
     let mut i = 0i32;
@@ -698,6 +742,7 @@ pub unsafe fn vk_load_pic(
             com_error(ERR_DROP, "MAX_GLTEXTURES");
         }
         numgltextures += 1;
+        gltextures.reserve_slots(numgltextures as usize);
     }
     let image = &mut gltextures[i as usize] as *mut Image;
 
@@ -705,14 +750,14 @@ pub unsafe fn vk_load_pic(
         com_error(ERR_DROP, &format!("Draw_LoadPic: \"{}\" is too long", name));
     }
     set_image_name(image, name);
+    IMAGE_INDEX.insert(name, i as usize);
     (*image).registration_sequence = registration_sequence();
     (*image).width = width;
     (*image).height = height;
     (*image).r#type = img_type;
 
     // load little pics into the scrap
-    if (*image).r#type == ImageType::Pic && (*image).width < 64 && (*image).height < 64
-        && bits == 8 {
+    if is_scrap_candidate(img_type, width, height, bits) {
             let mut x = 0i32;
             let mut y = 0i32;
             let texnum = scrap_alloc_block((*image).width, (*image).height, &mut x, &mut y);
@@ -740,9 +785,11 @@ pub unsafe fn vk_load_pic(
     (*image).texnum = TEXNUM_IMAGES + i;
     vk_bind((*image).texnum);
 
-    let mipmap = (*image).r#type != ImageType::Pic && (*image).r#type != ImageType::Sky;
+    let mipmap = is_mipmapped(img_type);
 
-    if bits == 8 {
+    if let Some(up) = prepared {
+        (*image).has_alpha = vk_upload_levels(up, mipmap);
+    } else if bits == 8 {
         (*image).has_alpha = vk_upload8(pic, width, height, mipmap, image);
     } else {
         (*image).has_alpha = vk_upload32(pic as *const u32, width, height, mipmap, bits, image);
@@ -843,12 +890,9 @@ pub unsafe fn vk_find_image_impl(name: &str, img_type: ImageType) -> *mut Image
     }
 
     // look for it
-    for i in 0..numgltextures as usize {
-        let img_name = get_image_name(&gltextures[i]);
-        if img_name == name {
-            gltextures[i].registration_sequence = registration_sequence();
-            return &mut gltextures[i] as *mut Image;
-        }
+    let image = vk_find_cached_image(name);
+    if !image.is_null() {
+        return image;
     }
 
     // load the pic from disk
@@ -863,37 +907,13 @@ pub unsafe fn vk_find_image_impl(name: &str, img_type: ImageType) -> *mut Image
         return std::ptr::null_mut();
     } else if ext.eq_ignore_ascii_case(".wal") {
         return vk_load_wal(name);
-    } else if ext.eq_ignore_ascii_case(".tga") {
-        if let Some(raw) = myq2_common::files::fs_load_file(name) {
-            if let Some((pixels, w, h)) = load_tga(&raw) {
-                return vk_load_pic(name, pixels.as_ptr(), w as i32, h as i32, img_type, 32);
-            }
-        }
-        return std::ptr::null_mut();
-    } else if ext.eq_ignore_ascii_case(".png") {
-        if let Some(raw) = myq2_common::files::fs_load_file(name) {
-            if let Some((pixels, w, h)) = load_png(&raw) {
-                return vk_load_pic(name, pixels.as_ptr(), w as i32, h as i32, img_type, 32);
-            }
-        }
-        return std::ptr::null_mut();
-    } else if ext.eq_ignore_ascii_case(".jpg") {
-        if let Some(raw) = myq2_common::files::fs_load_file(name) {
-            if let Some((pixels, w, h)) = load_jpg(&raw) {
-                return vk_load_pic(name, pixels.as_ptr(), w as i32, h as i32, img_type, 32);
-            }
-        }
-        return std::ptr::null_mut();
-    }
-
-    // Try .jpeg extension (5 chars)
-    if len >= 6 && name[len - 5..].eq_ignore_ascii_case(".jpeg") {
-        if let Some(raw) = myq2_common::files::fs_load_file(name) {
-            if let Some((pixels, w, h)) = load_jpg(&raw) {
-                return vk_load_pic(name, pixels.as_ptr(), w as i32, h as i32, img_type, 32);
-            }
-        }
-        return std::ptr::null_mut();
+    } else if is_true_colour(name) {
+        // TGA/PNG/JPG go through the texture cache when vk_texcache is set
+        let cache = crate::vk_texcache::TexCache::current();
+        return match decode_and_prepare(name, img_type, &UploadParams::current(), cache.as_ref()) {
+            Some(prepared) => vk_load_prepared(&prepared),
+            None => std::ptr::null_mut(),
+        };
     }
 
     std::ptr::null_mut()
@@ -906,12 +926,19 @@ pub unsafe fn vk_find_image_impl(name: &str, img_type: ImageType) -> *mut Image
 /// Find a 2D picture by name.
 /// If name doesn't start with '/' or '\', prepends "pics/" and appends ".pcx".
 pub unsafe fn draw_find_pic(name: &str) -> *mut Image {
-    if !name.starts_with('/') && !name.starts_with('\\') {
+    let cache = PIC_CACHE.get_or_insert_with(HashMap::new);
+    if let Some(&image) = cache.get(name) {
+        return image;
+    }
+
+    let image = if !name.starts_with('/') && !name.starts_with('\\') {
         let fullname = format!("pics/{}.pcx", name);
         vk_find_image(&fullname, ImageType::Pic)
     } else {
         vk_find_image(&name[1..], ImageType::Pic)
-    }
+    };
+    cache.insert(name.into(), image);
+    image
 }
 
 // ============================================================
@@ -946,8 +973,10 @@ pub unsafe fn vk_free_unused_images_impl() {
         }
         // free it
         qvk_delete_textures(1, &gltextures[i].texnum);
+        IMAGE_INDEX.remove(get_image_name(&gltextures[i]), i);
         gltextures[i] = Image::default();
     }
+    PIC_CACHE = None;
 }
 
 // ============================================================
@@ -1026,8 +1055,10 @@ pub unsafe fn vk_shutdown_images() {
         }
         // free it
         qvk_delete_textures(1, &gltextures[i].texnum);
+        IMAGE_INDEX.remove(get_image_name(&gltextures[i]), i);
         gltextures[i] = Image::default();
     }
+    PIC_CACHE = None;
 }
 
 // ============================================================
@@ -1071,16 +1102,24 @@ pub struct DecodedTexture {
 ///
 /// Returns None if the texture cannot be loaded or decoded.
 fn decode_single_texture(name: &str, img_type: ImageType) -> Option<DecodedTexture> {
+    if name.len() < 5 {
+        return None;
+    }
+    let raw = myq2_common::files::fs_load_file(name)?;
+    decode_texture_bytes(name, &raw, img_type)
+}
+
+/// Decode a texture file already in memory; the format comes from `name`.
+fn decode_texture_bytes(name: &str, raw: &[u8], img_type: ImageType) -> Option<DecodedTexture> {
     let len = name.len();
     if len < 5 {
         return None;
     }
 
     let ext = &name[len - 4..];
-    let raw = myq2_common::files::fs_load_file(name)?;
 
     if ext.eq_ignore_ascii_case(".pcx") {
-        let (pixels, w, h, _palette) = load_pcx(&raw)?;
+        let (pixels, w, h, _palette) = load_pcx(raw)?;
         Some(DecodedTexture {
             name: name.to_string(),
             pixels,
@@ -1111,7 +1150,7 @@ fn decode_single_texture(name: &str, img_type: ImageType) -> Option<DecodedTextu
             bits: 8,
         })
     } else if ext.eq_ignore_ascii_case(".tga") {
-        let (pixels, w, h) = load_tga(&raw)?;
+        let (pixels, w, h) = load_tga(raw)?;
         Some(DecodedTexture {
             name: name.to_string(),
             pixels,
@@ -1121,7 +1160,7 @@ fn decode_single_texture(name: &str, img_type: ImageType) -> Option<DecodedTextu
             bits: 32,
         })
     } else if ext.eq_ignore_ascii_case(".png") {
-        let (pixels, w, h) = load_png(&raw)?;
+        let (pixels, w, h) = load_png(raw)?;
         Some(DecodedTexture {
             name: name.to_string(),
             pixels,
@@ -1131,7 +1170,7 @@ fn decode_single_texture(name: &str, img_type: ImageType) -> Option<DecodedTextu
             bits: 32,
         })
     } else if ext.eq_ignore_ascii_case(".jpg") || (len >= 6 && name[len - 5..].eq_ignore_ascii_case(".jpeg")) {
-        let (pixels, w, h) = load_jpg(&raw)?;
+        let (pixels, w, h) = load_jpg(raw)?;
         Some(DecodedTexture {
             name: name.to_string(),
             pixels,
@@ -1184,6 +1223,108 @@ pub fn decode_textures_ordered(
         .collect()
 }
 
+/// A decoded texture whose upload levels were built off the main thread.
+pub struct PreparedTexture {
+    /// Texels are kept only for scrap candidates (upload is None).
+    pub texture: DecodedTexture,
+    pub upload: Option<UploadLevels>,
+}
+
+/// Whether vk_load_pic tries to place the image in the scrap.
+fn is_scrap_candidate(img_type: ImageType, width: i32, height: i32, bits: i32) -> bool {
+    img_type == ImageType::Pic && width < 64 && height < 64 && bits == 8
+}
+
+fn is_mipmapped(img_type: ImageType) -> bool {
+    img_type != ImageType::Pic && img_type != ImageType::Sky
+}
+
+/// Whether intensity/gamma apply, as vk_upload32 and vk_upload8 decide it.
+fn is_light_scaled(name: &str, img_type: ImageType) -> bool {
+    img_type != ImageType::Pic && !name.contains("fx/caustic")
+}
+
+/// TGA/PNG/JPG textures, the ones worth keeping in the texture cache.
+fn is_true_colour(name: &str) -> bool {
+    let lower = name.to_ascii_lowercase();
+    [".tga", ".png", ".jpg", ".jpeg"].iter().any(|ext| lower.ends_with(ext))
+}
+
+/// Expand, resample, light scale and mipmap a decoded texture (thread-safe,
+/// no GPU access). Scrap candidates are left as 8-bit texels.
+pub fn prepare_texture(mut texture: DecodedTexture, params: &UploadParams) -> PreparedTexture {
+    let t = &texture;
+    if is_scrap_candidate(t.img_type, t.width, t.height, t.bits) {
+        return PreparedTexture { texture, upload: None };
+    }
+    let mipmap = is_mipmapped(t.img_type);
+    let light_scale = is_light_scaled(&t.name, t.img_type);
+    let upload = if t.bits == 8 {
+        let rgba: Vec<u8> = expand_paletted(&t.pixels, t.width, t.height, &params.palette)
+            .iter()
+            .flat_map(|texel| texel.to_le_bytes())
+            .collect();
+        prepare_upload32(&rgba, t.width, t.height, mipmap, 8, light_scale, params)
+    } else {
+        prepare_upload32(&t.pixels, t.width, t.height, mipmap, t.bits, light_scale, params)
+    };
+    texture.pixels = Vec::new();
+    PreparedTexture { texture, upload: Some(upload) }
+}
+
+/// Decode and prepare textures on the worker pool, preserving input order
+/// (None for textures that failed to load).
+pub fn decode_and_prepare_textures(
+    names: &[String],
+    img_type: ImageType,
+    params: &UploadParams,
+) -> Vec<Option<PreparedTexture>> {
+    let cache = crate::vk_texcache::TexCache::current();
+    names.par_iter()
+        .map(|name| decode_and_prepare(name, img_type, params, cache.as_ref()))
+        .collect()
+}
+
+/// Decode and prepare one texture. True-colour textures are first looked up
+/// in `cache`, and stored there after a miss.
+pub fn decode_and_prepare(
+    name: &str,
+    img_type: ImageType,
+    params: &UploadParams,
+    cache: Option<&crate::vk_texcache::TexCache>,
+) -> Option<PreparedTexture> {
+    let cached = cache.filter(|_| is_true_colour(name)).and_then(|cache| {
+        let stamp = myq2_common::files::fs_file_stamp(name)?;
+        let key = crate::vk_texcache::cache_key(
+            name, &stamp, params, is_mipmapped(img_type), is_light_scaled(name, img_type),
+        );
+        Some((cache, key))
+    });
+
+    if let Some((cache, key)) = cached {
+        if let Some(hit) = cache.load(name, key) {
+            let texture = DecodedTexture {
+                name: name.to_string(),
+                pixels: Vec::new(),
+                width: hit.src_width,
+                height: hit.src_height,
+                img_type,
+                bits: 32,
+            };
+            return Some(PreparedTexture { texture, upload: Some(hit.upload) });
+        }
+    }
+
+    let texture = decode_single_texture(name, img_type)?;
+    let (width, height) = (texture.width, texture.height);
+    let prepared = prepare_texture(texture, params);
+    if let (Some((cache, key)), Some(up)) = (cached, prepared.upload.as_ref()) {
+        // a failed store only costs the next load a decode
+        let _ = cache.store(name, key, width, height, up);
+    }
+    Some(prepared)
+}
+
 /// Upload previously decoded textures to the GPU (must be called from main thread).
 ///
 /// This function takes the results of parallel CPU decoding and uploads them
@@ -1228,11 +1369,11 @@ pub unsafe fn upload_decoded_textures(textures: Vec<DecodedTexture>) -> Vec<*mut
 /// # Returns
 /// Pointers to loaded Image structs (null for failed loads).
 pub unsafe fn load_textures(names: &[String], img_type: ImageType) -> Vec<*mut Image> {
-    // Phase 1: Parallel CPU decoding (file I/O + format decoding)
-    let decoded = decode_textures(names, img_type);
+    // Phase 1: Parallel CPU decoding and upload preparation
+    let prepared = decode_and_prepare_textures(names, img_type, &UploadParams::current());
 
     // Phase 2: Sequential GPU upload (OpenGL must be on main thread)
-    upload_decoded_textures(decoded)
+    prepared.iter().flatten().map(|tex| vk_load_prepared(tex)).collect()
 }
 
 /// Check if a texture is already in the cache.
@@ -1246,22 +1387,20 @@ pub unsafe fn vk_find_cached_image(name: &str) -> *mut Image {
         return std::ptr::null_mut();
     }
 
-    for i in 0..numgltextures as usize {
-        let img_name = get_image_name(&gltextures[i]);
-        if img_name == name {
+    match IMAGE_INDEX.get(name) {
+        Some(i) if get_image_name(&gltextures[i]) == name => {
             gltextures[i].registration_sequence = registration_sequence();
-            return &mut gltextures[i] as *mut Image;
+            &mut gltextures[i] as *mut Image
         }
+        _ => std::ptr::null_mut(),
     }
-
-    std::ptr::null_mut()
 }
 
 /// Batch load textures with cache check.
 ///
 /// This is the optimal function for loading multiple textures during map load:
 /// 1. First checks cache for already-loaded textures (sequential)
-/// 2. Parallel decodes textures not in cache
+/// 2. Parallel decodes and prepares (resample, light scale, mipmap) textures not in cache
 /// 3. Sequential GPU upload
 ///
 /// # Safety
@@ -1294,22 +1433,14 @@ pub unsafe fn vk_batch_load_textures(
         return results;
     }
 
-    // Phase 2: Parallel decode uncached textures
+    // Phase 2: Parallel decode, resample and mipmap of uncached textures
     let names_to_load: Vec<String> = to_load.iter().map(|(_, n)| (*n).clone()).collect();
-    let decoded = decode_textures_ordered(&names_to_load, img_type);
+    let prepared = decode_and_prepare_textures(&names_to_load, img_type, &UploadParams::current());
 
     // Phase 3: Sequential GPU upload and assign to results
-    for ((idx, _), decoded_opt) in to_load.into_iter().zip(decoded.into_iter()) {
-        if let Some(tex) = decoded_opt {
-            let img_ptr = vk_load_pic(
-                &tex.name,
-                tex.pixels.as_ptr(),
-                tex.width,
-                tex.height,
-                tex.img_type,
-                tex.bits,
-            );
-            results[idx] = img_ptr;
+    for ((idx, _), prepared_opt) in to_load.into_iter().zip(prepared.iter()) {
+        if let Some(tex) = prepared_opt {
+            results[idx] = vk_load_prepared(tex);
         }
     }
 
@@ -1605,4 +1736,170 @@ mod tests {
         assert_eq!(dt.pixels.len(), 128 * 128 * 4);
         assert_eq!(dt.bits, 32);
     }
+
+    // ============================================================
+    // Upload preparation
+    // ============================================================
+
+    fn test_params(level: SimdLevel) -> UploadParams {
+        UploadParams {
+            picmip: 0,
+            gamma: std::array::from_fn(|i| i as u8),
+            intensity_gamma: std::array::from_fn(|i| (i * 2).min(255) as u8),
+            palette: std::array::from_fn(|i| make_palette_entry(i as u8, (i / 2) as u8, 255 - i as u8, if i == 255 { 0 } else { 255 })),
+            hw_mipmap: false,
+            level,
+        }
+    }
+
+    fn noise_rgba(texels: usize, seed: u32, opaque: bool) -> Vec<u8> {
+        let mut x = seed;
+        let mut out = Vec::with_capacity(texels * 4);
+        for _ in 0..texels {
+            x = x.wrapping_mul(1664525).wrapping_add(1013904223);
+            let b = x.to_le_bytes();
+            out.extend_from_slice(&[b[1], b[2], b[3], if opaque { 255 } else { b[0] }]);
+        }
+        out
+    }
+
+    #[test]
+    fn test_upload_size_rules() {
+        assert_eq!(upload_size(64, 64, true, 0), (64, 64));
+        assert_eq!(upload_size(100, 30, true, 0), (128, 32));
+        assert_eq!(upload_size(100, 30, true, 1), (32, 8));
+        assert_eq!(upload_size(128, 64, true, 1), (64, 32));
+        assert_eq!(upload_size(100, 30, false, 1), (128, 32));
+        assert_eq!(upload_size(4096, 1, true, 0), (2048, 1));
+    }
+
+    #[test]
+    fn test_expand_paletted_fills_transparent_rgb() {
+        let params = test_params(SimdLevel::Scalar);
+        // 3x2: the transparent texel at (1,0) borrows from the one below it
+        let data = [10u8, 255, 20, 30, 40, 50];
+        let out = expand_paletted(&data, 3, 2, &params.palette);
+        assert_eq!(out[0], params.palette[10]);
+        assert_eq!(out[1] & 0x00FF_FFFF, params.palette[40] & 0x00FF_FFFF);
+        assert_eq!(out[1] >> 24, 0);
+        // fully transparent image falls back to colour 0
+        let out = expand_paletted(&[255u8; 4], 2, 2, &params.palette);
+        assert!(out.iter().all(|&t| t == params.palette[0] & 0x00FF_FFFF));
+    }
+
+    #[test]
+    fn test_prepare_direct_upload_is_untouched() {
+        let rgba = noise_rgba(32 * 16, 3, false);
+        let up = prepare_upload32(&rgba, 32, 16, false, 32, true, &test_params(SimdLevel::Scalar));
+        assert!(up.direct && up.has_alpha);
+        assert_eq!(up.levels, LevelStore::Owned(vec![rgba]));
+    }
+
+    #[test]
+    fn test_prepare_builds_full_mip_chain() {
+        let rgba = noise_rgba(100 * 30, 5, true);
+        let up = prepare_upload32(&rgba, 100, 30, true, 32, true, &test_params(SimdLevel::Scalar));
+        assert!(!up.direct && !up.has_alpha);
+        assert_eq!((up.width, up.height), (128, 32));
+        assert_eq!(up.levels.len() as i32, mipmap_level_count(128, 32));
+        let (mut w, mut h) = (128usize, 32usize);
+        for level in up.levels.iter() {
+            assert_eq!(level.len(), w * h * 4);
+            w = (w >> 1).max(1);
+            h = (h >> 1).max(1);
+        }
+
+        let mut hw = test_params(SimdLevel::Scalar);
+        hw.hw_mipmap = true;
+        assert_eq!(prepare_upload32(&rgba, 100, 30, true, 32, true, &hw).levels.len(), 1);
+    }
+
+    #[test]
+    fn test_prepare_light_scale_tables() {
+        let rgba = [100u8, 150, 200, 255].repeat(4);
+        let mip = prepare_upload32(&rgba, 2, 2, true, 32, true, &test_params(SimdLevel::Scalar));
+        assert_eq!(&mip.levels[0][..4], &[200, 255, 255, 255]);
+        // not mipmapped, but resampled: gamma only (identity here)
+        let pic = prepare_upload32(&[100u8, 150, 200, 255].repeat(6), 2, 3, false, 32, true, &test_params(SimdLevel::Scalar));
+        assert_eq!(&pic.levels[0][..4], &[100, 150, 200, 255]);
+        let off = prepare_upload32(&rgba, 2, 2, true, 32, false, &test_params(SimdLevel::Scalar));
+        assert_eq!(&off.levels[0][..4], &[100, 150, 200, 255]);
+    }
+
+    #[test]
+    fn test_prepare_same_across_simd_levels() {
+        for &(w, h, mipmap) in &[(64, 64, true), (100, 75, true), (17, 300, false), (256, 16, true)] {
+            let rgba = noise_rgba(w * h, (w + h) as u32, false);
+            let reference = prepare_upload32(&rgba, w as i32, h as i32, mipmap, 32, true, &test_params(SimdLevel::Scalar));
+            for level in SimdLevel::supported() {
+                let up = prepare_upload32(&rgba, w as i32, h as i32, mipmap, 32, true, &test_params(level));
+                assert_eq!(up.levels, reference.levels, "{} {}x{}", level.name(), w, h);
+                assert_eq!(up.has_alpha, reference.has_alpha);
+            }
+        }
+    }
+
+    #[test]
+    fn test_prepare_texture_leaves_scrap_pics() {
+        let params = test_params(SimdLevel::Scalar);
+        let pic = DecodedTexture { name: "pics/a.pcx".into(), pixels: vec![1; 16 * 8], width: 16, height: 8, img_type: ImageType::Pic, bits: 8 };
+        let prepared = prepare_texture(pic, &params);
+        assert!(prepared.upload.is_none());
+        assert_eq!(prepared.texture.pixels.len(), 16 * 8);
+
+        let wall = DecodedTexture { name: "textures/a.wal".into(), pixels: vec![1; 16 * 8], width: 16, height: 8, img_type: ImageType::Wall, bits: 8 };
+        let prepared = prepare_texture(wall, &params);
+        let up = prepared.upload.unwrap();
+        assert_eq!(up.levels.len(), 5);
+        assert!(prepared.texture.pixels.is_empty());
+    }
+
+    /// Usage: MYQ2_BENCH_TEXDIR=baseq2/textures/e1u1 \
+    ///        cargo test -p myq2-renderer --release bench_image_pipeline -- --ignored --nocapture
+    ///
+    /// Decodes and prepares (resample, light scale, mip chain) every
+    /// .pcx/.wal/.tga/.png/.jpg under the directory, without a GPU:
+    /// serially with the scalar kernels, serially with the SIMD kernels, and
+    /// on the worker pool with the SIMD kernels.
+    #[test]
+    #[ignore]
+    fn bench_image_pipeline() {
+        let Ok(dir) = std::env::var("MYQ2_BENCH_TEXDIR") else {
+            eprintln!("MYQ2_BENCH_TEXDIR not set; skipping");
+            return;
+        };
+        let mut files = Vec::new();
+        let mut stack = vec![std::path::PathBuf::from(dir)];
+        while let Some(d) = stack.pop() {
+            for entry in std::fs::read_dir(&d).expect("read dir").flatten() {
+                let path = entry.path();
+                if path.is_dir() {
+                    stack.push(path);
+                } else if let Ok(raw) = std::fs::read(&path) {
+                    files.push((path.to_string_lossy().replace('\\', "/"), raw));
+                }
+            }
+        }
+
+        let run = |level: SimdLevel, parallel: bool| {
+            let params = test_params(level);
+            let work = |(name, raw): &(String, Vec<u8>)| {
+                decode_texture_bytes(name, raw, ImageType::Wall)
+                    .map(|tex| prepare_texture(tex, &params))
+                    .and_then(|p| p.upload)
+                    .map_or(0, |up| up.levels.iter().map(|l| l.len() / 4).sum::<usize>())
+            };
+            let start = std::time::Instant::now();
+            let texels: usize = if parallel { files.par_iter().map(work).sum() } else { files.iter().map(work).sum() };
+            (start.elapsed().as_secs_f64() * 1000.0, texels)
+        };
+
+        let (scalar_ms, texels) = run(SimdLevel::Scalar, false);
+        let (simd_ms, _) = run(crate::simd::detect(), false);
+        let (pool_ms, _) = run(crate::simd::detect(), true);
+        println!("{} files, {} texels uploaded", files.len(), texels);
+        println!("serial scalar      {:9.1} ms", scalar_ms);
+        println!("serial {:<11} {:9.1} ms ({:.2}x)", crate::simd::detect().name(), simd_ms, scalar_ms / simd_ms);
+        println!("pool x{:<3} {:<7} {:9.1} ms ({:.2}x)", rayon::current_num_threads(), crate::simd::detect().name(), pool_ms, scalar_ms / pool_ms);
+    }
 }
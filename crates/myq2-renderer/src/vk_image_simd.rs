@@ -0,0 +1,454 @@
+// vk_image_simd.rs — Vectorized stages of vk_upload32
+//
+// Every non-scrap texture goes through a resample to power-of-two size,
+// an alpha scan and a full box-filter mip chain before upload. With
+// hi-res texture packs these dominate map load time. The kernels here
+// work on plain slices (no renderer globals), so they can run on worker
+// threads:
+//
+//   resample_rgba   4-tap point average of GL_ResampleTexture, 4 (SSE2)
+//                   or 8 (AVX2, hardware gather) output texels at a time
+//   mipmap_rgba     in-place 2x2 box filter, 4 or 8 output texels at a time
+//   has_alpha       scan for any alpha byte other than 255
+//
+// All paths use integer sums with the same rounding as the scalar
+// reference, so the output is bit-identical (verified by the tests below).
+
+use crate::simd::SimdLevel;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+// ============================================================
+// Resample
+// ============================================================
+
+/// Byte averages of four RGBA texels.
+#[inline]
+fn avg4(a: u32, b: u32, c: u32, d: u32) -> u32 {
+    let mut out = 0u32;
+    for shift in [0, 8, 16, 24] {
+        let sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+        out |= (sum >> 2) << shift;
+    }
+    out
+}
+
+/// Source column pair sampled by each output column, as in GL_ResampleTexture.
+fn resample_columns(inwidth: usize, outwidth: usize) -> (Vec<u32>, Vec<u32>) {
+    let fracstep = ((inwidth as u32).wrapping_mul(0x10000)) / outwidth as u32;
+    let mut p1 = Vec::with_capacity(outwidth);
+    let mut p2 = Vec::with_capacity(outwidth);
+    let mut frac = fracstep >> 2;
+    for _ in 0..outwidth {
+        p1.push(frac >> 16);
+        frac = frac.wrapping_add(fracstep);
+    }
+    frac = 3 * (fracstep >> 2);
+    for _ in 0..outwidth {
+        p2.push(frac >> 16);
+        frac = frac.wrapping_add(fracstep);
+    }
+    (p1, p2)
+}
+
+/// Source row sampled for output row `i` at quarter offset `q` (0.25 or 0.75).
+#[inline]
+fn resample_row(i: usize, q: f32, inheight: usize, outheight: usize) -> usize {
+    ((i as f32 + q) * inheight as f32 / outheight as f32) as usize
+}
+
+/// Resample `src` (`inwidth` x `inheight` RGBA texels) into `dst`
+/// (`outwidth` x `outheight`), averaging four source texels per output texel.
+pub fn resample_rgba(
+    src: &[u32], inwidth: usize, inheight: usize,
+    dst: &mut [u32], outwidth: usize, outheight: usize,
+    level: SimdLevel,
+) {
+    assert!(src.len() >= inwidth * inheight && dst.len() >= outwidth * outheight);
+    if outwidth == 0 || outheight == 0 {
+        return;
+    }
+    let (p1, p2) = resample_columns(inwidth, outwidth);
+    assert!(p2.last().map_or(true, |&c| (c as usize) < inwidth));
+
+    for i in 0..outheight {
+        let r1 = resample_row(i, 0.25, inheight, outheight);
+        let r2 = resample_row(i, 0.75, inheight, outheight);
+        assert!(r2 < inheight);
+        let row1 = &src[r1 * inwidth..(r1 + 1) * inwidth];
+        let row2 = &src[r2 * inwidth..(r2 + 1) * inwidth];
+        let out = &mut dst[i * outwidth..(i + 1) * outwidth];
+        match level {
+            #[cfg(target_arch = "x86_64")]
+            SimdLevel::Avx2 => unsafe { resample_row_avx2(row1, row2, &p1, &p2, out) },
+            #[cfg(target_arch = "x86_64")]
+            SimdLevel::Sse2 => unsafe { resample_row_sse2(row1, row2, &p1, &p2, out) },
+            _ => resample_row_scalar(row1, row2, &p1, &p2, out, 0),
+        }
+    }
+}
+
+fn resample_row_scalar(row1: &[u32], row2: &[u32], p1: &[u32], p2: &[u32], out: &mut [u32], start: usize) {
+    for j in start..out.len() {
+        let (a, b) = (p1[j] as usize, p2[j] as usize);
+        out[j] = avg4(row1[a], row1[b], row2[a], row2[b]);
+    }
+}
+
+/// Byte-wise (a + b + c + d) >> 2 of 4 texel vectors.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn avg4_sse2(a: __m128i, b: __m128i, c: __m128i, d: __m128i) -> __m128i {
+    let z = _mm_setzero_si128();
+    let lo = _mm_add_epi16(
+        _mm_add_epi16(_mm_unpacklo_epi8(a, z), _mm_unpacklo_epi8(b, z)),
+        _mm_add_epi16(_mm_unpacklo_epi8(c, z), _mm_unpacklo_epi8(d, z)),
+    );
+    let hi = _mm_add_epi16(
+        _mm_add_epi16(_mm_unpackhi_epi8(a, z), _mm_unpackhi_epi8(b, z)),
+        _mm_add_epi16(_mm_unpackhi_epi8(c, z), _mm_unpackhi_epi8(d, z)),
+    );
+    _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn resample_row_sse2(row1: &[u32], row2: &[u32], p1: &[u32], p2: &[u32], out: &mut [u32]) {
+    let body = out.len() & !3;
+    let mut j = 0;
+    while j < body {
+        let g = |row: &[u32], p: &[u32]| {
+            _mm_set_epi32(
+                row[p[j + 3] as usize] as i32,
+                row[p[j + 2] as usize] as i32,
+                row[p[j + 1] as usize] as i32,
+                row[p[j] as usize] as i32,
+            )
+        };
+        let v = avg4_sse2(g(row1, p1), g(row1, p2), g(row2, p1), g(row2, p2));
+        _mm_storeu_si128(out.as_mut_ptr().add(j) as *mut __m128i, v);
+        j += 4;
+    }
+    resample_row_scalar(row1, row2, p1, p2, out, body);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "avx2")]
+unsafe fn avg4_avx2(a: __m256i, b: __m256i, c: __m256i, d: __m256i) -> __m256i {
+    let z = _mm256_setzero_si256();
+    let lo = _mm256_add_epi16(
+        _mm256_add_epi16(_mm256_unpacklo_epi8(a, z), _mm256_unpacklo_epi8(b, z)),
+        _mm256_add_epi16(_mm256_unpacklo_epi8(c, z), _mm256_unpacklo_epi8(d, z)),
+    );
+    let hi = _mm256_add_epi16(
+        _mm256_add_epi16(_mm256_unpackhi_epi8(a, z), _mm256_unpackhi_epi8(b, z)),
+        _mm256_add_epi16(_mm256_unpackhi_epi8(c, z), _mm256_unpackhi_epi8(d, z)),
+    );
+    // unpack and pack both work within 128-bit lanes, so texel order is kept
+    _mm256_packus_epi16(_mm256_srli_epi16(lo, 2), _mm256_srli_epi16(hi, 2))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn resample_row_avx2(row1: &[u32], row2: &[u32], p1: &[u32], p2: &[u32], out: &mut [u32]) {
+    let body = out.len() & !7;
+    let (r1, r2) = (row1.as_ptr() as *const i32, row2.as_ptr() as *const i32);
+    let mut j = 0;
+    while j < body {
+        let i1 = _mm256_loadu_si256(p1.as_ptr().add(j) as *const __m256i);
+        let i2 = _mm256_loadu_si256(p2.as_ptr().add(j) as *const __m256i);
+        let v = avg4_avx2(
+            _mm256_i32gather_epi32::<4>(r1, i1),
+            _mm256_i32gather_epi32::<4>(r1, i2),
+            _mm256_i32gather_epi32::<4>(r2, i1),
+            _mm256_i32gather_epi32::<4>(r2, i2),
+        );
+        _mm256_storeu_si256(out.as_mut_ptr().add(j) as *mut __m256i, v);
+        j += 8;
+    }
+    resample_row_scalar(row1, row2, p1, p2, out, body);
+}
+
+// ============================================================
+// Mipmap
+// ============================================================
+
+/// Replace the `width` x `height` RGBA texels at the start of `data` with the
+/// next mip level, averaging each 2x2 block. Source coordinates are clamped,
+/// so a 1-texel-wide or -high level averages the texel pair it has.
+pub fn mipmap_rgba(data: &mut [u8], width: usize, height: usize, level: SimdLevel) {
+    assert!(data.len() >= width * height * 4);
+    if width <= 1 && height <= 1 {
+        return;
+    }
+    let ow = (width >> 1).max(1);
+    let oh = (height >> 1).max(1);
+    let p = data.as_mut_ptr();
+    let pitch = width * 4;
+    for y in 0..oh {
+        // Output row y lies at or before input row 2y, and each output texel
+        // at or before the texels it reads, so rows can be filtered in place.
+        let ra = 2 * y * pitch;
+        let rb = if height > 1 { ra + pitch } else { ra };
+        let out = y * ow * 4;
+        let start = if width > 1 {
+            match level {
+                // SAFETY: the row offsets are within `data` (asserted above).
+                #[cfg(target_arch = "x86_64")]
+                SimdLevel::Avx2 => unsafe { mip_row_avx2(p, ra, rb, out, ow) },
+                #[cfg(target_arch = "x86_64")]
+                SimdLevel::Sse2 => unsafe { mip_row_sse2(p, ra, rb, out, ow) },
+                _ => 0,
+            }
+        } else {
+            0
+        };
+        for x in start..ow {
+            let xa = 2 * x * 4;
+            let xb = if width > 1 { xa + 4 } else { xa };
+            for c in 0..4 {
+                let sum = data[ra + xa + c] as u32 + data[ra + xb + c] as u32 + data[rb + xa + c] as u32 + data[rb + xb + c] as u32;
+                data[out + x * 4 + c] = (sum >> 2) as u8;
+            }
+        }
+    }
+}
+
+/// Filter 4 output texels per step; returns the first texel left undone.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn mip_row_sse2(p: *mut u8, ra: usize, rb: usize, out: usize, ow: usize) -> usize {
+    let z = _mm_setzero_si128();
+    let body = ow & !3;
+    let mut x = 0;
+    while x < body {
+        let ld = |ofs: usize| _mm_loadu_si128(p.add(ofs) as *const __m128i);
+        let (a0, a1) = (ld(ra + x * 8), ld(ra + x * 8 + 16));
+        let (b0, b1) = (ld(rb + x * 8), ld(rb + x * 8 + 16));
+        // each 16-bit half holds 2 texels; adding its upper 64 bits gives one output
+        let pair = |a: __m128i, b: __m128i, lo: bool| {
+            let s = if lo {
+                _mm_add_epi16(_mm_unpacklo_epi8(a, z), _mm_unpacklo_epi8(b, z))
+            } else {
+                _mm_add_epi16(_mm_unpackhi_epi8(a, z), _mm_unpackhi_epi8(b, z))
+            };
+            _mm_add_epi16(s, _mm_srli_si128::<8>(s))
+        };
+        let o01 = _mm_unpacklo_epi64(pair(a0, b0, true), pair(a0, b0, false));
+        let o23 = _mm_unpacklo_epi64(pair(a1, b1, true), pair(a1, b1, false));
+        let v = _mm_packus_epi16(_mm_srli_epi16(o01, 2), _mm_srli_epi16(o23, 2));
+        _mm_storeu_si128(p.add(out + x * 4) as *mut __m128i, v);
+        x += 4;
+    }
+    body
+}
+
+/// Filter 8 output texels per step; returns the first texel left undone.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn mip_row_avx2(p: *mut u8, ra: usize, rb: usize, out: usize, ow: usize) -> usize {
+    let z = _mm256_setzero_si256();
+    let body = ow & !7;
+    let mut x = 0;
+    while x < body {
+        let ld = |ofs: usize| _mm256_loadu_si256(p.add(ofs) as *const __m256i);
+        let (a0, a1) = (ld(ra + x * 8), ld(ra + x * 8 + 32));
+        let (b0, b1) = (ld(rb + x * 8), ld(rb + x * 8 + 32));
+        let pair = |a: __m256i, b: __m256i, lo: bool| {
+            let s = if lo {
+                _mm256_add_epi16(_mm256_unpacklo_epi8(a, z), _mm256_unpacklo_epi8(b, z))
+            } else {
+                _mm256_add_epi16(_mm256_unpackhi_epi8(a, z), _mm256_unpackhi_epi8(b, z))
+            };
+            _mm256_add_epi16(s, _mm256_srli_si256::<8>(s))
+        };
+        // lanes hold outputs (0,1 | 2,3) and (4,5 | 6,7)
+        let o0 = _mm256_unpacklo_epi64(pair(a0, b0, true), pair(a0, b0, false));
+        let o1 = _mm256_unpacklo_epi64(pair(a1, b1, true), pair(a1, b1, false));
+        let v = _mm256_packus_epi16(_mm256_srli_epi16(o0, 2), _mm256_srli_epi16(o1, 2));
+        let v = _mm256_permute4x64_epi64::<0b11_01_10_00>(v);
+        _mm256_storeu_si256(p.add(out + x * 4) as *mut __m256i, v);
+        x += 8;
+    }
+    body
+}
+
+// ============================================================
+// Alpha scan
+// ============================================================
+
+/// Whether any texel of the RGBA buffer has alpha other than 255.
+pub fn has_alpha(rgba: &[u8], level: SimdLevel) -> bool {
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { has_alpha_avx2(rgba) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { has_alpha_sse2(rgba) },
+        _ => has_alpha_scalar(rgba),
+    }
+}
+
+fn has_alpha_scalar(rgba: &[u8]) -> bool {
+    rgba.chunks_exact(4).any(|t| t[3] != 255)
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn has_alpha_sse2(rgba: &[u8]) -> bool {
+    let mask = _mm_set1_epi32(0xFF00_0000u32 as i32);
+    let body = rgba.len() & !15;
+    let mut i = 0;
+    while i < body {
+        let v = _mm_and_si128(_mm_loadu_si128(rgba.as_ptr().add(i) as *const __m128i), mask);
+        if _mm_movemask_epi8(_mm_cmpeq_epi32(v, mask)) != 0xFFFF {
+            return true;
+        }
+        i += 16;
+    }
+    has_alpha_scalar(&rgba[body..])
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn has_alpha_avx2(rgba: &[u8]) -> bool {
+    let mask = _mm256_set1_epi32(0xFF00_0000u32 as i32);
+    let body = rgba.len() & !31;
+    let mut i = 0;
+    while i < body {
+        let v = _mm256_and_si256(_mm256_loadu_si256(rgba.as_ptr().add(i) as *const __m256i), mask);
+        if _mm256_movemask_epi8(_mm256_cmpeq_epi32(v, mask)) != -1 {
+            return true;
+        }
+        i += 32;
+    }
+    has_alpha_scalar(&rgba[body..])
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn noise(n: usize, seed: u32) -> Vec<u32> {
+        let mut x = seed;
+        (0..n)
+            .map(|_| {
+                x = x.wrapping_mul(1664525).wrapping_add(1013904223);
+                x ^ (x >> 13)
+            })
+            .collect()
+    }
+
+    /// The pointer-based resample vk_upload32 used before these kernels.
+    unsafe fn legacy_resample(in_data: *const u32, inwidth: i32, inheight: i32, out_data: *mut u32, outwidth: i32, outheight: i32) {
+        let fracstep = ((inwidth as u32).wrapping_mul(0x10000)) / outwidth as u32;
+        let mut p1 = vec![0u32; outwidth as usize];
+        let mut p2 = vec![0u32; outwidth as usize];
+        let mut frac = fracstep >> 2;
+        for i in 0..outwidth as usize {
+            p1[i] = 4 * (frac >> 16);
+            frac = frac.wrapping_add(fracstep);
+        }
+        frac = 3 * (fracstep >> 2);
+        for i in 0..outwidth as usize {
+            p2[i] = 4 * (frac >> 16);
+            frac = frac.wrapping_add(fracstep);
+        }
+        let mut out = out_data;
+        for i in 0..outheight {
+            let inrow = in_data.offset((inwidth as isize) * ((i as f32 + 0.25) * inheight as f32 / outheight as f32) as isize);
+            let inrow2 = in_data.offset((inwidth as isize) * ((i as f32 + 0.75) * inheight as f32 / outheight as f32) as isize);
+            for j in 0..outwidth as usize {
+                let pix1 = (inrow as *const u8).add(p1[j] as usize);
+                let pix2 = (inrow as *const u8).add(p2[j] as usize);
+                let pix3 = (inrow2 as *const u8).add(p1[j] as usize);
+                let pix4 = (inrow2 as *const u8).add(p2[j] as usize);
+                let outp = out.add(j) as *mut u8;
+                for c in 0..4 {
+                    *outp.add(c) = ((*pix1.add(c) as u32 + *pix2.add(c) as u32 + *pix3.add(c) as u32 + *pix4.add(c) as u32) >> 2) as u8;
+                }
+            }
+            out = out.offset(outwidth as isize);
+        }
+    }
+
+    /// The pointer-based mipmap vk_upload32 used before (valid for width, height >= 2).
+    unsafe fn legacy_mipmap(in_data: *mut u8, width: i32, height: i32) {
+        let w = (width << 2) as isize;
+        let mut out = in_data;
+        let mut inp = in_data;
+        for _ in 0..(height >> 1) {
+            let mut j = 0;
+            while j < w {
+                for c in 0..4 {
+                    *out.offset(c) = ((*inp.offset(c) as u32 + *inp.offset(c + 4) as u32 + *inp.offset(w + c) as u32 + *inp.offset(w + c + 4) as u32) >> 2) as u8;
+                }
+                out = out.offset(4);
+                inp = inp.offset(8);
+                j += 8;
+            }
+            inp = inp.offset(w);
+        }
+    }
+
+    #[test]
+    fn test_resample_matches_legacy_on_all_levels() {
+        let sizes = [(64, 64, 64, 64), (100, 75, 128, 128), (37, 19, 32, 16), (300, 200, 256, 256), (16, 16, 256, 8), (1, 1, 4, 4), (257, 3, 5, 9)];
+        for &(iw, ih, ow, oh) in &sizes {
+            let src = noise(iw * ih, (iw * 31 + ih) as u32);
+            let mut expect = vec![0u32; ow * oh];
+            unsafe { legacy_resample(src.as_ptr(), iw as i32, ih as i32, expect.as_mut_ptr(), ow as i32, oh as i32) };
+            for level in SimdLevel::supported() {
+                let mut out = vec![0u32; ow * oh];
+                resample_rgba(&src, iw, ih, &mut out, ow, oh, level);
+                assert_eq!(out, expect, "{} {}x{} -> {}x{}", level.name(), iw, ih, ow, oh);
+            }
+        }
+    }
+
+    #[test]
+    fn test_mipmap_matches_legacy_for_2d_levels() {
+        for &(w, h) in &[(2, 2), (4, 2), (8, 8), (16, 4), (32, 32), (64, 16), (256, 128), (6, 10)] {
+            let src: Vec<u8> = noise(w * h, (w * 7 + h) as u32).iter().flat_map(|t| t.to_le_bytes()).collect();
+            let mut expect = src.clone();
+            unsafe { legacy_mipmap(expect.as_mut_ptr(), w as i32, h as i32) };
+            let n = (w / 2) * (h / 2) * 4;
+            for level in SimdLevel::supported() {
+                let mut data = src.clone();
+                mipmap_rgba(&mut data, w, h, level);
+                assert_eq!(&data[..n], &expect[..n], "{} {}x{}", level.name(), w, h);
+            }
+        }
+    }
+
+    #[test]
+    fn test_mipmap_thin_levels_clamp() {
+        // 4x1: pairs averaged horizontally
+        for level in SimdLevel::supported() {
+            let mut data = vec![10, 20, 30, 255, 30, 40, 50, 255, 0, 0, 0, 0, 100, 100, 100, 100];
+            mipmap_rgba(&mut data, 4, 1, level);
+            assert_eq!(&data[..8], &[20, 30, 40, 255, 50, 50, 50, 50]);
+            // 1x2: the column pair averaged
+            let mut data = vec![0, 0, 0, 0, 200, 100, 50, 255];
+            mipmap_rgba(&mut data, 1, 2, level);
+            assert_eq!(&data[..4], &[100, 50, 25, 127]);
+        }
+    }
+
+    #[test]
+    fn test_has_alpha_all_paths() {
+        for n in [0usize, 1, 3, 4, 5, 8, 9, 31, 64, 67] {
+            let opaque: Vec<u8> = (0..n).flat_map(|i| [i as u8, 1, 2, 255]).collect();
+            for level in SimdLevel::supported() {
+                assert!(!has_alpha(&opaque, level), "{} n={}", level.name(), n);
+                for k in 0..n {
+                    let mut v = opaque.clone();
+                    v[k * 4 + 3] = 254;
+                    assert!(has_alpha(&v, level), "{} n={} k={}", level.name(), n, k);
+                }
+            }
+        }
+    }
+}
@@ -3,6 +3,8 @@
 
 use crate::vk_local::*;
 use crate::vk_rmain::vid_printf;
+use crate::vk_light_simd::{self as lmsimd, BlockLights, BLOCKLIGHT_TEXELS};
+use crate::vk_world_cull::{boxes_touching_sphere, BoundsSoA};
 use myq2_common::q_shared::*;
 
 // ============================================================
@@ -21,7 +23,8 @@ pub static mut pointcolor: Vec3 = [0.0; 3];
 pub static mut lightplane: *const CPlane = std::ptr::null();
 pub static mut lightspot: Vec3 = [0.0; 3];
 
-static mut S_BLOCKLIGHTS: [f32; 34 * 34 * 3] = [0.0; 34 * 34 * 3];
+/// Planar (R, G, B) block-light buffer; see vk_light_simd.rs.
+static mut S_BLOCKLIGHTS: BlockLights = BlockLights::new();
 
 static mut TEMP_STAIN: DStain = DStain {
     origin: [0.0; 3],
@@ -69,85 +72,158 @@ use myq2_common::qfiles::MAXLIGHTMAPS;
 // DYNAMIC LIGHTS — BSP marking
 // ============================================================
 
-/// Recursively mark surfaces affected by a dynamic light.
+/// Flag a surface as lit by dynamic light `bit` this frame.
+/// Returns true when the surface was not yet lit this frame.
+unsafe fn mark_surface(surf: &mut MSurface, light: &DLight, bit: i32) -> bool {
+    let first = surf.dlightframe != r_dlightframecount;
+    if DLIGHT_SURFACE_FIX {
+        let dist = dot_product(&light.origin, &(*surf.plane).normal) - (*surf.plane).dist;
+        let sidebit = if dist >= 0.0 { 0 } else { SURF_PLANEBACK };
+
+        if (surf.flags & SURF_PLANEBACK) != sidebit {
+            return false;
+        }
+
+        if first {
+            surf.dlightbits = bit;
+            surf.dlightframe = r_dlightframecount;
+        } else {
+            surf.dlightbits |= bit;
+        }
+    } else {
+        if first {
+            surf.dlightbits = 0;
+            surf.dlightframe = r_dlightframecount;
+        }
+        surf.dlightbits |= bit;
+    }
+    first
+}
+
+/// Start a new dynamic light frame.
+///
+/// Marking is deferred to r_mark_visible_dlights, once the visible surface
+/// set is known.
 ///
 /// # Safety
-/// Accesses world model surfaces and BSP node tree via raw pointers.
-pub unsafe fn r_mark_lights(light: &DLight, bit: i32, node: *mut MNode) {
-    if node.is_null() {
+/// Accesses global renderer state.
+pub unsafe fn r_push_dlights() {
+    if crate::vk_rmain::VK_DYNAMIC.value == 0.0 {
         return;
     }
-    let node_ref = &mut *node;
-
-    if node_ref.contents != -1 {
+    if crate::vk_rmain::VK_FLASHBLEND.value != 0.0 {
         return;
     }
 
-    let splitplane = &*node_ref.plane;
-    let dist = dot_product(&light.origin, &splitplane.normal) - splitplane.dist;
+    r_dlightframecount = r_framecount + 1;
+}
 
-    if dist > light.intensity - DLIGHT_CUTOFF {
-        r_mark_lights(light, bit, node_ref.children[0]);
-        return;
-    }
-    if dist < -light.intensity + DLIGHT_CUTOFF {
-        r_mark_lights(light, bit, node_ref.children[1]);
-        return;
-    }
+/// Per-frame dynamic light marking counters for r_speeds.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct DlightStats {
+    /// Lights marked.
+    pub lights: u32,
+    /// Surface/light pairs tested against the light sphere.
+    pub tested: u32,
+    /// Surfaces flagged as lit.
+    pub marked: u32,
+    /// Lit surfaces whose lightmap was rebuilt.
+    pub rebuilt: u32,
+}
 
-    // mark the polygons
-    let surfaces = r_worldmodel_surfaces();
-    for i in 0..node_ref.numsurfaces {
-        let surf = &mut *surfaces.offset((node_ref.firstsurface + i) as isize);
+pub static mut DLIGHT_STATS: DlightStats = DlightStats { lights: 0, tested: 0, marked: 0, rebuilt: 0 };
 
-        if DLIGHT_SURFACE_FIX {
-            let dist2 =
-                dot_product(&light.origin, &(*surf.plane).normal) - (*surf.plane).dist;
-            let sidebit = if dist2 >= 0.0 { 0 } else { SURF_PLANEBACK };
+/// World surface bounds, padded by a lightmap texel, built once per world.
+static mut SURFACE_BOUNDS: BoundsSoA = BoundsSoA::new();
+/// SURFACE_BOUNDS holds the current world; cleared when a world loads.
+static mut SURFACE_BOUNDS_BUILT: bool = false;
+/// This frame's visible surface bounds, in visible-list order.
+static mut VISIBLE_BOUNDS: BoundsSoA = BoundsSoA::new();
+static mut DLIGHT_TOUCHED: Vec<u32> = Vec::new();
 
-            if (surf.flags & SURF_PLANEBACK) != sidebit {
-                continue;
-            }
+/// Lightmap texels reach up to one luxel past the polygon edge.
+const SURFACE_BOUNDS_PAD: f32 = 16.0;
 
-            if surf.dlightframe != r_dlightframecount {
-                surf.dlightbits = bit;
-                surf.dlightframe = r_dlightframecount;
+/// Compute the bounds of every world surface from its edge loop.
+///
+/// # Safety
+/// Dereferences world model pointers.
+unsafe fn r_build_surface_bounds() {
+    let world = &*r_worldmodel;
+    let bounds = &mut *std::ptr::addr_of_mut!(SURFACE_BOUNDS);
+    bounds.clear();
+
+    for s in 0..world.numsurfaces as usize {
+        let surf = &*world.surfaces.add(s);
+        let mut mm = [f32::MAX, f32::MAX, f32::MAX, f32::MIN, f32::MIN, f32::MIN];
+        for i in 0..surf.numedges {
+            let e = *world.surfedges.add((surf.firstedge + i) as usize);
+            let v = if e >= 0 {
+                (*world.edges.add(e as usize)).v[0]
             } else {
-                surf.dlightbits |= bit;
+                (*world.edges.add((-e) as usize)).v[1]
+            };
+            let p = &(*world.vertexes.add(v as usize)).position;
+            for j in 0..3 {
+                mm[j] = mm[j].min(p[j] - SURFACE_BOUNDS_PAD);
+                mm[3 + j] = mm[3 + j].max(p[j] + SURFACE_BOUNDS_PAD);
             }
-        } else {
-            if surf.dlightframe != r_dlightframecount {
-                surf.dlightbits = 0;
-                surf.dlightframe = r_dlightframecount;
-            }
-            surf.dlightbits |= bit;
         }
+        bounds.push(&mm);
     }
-
-    r_mark_lights(light, bit, node_ref.children[0]);
-    r_mark_lights(light, bit, node_ref.children[1]);
 }
 
-/// Push dynamic lights into the BSP tree.
+/// Mark the dynamic lights on this frame's visible world surfaces.
+///
+/// Instead of walking the whole BSP per light, each light sphere is tested
+/// against the visible surfaces' bounds in SIMD batches, and only those
+/// within reach of the surface plane are flagged for r_build_light_map.
 ///
 /// # Safety
-/// Accesses global renderer state.
-pub unsafe fn r_push_dlights() {
-    if crate::vk_rmain::VK_DYNAMIC.value == 0.0 {
+/// Accesses global renderer state and world model pointers.
+pub unsafe fn r_mark_visible_dlights(visible: &[u32]) {
+    if crate::vk_rmain::VK_DYNAMIC.value == 0.0 || crate::vk_rmain::VK_FLASHBLEND.value != 0.0 {
         return;
     }
-    if crate::vk_rmain::VK_FLASHBLEND.value != 0.0 {
+    if r_newrefdef.num_dlights <= 0 || visible.is_empty() {
         return;
     }
 
-    r_dlightframecount = r_framecount + 1;
+    if !SURFACE_BOUNDS_BUILT {
+        r_build_surface_bounds();
+        SURFACE_BOUNDS_BUILT = true;
+    }
+
+    let all = &*std::ptr::addr_of!(SURFACE_BOUNDS);
+    let bounds = &mut *std::ptr::addr_of_mut!(VISIBLE_BOUNDS);
+    bounds.clear();
+    for &s in visible {
+        for a in 0..3 {
+            bounds.min[a].push(all.min[a][s as usize]);
+            bounds.max[a].push(all.max[a][s as usize]);
+        }
+    }
 
+    let level = crate::simd::level();
+    let touched = &mut *std::ptr::addr_of_mut!(DLIGHT_TOUCHED);
     for i in 0..r_newrefdef.num_dlights {
-        r_mark_lights(
-            r_newrefdef.dlight(i as usize),
-            1 << i,
-            r_worldmodel_nodes(),
-        );
+        let light = r_newrefdef.dlight(i as usize);
+        touched.clear();
+        boxes_touching_sphere(bounds, light.origin, light.intensity, touched, level);
+        DLIGHT_STATS.lights += 1;
+        DLIGHT_STATS.tested += visible.len() as u32;
+
+        for &j in touched.iter() {
+            let surf = &mut *surfaces.add(visible[j as usize] as usize);
+            let plane = &*surf.plane;
+            let dist = dot_product(&light.origin, &plane.normal) - plane.dist;
+            if dist.abs() > light.intensity - DLIGHT_CUTOFF {
+                continue;
+            }
+            if mark_surface(surf, light, 1 << i) {
+                DLIGHT_STATS.marked += 1;
+            }
+        }
     }
 }
 
@@ -230,42 +306,36 @@ pub unsafe fn recursive_light_point(node: *const MNode, start: &Vec3, end: &Vec3
         }
 
         if surf.samples.is_null() {
+            LIGHT_HIT = LightHit::NoSamples;
             return 0;
         }
 
         let ds = ds >> 4;
         let dt = dt >> 4;
 
-        pointcolor = [0.0; 3];
-        if !surf.samples.is_null() {
-            let mut lightmap = surf.samples;
-            let width = (surf.extents[0] as i32 >> 4) + 1;
-
-            lightmap = lightmap.offset((3 * (dt * width + ds)) as isize);
+        let mut sample = LightSample::default();
+        let mut lightmap = surf.samples;
+        let width = (surf.extents[0] as i32 >> 4) + 1;
 
-            for maps in 0..MAXLIGHTMAPS {
-                if surf.styles[maps] == 255 {
-                    break;
-                }
+        lightmap = lightmap.offset((3 * (dt * width + ds)) as isize);
 
-                let style = &r_newrefdef.lightstyle(surf.styles[maps] as usize);
-                let scale = [
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[0],
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[1],
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[2],
-                ];
-
-                pointcolor[0] += *lightmap.offset(0) as f32 * scale[0] * (1.0 / 255.0);
-                pointcolor[1] += *lightmap.offset(1) as f32 * scale[1] * (1.0 / 255.0);
-                pointcolor[2] += *lightmap.offset(2) as f32 * scale[2] * (1.0 / 255.0);
-
-                lightmap = lightmap.offset(
-                    (3 * ((surf.extents[0] as i32 >> 4) + 1)
-                        * ((surf.extents[1] as i32 >> 4) + 1)) as isize,
-                );
+        for maps in 0..MAXLIGHTMAPS {
+            if surf.styles[maps] == 255 {
+                break;
             }
+
+            sample.styles[maps] = surf.styles[maps];
+            sample.texels[maps] = [*lightmap.offset(0), *lightmap.offset(1), *lightmap.offset(2)];
+            sample.count += 1;
+
+            lightmap = lightmap.offset(
+                (3 * ((surf.extents[0] as i32 >> 4) + 1)
+                    * ((surf.extents[1] as i32 >> 4) + 1)) as isize,
+            );
         }
 
+        pointcolor = light_sample_color(&sample);
+        LIGHT_HIT = LightHit::Lit(sample);
         return 1;
     }
 
@@ -424,6 +494,149 @@ pub unsafe fn r_stain_node(st: &DStain, node: *mut MNode) {
     r_stain_node(st, node_ref.children[1]);
 }
 
+// ============================================================
+// Light point cache
+// ============================================================
+//
+// R_LightPoint traces down the BSP under every lit entity every frame, though
+// most of them (items, corpses, idle monsters) have not moved. The trace
+// result is cached per quantized origin as the raw lightmap texels and their
+// style numbers, so lightstyles are applied on every lookup and animated or
+// switched lights never go stale; dynamic lights are likewise added per call.
+// The cache belongs to the world's lightdata and is dropped when that changes.
+
+/// Origins are quantized to this many units.
+pub const LIGHT_CACHE_QUANT: f32 = 1.0;
+/// Entries kept before the cache is flushed (moving entities add a new key
+/// per frame).
+pub const LIGHT_CACHE_MAX: usize = 4096;
+
+/// Lightmap texels under a point, one per style that lights the surface.
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct LightSample {
+    pub count: u8,
+    pub styles: [u8; MAXLIGHTMAPS],
+    pub texels: [[u8; 3]; MAXLIGHTMAPS],
+}
+
+impl LightSample {
+    /// Weight the texels by their style's colour, as RecursiveLightPoint does.
+    pub fn weight(&self, modulate: f32, style_rgb: impl Fn(u8) -> [f32; 3]) -> Vec3 {
+        let mut color = [0.0; 3];
+        for maps in 0..self.count as usize {
+            let rgb = style_rgb(self.styles[maps]);
+            let scale = [modulate * rgb[0], modulate * rgb[1], modulate * rgb[2]];
+            for c in 0..3 {
+                color[c] += self.texels[maps][c] as f32 * scale[c] * (1.0 / 255.0);
+            }
+        }
+        color
+    }
+}
+
+/// Outcome of the last recursive_light_point.
+#[derive(Debug, Clone, Copy)]
+pub enum LightHit {
+    /// Nothing lightmapped below the point.
+    Miss,
+    /// Hit a surface without lightmap samples (pointcolor is left as is).
+    NoSamples,
+    Lit(LightSample),
+}
+
+static mut LIGHT_HIT: LightHit = LightHit::Miss;
+
+#[derive(Clone, Copy)]
+struct CachedLight {
+    hit: LightHit,
+    spot: Vec3,
+    plane: *const CPlane,
+}
+
+/// Per-frame light point cache statistics for r_speeds.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct LightPointStats {
+    pub hits: u32,
+    pub misses: u32,
+}
+
+pub static mut LIGHT_POINT_STATS: LightPointStats = LightPointStats { hits: 0, misses: 0 };
+
+static mut LIGHT_CACHE: Option<std::collections::HashMap<[i32; 3], CachedLight>> = None;
+static mut LIGHT_CACHE_DATA: *const u8 = std::ptr::null();
+
+/// Cache key of a point.
+pub fn light_cache_key(p: &Vec3) -> [i32; 3] {
+    [
+        (p[0] / LIGHT_CACHE_QUANT).floor() as i32,
+        (p[1] / LIGHT_CACHE_QUANT).floor() as i32,
+        (p[2] / LIGHT_CACHE_QUANT).floor() as i32,
+    ]
+}
+
+unsafe fn light_sample_color(sample: &LightSample) -> Vec3 {
+    sample.weight(crate::vk_rmain::VK_MODULATE_CVAR.value, |style| r_newrefdef.lightstyle(style as usize).rgb)
+}
+
+/// Drop the world surface bounds; they are rebuilt for the next world.
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_clear_surface_bounds() {
+    SURFACE_BOUNDS_BUILT = false;
+}
+
+/// Drop every cached light sample.
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_clear_light_cache() {
+    LIGHT_CACHE = None;
+    LIGHT_CACHE_DATA = std::ptr::null();
+}
+
+/// recursive_light_point from the world root, through the cache. Returns
+/// the static light at `p` and sets lightspot/lightplane as the trace would.
+unsafe fn cached_light_point(p: &Vec3) -> Vec3 {
+    let lightdata = r_worldmodel_lightdata() as *const u8;
+    if LIGHT_CACHE_DATA != lightdata {
+        LIGHT_CACHE = None;
+        LIGHT_CACHE_DATA = lightdata;
+    }
+    let cache = LIGHT_CACHE.get_or_insert_with(std::collections::HashMap::new);
+    let key = light_cache_key(p);
+
+    let entry = match cache.get(&key) {
+        Some(entry) => {
+            LIGHT_POINT_STATS.hits += 1;
+            lightspot = entry.spot;
+            lightplane = entry.plane;
+            *entry
+        }
+        None => {
+            LIGHT_POINT_STATS.misses += 1;
+            let end = [p[0], p[1], p[2] - 2048.0];
+            LIGHT_HIT = LightHit::Miss;
+            recursive_light_point(r_worldmodel_nodes() as *const MNode, p, &end);
+            if cache.len() >= LIGHT_CACHE_MAX {
+                cache.clear();
+            }
+            let entry = CachedLight { hit: LIGHT_HIT, spot: lightspot, plane: lightplane };
+            cache.insert(key, entry);
+            entry
+        }
+    };
+
+    match entry.hit {
+        LightHit::Miss => vec3_origin,
+        LightHit::NoSamples => pointcolor,
+        LightHit::Lit(sample) => {
+            pointcolor = light_sample_color(&sample);
+            pointcolor
+        }
+    }
+}
+
 /// Sample the lightmap at a world point, adding dynamic lights.
 ///
 /// # Safety
@@ -436,15 +649,7 @@ pub unsafe fn r_light_point(p: &Vec3, color: &mut Vec3) {
         return;
     }
 
-    let end = [p[0], p[1], p[2] - 2048.0];
-
-    let r = recursive_light_point(r_worldmodel_nodes() as *const MNode, p, &end);
-
-    if r == -1 {
-        *color = vec3_origin;
-    } else {
-        *color = pointcolor;
-    }
+    *color = cached_light_point(p);
 
     // add dynamic lights
     for lnum in 0..r_newrefdef.num_dlights {
@@ -505,50 +710,17 @@ pub unsafe fn r_add_dynamic_lights(surf: &MSurface) {
         ) + tex.vecs[1][3]
             - surf.texturemins[1] as f32;
 
-        let mut bl_idx: usize = 0;
-        let mut ftacc: f32 = 0.0;
-        for _t in 0..tmax {
-            let mut td = (local_1 - ftacc) as i32;
-            if td < 0 {
-                td = -td;
-            }
-
-            let mut fsacc: f32 = 0.0;
-            for _s in 0..smax {
-                let mut sd = (local_0 - fsacc) as i32;
-                if sd < 0 {
-                    sd = -sd;
-                }
-
-                let fdist_local = if sd > td {
-                    sd as f32 + (td >> 1) as f32
-                } else {
-                    td as f32 + (sd >> 1) as f32
-                };
-
-                if fdist_local < fminlight {
-                    if BETTER_DLIGHT_FALLOFF {
-                        S_BLOCKLIGHTS[bl_idx] +=
-                            (fminlight - fdist_local) * dl.color[0];
-                        S_BLOCKLIGHTS[bl_idx + 1] +=
-                            (fminlight - fdist_local) * dl.color[1];
-                        S_BLOCKLIGHTS[bl_idx + 2] +=
-                            (fminlight - fdist_local) * dl.color[2];
-                    } else {
-                        S_BLOCKLIGHTS[bl_idx] +=
-                            (frad_adj - fdist_local) * dl.color[0];
-                        S_BLOCKLIGHTS[bl_idx + 1] +=
-                            (frad_adj - fdist_local) * dl.color[1];
-                        S_BLOCKLIGHTS[bl_idx + 2] +=
-                            (frad_adj - fdist_local) * dl.color[2];
-                    }
-                }
-
-                fsacc += 16.0;
-                bl_idx += 3;
-            }
-            ftacc += 16.0;
-        }
+        let base = if BETTER_DLIGHT_FALLOFF { fminlight } else { frad_adj };
+        lmsimd::add_dlight(
+            &mut S_BLOCKLIGHTS,
+            smax as usize,
+            tmax as usize,
+            [local_0, local_1],
+            fminlight,
+            base,
+            dl.color,
+            crate::simd::level(),
+        );
     }
 }
 
@@ -557,26 +729,14 @@ pub unsafe fn r_add_dynamic_lights(surf: &MSurface) {
 /// # Safety
 /// Accesses global blocklights buffer and surface stain data.
 pub unsafe fn r_add_stains(surf: &MSurface) {
-    let scale = [crate::vk_rmain::VK_MODULATE_CVAR.value; 3];
+    let scale = crate::vk_rmain::VK_MODULATE_CVAR.value;
 
     let smax = (surf.extents[0] as i32 >> 4) + 1;
     let tmax = (surf.extents[1] as i32 >> 4) + 1;
+    let size = (smax * tmax) as usize;
 
-    let mut bl_idx: usize = 0;
-    let mut stain_ptr = surf.stains;
-
-    for _t in 0..tmax {
-        for _s in 0..smax {
-            for i in 0..3 {
-                let stain_val = *stain_ptr.offset(i) as f32 * scale[i as usize];
-                if S_BLOCKLIGHTS[bl_idx + i as usize] > stain_val {
-                    S_BLOCKLIGHTS[bl_idx + i as usize] = stain_val;
-                }
-            }
-            bl_idx += 3;
-            stain_ptr = stain_ptr.offset(3);
-        }
-    }
+    let stains = std::slice::from_raw_parts(surf.stains, size * 3);
+    lmsimd::apply_stains(&mut S_BLOCKLIGHTS, stains, size, scale, crate::simd::level());
 }
 
 /// Cache the current lightstyle values for a surface.
@@ -608,118 +768,20 @@ pub unsafe fn r_build_light_map(surf: &MSurface, dest: *mut u8, stride: i32) {
 
     let smax = (surf.extents[0] as i32 >> 4) + 1;
     let tmax = (surf.extents[1] as i32 >> 4) + 1;
-    let size = (smax * tmax) as usize;
 
-    if size > (std::mem::size_of_val(&S_BLOCKLIGHTS) >> 4) {
+    if !r_light_map_fits(surf) {
         vid_printf(ERR_DROP, "Bad s_blocklights size");
         return;
     }
 
-    // set to full bright if no light data
-    if surf.samples.is_null() {
-        for i in 0..(size * 3) {
-            S_BLOCKLIGHTS[i] = 255.0;
-        }
-        // still need to iterate styles for side effects
-        for maps in 0..MAXLIGHTMAPS {
-            if surf.styles[maps] == 255 {
-                break;
-            }
-            let _ = &r_newrefdef.lightstyle(surf.styles[maps] as usize);
-        }
-        // goto store equivalent — fall through to store section
-    } else {
-        // count the # of maps
-        let mut nummaps = 0;
-        for maps in 0..MAXLIGHTMAPS {
-            if surf.styles[maps] == 255 {
-                break;
-            }
-            nummaps += 1;
-        }
-
-        let mut lightmap = surf.samples;
-
-        if nummaps == 1 {
-            for maps in 0..MAXLIGHTMAPS {
-                if surf.styles[maps] == 255 {
-                    break;
-                }
-
-                let style = &r_newrefdef.lightstyle(surf.styles[maps] as usize);
-                let scale = [
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[0],
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[1],
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[2],
-                ];
-
-                if scale[0] == 1.0 && scale[1] == 1.0 && scale[2] == 1.0 {
-                    let mut bl_idx = 0;
-                    for i in 0..size {
-                        S_BLOCKLIGHTS[bl_idx] = *lightmap.add(i * 3) as f32;
-                        S_BLOCKLIGHTS[bl_idx + 1] = *lightmap.add(i * 3 + 1) as f32;
-                        S_BLOCKLIGHTS[bl_idx + 2] = *lightmap.add(i * 3 + 2) as f32;
-                        bl_idx += 3;
-                    }
-                } else {
-                    let mut bl_idx = 0;
-                    for i in 0..size {
-                        S_BLOCKLIGHTS[bl_idx] =
-                            *lightmap.add(i * 3) as f32 * scale[0];
-                        S_BLOCKLIGHTS[bl_idx + 1] =
-                            *lightmap.add(i * 3 + 1) as f32 * scale[1];
-                        S_BLOCKLIGHTS[bl_idx + 2] =
-                            *lightmap.add(i * 3 + 2) as f32 * scale[2];
-                        bl_idx += 3;
-                    }
-                }
-                lightmap = lightmap.add(size * 3);
-            }
-        } else {
-            // zero out blocklights
-            for i in 0..(size * 3) {
-                S_BLOCKLIGHTS[i] = 0.0;
-            }
-
-            for maps in 0..MAXLIGHTMAPS {
-                if surf.styles[maps] == 255 {
-                    break;
-                }
-
-                let style = &r_newrefdef.lightstyle(surf.styles[maps] as usize);
-                let scale = [
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[0],
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[1],
-                    crate::vk_rmain::VK_MODULATE_CVAR.value * style.rgb[2],
-                ];
-
-                if scale[0] == 1.0 && scale[1] == 1.0 && scale[2] == 1.0 {
-                    let mut bl_idx = 0;
-                    for i in 0..size {
-                        S_BLOCKLIGHTS[bl_idx] +=
-                            *lightmap.add(i * 3) as f32;
-                        S_BLOCKLIGHTS[bl_idx + 1] +=
-                            *lightmap.add(i * 3 + 1) as f32;
-                        S_BLOCKLIGHTS[bl_idx + 2] +=
-                            *lightmap.add(i * 3 + 2) as f32;
-                        bl_idx += 3;
-                    }
-                } else {
-                    let mut bl_idx = 0;
-                    for i in 0..size {
-                        S_BLOCKLIGHTS[bl_idx] +=
-                            *lightmap.add(i * 3) as f32 * scale[0];
-                        S_BLOCKLIGHTS[bl_idx + 1] +=
-                            *lightmap.add(i * 3 + 1) as f32 * scale[1];
-                        S_BLOCKLIGHTS[bl_idx + 2] +=
-                            *lightmap.add(i * 3 + 2) as f32 * scale[2];
-                        bl_idx += 3;
-                    }
-                }
-                lightmap = lightmap.add(size * 3);
-            }
-        }
+    let level = crate::simd::level();
+    let modulate = crate::vk_rmain::VK_MODULATE_CVAR.value;
+    let lit = r_accumulate_static_light(surf, &mut S_BLOCKLIGHTS, |style| {
+        let rgb = r_newrefdef.lightstyle(style).rgb;
+        [modulate * rgb[0], modulate * rgb[1], modulate * rgb[2]]
+    }, level);
 
+    if lit {
         // add all the dynamic lights
         if surf.dlightframe == r_framecount {
             r_add_dynamic_lights(surf);
@@ -732,70 +794,83 @@ pub unsafe fn r_build_light_map(surf: &MSurface, dest: *mut u8, stride: i32) {
             }
     }
 
-    // put into texture format (store:)
-    let stride_adj = stride - (smax << 2);
-    let mut bl_idx: usize = 0;
-    let mut dest_ptr = dest;
-
-    let monolightmap = vk_monolightmap_char();
+    r_store_light_map(&S_BLOCKLIGHTS, smax, tmax, dest, stride, vk_monolightmap_char(), level);
+}
 
-    if monolightmap == b'0' {
-        for _i in 0..tmax {
-            for _j in 0..smax {
-                let mut r = S_BLOCKLIGHTS[bl_idx] as i32;
-                let mut g = S_BLOCKLIGHTS[bl_idx + 1] as i32;
-                let mut b = S_BLOCKLIGHTS[bl_idx + 2] as i32;
+/// Whether the surface's lightmap fits the blocklights buffer: the same limit
+/// as the original interleaved float[34*34*3] buffer (sizeof >> 4).
+pub fn r_light_map_fits(surf: &MSurface) -> bool {
+    let smax = (surf.extents[0] as usize >> 4) + 1;
+    let tmax = (surf.extents[1] as usize >> 4) + 1;
+    smax * tmax <= (BLOCKLIGHT_TEXELS * 3 * std::mem::size_of::<f32>()) >> 4
+}
 
-                if r < 0 { r = 0; }
-                if g < 0 { g = 0; }
-                if b < 0 { b = 0; }
+/// The static part of R_BuildLightMap: sum the surface's light styles into
+/// `bl`, each scaled by `style_scale(style)`, or fill full bright when the
+/// surface has no light data (returns false then). Touches no globals, so map
+/// loading runs it from worker threads with their own `bl`.
+///
+/// # Safety
+/// `surf.samples` must cover every style's smax * tmax samples.
+pub unsafe fn r_accumulate_static_light(
+    surf: &MSurface,
+    bl: &mut BlockLights,
+    style_scale: impl Fn(usize) -> [f32; 3],
+    level: crate::simd::SimdLevel,
+) -> bool {
+    let smax = (surf.extents[0] as i32 >> 4) + 1;
+    let tmax = (surf.extents[1] as i32 >> 4) + 1;
+    let size = (smax * tmax) as usize;
 
-                let mut max = if r > g { r } else { g };
-                if b > max { max = b; }
+    // set to full bright if no light data
+    if surf.samples.is_null() {
+        lmsimd::fill(bl, size, 255.0);
+        return false;
+    }
 
-                let mut a = max;
+    // count the # of maps
+    let nummaps = surf.styles.iter().take_while(|&&s| s != 255).count();
 
-                if max > 255 {
-                    let t = 255.0 / max as f32;
-                    r = (r as f32 * t) as i32;
-                    g = (g as f32 * t) as i32;
-                    b = (b as f32 * t) as i32;
-                    a = (a as f32 * t) as i32;
-                }
+    // A single map is assigned directly; several are summed from zero.
+    if nummaps != 1 {
+        lmsimd::fill(bl, size, 0.0);
+    }
 
-                *dest_ptr.offset(0) = r as u8;
-                *dest_ptr.offset(1) = g as u8;
-                *dest_ptr.offset(2) = b as u8;
-                *dest_ptr.offset(3) = a as u8;
+    let mut lightmap = surf.samples;
+    for maps in 0..nummaps {
+        let scale = style_scale(surf.styles[maps] as usize);
+        let samples = std::slice::from_raw_parts(lightmap, size * 3);
+        lmsimd::accumulate(bl, samples, size, scale, nummaps == 1, level);
+        lightmap = lightmap.add(size * 3);
+    }
+    true
+}
 
-                bl_idx += 3;
-                dest_ptr = dest_ptr.offset(4);
-            }
-            dest_ptr = dest_ptr.offset(stride_adj as isize);
-        }
+/// Put `bl` into texture format at `dest` (R_BuildLightMap's store:).
+///
+/// # Safety
+/// `dest` must address `tmax` rows of `smax` RGBA texels, `stride` bytes apart.
+pub unsafe fn r_store_light_map(
+    bl: &BlockLights,
+    smax: i32,
+    tmax: i32,
+    dest: *mut u8,
+    stride: i32,
+    monolightmap: u8,
+    level: crate::simd::SimdLevel,
+) {
+    if monolightmap == b'0' {
+        lmsimd::store_rgba(bl, smax as usize, tmax as usize, dest, stride as usize, level);
     } else {
+        let stride_adj = stride - (smax << 2);
+        let mut bl_idx: usize = 0;
+        let mut dest_ptr = dest;
+
         for _i in 0..tmax {
             for _j in 0..smax {
-                let mut r = S_BLOCKLIGHTS[bl_idx] as i32;
-                let mut g = S_BLOCKLIGHTS[bl_idx + 1] as i32;
-                let mut b = S_BLOCKLIGHTS[bl_idx + 2] as i32;
-
-                if r < 0 { r = 0; }
-                if g < 0 { g = 0; }
-                if b < 0 { b = 0; }
-
-                let mut max = if r > g { r } else { g };
-                if b > max { max = b; }
-
-                let mut a = max;
-
-                if max > 255 {
-                    let t = 255.0 / max as f32;
-                    r = (r as f32 * t) as i32;
-                    g = (g as f32 * t) as i32;
-                    b = (b as f32 * t) as i32;
-                    a = (a as f32 * t) as i32;
-                }
+                let (r_in, g_in, b_in) = bl.texel(bl_idx);
+                let [r8, g8, b8, a8] = lmsimd::texel_to_rgba(r_in, g_in, b_in).to_le_bytes();
+                let (mut r, mut g, mut b, mut a) = (r8 as i32, g8 as i32, b8 as i32, a8 as i32);
 
                 match monolightmap {
                     b'L' | b'I' => {
@@ -823,7 +898,7 @@ pub unsafe fn r_build_light_map(surf: &MSurface, dest: *mut u8, stride: i32) {
                 *dest_ptr.offset(2) = b as u8;
                 *dest_ptr.offset(3) = a as u8;
 
-                bl_idx += 3;
+                bl_idx += 1;
                 dest_ptr = dest_ptr.offset(4);
             }
             dest_ptr = dest_ptr.offset(stride_adj as isize);
@@ -897,7 +972,8 @@ pub fn blocklights_to_rgba(r_in: f32, g_in: f32, b_in: f32) -> (u8, u8, u8, u8)
     (r as u8, g as u8, b as u8, a as u8)
 }
 
-/// Add a stain to the world at the given position.
+/// Queue a stain at the given position. The BSP walk and texel work are
+/// deferred to `r_flush_stains`, which runs once per frame.
 ///
 /// # Safety
 /// Accesses global renderer state.
@@ -920,7 +996,302 @@ pub unsafe fn add_stain(
     TEMP_STAIN.intensity = intensity;
     TEMP_STAIN.stain_type = stain_type;
 
-    r_stain_node(&TEMP_STAIN, r_worldmodel_nodes());
+    queue_stain(&TEMP_STAIN);
+}
+
+// ============================================================
+// Deferred stain queue
+// ============================================================
+//
+// A firefight can add dozens of stains per frame. Instead of one BSP walk
+// and one texel pass per stain, stains are queued and resolved together:
+// one walk carries the whole batch down the tree, hits are indexed by
+// surface, and each surface applies all of its stains in a single texel
+// pass. Touched surfaces are flagged so vk_update_dynamic_lightmaps folds
+// the new stains into that frame's lightmap rebuild.
+
+/// Stains accepted per frame; the rest are dropped and counted.
+pub const MAX_QUEUED_STAINS: usize = 256;
+
+/// Per-frame stain statistics for r_speeds.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct StainStats {
+    pub queued: u32,
+    pub dropped: u32,
+    pub surfaces: u32,
+    pub texels: u32,
+}
+
+pub static mut STAIN_STATS: StainStats = StainStats {
+    queued: 0,
+    dropped: 0,
+    surfaces: 0,
+    texels: 0,
+};
+
+static mut STAIN_QUEUE: Vec<DStain> = Vec::new();
+static mut STAIN_DROPPED: u32 = 0;
+/// Stain indices being carried down the tree (one segment per recursion level).
+static mut STAIN_WALK: Vec<u16> = Vec::new();
+/// (surface index, stain index) pairs produced by the walk.
+static mut STAIN_HITS: Vec<(u32, u16)> = Vec::new();
+static mut STAIN_SURF_LIST: Vec<SurfaceStain> = Vec::new();
+
+/// A stain projected onto one surface's texture space.
+#[derive(Debug, Clone, Copy)]
+pub struct SurfaceStain {
+    pub local: [f32; 2],
+    pub frad: f32,
+    pub alpha: f32,
+    pub color: Vec3,
+    pub stain_type: StainType,
+}
+
+/// Queue a stain for the next `r_flush_stains`.
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn queue_stain(st: &DStain) {
+    if STAIN_QUEUE.len() >= MAX_QUEUED_STAINS {
+        STAIN_DROPPED += 1;
+        return;
+    }
+    STAIN_QUEUE.push(*st);
+}
+
+/// Drop any queued stains (map change).
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_clear_stains() {
+    STAIN_QUEUE.clear();
+    STAIN_HITS.clear();
+    STAIN_DROPPED = 0;
+}
+
+/// Resolve every queued stain against the world and apply them per surface.
+///
+/// # Safety
+/// Accesses global renderer state and world surface data.
+pub unsafe fn r_flush_stains() {
+    STAIN_STATS = StainStats {
+        queued: STAIN_QUEUE.len() as u32,
+        dropped: STAIN_DROPPED,
+        surfaces: 0,
+        texels: 0,
+    };
+    STAIN_DROPPED = 0;
+    if STAIN_QUEUE.is_empty() {
+        return;
+    }
+
+    let nodes = r_worldmodel_nodes();
+    let surfaces = r_worldmodel_surfaces();
+    if nodes.is_null() || surfaces.is_null() {
+        STAIN_QUEUE.clear();
+        return;
+    }
+
+    STAIN_WALK.clear();
+    STAIN_WALK.extend(0..STAIN_QUEUE.len() as u16);
+    STAIN_HITS.clear();
+    r_stain_node_batch(nodes, 0, STAIN_QUEUE.len());
+
+    // Group by surface; within a surface the stains stay in queue order so
+    // overlapping stains blend exactly as the immediate path would.
+    STAIN_HITS.sort_unstable();
+
+    let mut i = 0;
+    while i < STAIN_HITS.len() {
+        let surfnum = STAIN_HITS[i].0;
+        let mut end = i + 1;
+        while end < STAIN_HITS.len() && STAIN_HITS[end].0 == surfnum {
+            end += 1;
+        }
+        r_stain_surface(&mut *surfaces.offset(surfnum as isize), i, end);
+        i = end;
+    }
+
+    STAIN_QUEUE.clear();
+}
+
+/// Carry `STAIN_WALK[start..start + count]` down from `node`, recording a hit
+/// for every surface on a node plane that a stain sphere straddles.
+unsafe fn r_stain_node_batch(node: *mut MNode, start: usize, count: usize) {
+    if node.is_null() || count == 0 {
+        return;
+    }
+    let node_ref = &*node;
+    if node_ref.contents != -1 {
+        return;
+    }
+
+    let plane = &*node_ref.plane;
+    let base = STAIN_WALK.len();
+    let mut back = 0usize;
+
+    // Front-side stains are appended as the next segment; back-side ones are
+    // gathered into the scratch tail after the front subtree is done.
+    for k in start..start + count {
+        let idx = STAIN_WALK[k];
+        let st = &STAIN_QUEUE[idx as usize];
+        let dist = dot_product(&st.origin, &plane.normal) - plane.dist;
+        if dist >= -st.intensity {
+            STAIN_WALK.push(idx);
+        }
+        if dist <= st.intensity {
+            back += 1;
+        }
+        if dist >= -st.intensity && dist <= st.intensity {
+            for j in 0..node_ref.numsurfaces as u32 {
+                STAIN_HITS.push((node_ref.firstsurface as u32 + j, idx));
+            }
+        }
+    }
+
+    let front = STAIN_WALK.len() - base;
+    r_stain_node_batch(node_ref.children[0], base, front);
+    STAIN_WALK.truncate(base);
+
+    if back == 0 {
+        return;
+    }
+    for k in start..start + count {
+        let idx = STAIN_WALK[k];
+        let st = &STAIN_QUEUE[idx as usize];
+        let dist = dot_product(&st.origin, &plane.normal) - plane.dist;
+        if dist <= st.intensity {
+            STAIN_WALK.push(idx);
+        }
+    }
+    r_stain_node_batch(node_ref.children[1], base, back);
+    STAIN_WALK.truncate(base);
+}
+
+/// Apply the hits `STAIN_HITS[first..end]` (all for `surf`) in one texel pass
+/// and flag the surface for a lightmap rebuild.
+unsafe fn r_stain_surface(surf: &mut MSurface, first: usize, end: usize) {
+    if surf.stains.is_null() {
+        return;
+    }
+    let tex = &*surf.texinfo;
+    if tex.flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP) != 0 {
+        return;
+    }
+
+    let plane = &*surf.plane;
+    STAIN_SURF_LIST.clear();
+    for h in first..end {
+        let st = &STAIN_QUEUE[STAIN_HITS[h].1 as usize];
+
+        let mut fdist = dot_product(&st.origin, &plane.normal) - plane.dist;
+        if surf.flags & SURF_PLANEBACK != 0 {
+            fdist *= -1.0;
+        }
+        let frad = st.intensity - fdist.abs();
+        if frad < 0.0 {
+            continue;
+        }
+
+        let mut impact = [0.0f32; 3];
+        for i in 0..3 {
+            impact[i] = st.origin[i] - plane.normal[i] * fdist;
+        }
+        let local_0 = dot_product(
+            &impact,
+            &[tex.vecs[0][0], tex.vecs[0][1], tex.vecs[0][2]],
+        ) + tex.vecs[0][3]
+            - surf.texturemins[0] as f32;
+        let local_1 = dot_product(
+            &impact,
+            &[tex.vecs[1][0], tex.vecs[1][1], tex.vecs[1][2]],
+        ) + tex.vecs[1][3]
+            - surf.texturemins[1] as f32;
+
+        STAIN_SURF_LIST.push(SurfaceStain {
+            local: [local_0, local_1],
+            frad,
+            alpha: st.alpha,
+            color: st.color,
+            stain_type: st.stain_type,
+        });
+    }
+    if STAIN_SURF_LIST.is_empty() {
+        return;
+    }
+
+    let smax = (surf.extents[0] as i32 >> 4) + 1;
+    let tmax = (surf.extents[1] as i32 >> 4) + 1;
+    let stains = std::slice::from_raw_parts_mut(surf.stains, (smax * tmax * 3) as usize);
+    STAIN_STATS.texels += apply_surface_stains(stains, smax, tmax, &STAIN_SURF_LIST);
+    STAIN_STATS.surfaces += 1;
+
+    surf.cached_light[0] = crate::vk_rsurf::LM_CACHE_DIRTY;
+}
+
+/// Blend `list` into one surface's RGB stain map in a single pass over its
+/// texels. Per texel the stains are applied in list order, so the result is
+/// identical to applying them one surface pass at a time. Returns the number
+/// of texels touched.
+pub fn apply_surface_stains(stains: &mut [u8], smax: i32, tmax: i32, list: &[SurfaceStain]) -> u32 {
+    let mut touched = 0u32;
+    let mut texel = 0usize;
+
+    let mut ftacc: f32 = 0.0;
+    for _t in 0..tmax {
+        let mut fsacc: f32 = 0.0;
+        for _s in 0..smax {
+            let mut hit = false;
+            for st in list {
+                let mut td = (st.local[1] - ftacc) as i32;
+                if td < 0 {
+                    td = -td;
+                }
+                let mut sd = (st.local[0] - fsacc) as i32;
+                if sd < 0 {
+                    sd = -sd;
+                }
+                let fdist = if sd > td {
+                    sd as f32 + (td >> 1) as f32
+                } else {
+                    td as f32 + (sd >> 1) as f32
+                };
+                if fdist >= st.frad {
+                    continue;
+                }
+
+                let mut mult = st.frad / fdist;
+                if mult > 5.0 {
+                    mult = 5.0;
+                }
+                let mut alpha = st.alpha * mult;
+                if alpha > 255.0 {
+                    alpha = 255.0;
+                }
+                if alpha > st.alpha {
+                    alpha = st.alpha;
+                }
+                if alpha < 0.0 {
+                    alpha = 0.0;
+                }
+                alpha /= 255.0;
+
+                let px = &mut stains[texel..texel + 3];
+                for i in 0..3 {
+                    px[i] = stain_blend_channel(px[i] as f32, alpha, st.color[i], st.stain_type);
+                }
+                hit = true;
+            }
+            if hit {
+                touched += 1;
+            }
+
+            fsacc += 16.0;
+            texel += 3;
+        }
+        ftacc += 16.0;
+    }
+    touched
 }
 
 #[cfg(test)]
@@ -1129,6 +1500,101 @@ mod tests {
         // S_BLOCKLIGHTS should be 34*34*3 = 3468 floats
         // This matches the maximum lightmap size
         assert_eq!(34 * 34 * 3, 3468);
+        assert_eq!(BLOCKLIGHT_TEXELS * 3, 3468);
+    }
+
+    #[test]
+    fn test_texel_to_rgba_matches_blocklights_to_rgba() {
+        for &(r, g, b) in &[(100.0, 150.0, 200.0), (300.0, 100.0, 50.0), (-10.0, 20.0, 30.0), (256.0, 256.0, 256.0)] {
+            let (r8, g8, b8, a8) = blocklights_to_rgba(r, g, b);
+            assert_eq!(lmsimd::texel_to_rgba(r, g, b).to_le_bytes(), [r8, g8, b8, a8]);
+        }
+    }
+
+    // ============================================================
+    // Deferred stain application
+    // ============================================================
+
+    fn test_stain(local: [f32; 2], frad: f32, color: Vec3, stain_type: StainType) -> SurfaceStain {
+        SurfaceStain { local, frad, alpha: 200.0, color, stain_type }
     }
-}
 
+    #[test]
+    fn test_apply_surface_stains_coalesced_matches_sequential() {
+        let (smax, tmax) = (9, 7);
+        let list = [
+            test_stain([40.0, 30.0], 60.0, [255.0, 0.0, 0.0], StainType::Modulate),
+            test_stain([70.0, 50.0], 45.0, [0.0, 0.0, 0.0], StainType::Subtract),
+            test_stain([20.0, 80.0], 90.0, [30.0, 60.0, 90.0], StainType::Add),
+            test_stain([55.0, 35.0], 30.0, [10.0, 200.0, 10.0], StainType::Modulate),
+        ];
+        let init: Vec<u8> = (0..smax * tmax * 3).map(|i| (i * 37 % 256) as u8).collect();
+
+        let mut sequential = init.clone();
+        for st in &list {
+            apply_surface_stains(&mut sequential, smax, tmax, std::slice::from_ref(st));
+        }
+        let mut coalesced = init.clone();
+        let touched = apply_surface_stains(&mut coalesced, smax, tmax, &list);
+
+        assert_eq!(coalesced, sequential);
+        assert!(touched > 0 && touched <= (smax * tmax) as u32);
+    }
+
+    #[test]
+    fn test_apply_surface_stains_outside_radius_untouched() {
+        let (smax, tmax) = (4, 4);
+        let mut stains = vec![128u8; (smax * tmax * 3) as usize];
+        let far = test_stain([500.0, 500.0], 16.0, [0.0; 3], StainType::Subtract);
+        assert_eq!(apply_surface_stains(&mut stains, smax, tmax, &[far]), 0);
+        assert!(stains.iter().all(|&v| v == 128));
+    }
+
+    #[test]
+    fn test_apply_surface_stains_only_hits_inside_radius() {
+        let (smax, tmax) = (8, 1);
+        let mut stains = vec![200u8; (smax * tmax * 3) as usize];
+        // Texel s sits at s*16; radius 40 from the origin reaches s = 0, 1, 2.
+        let st = test_stain([0.0, 0.0], 40.0, [255.0; 3], StainType::Subtract);
+        assert_eq!(apply_surface_stains(&mut stains, smax, tmax, &[st]), 3);
+        for s in 0..smax as usize {
+            let px = &stains[s * 3..s * 3 + 3];
+            if s < 3 {
+                assert!(px[0] < 200);
+            } else {
+                assert_eq!(px, [200, 200, 200]);
+            }
+        }
+    }
+
+    // ============================================================
+    // Light point cache
+    // ============================================================
+
+    #[test]
+    fn test_light_sample_weight_applies_styles() {
+        let sample = LightSample {
+            count: 2,
+            styles: [0, 7, 255, 255],
+            texels: [[255, 128, 0], [51, 51, 51], [9, 9, 9], [9, 9, 9]],
+        };
+        let styles = |s: u8| if s == 0 { [1.0, 1.0, 1.0] } else { [2.0, 0.0, 1.0] };
+        let c = sample.weight(1.5, styles);
+        assert!((c[0] - (1.5 + 51.0 * 3.0 / 255.0)).abs() < 1e-6);
+        assert!((c[1] - 128.0 * 1.5 / 255.0).abs() < 1e-6);
+        assert!((c[2] - 51.0 * 1.5 / 255.0).abs() < 1e-6);
+
+        // a style switched off drops only its own contribution
+        let off = sample.weight(1.5, |s| if s == 0 { [1.0; 3] } else { [0.0; 3] });
+        assert_eq!(off[2], 0.0);
+        assert!((off[0] - 1.5).abs() < 1e-6 && (off[1] - c[1]).abs() < 1e-6);
+        assert_eq!(LightSample::default().weight(1.0, styles), [0.0; 3]);
+    }
+
+    #[test]
+    fn test_light_cache_key_quantizes() {
+        assert_eq!(light_cache_key(&[0.0, 0.5, 0.99]), [0, 0, 0]);
+        assert_eq!(light_cache_key(&[-0.25, 12.0, -64.0]), [-1, 12, -64]);
+        assert_ne!(light_cache_key(&[1.0, 0.0, 0.0]), light_cache_key(&[0.999, 0.0, 0.0]));
+    }
+}
@@ -0,0 +1,1071 @@
+// vk_light_simd.rs — Vectorized stages of R_BuildLightMap
+//
+// R_BuildLightMap runs for every dirty surface each frame once lightstyles
+// animate or dlights move. The block-light buffer is kept planar (one plane
+// per colour channel) so each stage processes 4 (SSE2) or 8 (AVX2) texels per
+// instruction:
+//
+//   accumulate   lightstyle samples * scale into the planes
+//   dlight       BETTER_DLIGHT_FALLOFF weight added where fdist < cutoff
+//   stains       per-channel min against the stainmap
+//   store        clamp / overbright normalize / pack to RGBA
+//
+// Every SIMD path performs the same IEEE operations in the same order as the
+// scalar reference, so output is bit-identical (verified by the tests below).
+
+use crate::simd::SimdLevel;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+/// Texels in the block-light buffer (largest surface is 34x34 luxels).
+pub const BLOCKLIGHT_TEXELS: usize = 34 * 34;
+
+/// Planar floating-point block-light buffer.
+#[repr(C, align(32))]
+pub struct BlockLights {
+    pub r: [f32; BLOCKLIGHT_TEXELS],
+    pub g: [f32; BLOCKLIGHT_TEXELS],
+    pub b: [f32; BLOCKLIGHT_TEXELS],
+}
+
+impl BlockLights {
+    pub const fn new() -> Self {
+        Self {
+            r: [0.0; BLOCKLIGHT_TEXELS],
+            g: [0.0; BLOCKLIGHT_TEXELS],
+            b: [0.0; BLOCKLIGHT_TEXELS],
+        }
+    }
+
+    /// Read texel `i` as (r, g, b).
+    #[inline]
+    pub fn texel(&self, i: usize) -> (f32, f32, f32) {
+        (self.r[i], self.g[i], self.b[i])
+    }
+}
+
+impl Default for BlockLights {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+// ============================================================
+// Stage entry points (dispatch on SimdLevel)
+// ============================================================
+
+/// Set the first `size` texels of every plane to `value`.
+pub fn fill(bl: &mut BlockLights, size: usize, value: f32) {
+    bl.r[..size].fill(value);
+    bl.g[..size].fill(value);
+    bl.b[..size].fill(value);
+}
+
+/// Accumulate one lightstyle map. `samples` holds `size` interleaved RGB bytes.
+/// With `assign` the planes are overwritten (first/only map), otherwise the
+/// scaled samples are added.
+pub fn accumulate(bl: &mut BlockLights, samples: &[u8], size: usize, scale: [f32; 3], assign: bool, level: SimdLevel) {
+    assert!(size <= BLOCKLIGHT_TEXELS && samples.len() >= size * 3);
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { accumulate_avx2(bl, samples, size, scale, assign) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { accumulate_sse2(bl, samples, size, scale, assign, 0) },
+        _ => accumulate_scalar(bl, samples, 0, size, scale, assign),
+    }
+}
+
+/// Add one dynamic light's falloff. `local` is the light's impact point in
+/// surface-local luxel space (already minus texturemins); texels whose
+/// approximate distance is below `cutoff` receive `(base - fdist) * color`.
+pub fn add_dlight(
+    bl: &mut BlockLights,
+    smax: usize,
+    tmax: usize,
+    local: [f32; 2],
+    cutoff: f32,
+    base: f32,
+    color: [f32; 3],
+    level: SimdLevel,
+) {
+    assert!(smax * tmax <= BLOCKLIGHT_TEXELS);
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { add_dlight_avx2(bl, smax, tmax, local, cutoff, base, color) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { add_dlight_sse2(bl, smax, tmax, local, cutoff, base, color) },
+        _ => {
+            for t in 0..tmax {
+                let td = row_td(local[1], t);
+                add_dlight_row_scalar(bl, t * smax, 0, smax, local[0], td, cutoff, base, color);
+            }
+        }
+    }
+}
+
+/// Clamp each channel to the stainmap (`stains` is interleaved RGB bytes).
+pub fn apply_stains(bl: &mut BlockLights, stains: &[u8], size: usize, scale: f32, level: SimdLevel) {
+    assert!(size <= BLOCKLIGHT_TEXELS && stains.len() >= size * 3);
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 | SimdLevel::Avx2 => unsafe { apply_stains_sse2(bl, stains, size, scale) },
+        _ => apply_stains_scalar(bl, stains, 0, size, scale),
+    }
+}
+
+/// Convert the planes to RGBA (monolightmap '0'), writing `smax` texels per
+/// row and advancing `stride` bytes between rows.
+///
+/// # Safety
+/// `dest` must be valid for `tmax` rows of `smax * 4` bytes spaced `stride` apart.
+pub unsafe fn store_rgba(bl: &BlockLights, smax: usize, tmax: usize, dest: *mut u8, stride: usize, level: SimdLevel) {
+    assert!(smax * tmax <= BLOCKLIGHT_TEXELS);
+    for t in 0..tmax {
+        let row = dest.add(t * stride);
+        let first = t * smax;
+        match level {
+            #[cfg(target_arch = "x86_64")]
+            SimdLevel::Avx2 => store_row_avx2(bl, first, smax, row),
+            #[cfg(target_arch = "x86_64")]
+            SimdLevel::Sse2 => store_row_sse2(bl, first, smax, row, 0),
+            _ => store_row_scalar(bl, first, 0, smax, row),
+        }
+    }
+}
+
+// ============================================================
+// Scalar reference
+// ============================================================
+
+#[inline]
+fn accumulate_scalar(bl: &mut BlockLights, samples: &[u8], start: usize, size: usize, scale: [f32; 3], assign: bool) {
+    for i in start..size {
+        let r = samples[i * 3] as f32 * scale[0];
+        let g = samples[i * 3 + 1] as f32 * scale[1];
+        let b = samples[i * 3 + 2] as f32 * scale[2];
+        if assign {
+            bl.r[i] = r;
+            bl.g[i] = g;
+            bl.b[i] = b;
+        } else {
+            bl.r[i] += r;
+            bl.g[i] += g;
+            bl.b[i] += b;
+        }
+    }
+}
+
+/// Absolute truncated t-distance for row `t` (the `ftacc` walk in 16-unit steps).
+#[inline]
+fn row_td(local_t: f32, t: usize) -> i32 {
+    ((local_t - (t as f32) * 16.0) as i32).abs()
+}
+
+#[inline]
+fn add_dlight_row_scalar(
+    bl: &mut BlockLights,
+    row: usize,
+    s_start: usize,
+    smax: usize,
+    local_s: f32,
+    td: i32,
+    cutoff: f32,
+    base: f32,
+    color: [f32; 3],
+) {
+    for s in s_start..smax {
+        let sd = ((local_s - (s as f32) * 16.0) as i32).abs();
+        let fdist = if sd > td {
+            sd as f32 + (td >> 1) as f32
+        } else {
+            td as f32 + (sd >> 1) as f32
+        };
+        if fdist < cutoff {
+            let w = base - fdist;
+            bl.r[row + s] += w * color[0];
+            bl.g[row + s] += w * color[1];
+            bl.b[row + s] += w * color[2];
+        }
+    }
+}
+
+#[inline]
+fn apply_stains_scalar(bl: &mut BlockLights, stains: &[u8], start: usize, size: usize, scale: f32) {
+    for i in start..size {
+        let sr = stains[i * 3] as f32 * scale;
+        let sg = stains[i * 3 + 1] as f32 * scale;
+        let sb = stains[i * 3 + 2] as f32 * scale;
+        if bl.r[i] > sr { bl.r[i] = sr; }
+        if bl.g[i] > sg { bl.g[i] = sg; }
+        if bl.b[i] > sb { bl.b[i] = sb; }
+    }
+}
+
+/// Pack one texel exactly as the original store loop does.
+#[inline]
+pub fn texel_to_rgba(r_in: f32, g_in: f32, b_in: f32) -> u32 {
+    let mut r = (r_in as i32).max(0);
+    let mut g = (g_in as i32).max(0);
+    let mut b = (b_in as i32).max(0);
+
+    let max = r.max(g).max(b);
+    let mut a = max;
+
+    if max > 255 {
+        let t = 255.0 / max as f32;
+        r = (r as f32 * t) as i32;
+        g = (g as f32 * t) as i32;
+        b = (b as f32 * t) as i32;
+        a = (a as f32 * t) as i32;
+    }
+
+    u32::from_le_bytes([r as u8, g as u8, b as u8, a as u8])
+}
+
+#[inline]
+unsafe fn store_row_scalar(bl: &BlockLights, first: usize, s_start: usize, smax: usize, row: *mut u8) {
+    for s in s_start..smax {
+        let i = first + s;
+        let px = texel_to_rgba(bl.r[i], bl.g[i], bl.b[i]);
+        std::ptr::write_unaligned(row.add(s * 4) as *mut u32, px.to_le());
+    }
+}
+
+// ============================================================
+// SSE2
+// ============================================================
+
+/// `_mm_shuffle_ps` immediate: lanes (a[a0], a[a1], b[b0], b[b1]).
+#[cfg(target_arch = "x86_64")]
+const fn shuf(a0: i32, a1: i32, b0: i32, b1: i32) -> i32 {
+    a0 | (a1 << 2) | (b0 << 4) | (b1 << 6)
+}
+
+#[cfg(target_arch = "x86_64")]
+const SHUF_0033: i32 = shuf(0, 0, 3, 3);
+#[cfg(target_arch = "x86_64")]
+const SHUF_2211: i32 = shuf(2, 2, 1, 1);
+#[cfg(target_arch = "x86_64")]
+const SHUF_1100: i32 = shuf(1, 1, 0, 0);
+#[cfg(target_arch = "x86_64")]
+const SHUF_3322: i32 = shuf(3, 3, 2, 2);
+#[cfg(target_arch = "x86_64")]
+const SHUF_0202: i32 = shuf(0, 2, 0, 2);
+
+/// Load 4 interleaved RGB8 texels (12 bytes, no over-read) as three f32 planes.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn load_rgb4_sse2(p: *const u8) -> (__m128, __m128, __m128) {
+    let lo = _mm_loadl_epi64(p as *const __m128i);
+    let hi = _mm_cvtsi32_si128(std::ptr::read_unaligned(p.add(8) as *const i32));
+    let bytes = _mm_unpacklo_epi64(lo, hi);
+    let zero = _mm_setzero_si128();
+    let w_lo = _mm_unpacklo_epi8(bytes, zero);
+    let w_hi = _mm_unpackhi_epi8(bytes, zero);
+    // v0 = r0 g0 b0 r1 | v1 = g1 b1 r2 g2 | v2 = b2 r3 g3 b3
+    let v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(w_lo, zero));
+    let v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(w_lo, zero));
+    let v2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(w_hi, zero));
+
+    let r = _mm_shuffle_ps(_mm_shuffle_ps(v0, v0, SHUF_0033), _mm_shuffle_ps(v1, v2, SHUF_2211), SHUF_0202);
+    let g = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, SHUF_1100), _mm_shuffle_ps(v1, v2, SHUF_3322), SHUF_0202);
+    let b = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, SHUF_2211), _mm_shuffle_ps(v2, v2, SHUF_0033), SHUF_0202);
+    (r, g, b)
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn select_ps(mask: __m128, a: __m128, b: __m128) -> __m128 {
+    _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn select_epi32(mask: __m128i, a: __m128i, b: __m128i) -> __m128i {
+    _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn abs_epi32_sse2(x: __m128i) -> __m128i {
+    let sign = _mm_srai_epi32(x, 31);
+    _mm_sub_epi32(_mm_xor_si128(x, sign), sign)
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn accumulate_sse2(bl: &mut BlockLights, samples: &[u8], size: usize, scale: [f32; 3], assign: bool, start: usize) {
+    let sr = _mm_set1_ps(scale[0]);
+    let sg = _mm_set1_ps(scale[1]);
+    let sb = _mm_set1_ps(scale[2]);
+    let src = samples.as_ptr();
+    let (pr, pg, pb) = (bl.r.as_mut_ptr(), bl.g.as_mut_ptr(), bl.b.as_mut_ptr());
+
+    let mut i = start;
+    while i + 4 <= size {
+        let (r, g, b) = load_rgb4_sse2(src.add(i * 3));
+        let (r, g, b) = (_mm_mul_ps(r, sr), _mm_mul_ps(g, sg), _mm_mul_ps(b, sb));
+        if assign {
+            _mm_storeu_ps(pr.add(i), r);
+            _mm_storeu_ps(pg.add(i), g);
+            _mm_storeu_ps(pb.add(i), b);
+        } else {
+            _mm_storeu_ps(pr.add(i), _mm_add_ps(_mm_loadu_ps(pr.add(i)), r));
+            _mm_storeu_ps(pg.add(i), _mm_add_ps(_mm_loadu_ps(pg.add(i)), g));
+            _mm_storeu_ps(pb.add(i), _mm_add_ps(_mm_loadu_ps(pb.add(i)), b));
+        }
+        i += 4;
+    }
+    accumulate_scalar(bl, samples, i, size, scale, assign);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn add_dlight_sse2(
+    bl: &mut BlockLights,
+    smax: usize,
+    tmax: usize,
+    local: [f32; 2],
+    cutoff: f32,
+    base: f32,
+    color: [f32; 3],
+) {
+    let local_s = _mm_set1_ps(local[0]);
+    let cut = _mm_set1_ps(cutoff);
+    let basev = _mm_set1_ps(base);
+    let (cr, cg, cb) = (_mm_set1_ps(color[0]), _mm_set1_ps(color[1]), _mm_set1_ps(color[2]));
+    let sixteen = _mm_set1_ps(16.0);
+    let lane = _mm_setr_epi32(0, 1, 2, 3);
+    let (pr, pg, pb) = (bl.r.as_mut_ptr(), bl.g.as_mut_ptr(), bl.b.as_mut_ptr());
+
+    for t in 0..tmax {
+        let td_s = row_td(local[1], t);
+        let td = _mm_set1_epi32(td_s);
+        let td_half = _mm_set1_epi32(td_s >> 1);
+        let row = t * smax;
+
+        let mut s = 0;
+        while s + 4 <= smax {
+            let sacc = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(s as i32), lane)), sixteen);
+            let sd = abs_epi32_sse2(_mm_cvttps_epi32(_mm_sub_ps(local_s, sacc)));
+            let far_s = _mm_add_epi32(sd, td_half);
+            let far_t = _mm_add_epi32(td, _mm_srai_epi32(sd, 1));
+            let dist = _mm_cvtepi32_ps(select_epi32(_mm_cmpgt_epi32(sd, td), far_s, far_t));
+            let lit = _mm_cmplt_ps(dist, cut);
+            if _mm_movemask_ps(lit) != 0 {
+                let w = _mm_sub_ps(basev, dist);
+                let i = row + s;
+                let r = _mm_loadu_ps(pr.add(i));
+                let g = _mm_loadu_ps(pg.add(i));
+                let b = _mm_loadu_ps(pb.add(i));
+                _mm_storeu_ps(pr.add(i), select_ps(lit, _mm_add_ps(r, _mm_mul_ps(w, cr)), r));
+                _mm_storeu_ps(pg.add(i), select_ps(lit, _mm_add_ps(g, _mm_mul_ps(w, cg)), g));
+                _mm_storeu_ps(pb.add(i), select_ps(lit, _mm_add_ps(b, _mm_mul_ps(w, cb)), b));
+            }
+            s += 4;
+        }
+        add_dlight_row_scalar(bl, row, s, smax, local[0], td_s, cutoff, base, color);
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn apply_stains_sse2(bl: &mut BlockLights, stains: &[u8], size: usize, scale: f32) {
+    let sc = _mm_set1_ps(scale);
+    let src = stains.as_ptr();
+    let (pr, pg, pb) = (bl.r.as_mut_ptr(), bl.g.as_mut_ptr(), bl.b.as_mut_ptr());
+
+    let mut i = 0;
+    while i + 4 <= size {
+        let (r, g, b) = load_rgb4_sse2(src.add(i * 3));
+        // min_ps(stain, bl) returns bl unless stain < bl — same as `if bl > stain`.
+        _mm_storeu_ps(pr.add(i), _mm_min_ps(_mm_mul_ps(r, sc), _mm_loadu_ps(pr.add(i))));
+        _mm_storeu_ps(pg.add(i), _mm_min_ps(_mm_mul_ps(g, sc), _mm_loadu_ps(pg.add(i))));
+        _mm_storeu_ps(pb.add(i), _mm_min_ps(_mm_mul_ps(b, sc), _mm_loadu_ps(pb.add(i))));
+        i += 4;
+    }
+    apply_stains_scalar(bl, stains, i, size, scale);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn clamp0_epi32_sse2(x: __m128i) -> __m128i {
+    _mm_andnot_si128(_mm_srai_epi32(x, 31), x)
+}
+
+/// `(x as f32 * t) as i32` per lane.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn scale_epi32_sse2(x: __m128i, t: __m128) -> __m128i {
+    _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(x), t))
+}
+
+/// Normalize 4 texels to packed RGBA.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn pack4_sse2(rf: __m128, gf: __m128, bf: __m128) -> __m128i {
+    let r = clamp0_epi32_sse2(_mm_cvttps_epi32(rf));
+    let g = clamp0_epi32_sse2(_mm_cvttps_epi32(gf));
+    let b = clamp0_epi32_sse2(_mm_cvttps_epi32(bf));
+
+    let max = select_epi32(_mm_cmpgt_epi32(r, g), r, g);
+    let max = select_epi32(_mm_cmpgt_epi32(b, max), b, max);
+
+    let over = _mm_cmpgt_epi32(max, _mm_set1_epi32(255));
+    let (r, g, b, a) = if _mm_movemask_epi8(over) != 0 {
+        // Lanes with max <= 255 divide by a small or zero max; they are masked off.
+        let t = _mm_div_ps(_mm_set1_ps(255.0), _mm_cvtepi32_ps(max));
+        (
+            select_epi32(over, scale_epi32_sse2(r, t), r),
+            select_epi32(over, scale_epi32_sse2(g, t), g),
+            select_epi32(over, scale_epi32_sse2(b, t), b),
+            select_epi32(over, scale_epi32_sse2(max, t), max),
+        )
+    } else {
+        (r, g, b, max)
+    };
+
+    let m = _mm_set1_epi32(0xff);
+    let px = _mm_and_si128(r, m);
+    let px = _mm_or_si128(px, _mm_slli_epi32(_mm_and_si128(g, m), 8));
+    let px = _mm_or_si128(px, _mm_slli_epi32(_mm_and_si128(b, m), 16));
+    _mm_or_si128(px, _mm_slli_epi32(a, 24))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn store_row_sse2(bl: &BlockLights, first: usize, smax: usize, row: *mut u8, start: usize) {
+    let mut s = start;
+    while s + 4 <= smax {
+        let i = first + s;
+        let px = pack4_sse2(
+            _mm_loadu_ps(bl.r.as_ptr().add(i)),
+            _mm_loadu_ps(bl.g.as_ptr().add(i)),
+            _mm_loadu_ps(bl.b.as_ptr().add(i)),
+        );
+        _mm_storeu_si128(row.add(s * 4) as *mut __m128i, px);
+        s += 4;
+    }
+    store_row_scalar(bl, first, s, smax, row);
+}
+
+// ============================================================
+// AVX2
+// ============================================================
+
+/// Load 8 interleaved RGB8 texels (24 bytes, no over-read) as three f32 planes.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "avx2")]
+unsafe fn load_rgb8_avx2(p: *const u8) -> (__m256, __m256, __m256) {
+    let lo = _mm_loadu_si128(p as *const __m128i);
+    let hi = _mm_loadl_epi64(p.add(16) as *const __m128i);
+    // Gather each channel's 8 bytes (5-6 from `lo`, the rest from `hi`).
+    let gather = |lo_idx: __m128i, hi_idx: __m128i| {
+        _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_or_si128(
+            _mm_shuffle_epi8(lo, lo_idx),
+            _mm_shuffle_epi8(hi, hi_idx),
+        )))
+    };
+    let r = gather(
+        _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1),
+    );
+    let g = gather(
+        _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1),
+    );
+    let b = gather(
+        _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+        _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1),
+    );
+    (r, g, b)
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn accumulate_avx2(bl: &mut BlockLights, samples: &[u8], size: usize, scale: [f32; 3], assign: bool) {
+    let sr = _mm256_set1_ps(scale[0]);
+    let sg = _mm256_set1_ps(scale[1]);
+    let sb = _mm256_set1_ps(scale[2]);
+    let src = samples.as_ptr();
+    let (pr, pg, pb) = (bl.r.as_mut_ptr(), bl.g.as_mut_ptr(), bl.b.as_mut_ptr());
+
+    let mut i = 0;
+    while i + 8 <= size {
+        let (r, g, b) = load_rgb8_avx2(src.add(i * 3));
+        let (r, g, b) = (_mm256_mul_ps(r, sr), _mm256_mul_ps(g, sg), _mm256_mul_ps(b, sb));
+        if assign {
+            _mm256_storeu_ps(pr.add(i), r);
+            _mm256_storeu_ps(pg.add(i), g);
+            _mm256_storeu_ps(pb.add(i), b);
+        } else {
+            _mm256_storeu_ps(pr.add(i), _mm256_add_ps(_mm256_loadu_ps(pr.add(i)), r));
+            _mm256_storeu_ps(pg.add(i), _mm256_add_ps(_mm256_loadu_ps(pg.add(i)), g));
+            _mm256_storeu_ps(pb.add(i), _mm256_add_ps(_mm256_loadu_ps(pb.add(i)), b));
+        }
+        i += 8;
+    }
+    accumulate_scalar(bl, samples, i, size, scale, assign);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn add_dlight_avx2(
+    bl: &mut BlockLights,
+    smax: usize,
+    tmax: usize,
+    local: [f32; 2],
+    cutoff: f32,
+    base: f32,
+    color: [f32; 3],
+) {
+    let local_s = _mm256_set1_ps(local[0]);
+    let cut = _mm256_set1_ps(cutoff);
+    let basev = _mm256_set1_ps(base);
+    let (cr, cg, cb) = (_mm256_set1_ps(color[0]), _mm256_set1_ps(color[1]), _mm256_set1_ps(color[2]));
+    let sixteen = _mm256_set1_ps(16.0);
+    let lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    let (pr, pg, pb) = (bl.r.as_mut_ptr(), bl.g.as_mut_ptr(), bl.b.as_mut_ptr());
+
+    for t in 0..tmax {
+        let td_s = row_td(local[1], t);
+        let td = _mm256_set1_epi32(td_s);
+        let td_half = _mm256_set1_epi32(td_s >> 1);
+        let row = t * smax;
+
+        let mut s = 0;
+        while s + 8 <= smax {
+            let sacc = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(s as i32), lane)), sixteen);
+            let sd = _mm256_abs_epi32(_mm256_cvttps_epi32(_mm256_sub_ps(local_s, sacc)));
+            let far_s = _mm256_add_epi32(sd, td_half);
+            let far_t = _mm256_add_epi32(td, _mm256_srai_epi32(sd, 1));
+            let pick_s = _mm256_cmpgt_epi32(sd, td);
+            let dist = _mm256_cvtepi32_ps(_mm256_blendv_epi8(far_t, far_s, pick_s));
+            let lit = _mm256_cmp_ps(dist, cut, _CMP_LT_OQ);
+            if _mm256_movemask_ps(lit) != 0 {
+                let w = _mm256_sub_ps(basev, dist);
+                let i = row + s;
+                let r = _mm256_loadu_ps(pr.add(i));
+                let g = _mm256_loadu_ps(pg.add(i));
+                let b = _mm256_loadu_ps(pb.add(i));
+                _mm256_storeu_ps(pr.add(i), _mm256_blendv_ps(r, _mm256_add_ps(r, _mm256_mul_ps(w, cr)), lit));
+                _mm256_storeu_ps(pg.add(i), _mm256_blendv_ps(g, _mm256_add_ps(g, _mm256_mul_ps(w, cg)), lit));
+                _mm256_storeu_ps(pb.add(i), _mm256_blendv_ps(b, _mm256_add_ps(b, _mm256_mul_ps(w, cb)), lit));
+            }
+            s += 8;
+        }
+        add_dlight_row_scalar(bl, row, s, smax, local[0], td_s, cutoff, base, color);
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "avx2")]
+unsafe fn scale_epi32_avx2(x: __m256i, t: __m256) -> __m256i {
+    _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(x), t))
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn store_row_avx2(bl: &BlockLights, first: usize, smax: usize, row: *mut u8) {
+    let zero = _mm256_setzero_si256();
+    let lim = _mm256_set1_epi32(255);
+    let m = _mm256_set1_epi32(0xff);
+
+    let mut s = 0;
+    while s + 8 <= smax {
+        let i = first + s;
+        let r = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(bl.r.as_ptr().add(i))), zero);
+        let g = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(bl.g.as_ptr().add(i))), zero);
+        let b = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_loadu_ps(bl.b.as_ptr().add(i))), zero);
+        let max = _mm256_max_epi32(_mm256_max_epi32(r, g), b);
+
+        let over = _mm256_cmpgt_epi32(max, lim);
+        let (r, g, b, a) = if _mm256_movemask_epi8(over) != 0 {
+            let t = _mm256_div_ps(_mm256_set1_ps(255.0), _mm256_cvtepi32_ps(max));
+            (
+                _mm256_blendv_epi8(r, scale_epi32_avx2(r, t), over),
+                _mm256_blendv_epi8(g, scale_epi32_avx2(g, t), over),
+                _mm256_blendv_epi8(b, scale_epi32_avx2(b, t), over),
+                _mm256_blendv_epi8(max, scale_epi32_avx2(max, t), over),
+            )
+        } else {
+            (r, g, b, max)
+        };
+
+        let px = _mm256_and_si256(r, m);
+        let px = _mm256_or_si256(px, _mm256_slli_epi32(_mm256_and_si256(g, m), 8));
+        let px = _mm256_or_si256(px, _mm256_slli_epi32(_mm256_and_si256(b, m), 16));
+        let px = _mm256_or_si256(px, _mm256_slli_epi32(a, 24));
+        _mm256_storeu_si256(row.add(s * 4) as *mut __m256i, px);
+        s += 8;
+    }
+    store_row_scalar(bl, first, s, smax, row);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use myq2_common::qfiles::{
+        BSPVERSION, HEADER_LUMPS, IDBSPHEADER, LUMP_EDGES, LUMP_FACES, LUMP_LIGHTING, LUMP_SURFEDGES,
+        LUMP_TEXINFO, LUMP_VERTEXES, MAXLIGHTMAPS,
+    };
+    use myq2_common::q_shared::{SURF_SKY, SURF_TRANS33, SURF_TRANS66, SURF_WARP};
+
+    /// Small deterministic generator so the tests need no extra crates.
+    struct Lcg(u64);
+
+    impl Lcg {
+        fn next_u32(&mut self) -> u32 {
+            self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+            (self.0 >> 33) as u32
+        }
+        fn byte(&mut self) -> u8 {
+            self.next_u32() as u8
+        }
+        fn range(&mut self, lo: f32, hi: f32) -> f32 {
+            lo + (self.next_u32() as f32 / u32::MAX as f32) * (hi - lo)
+        }
+        fn bytes(&mut self, n: usize) -> Vec<u8> {
+            (0..n).map(|_| self.byte()).collect()
+        }
+    }
+
+    fn planes_bits(bl: &BlockLights, size: usize) -> Vec<u32> {
+        (0..size)
+            .flat_map(|i| [bl.r[i].to_bits(), bl.g[i].to_bits(), bl.b[i].to_bits()])
+            .collect()
+    }
+
+    fn levels() -> Vec<SimdLevel> {
+        SimdLevel::supported()
+    }
+
+    /// The original interleaved R_BuildLightMap pipeline (monolightmap '0',
+    /// BETTER_DLIGHT_FALLOFF), kept as the bit-exact reference.
+    struct RefSurface<'a> {
+        smax: usize,
+        tmax: usize,
+        samples: &'a [u8],
+        scales: Vec<[f32; 3]>,
+        dlights: Vec<([f32; 2], f32, [f32; 3])>,
+        stains: Option<(&'a [u8], f32)>,
+    }
+
+    fn reference_build(s: &RefSurface, dest: &mut [u8], stride: usize) {
+        let size = s.smax * s.tmax;
+        let mut bl = vec![0.0f32; size * 3];
+        let nummaps = s.scales.len();
+        let mut lm = 0;
+        for scale in &s.scales {
+            for i in 0..size {
+                for c in 0..3 {
+                    let v = s.samples[lm + i * 3 + c] as f32 * scale[c];
+                    if nummaps == 1 { bl[i * 3 + c] = v; } else { bl[i * 3 + c] += v; }
+                }
+            }
+            lm += size * 3;
+        }
+        for &(local, fminlight, color) in &s.dlights {
+            let mut idx = 0;
+            let mut ftacc = 0.0f32;
+            for _t in 0..s.tmax {
+                let mut td = (local[1] - ftacc) as i32;
+                if td < 0 { td = -td; }
+                let mut fsacc = 0.0f32;
+                for _s in 0..s.smax {
+                    let mut sd = (local[0] - fsacc) as i32;
+                    if sd < 0 { sd = -sd; }
+                    let fdist = if sd > td { sd as f32 + (td >> 1) as f32 } else { td as f32 + (sd >> 1) as f32 };
+                    if fdist < fminlight {
+                        for c in 0..3 {
+                            bl[idx + c] += (fminlight - fdist) * color[c];
+                        }
+                    }
+                    fsacc += 16.0;
+                    idx += 3;
+                }
+                ftacc += 16.0;
+            }
+        }
+        if let Some((stains, scale)) = s.stains {
+            for i in 0..size * 3 {
+                let sv = stains[i] as f32 * scale;
+                if bl[i] > sv { bl[i] = sv; }
+            }
+        }
+        for t in 0..s.tmax {
+            for x in 0..s.smax {
+                let i = (t * s.smax + x) * 3;
+                let px = texel_to_rgba(bl[i], bl[i + 1], bl[i + 2]).to_le_bytes();
+                dest[t * stride + x * 4..t * stride + x * 4 + 4].copy_from_slice(&px);
+            }
+        }
+    }
+
+    fn planar_build(s: &RefSurface, dest: &mut [u8], stride: usize, level: SimdLevel) {
+        let size = s.smax * s.tmax;
+        let mut bl = Box::new(BlockLights::new());
+        let nummaps = s.scales.len();
+        if nummaps > 1 {
+            fill(&mut bl, size, 0.0);
+        }
+        for (m, scale) in s.scales.iter().enumerate() {
+            accumulate(&mut bl, &s.samples[m * size * 3..], size, *scale, nummaps == 1, level);
+        }
+        for &(local, fminlight, color) in &s.dlights {
+            add_dlight(&mut bl, s.smax, s.tmax, local, fminlight, fminlight, color, level);
+        }
+        if let Some((stains, scale)) = s.stains {
+            apply_stains(&mut bl, stains, size, scale, level);
+        }
+        unsafe { store_rgba(&bl, s.smax, s.tmax, dest.as_mut_ptr(), stride, level) };
+    }
+
+    // ============================================================
+    // Packing
+    // ============================================================
+
+    #[test]
+    fn test_texel_to_rgba_normal() {
+        assert_eq!(texel_to_rgba(100.0, 150.0, 200.0).to_le_bytes(), [100, 150, 200, 200]);
+    }
+
+    #[test]
+    fn test_texel_to_rgba_overbright_scales() {
+        let px = texel_to_rgba(510.0, 255.0, 0.0).to_le_bytes();
+        assert_eq!(px[0], 255);
+        assert_eq!(px[1], 127);
+        assert_eq!(px[2], 0);
+        assert_eq!(px[3], 255);
+    }
+
+    #[test]
+    fn test_texel_to_rgba_negative_clamped() {
+        assert_eq!(texel_to_rgba(-5.0, -0.5, 3.9).to_le_bytes(), [0, 0, 3, 3]);
+    }
+
+    // ============================================================
+    // Per-stage bit-exactness (SIMD vs scalar)
+    // ============================================================
+
+    #[test]
+    fn test_accumulate_matches_scalar() {
+        let mut rng = Lcg(1);
+        for size in [1usize, 3, 4, 7, 8, 9, 31, 256, BLOCKLIGHT_TEXELS] {
+            let samples = rng.bytes(size * 3);
+            let scale = [rng.range(0.0, 3.0), rng.range(0.0, 3.0), 1.0];
+            let prev = rng.bytes(size * 3);
+            let mut expected = None;
+            for level in levels() {
+                let mut bl = Box::new(BlockLights::new());
+                for i in 0..size {
+                    bl.r[i] = prev[i * 3] as f32 * 0.37;
+                    bl.g[i] = prev[i * 3 + 1] as f32 * 0.37;
+                    bl.b[i] = prev[i * 3 + 2] as f32 * 0.37;
+                }
+                accumulate(&mut bl, &samples, size, scale, false, level);
+                accumulate(&mut bl, &samples, size, [scale[2], scale[0], scale[1]], false, level);
+                let bits = planes_bits(&bl, size);
+                match &expected {
+                    None => expected = Some(bits),
+                    Some(e) => assert_eq!(e, &bits, "size {} level {:?}", size, level),
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_accumulate_assign_overwrites() {
+        let samples = [10u8, 20, 30, 40, 50, 60, 70, 80, 90, 1, 2, 3, 4, 5, 6];
+        for level in levels() {
+            let mut bl = Box::new(BlockLights::new());
+            fill(&mut bl, 5, 999.0);
+            accumulate(&mut bl, &samples, 5, [2.0, 1.0, 0.5], true, level);
+            assert_eq!(bl.texel(0), (20.0, 20.0, 15.0));
+            assert_eq!(bl.texel(4), (8.0, 5.0, 3.0));
+            assert_eq!(bl.r[5], 0.0);
+        }
+    }
+
+    #[test]
+    fn test_add_dlight_matches_scalar() {
+        let mut rng = Lcg(2);
+        for _ in 0..200 {
+            let smax = 1 + (rng.next_u32() % 34) as usize;
+            let tmax = 1 + (rng.next_u32() % 34) as usize;
+            let local = [rng.range(-64.0, 600.0), rng.range(-64.0, 600.0)];
+            let cutoff = rng.range(0.0, 400.0);
+            let color = [rng.range(0.0, 1.0), rng.range(0.0, 1.0), rng.range(0.0, 1.0)];
+            let mut expected = None;
+            for level in levels() {
+                let mut bl = Box::new(BlockLights::new());
+                fill(&mut bl, smax * tmax, 12.5);
+                add_dlight(&mut bl, smax, tmax, local, cutoff, cutoff, color, level);
+                let bits = planes_bits(&bl, smax * tmax);
+                match &expected {
+                    None => expected = Some(bits),
+                    Some(e) => assert_eq!(e, &bits, "{}x{} level {:?}", smax, tmax, level),
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_add_dlight_outside_cutoff_untouched() {
+        for level in levels() {
+            let mut bl = Box::new(BlockLights::new());
+            fill(&mut bl, 16 * 16, -0.0);
+            add_dlight(&mut bl, 16, 16, [5000.0, 5000.0], 100.0, 100.0, [1.0; 3], level);
+            assert!(bl.r[..256].iter().all(|v| v.to_bits() == (-0.0f32).to_bits()));
+        }
+    }
+
+    #[test]
+    fn test_apply_stains_matches_scalar() {
+        let mut rng = Lcg(3);
+        for size in [1usize, 5, 8, 13, 100, BLOCKLIGHT_TEXELS] {
+            let stains = rng.bytes(size * 3);
+            let init = rng.bytes(size * 3);
+            let mut expected = None;
+            for level in levels() {
+                let mut bl = Box::new(BlockLights::new());
+                accumulate(&mut bl, &init, size, [2.0; 3], true, SimdLevel::Scalar);
+                apply_stains(&mut bl, &stains, size, 1.5, level);
+                let bits = planes_bits(&bl, size);
+                match &expected {
+                    None => expected = Some(bits),
+                    Some(e) => assert_eq!(e, &bits, "size {} level {:?}", size, level),
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_store_matches_scalar() {
+        let mut rng = Lcg(4);
+        for &(smax, tmax) in &[(1usize, 1usize), (3, 5), (4, 4), (8, 2), (17, 9), (34, 34)] {
+            let mut bl = Box::new(BlockLights::new());
+            for i in 0..smax * tmax {
+                bl.r[i] = rng.range(-50.0, 1200.0);
+                bl.g[i] = rng.range(-50.0, 300.0);
+                bl.b[i] = rng.range(-50.0, 700.0);
+            }
+            let stride = smax * 4 + 12;
+            let mut expected = None;
+            for level in levels() {
+                let mut dest = vec![0xAAu8; stride * tmax];
+                unsafe { store_rgba(&bl, smax, tmax, dest.as_mut_ptr(), stride, level) };
+                // Padding between rows must be left alone.
+                for t in 0..tmax {
+                    assert!(dest[t * stride + smax * 4..(t + 1) * stride].iter().all(|&b| b == 0xAA));
+                }
+                match &expected {
+                    None => expected = Some(dest),
+                    Some(e) => assert_eq!(e, &dest, "{}x{} level {:?}", smax, tmax, level),
+                }
+            }
+        }
+    }
+
+    // ============================================================
+    // Full pipeline vs the original interleaved algorithm
+    // ============================================================
+
+    #[test]
+    fn test_full_build_bit_exact_with_original() {
+        let mut rng = Lcg(5);
+        for _ in 0..100 {
+            let smax = 1 + (rng.next_u32() % 34) as usize;
+            let tmax = 1 + (rng.next_u32() % 34) as usize;
+            let size = smax * tmax;
+            let nummaps = 1 + (rng.next_u32() % MAXLIGHTMAPS as u32) as usize;
+            let samples = rng.bytes(size * 3 * nummaps);
+            let stains = rng.bytes(size * 3);
+            let scales = (0..nummaps)
+                .map(|_| [rng.range(0.0, 2.0) * 1.5, rng.range(0.0, 2.0) * 1.5, 1.5])
+                .collect();
+            let dlights = (0..(rng.next_u32() % 4))
+                .map(|_| {
+                    let c = rng.range(0.0, 300.0);
+                    ([rng.range(0.0, 544.0), rng.range(0.0, 544.0)], c, [rng.range(0.0, 1.0), rng.range(0.0, 1.0), rng.range(0.0, 1.0)])
+                })
+                .collect();
+            let surf = RefSurface {
+                smax,
+                tmax,
+                samples: &samples,
+                scales,
+                dlights,
+                stains: if rng.next_u32() & 1 == 0 { Some((&stains, 1.5)) } else { None },
+            };
+
+            let stride = 128 * 4;
+            let mut expected = vec![0u8; stride * tmax];
+            reference_build(&surf, &mut expected, stride);
+            for level in levels() {
+                let mut dest = vec![0u8; stride * tmax];
+                planar_build(&surf, &mut dest, stride, level);
+                assert_eq!(expected, dest, "{}x{} maps {} level {:?}", smax, tmax, nummaps, level);
+            }
+        }
+    }
+
+    // ============================================================
+    // Microbenchmark: every lightmap of a BSP, no GL context
+    // ============================================================
+
+    struct BenchFace {
+        smax: usize,
+        tmax: usize,
+        nummaps: usize,
+        lightofs: Option<usize>,
+    }
+
+    fn rd_i32(b: &[u8], o: usize) -> i32 {
+        i32::from_le_bytes([b[o], b[o + 1], b[o + 2], b[o + 3]])
+    }
+
+    fn rd_f32(b: &[u8], o: usize) -> f32 {
+        f32::from_bits(rd_i32(b, o) as u32)
+    }
+
+    fn rd_u16(b: &[u8], o: usize) -> u16 {
+        u16::from_le_bytes([b[o], b[o + 1]])
+    }
+
+    /// Parse just enough of a BSP to size every lit face (mirrors CalcSurfaceExtents).
+    fn load_bench_faces(data: &[u8]) -> Option<(Vec<u8>, Vec<BenchFace>)> {
+        if rd_i32(data, 0) != IDBSPHEADER || rd_i32(data, 4) != BSPVERSION {
+            return None;
+        }
+        let lump = |n: usize| {
+            assert!(n < HEADER_LUMPS);
+            let ofs = rd_i32(data, 8 + n * 8) as usize;
+            let len = rd_i32(data, 12 + n * 8) as usize;
+            &data[ofs..ofs + len]
+        };
+        let (texinfo, faces, verts) = (lump(LUMP_TEXINFO), lump(LUMP_FACES), lump(LUMP_VERTEXES));
+        let (edges, surfedges) = (lump(LUMP_EDGES), lump(LUMP_SURFEDGES));
+        let lighting = lump(LUMP_LIGHTING).to_vec();
+
+        let mut out = Vec::new();
+        for f in faces.chunks_exact(20) {
+            let firstedge = rd_i32(f, 4);
+            let numedges = rd_u16(f, 8) as i32;
+            let ti = &texinfo[rd_u16(f, 10) as usize * 76..];
+            let flags = rd_i32(ti, 32);
+            if flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP) != 0 {
+                continue;
+            }
+            let nummaps = f[12..16].iter().take_while(|&&s| s != 255).count();
+            let lightofs = rd_i32(f, 16);
+
+            let mut mins = [999999.0f32; 2];
+            let mut maxs = [-99999.0f32; 2];
+            for i in 0..numedges {
+                let e = rd_i32(surfedges, (firstedge + i) as usize * 4);
+                let v = if e >= 0 {
+                    rd_u16(edges, e as usize * 4)
+                } else {
+                    rd_u16(edges, (-e) as usize * 4 + 2)
+                } as usize;
+                for j in 0..2 {
+                    let val = rd_f32(verts, v * 12) * rd_f32(ti, j * 16)
+                        + rd_f32(verts, v * 12 + 4) * rd_f32(ti, j * 16 + 4)
+                        + rd_f32(verts, v * 12 + 8) * rd_f32(ti, j * 16 + 8)
+                        + rd_f32(ti, j * 16 + 12);
+                    mins[j] = mins[j].min(val);
+                    maxs[j] = maxs[j].max(val);
+                }
+            }
+            let extent = |j: usize| (((maxs[j] / 16.0).ceil() as i32 - (mins[j] / 16.0).floor() as i32) * 16) as usize;
+            let (smax, tmax) = ((extent(0) >> 4) + 1, (extent(1) >> 4) + 1);
+            if smax * tmax > BLOCKLIGHT_TEXELS || smax > 128 {
+                continue;
+            }
+            let lightofs = if lightofs >= 0 && (lightofs as usize) + smax * tmax * 3 * nummaps <= lighting.len() {
+                Some(lightofs as usize)
+            } else {
+                None
+            };
+            out.push(BenchFace { smax, tmax, nummaps, lightofs });
+        }
+        Some((lighting, out))
+    }
+
+    /// Usage: MYQ2_BENCH_BSP=baseq2/maps/base1.bsp cargo test -p myq2-renderer --release \
+    ///        bench_build_all_lightmaps -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_build_all_lightmaps() {
+        let Ok(path) = std::env::var("MYQ2_BENCH_BSP") else {
+            eprintln!("MYQ2_BENCH_BSP not set; skipping");
+            return;
+        };
+        let data = std::fs::read(&path).expect("read bsp");
+        let (lighting, faces) = load_bench_faces(&data).expect("not a Quake 2 BSP");
+        let iters: usize = std::env::var("MYQ2_BENCH_ITERS").ok().and_then(|s| s.parse().ok()).unwrap_or(50);
+        let texels: usize = faces.iter().map(|f| f.smax * f.tmax).sum();
+        println!("{}: {} lit faces, {} texels, {} iterations", path, faces.len(), texels, iters);
+
+        let stride = 128 * 4;
+        let mut dest = vec![0u8; stride * 34];
+        let mut bl = Box::new(BlockLights::new());
+        let mut baseline: Option<(u64, f64)> = None;
+
+        for level in levels() {
+            let mut checksum = 0u64;
+            let start = std::time::Instant::now();
+            for _ in 0..iters {
+                for f in &faces {
+                    let size = f.smax * f.tmax;
+                    match f.lightofs {
+                        None => fill(&mut bl, size, 255.0),
+                        Some(ofs) => {
+                            if f.nummaps != 1 {
+                                fill(&mut bl, size, 0.0);
+                            }
+                            for m in 0..f.nummaps {
+                                let samples = &lighting[ofs + m * size * 3..];
+                                accumulate(&mut bl, samples, size, [1.5; 3], f.nummaps == 1, level);
+                            }
+                            // One dlight centred on the face, as a rocket passing by.
+                            let centre = [(f.smax * 8) as f32, (f.tmax * 8) as f32];
+                            add_dlight(&mut bl, f.smax, f.tmax, centre, 200.0, 200.0, [1.0, 0.5, 0.25], level);
+                        }
+                    }
+                    unsafe { store_rgba(&bl, f.smax, f.tmax, dest.as_mut_ptr(), stride, level) };
+                    checksum = checksum.wrapping_mul(31).wrapping_add(dest[..f.smax * 4].iter().map(|&b| b as u64).sum::<u64>());
+                }
+            }
+            let secs = start.elapsed().as_secs_f64();
+            let mtexels = (texels * iters) as f64 / secs / 1.0e6;
+            match baseline {
+                None => {
+                    println!("  {:>6}: {:8.2} ms/pass  {:8.1} Mtexel/s", level.name(), secs * 1000.0 / iters as f64, mtexels);
+                    baseline = Some((checksum, secs));
+                }
+                Some((sum, base_secs)) => {
+                    assert_eq!(sum, checksum, "{} output differs from scalar", level.name());
+                    println!(
+                        "  {:>6}: {:8.2} ms/pass  {:8.1} Mtexel/s  ({:.2}x)",
+                        level.name(),
+                        secs * 1000.0 / iters as f64,
+                        mtexels,
+                        base_secs / secs
+                    );
+                }
+            }
+        }
+    }
+}
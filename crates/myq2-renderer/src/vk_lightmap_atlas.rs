@@ -0,0 +1,641 @@
+// vk_lightmap_atlas.rs — Large-page lightmap atlas with dirty-rectangle uploads
+//
+// The classic path packs lightmaps into 128x128 blocks (LM_AllocBlock) and
+// re-uploads a whole block whenever anything in it changes. In atlas mode the
+// pages are much larger (vk_lightmap_atlas 1024/2048), packed with a skyline
+// allocator, and every page keeps a CPU copy of its texels. Surfaces whose
+// lightmap is rebuilt mark a dirty rectangle; once per frame the rectangles of
+// each page are coalesced and sent as a handful of sub-image uploads.
+//
+// Upload accounting lives here too (LightmapUploadStats) so that bytes and
+// pages touched per frame can be measured with a null refresh.
+
+/// Smallest / largest page edge accepted for atlas mode.
+pub const LM_ATLAS_MIN_SIZE: u32 = 128;
+pub const LM_ATLAS_MAX_SIZE: u32 = 4096;
+
+/// Bytes per lightmap texel (RGBA).
+pub const LM_ATLAS_BYTES: usize = 4;
+
+/// Past this many rectangles on one page they collapse to a bounding box.
+const MAX_DIRTY_RECTS_PER_PAGE: usize = 16;
+
+/// Two rectangles merge when their bounding box wastes no more than this
+/// fraction of its area (uploading a few clean texels beats an extra copy).
+const COALESCE_WASTE: f32 = 0.25;
+
+// ============================================================
+// Rectangles
+// ============================================================
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct LmRect {
+    pub x: u32,
+    pub y: u32,
+    pub w: u32,
+    pub h: u32,
+}
+
+impl LmRect {
+    pub const fn new(x: u32, y: u32, w: u32, h: u32) -> Self {
+        Self { x, y, w, h }
+    }
+
+    #[inline]
+    pub fn area(&self) -> u64 {
+        self.w as u64 * self.h as u64
+    }
+
+    #[inline]
+    pub fn right(&self) -> u32 {
+        self.x + self.w
+    }
+
+    #[inline]
+    pub fn bottom(&self) -> u32 {
+        self.y + self.h
+    }
+
+    pub fn union(&self, o: &LmRect) -> LmRect {
+        let x = self.x.min(o.x);
+        let y = self.y.min(o.y);
+        LmRect::new(x, y, self.right().max(o.right()) - x, self.bottom().max(o.bottom()) - y)
+    }
+
+    pub fn contains(&self, o: &LmRect) -> bool {
+        o.x >= self.x && o.y >= self.y && o.right() <= self.right() && o.bottom() <= self.bottom()
+    }
+
+    /// Whether merging with `o` is cheaper than uploading both separately.
+    fn should_merge(&self, o: &LmRect) -> bool {
+        let u = self.union(o);
+        let used = self.area() + o.area();
+        used as f32 >= u.area() as f32 * (1.0 - COALESCE_WASTE)
+    }
+}
+
+// ============================================================
+// Skyline packer
+// ============================================================
+
+#[derive(Debug, Clone, Copy)]
+struct SkylineSegment {
+    x: u32,
+    y: u32,
+    w: u32,
+}
+
+/// Bottom-left skyline rectangle packer.
+///
+/// Keeps the top edge of the packed area as a list of horizontal segments; a
+/// new rectangle goes where its bottom edge is lowest (ties: least wasted
+/// width). This packs the many small, similarly sized BSP lightmaps far
+/// tighter than the per-column height array of LM_AllocBlock at large page
+/// sizes, and stays O(segments) per allocation.
+#[derive(Debug, Clone)]
+pub struct SkylinePacker {
+    width: u32,
+    height: u32,
+    skyline: Vec<SkylineSegment>,
+    used_area: u64,
+}
+
+impl SkylinePacker {
+    pub fn new(width: u32, height: u32) -> Self {
+        Self {
+            width,
+            height,
+            skyline: vec![SkylineSegment { x: 0, y: 0, w: width }],
+            used_area: 0,
+        }
+    }
+
+    pub fn reset(&mut self) {
+        self.skyline.clear();
+        self.skyline.push(SkylineSegment { x: 0, y: 0, w: self.width });
+        self.used_area = 0;
+    }
+
+    /// Fraction of the page covered by allocations.
+    pub fn occupancy(&self) -> f32 {
+        self.used_area as f32 / (self.width as u64 * self.height as u64) as f32
+    }
+
+    /// Y at which a `w`x`h` rectangle would sit if placed at segment `i`.
+    fn fit(&self, i: usize, w: u32, h: u32) -> Option<u32> {
+        let x = self.skyline[i].x;
+        if x + w > self.width {
+            return None;
+        }
+        let mut remaining = w as i64;
+        let mut y = 0;
+        let mut j = i;
+        while remaining > 0 {
+            let seg = self.skyline[j];
+            y = y.max(seg.y);
+            if y + h > self.height {
+                return None;
+            }
+            remaining -= seg.w as i64;
+            j += 1;
+        }
+        Some(y)
+    }
+
+    /// Reserve a `w`x`h` rectangle, returning its top-left corner.
+    pub fn alloc(&mut self, w: u32, h: u32) -> Option<(u32, u32)> {
+        if w == 0 || h == 0 || w > self.width || h > self.height {
+            return None;
+        }
+
+        let mut best: Option<(usize, u32, u32)> = None; // (segment, y, segment width)
+        for i in 0..self.skyline.len() {
+            if let Some(y) = self.fit(i, w, h) {
+                let seg_w = self.skyline[i].w;
+                let better = match best {
+                    None => true,
+                    Some((_, by, bw)) => y < by || (y == by && seg_w < bw),
+                };
+                if better {
+                    best = Some((i, y, seg_w));
+                }
+            }
+        }
+
+        let (i, y, _) = best?;
+        let x = self.skyline[i].x;
+        self.skyline.insert(i, SkylineSegment { x, y: y + h, w });
+
+        // Trim or drop the segments now covered by the new one.
+        let end = x + w;
+        let j = i + 1;
+        while j < self.skyline.len() {
+            let seg = self.skyline[j];
+            if seg.x >= end {
+                break;
+            }
+            let seg_end = seg.x + seg.w;
+            if seg_end <= end {
+                self.skyline.remove(j);
+            } else {
+                self.skyline[j].x = end;
+                self.skyline[j].w = seg_end - end;
+                break;
+            }
+        }
+
+        // Merge neighbours at the same height.
+        let mut k = 0;
+        while k + 1 < self.skyline.len() {
+            if self.skyline[k].y == self.skyline[k + 1].y {
+                self.skyline[k].w += self.skyline[k + 1].w;
+                self.skyline.remove(k + 1);
+            } else {
+                k += 1;
+            }
+        }
+
+        self.used_area += w as u64 * h as u64;
+        Some((x, y))
+    }
+}
+
+// ============================================================
+// Upload accounting
+// ============================================================
+
+/// Lightmap upload counters, split into the current frame and the running total.
+#[derive(Debug, Clone, Default)]
+pub struct LightmapUploadStats {
+    /// Bytes handed to sub-image/image uploads this frame.
+    pub frame_bytes: u64,
+    /// Upload calls issued this frame.
+    pub frame_uploads: u32,
+    /// Distinct lightmap pages written this frame.
+    pub frame_pages: u32,
+    /// Surfaces whose lightmap was rebuilt this frame.
+    pub frame_surfaces: u32,
+    pub total_bytes: u64,
+    pub total_uploads: u64,
+    touched: Vec<u32>,
+}
+
+impl LightmapUploadStats {
+    pub const fn new() -> Self {
+        Self {
+            frame_bytes: 0,
+            frame_uploads: 0,
+            frame_pages: 0,
+            frame_surfaces: 0,
+            total_bytes: 0,
+            total_uploads: 0,
+            touched: Vec::new(),
+        }
+    }
+
+    /// Reset the per-frame counters.
+    pub fn begin_frame(&mut self) {
+        self.frame_bytes = 0;
+        self.frame_uploads = 0;
+        self.frame_pages = 0;
+        self.frame_surfaces = 0;
+        self.touched.clear();
+    }
+
+    /// Record one upload of `bytes` into `page`.
+    pub fn record_upload(&mut self, page: u32, bytes: u64) {
+        self.frame_bytes += bytes;
+        self.frame_uploads += 1;
+        self.total_bytes += bytes;
+        self.total_uploads += 1;
+        if !self.touched.contains(&page) {
+            self.touched.push(page);
+            self.frame_pages += 1;
+        }
+    }
+
+    pub fn record_surface(&mut self) {
+        self.frame_surfaces += 1;
+    }
+}
+
+// ============================================================
+// Atlas pages
+// ============================================================
+
+struct AtlasPage {
+    packer: SkylinePacker,
+    pixels: Vec<u8>,
+    dirty: Vec<LmRect>,
+}
+
+/// CPU side of the large-page lightmap atlas.
+pub struct LightmapAtlas {
+    size: u32,
+    max_pages: usize,
+    pages: Vec<AtlasPage>,
+    scratch: Vec<u8>,
+}
+
+impl LightmapAtlas {
+    /// `size` is clamped to [LM_ATLAS_MIN_SIZE, LM_ATLAS_MAX_SIZE] and rounded
+    /// down to a power of two.
+    pub fn new(size: u32, max_pages: usize) -> Self {
+        let size = size.clamp(LM_ATLAS_MIN_SIZE, LM_ATLAS_MAX_SIZE);
+        let size = 1u32 << (31 - size.leading_zeros());
+        Self {
+            size,
+            max_pages: max_pages.max(1),
+            pages: Vec::new(),
+            scratch: Vec::new(),
+        }
+    }
+
+    /// Page edge length in texels.
+    pub fn size(&self) -> u32 {
+        self.size
+    }
+
+    /// Bytes per page row.
+    pub fn stride(&self) -> usize {
+        self.size as usize * LM_ATLAS_BYTES
+    }
+
+    pub fn page_count(&self) -> usize {
+        self.pages.len()
+    }
+
+    /// Drop every page (map change).
+    pub fn clear(&mut self) {
+        self.pages.clear();
+    }
+
+    fn new_page(&self) -> AtlasPage {
+        AtlasPage {
+            packer: SkylinePacker::new(self.size, self.size),
+            pixels: vec![0; self.size as usize * self.stride()],
+            dirty: Vec::new(),
+        }
+    }
+
+    /// Reserve a `w`x`h` texel block, opening a new page when none has room.
+    /// Returns (page, x, y).
+    pub fn alloc(&mut self, w: u32, h: u32) -> Option<(u32, u32, u32)> {
+        for (i, page) in self.pages.iter_mut().enumerate() {
+            if let Some((x, y)) = page.packer.alloc(w, h) {
+                return Some((i as u32, x, y));
+            }
+        }
+        if self.pages.len() >= self.max_pages {
+            return None;
+        }
+        let mut page = self.new_page();
+        let (x, y) = page.packer.alloc(w, h)?;
+        self.pages.push(page);
+        Some((self.pages.len() as u32 - 1, x, y))
+    }
+
+    /// RGBA texels of a whole page (`stride()` bytes per row).
+    pub fn page_pixels(&self, page: u32) -> &[u8] {
+        &self.pages[page as usize].pixels
+    }
+
+    pub fn page_pixels_mut(&mut self, page: u32) -> &mut [u8] {
+        &mut self.pages[page as usize].pixels
+    }
+
+    /// Pointer to texel (x, y) of `page`, for R_BuildLightMap.
+    pub fn texel_ptr(&mut self, page: u32, x: u32, y: u32) -> *mut u8 {
+        let ofs = y as usize * self.stride() + x as usize * LM_ATLAS_BYTES;
+        self.pages[page as usize].pixels[ofs..].as_mut_ptr()
+    }
+
+    pub fn page_occupancy(&self, page: u32) -> f32 {
+        self.pages[page as usize].packer.occupancy()
+    }
+
+    /// Mark a region of `page` as needing upload, merging it with overlapping
+    /// or nearby dirty regions.
+    pub fn mark_dirty(&mut self, page: u32, rect: LmRect) {
+        let dirty = &mut self.pages[page as usize].dirty;
+        let mut rect = rect;
+
+        // Absorb existing rectangles until nothing else is worth merging.
+        let mut i = 0;
+        while i < dirty.len() {
+            if dirty[i].contains(&rect) {
+                return;
+            }
+            if rect.contains(&dirty[i]) || rect.should_merge(&dirty[i]) {
+                rect = rect.union(&dirty[i]);
+                dirty.swap_remove(i);
+                i = 0;
+            } else {
+                i += 1;
+            }
+        }
+        dirty.push(rect);
+
+        if dirty.len() > MAX_DIRTY_RECTS_PER_PAGE {
+            let bounds = dirty.iter().skip(1).fold(dirty[0], |a, r| a.union(r));
+            dirty.clear();
+            dirty.push(bounds);
+        }
+    }
+
+    /// Mark a whole page dirty (initial upload).
+    pub fn mark_page_dirty(&mut self, page: u32) {
+        let full = LmRect::new(0, 0, self.size, self.size);
+        let dirty = &mut self.pages[page as usize].dirty;
+        dirty.clear();
+        dirty.push(full);
+    }
+
+    /// Pending dirty rectangles of a page.
+    pub fn dirty_rects(&self, page: u32) -> &[LmRect] {
+        &self.pages[page as usize].dirty
+    }
+
+    pub fn has_dirty(&self) -> bool {
+        self.pages.iter().any(|p| !p.dirty.is_empty())
+    }
+
+    /// Hand every pending rectangle to `upload(page, rect, texels)` with its
+    /// texels packed tightly (rect.w * 4 bytes per row), then clear them.
+    pub fn flush<F>(&mut self, stats: &mut LightmapUploadStats, mut upload: F)
+    where
+        F: FnMut(u32, LmRect, &[u8]),
+    {
+        let stride = self.stride();
+        for (index, page) in self.pages.iter_mut().enumerate() {
+            for rect in page.dirty.drain(..) {
+                let row_bytes = rect.w as usize * LM_ATLAS_BYTES;
+                let bytes = row_bytes * rect.h as usize;
+                let start = rect.y as usize * stride + rect.x as usize * LM_ATLAS_BYTES;
+
+                if row_bytes == stride {
+                    // Full-width band: already contiguous.
+                    upload(index as u32, rect, &page.pixels[start..start + bytes]);
+                } else {
+                    self.scratch.clear();
+                    for row in 0..rect.h as usize {
+                        let src = start + row * stride;
+                        self.scratch.extend_from_slice(&page.pixels[src..src + row_bytes]);
+                    }
+                    upload(index as u32, rect, &self.scratch);
+                }
+                stats.record_upload(index as u32, bytes as u64);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // ============================================================
+    // Skyline packer
+    // ============================================================
+
+    #[test]
+    fn test_skyline_first_alloc_at_origin() {
+        let mut p = SkylinePacker::new(128, 128);
+        assert_eq!(p.alloc(10, 20), Some((0, 0)));
+    }
+
+    #[test]
+    fn test_skyline_fills_row_then_stacks() {
+        let mut p = SkylinePacker::new(64, 64);
+        assert_eq!(p.alloc(32, 16), Some((0, 0)));
+        assert_eq!(p.alloc(32, 16), Some((32, 0)));
+        assert_eq!(p.alloc(32, 16), Some((0, 16)));
+    }
+
+    #[test]
+    fn test_skyline_rejects_oversize() {
+        let mut p = SkylinePacker::new(64, 64);
+        assert_eq!(p.alloc(65, 1), None);
+        assert_eq!(p.alloc(1, 65), None);
+        assert_eq!(p.alloc(0, 4), None);
+    }
+
+    #[test]
+    fn test_skyline_full_page() {
+        let mut p = SkylinePacker::new(32, 32);
+        for _ in 0..16 {
+            assert!(p.alloc(8, 8).is_some());
+        }
+        assert_eq!(p.alloc(8, 8), None);
+        assert!((p.occupancy() - 1.0).abs() < 1e-6);
+    }
+
+    #[test]
+    fn test_skyline_no_overlap() {
+        let mut p = SkylinePacker::new(256, 256);
+        let mut placed: Vec<LmRect> = Vec::new();
+        let mut seed = 7u32;
+        for _ in 0..2000 {
+            seed = seed.wrapping_mul(1103515245).wrapping_add(12345);
+            let w = 1 + (seed >> 16) % 18;
+            let h = 1 + (seed >> 8) % 18;
+            if let Some((x, y)) = p.alloc(w, h) {
+                let r = LmRect::new(x, y, w, h);
+                assert!(r.right() <= 256 && r.bottom() <= 256);
+                for o in &placed {
+                    let overlap = r.x < o.right() && o.x < r.right() && r.y < o.bottom() && o.y < r.bottom();
+                    assert!(!overlap, "{:?} overlaps {:?}", r, o);
+                }
+                placed.push(r);
+            }
+        }
+        assert!(p.occupancy() > 0.7, "occupancy {}", p.occupancy());
+    }
+
+    #[test]
+    fn test_skyline_reset() {
+        let mut p = SkylinePacker::new(16, 16);
+        assert!(p.alloc(16, 16).is_some());
+        assert!(p.alloc(1, 1).is_none());
+        p.reset();
+        assert_eq!(p.alloc(1, 1), Some((0, 0)));
+    }
+
+    // ============================================================
+    // Atlas
+    // ============================================================
+
+    #[test]
+    fn test_atlas_size_rounded_and_clamped() {
+        assert_eq!(LightmapAtlas::new(1000, 4).size(), 512);
+        assert_eq!(LightmapAtlas::new(2048, 4).size(), 2048);
+        assert_eq!(LightmapAtlas::new(16, 4).size(), LM_ATLAS_MIN_SIZE);
+        assert_eq!(LightmapAtlas::new(1 << 20, 4).size(), LM_ATLAS_MAX_SIZE);
+    }
+
+    #[test]
+    fn test_atlas_opens_pages_on_demand() {
+        let mut a = LightmapAtlas::new(128, 2);
+        assert_eq!(a.page_count(), 0);
+        assert_eq!(a.alloc(128, 128), Some((0, 0, 0)));
+        assert_eq!(a.alloc(10, 10), Some((1, 0, 0)));
+        assert_eq!(a.page_count(), 2);
+        assert_eq!(a.alloc(128, 128), None);
+    }
+
+    #[test]
+    fn test_atlas_texel_ptr_offset() {
+        let mut a = LightmapAtlas::new(128, 1);
+        a.alloc(4, 4).unwrap();
+        let base = a.page_pixels_mut(0).as_mut_ptr();
+        let p = a.texel_ptr(0, 3, 2);
+        assert_eq!(p as usize - base as usize, 2 * 128 * 4 + 3 * 4);
+    }
+
+    #[test]
+    fn test_mark_dirty_merges_adjacent() {
+        let mut a = LightmapAtlas::new(128, 1);
+        a.alloc(1, 1).unwrap();
+        a.mark_dirty(0, LmRect::new(0, 0, 8, 8));
+        a.mark_dirty(0, LmRect::new(8, 0, 8, 8));
+        assert_eq!(a.dirty_rects(0), &[LmRect::new(0, 0, 16, 8)]);
+    }
+
+    #[test]
+    fn test_mark_dirty_keeps_distant_rects_apart() {
+        let mut a = LightmapAtlas::new(256, 1);
+        a.alloc(1, 1).unwrap();
+        a.mark_dirty(0, LmRect::new(0, 0, 8, 8));
+        a.mark_dirty(0, LmRect::new(200, 200, 8, 8));
+        assert_eq!(a.dirty_rects(0).len(), 2);
+    }
+
+    #[test]
+    fn test_mark_dirty_contained_is_noop() {
+        let mut a = LightmapAtlas::new(128, 1);
+        a.alloc(1, 1).unwrap();
+        a.mark_dirty(0, LmRect::new(0, 0, 32, 32));
+        a.mark_dirty(0, LmRect::new(4, 4, 4, 4));
+        assert_eq!(a.dirty_rects(0), &[LmRect::new(0, 0, 32, 32)]);
+    }
+
+    #[test]
+    fn test_mark_dirty_caps_rect_count() {
+        let mut a = LightmapAtlas::new(1024, 1);
+        a.alloc(1, 1).unwrap();
+        for i in 0..(MAX_DIRTY_RECTS_PER_PAGE as u32 + 1) {
+            a.mark_dirty(0, LmRect::new(i * 60, i * 60, 2, 2));
+        }
+        assert_eq!(a.dirty_rects(0).len(), 1);
+        let b = a.dirty_rects(0)[0];
+        assert_eq!((b.x, b.y), (0, 0));
+        assert_eq!(b.right(), MAX_DIRTY_RECTS_PER_PAGE as u32 * 60 + 2);
+    }
+
+    #[test]
+    fn test_flush_packs_rect_rows_and_counts() {
+        let mut a = LightmapAtlas::new(128, 2);
+        a.alloc(1, 1).unwrap();
+        {
+            let stride = a.stride();
+            let px = a.page_pixels_mut(0);
+            for y in 0..4 {
+                for x in 0..4 {
+                    px[(10 + y) * stride + (20 + x) * 4] = (y * 4 + x) as u8;
+                }
+            }
+        }
+        a.mark_dirty(0, LmRect::new(20, 10, 4, 4));
+
+        let mut stats = LightmapUploadStats::new();
+        let mut seen = Vec::new();
+        a.flush(&mut stats, |page, rect, data| {
+            assert_eq!(data.len(), (rect.w * rect.h * 4) as usize);
+            let firsts: Vec<u8> = data.chunks(4).map(|c| c[0]).collect();
+            seen.push((page, rect, firsts));
+        });
+        assert_eq!(seen.len(), 1);
+        assert_eq!(seen[0].0, 0);
+        assert_eq!(seen[0].2, (0..16).collect::<Vec<u8>>());
+        assert_eq!(stats.frame_bytes, 64);
+        assert_eq!(stats.frame_uploads, 1);
+        assert_eq!(stats.frame_pages, 1);
+        assert!(!a.has_dirty());
+    }
+
+    #[test]
+    fn test_flush_full_width_band() {
+        let mut a = LightmapAtlas::new(128, 1);
+        a.alloc(1, 1).unwrap();
+        a.mark_page_dirty(0);
+        let mut stats = LightmapUploadStats::new();
+        let mut n = 0;
+        a.flush(&mut stats, |_, rect, data| {
+            assert_eq!(rect, LmRect::new(0, 0, 128, 128));
+            assert_eq!(data.len(), 128 * 128 * 4);
+            n += 1;
+        });
+        assert_eq!(n, 1);
+        assert_eq!(stats.frame_bytes, 128 * 128 * 4);
+    }
+
+    // ============================================================
+    // Stats
+    // ============================================================
+
+    #[test]
+    fn test_stats_pages_touched_deduplicated() {
+        let mut s = LightmapUploadStats::new();
+        s.record_upload(3, 100);
+        s.record_upload(3, 50);
+        s.record_upload(5, 10);
+        assert_eq!(s.frame_pages, 2);
+        assert_eq!(s.frame_uploads, 3);
+        assert_eq!(s.frame_bytes, 160);
+        s.begin_frame();
+        assert_eq!(s.frame_pages, 0);
+        assert_eq!(s.frame_bytes, 0);
+        assert_eq!(s.total_bytes, 160);
+        assert_eq!(s.total_uploads, 3);
+    }
+}
@@ -84,7 +84,8 @@ pub use myq2_common::q_shared::VidDef;
 pub const TEXNUM_LIGHTMAPS: i32 = 1024;
 pub const TEXNUM_SCRAPS: i32 = 1152;
 pub const TEXNUM_IMAGES: i32 = 1153;
-pub const MAX_GLTEXTURES: usize = 1024;
+/// Upper bound on image slots; storage grows in chunks up to this.
+pub const MAX_GLTEXTURES: usize = 8192;
 
 // ============================================================================
 // rserr_t
@@ -256,21 +257,72 @@ pub fn qvk_tex_parameteri(target: u32, pname: u32, param: i32) {
     // SAFETY: Delegates to OpenGL; GL must be loaded via crate::vk_bindings::load_with first.
     unsafe { crate::vk_bindings::TexParameteri(target, pname, param); }
 }
+// State setters go through vk_glstate, which drops calls that would not
+// change anything and counts both kinds. Issued calls are echoed to gl.log
+// when vk_log is set.
+
 pub fn qvk_color4f(r: f32, g: f32, b: f32, a: f32) {
-    // SAFETY: Delegates to OpenGL; GL must be loaded via crate::vk_bindings::load_with first.
-    unsafe { crate::vk_bindings::Color4f(r, g, b, a); }
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().color(r, g, b, a) {
+            crate::vk_rmain::glimp_log_call(format_args!("glColor4f( {}, {}, {}, {} )", r, g, b, a));
+            crate::vk_bindings::Color4f(r, g, b, a);
+        }
+    }
 }
 pub fn qvk_enable(cap: u32) {
-    // SAFETY: Delegates to OpenGL; GL must be loaded via crate::vk_bindings::load_with first.
-    unsafe { crate::vk_bindings::Enable(cap); }
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().enable(cap) {
+            crate::vk_rmain::glimp_log_call(format_args!("glEnable( 0x{:x} )", cap));
+            crate::vk_bindings::Enable(cap);
+        }
+    }
 }
 pub fn qvk_disable(cap: u32) {
-    // SAFETY: Delegates to OpenGL; GL must be loaded via crate::vk_bindings::load_with first.
-    unsafe { crate::vk_bindings::Disable(cap); }
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().disable(cap) {
+            crate::vk_rmain::glimp_log_call(format_args!("glDisable( 0x{:x} )", cap));
+            crate::vk_bindings::Disable(cap);
+        }
+    }
+}
+pub fn qvk_depth_func(func: u32) {
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().depth_func(func) {
+            crate::vk_rmain::glimp_log_call(format_args!("glDepthFunc( 0x{:x} )", func));
+            crate::vk_bindings::DepthFunc(func);
+        }
+    }
+}
+pub fn qvk_alpha_func(func: u32, ref_val: f32) {
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().alpha_func(func, ref_val) {
+            crate::vk_rmain::glimp_log_call(format_args!("glAlphaFunc( 0x{:x}, {} )", func, ref_val));
+            crate::vk_bindings::AlphaFunc(func, ref_val);
+        }
+    }
+}
+pub fn qvk_cull_face(mode: u32) {
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().cull_face(mode) {
+            crate::vk_rmain::glimp_log_call(format_args!("glCullFace( 0x{:x} )", mode));
+            crate::vk_bindings::CullFace(mode);
+        }
+    }
 }
 pub fn qvk_bind_texture(target: u32, texture: i32) {
-    // SAFETY: Delegates to OpenGL; GL must be loaded via crate::vk_bindings::load_with first.
-    unsafe { crate::vk_bindings::BindTexture(target, texture as u32); }
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().bind_texture(target, texture as u32) {
+            crate::vk_rmain::glimp_log_call(format_args!("glBindTexture( 0x{:x}, {} )", target, texture));
+            crate::vk_bindings::BindTexture(target, texture as u32);
+        }
+    }
 }
 pub fn qvk_tex_image2d(
     target: u32, level: i32, internal_format: i32,
@@ -282,23 +334,44 @@ pub fn qvk_tex_image2d(
 }
 pub fn qvk_delete_textures(n: i32, textures: &i32) {
     // SAFETY: Delegates to OpenGL; caller must ensure textures pointer is valid for n elements.
-    unsafe { crate::vk_bindings::DeleteTextures(n, textures as *const i32 as *const u32); }
+    unsafe {
+        let ids = std::slice::from_raw_parts(textures as *const i32 as *const u32, n.max(0) as usize);
+        for &id in ids {
+            crate::vk_glstate::gl_state().forget_texture(id);
+        }
+        crate::vk_bindings::DeleteTextures(n, ids.as_ptr());
+    }
 }
 pub fn qvk_tex_envf(target: u32, pname: u32, param: f32) {
-    // SAFETY: Delegates to OpenGL; GL must be loaded via crate::vk_bindings::load_with first.
-    unsafe { crate::vk_bindings::TexEnvf(target, pname, param); }
+    // SAFETY: render thread only; GL must be loaded via crate::vk_bindings::load_with first.
+    unsafe {
+        if crate::vk_glstate::gl_state().tex_env(target, pname, param) {
+            crate::vk_rmain::glimp_log_call(format_args!("glTexEnvf( 0x{:x}, 0x{:x}, {} )", target, pname, param));
+            crate::vk_bindings::TexEnvf(target, pname, param);
+        }
+    }
 }
 pub fn qvk_select_texture_sgis(texture: u32) {
-    // SAFETY: SGIS texture select maps to glActiveTexture in modern GL.
-    unsafe { crate::vk_bindings::ActiveTexture(texture); }
+    // SGIS texture select maps to glActiveTexture in modern GL.
+    qvk_active_texture_arb(texture);
 }
 pub fn qvk_active_texture_arb(texture: u32) {
     // SAFETY: ARB active texture maps to glActiveTexture.
-    unsafe { crate::vk_bindings::ActiveTexture(texture); }
+    unsafe {
+        if crate::vk_glstate::gl_state().active_texture(texture) {
+            crate::vk_rmain::glimp_log_call(format_args!("glActiveTexture( 0x{:x} )", texture));
+            crate::vk_bindings::ActiveTexture(texture);
+        }
+    }
 }
 pub fn qvk_client_active_texture_arb(texture: u32) {
     // SAFETY: ARB client active texture maps to glClientActiveTexture.
-    unsafe { crate::vk_bindings::ClientActiveTexture(texture); }
+    unsafe {
+        if crate::vk_glstate::gl_state().client_active_texture(texture) {
+            crate::vk_rmain::glimp_log_call(format_args!("glClientActiveTexture( 0x{:x} )", texture));
+            crate::vk_bindings::ClientActiveTexture(texture);
+        }
+    }
 }
 
 // ============================================================================
@@ -391,7 +464,7 @@ pub static mut r_world_matrix: [f32; 16] = [0.0; 16];
 
 pub static mut r_notexture: *mut Image = std::ptr::null_mut();
 
-pub static mut gltextures: [Image; MAX_GLTEXTURES] = unsafe { std::mem::zeroed() };
+pub static mut gltextures: crate::vk_registry::SlotPool<Image> = crate::vk_registry::SlotPool::new();
 pub static mut numgltextures: i32 = 0;
 
 // ============================================================================
@@ -418,8 +491,13 @@ pub fn qvk_rotatef(angle: f32, x: f32, y: f32, z: f32) {
     unsafe { crate::vk_bindings::Rotatef(angle, x, y, z); }
 }
 pub fn qvk_tex_envi(target: u32, pname: u32, param: i32) {
-    // SAFETY: Delegates to OpenGL.
-    unsafe { crate::vk_bindings::TexEnvi(target, pname, param); }
+    // SAFETY: render thread only; delegates to OpenGL.
+    unsafe {
+        if crate::vk_glstate::gl_state().tex_env(target, pname, param as f32) {
+            crate::vk_rmain::glimp_log_call(format_args!("glTexEnvi( 0x{:x}, 0x{:x}, 0x{:x} )", target, pname, param));
+            crate::vk_bindings::TexEnvi(target, pname, param);
+        }
+    }
 }
 pub fn qvk_tex_sub_image_2d(
     target: u32, level: i32, xoffset: i32, yoffset: i32,
@@ -446,8 +524,7 @@ pub unsafe fn vk_bind(texnum: i32) {
         return;
     }
     vk_state.currenttextures[vk_state.currenttmu as usize] = texnum;
-    // SAFETY: Delegates to OpenGL.
-    crate::vk_bindings::BindTexture(crate::vk_bindings::TEXTURE_2D, texnum as u32);
+    qvk_bind_texture(VK_TEXTURE_2D, texnum);
 }
 
 /// Bind a texture on a specific multitexture unit if not already bound.
@@ -458,24 +535,23 @@ pub unsafe fn vk_mbind(target: u32, texnum: i32) {
     }
     vk_select_texture(target);
     vk_state.currenttextures[tmu] = texnum;
-    crate::vk_bindings::BindTexture(crate::vk_bindings::TEXTURE_2D, texnum as u32);
+    qvk_bind_texture(VK_TEXTURE_2D, texnum);
 }
 
 /// Set the texture environment mode for the current TMU.
 pub unsafe fn vk_tex_env(value: u32) {
-    // SAFETY: Delegates to OpenGL.
-    crate::vk_bindings::TexEnvf(crate::vk_bindings::TEXTURE_ENV, crate::vk_bindings::TEXTURE_ENV_MODE, value as f32);
+    qvk_tex_envf(VK_TEXTURE_ENV, VK_TEXTURE_ENV_MODE, value as f32);
 }
 
 /// Enable or disable multitexturing.
 pub unsafe fn vk_enable_multitexture(enable: bool) {
     if enable {
         vk_select_texture(VK_TEXTURE1);
-        crate::vk_bindings::Enable(crate::vk_bindings::TEXTURE_2D);
+        qvk_enable(VK_TEXTURE_2D);
         vk_tex_env(VK_REPLACE as u32);
     } else {
         vk_select_texture(VK_TEXTURE1);
-        crate::vk_bindings::Disable(crate::vk_bindings::TEXTURE_2D);
+        qvk_disable(VK_TEXTURE_2D);
         vk_tex_env(VK_REPLACE as u32);
         vk_select_texture(VK_TEXTURE0);
         vk_tex_env(VK_REPLACE as u32);
@@ -489,9 +565,8 @@ pub unsafe fn vk_select_texture(texture: u32) {
         return;
     }
     vk_state.currenttmu = tmu;
-    // SAFETY: Delegates to OpenGL.
-    crate::vk_bindings::ActiveTexture(texture);
-    crate::vk_bindings::ClientActiveTexture(texture);
+    qvk_active_texture_arb(texture);
+    qvk_client_active_texture_arb(texture);
 }
 
 pub unsafe fn r_cull_box(mins: &Vec3, maxs: &Vec3) -> bool {
@@ -0,0 +1,477 @@
+// vk_mesh_edges.rs — Alias model edge adjacency, silhouettes and shadow projection
+//
+// GL_DrawOutLine redrew every triangle of the glcmd strips and fans as lines
+// each frame, and GL_DrawAliasShadow re-walked the same strips to project
+// each vertex once per reference. Instead, Mod_LoadAliasModel builds the
+// triangle edge adjacency once (AliasEdges). Per frame:
+//
+//   triangle_facing    one facing bit per triangle against the model-space
+//                      eye, 4 (SSE2) or 8 (AVX2) triangles per instruction
+//   silhouette_edges   edges whose two triangles disagree, plus open edges
+//                      of front faces; only these are drawn as outline
+//   project_shadow     flattens the already lerped vertex array onto the
+//                      shadow plane once per vertex, drawn with the triangle
+//                      indices
+//
+// The SIMD facing test performs the scalar operations in the same order, so
+// all paths agree exactly.
+
+use crate::simd::SimdLevel;
+use std::collections::HashMap;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+/// Marks an edge used by only one triangle.
+pub const NO_TRIANGLE: u32 = u32::MAX;
+
+/// An edge between two vertices and the (up to) two triangles sharing it.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct AliasEdge {
+    pub v: [u16; 2],
+    pub tri: [u32; 2],
+}
+
+/// Triangle list and edge adjacency of an alias model.
+pub struct AliasEdges {
+    tris: Vec<[u16; 3]>,
+    edges: Vec<AliasEdge>,
+    /// Edges shared by more than two triangles (the extra uses are ignored).
+    nonmanifold: u32,
+}
+
+fn rd_i32(data: &[u8], ofs: usize) -> Option<i32> {
+    Some(i32::from_le_bytes(data.get(ofs..ofs + 4)?.try_into().ok()?))
+}
+
+fn rd_i16(data: &[u8], ofs: usize) -> Option<i16> {
+    Some(i16::from_le_bytes(data.get(ofs..ofs + 2)?.try_into().ok()?))
+}
+
+impl AliasEdges {
+    /// Build adjacency from triangles of vertex indices. Degenerate triangles
+    /// are dropped.
+    pub fn from_triangles(tris: &[[u16; 3]]) -> Self {
+        let mut out = Self { tris: Vec::with_capacity(tris.len()), edges: Vec::new(), nonmanifold: 0 };
+        let mut lookup: HashMap<(u16, u16), u32> = HashMap::with_capacity(tris.len() * 3 / 2);
+
+        for t in tris {
+            if t[0] == t[1] || t[1] == t[2] || t[2] == t[0] {
+                continue;
+            }
+            let ti = out.tris.len() as u32;
+            out.tris.push(*t);
+            for k in 0..3 {
+                let (a, b) = (t[k], t[(k + 1) % 3]);
+                let key = (a.min(b), a.max(b));
+                match lookup.get(&key) {
+                    Some(&e) => {
+                        let edge = &mut out.edges[e as usize];
+                        if edge.tri[1] == NO_TRIANGLE {
+                            edge.tri[1] = ti;
+                        } else {
+                            out.nonmanifold += 1;
+                        }
+                    }
+                    None => {
+                        lookup.insert(key, out.edges.len() as u32);
+                        out.edges.push(AliasEdge { v: [a, b], tri: [ti, NO_TRIANGLE] });
+                    }
+                }
+            }
+        }
+        out
+    }
+
+    /// Build adjacency from the triangle list of an MD2 file.
+    pub fn from_md2(data: &[u8]) -> Option<Self> {
+        let num_xyz = rd_i32(data, 24)?;
+        let num_tris = rd_i32(data, 32)?;
+        let ofs_tris = rd_i32(data, 52)?;
+        if num_tris < 0 || ofs_tris < 0 {
+            return None;
+        }
+        let mut tris = Vec::with_capacity(num_tris as usize);
+        for i in 0..num_tris as usize {
+            // dtriangle_t: index_xyz[3], index_st[3]
+            let ofs = ofs_tris as usize + i * 12;
+            let mut t = [0u16; 3];
+            for k in 0..3 {
+                let v = rd_i16(data, ofs + k * 2)?;
+                if v < 0 || v as i32 >= num_xyz {
+                    return None;
+                }
+                t[k] = v as u16;
+            }
+            tris.push(t);
+        }
+        Some(Self::from_triangles(&tris))
+    }
+
+    pub fn triangles(&self) -> &[[u16; 3]] {
+        &self.tris
+    }
+
+    pub fn edges(&self) -> &[AliasEdge] {
+        &self.edges
+    }
+
+    /// Edges with only one triangle (holes in the mesh).
+    pub fn open_edges(&self) -> usize {
+        self.edges.iter().filter(|e| e.tri[1] == NO_TRIANGLE).count()
+    }
+
+    pub fn nonmanifold_edges(&self) -> u32 {
+        self.nonmanifold
+    }
+
+    /// Heap bytes held (for modellist-style reporting).
+    pub fn size_bytes(&self) -> usize {
+        self.tris.len() * 6 + self.edges.len() * std::mem::size_of::<AliasEdge>()
+    }
+}
+
+// ============================================================
+// Facing test
+// ============================================================
+
+/// Set `facing[t]` to whether triangle `t` faces `eye` (model space), given
+/// the lerped vertices as [x, y, z, _].
+pub fn triangle_facing(tris: &[[u16; 3]], verts: &[[f32; 4]], eye: [f32; 3], facing: &mut Vec<bool>, level: SimdLevel) {
+    facing.clear();
+    facing.resize(tris.len(), false);
+    assert!(tris.iter().flatten().all(|&i| (i as usize) < verts.len()));
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { facing_avx2(tris, verts, eye, facing) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { facing_sse2(tris, verts, eye, facing, 0) },
+        _ => facing_scalar(tris, verts, eye, facing, 0),
+    }
+}
+
+fn facing_scalar(tris: &[[u16; 3]], verts: &[[f32; 4]], eye: [f32; 3], facing: &mut [bool], start: usize) {
+    for t in start..tris.len() {
+        let a = &verts[tris[t][0] as usize];
+        let b = &verts[tris[t][1] as usize];
+        let c = &verts[tris[t][2] as usize];
+        let e1 = [b[0] - a[0], b[1] - a[1], b[2] - a[2]];
+        let e2 = [c[0] - a[0], c[1] - a[1], c[2] - a[2]];
+        let n = [
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0],
+        ];
+        let d = [eye[0] - a[0], eye[1] - a[1], eye[2] - a[2]];
+        facing[t] = n[0] * d[0] + n[1] * d[1] + n[2] * d[2] > 0.0;
+    }
+}
+
+/// Facing mask of 4 triangles given their corners in structure-of-arrays form.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn facing4_sse2(a: [__m128; 3], b: [__m128; 3], c: [__m128; 3], eye: [__m128; 3]) -> i32 {
+    let e1 = [_mm_sub_ps(b[0], a[0]), _mm_sub_ps(b[1], a[1]), _mm_sub_ps(b[2], a[2])];
+    let e2 = [_mm_sub_ps(c[0], a[0]), _mm_sub_ps(c[1], a[1]), _mm_sub_ps(c[2], a[2])];
+    let nx = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+    let ny = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+    let nz = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+    let dx = _mm_sub_ps(eye[0], a[0]);
+    let dy = _mm_sub_ps(eye[1], a[1]);
+    let dz = _mm_sub_ps(eye[2], a[2]);
+    let dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)), _mm_mul_ps(nz, dz));
+    _mm_movemask_ps(_mm_cmpgt_ps(dot, _mm_setzero_ps()))
+}
+
+/// Load one corner of 4 triangles and transpose to x, y, z vectors.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn gather4_sse2(verts: &[[f32; 4]], idx: [u16; 4]) -> [__m128; 3] {
+    let p = verts.as_ptr() as *const f32;
+    let r0 = _mm_loadu_ps(p.add(idx[0] as usize * 4));
+    let r1 = _mm_loadu_ps(p.add(idx[1] as usize * 4));
+    let r2 = _mm_loadu_ps(p.add(idx[2] as usize * 4));
+    let r3 = _mm_loadu_ps(p.add(idx[3] as usize * 4));
+    let t0 = _mm_unpacklo_ps(r0, r1); // x0 x1 y0 y1
+    let t1 = _mm_unpacklo_ps(r2, r3); // x2 x3 y2 y3
+    let t2 = _mm_unpackhi_ps(r0, r1); // z0 z1 _ _
+    let t3 = _mm_unpackhi_ps(r2, r3); // z2 z3 _ _
+    [_mm_movelh_ps(t0, t1), _mm_movehl_ps(t1, t0), _mm_movelh_ps(t2, t3)]
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn facing_sse2(tris: &[[u16; 3]], verts: &[[f32; 4]], eye: [f32; 3], facing: &mut [bool], start: usize) {
+    let ev = [_mm_set1_ps(eye[0]), _mm_set1_ps(eye[1]), _mm_set1_ps(eye[2])];
+    let body = start + ((tris.len() - start) & !3);
+    let mut t = start;
+    while t < body {
+        let q = &tris[t..t + 4];
+        let corner = |k: usize| gather4_sse2(verts, [q[0][k], q[1][k], q[2][k], q[3][k]]);
+        let mask = facing4_sse2(corner(0), corner(1), corner(2), ev);
+        for k in 0..4 {
+            facing[t + k] = mask & (1 << k) != 0;
+        }
+        t += 4;
+    }
+    facing_scalar(tris, verts, eye, facing, body);
+}
+
+/// Load one corner of 8 triangles and transpose to x, y, z vectors.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "avx2")]
+unsafe fn gather8_avx2(verts: &[[f32; 4]], idx: [u16; 8]) -> [__m256; 3] {
+    let p = verts.as_ptr() as *const f32;
+    let row = |i: usize, j: usize| _mm256_loadu2_m128(p.add(idx[j] as usize * 4), p.add(idx[i] as usize * 4));
+    let (r0, r1, r2, r3) = (row(0, 4), row(1, 5), row(2, 6), row(3, 7));
+    let t0 = _mm256_unpacklo_ps(r0, r1);
+    let t1 = _mm256_unpacklo_ps(r2, r3);
+    let t2 = _mm256_unpackhi_ps(r0, r1);
+    let t3 = _mm256_unpackhi_ps(r2, r3);
+    let x = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t1)));
+    let y = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t1)));
+    let z = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(t2), _mm256_castps_pd(t3)));
+    [x, y, z]
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn facing_avx2(tris: &[[u16; 3]], verts: &[[f32; 4]], eye: [f32; 3], facing: &mut [bool]) {
+    let ev = [_mm256_set1_ps(eye[0]), _mm256_set1_ps(eye[1]), _mm256_set1_ps(eye[2])];
+    let body = tris.len() & !7;
+    let mut t = 0;
+    while t < body {
+        let q = &tris[t..t + 8];
+        let corner = |k: usize| gather8_avx2(verts, std::array::from_fn(|i| q[i][k]));
+        let (a, b, c) = (corner(0), corner(1), corner(2));
+        let e1 = [_mm256_sub_ps(b[0], a[0]), _mm256_sub_ps(b[1], a[1]), _mm256_sub_ps(b[2], a[2])];
+        let e2 = [_mm256_sub_ps(c[0], a[0]), _mm256_sub_ps(c[1], a[1]), _mm256_sub_ps(c[2], a[2])];
+        let nx = _mm256_sub_ps(_mm256_mul_ps(e1[1], e2[2]), _mm256_mul_ps(e1[2], e2[1]));
+        let ny = _mm256_sub_ps(_mm256_mul_ps(e1[2], e2[0]), _mm256_mul_ps(e1[0], e2[2]));
+        let nz = _mm256_sub_ps(_mm256_mul_ps(e1[0], e2[1]), _mm256_mul_ps(e1[1], e2[0]));
+        let dx = _mm256_sub_ps(ev[0], a[0]);
+        let dy = _mm256_sub_ps(ev[1], a[1]);
+        let dz = _mm256_sub_ps(ev[2], a[2]);
+        let dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, dx), _mm256_mul_ps(ny, dy)), _mm256_mul_ps(nz, dz));
+        let mask = _mm256_movemask_ps(_mm256_cmp_ps::<_CMP_GT_OQ>(dot, _mm256_setzero_ps()));
+        for k in 0..8 {
+            facing[t + k] = mask & (1 << k) != 0;
+        }
+        t += 8;
+    }
+    facing_scalar(tris, verts, eye, facing, body);
+}
+
+// ============================================================
+// Silhouettes and shadows
+// ============================================================
+
+/// Append the silhouette edges for `facing` to `out` and return how many
+/// were emitted: edges between a front and a back face, and open edges of
+/// front faces.
+pub fn silhouette_edges(edges: &[AliasEdge], facing: &[bool], out: &mut Vec<[u16; 2]>) -> usize {
+    let before = out.len();
+    for e in edges {
+        let front = facing[e.tri[0] as usize];
+        let silhouette = if e.tri[1] == NO_TRIANGLE { front } else { front != facing[e.tri[1] as usize] };
+        if silhouette {
+            out.push(e.v);
+        }
+    }
+    out.len() - before
+}
+
+/// GL_DrawAliasShadow's projection applied once per lerped vertex: slide
+/// each point along `shadevector` by its height above the light spot and
+/// flatten it to `height`.
+pub fn project_shadow(lerped: &[[f32; 4]], shadevector: [f32; 3], lheight: f32, height: f32, out: &mut [[f32; 4]]) {
+    for (o, p) in out.iter_mut().zip(lerped) {
+        let h = p[2] + lheight;
+        *o = [p[0] - shadevector[0] * h, p[1] - shadevector[1] * h, height, 0.0];
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Closed cube: 8 corners, 12 outward-facing triangles.
+    fn cube() -> (Vec<[f32; 4]>, Vec<[u16; 3]>) {
+        let verts = (0..8)
+            .map(|i| [(i & 1) as f32 * 2.0 - 1.0, ((i >> 1) & 1) as f32 * 2.0 - 1.0, ((i >> 2) & 1) as f32 * 2.0 - 1.0, 0.0])
+            .collect();
+        let tris = vec![
+            [0, 2, 3], [0, 3, 1], // z-
+            [4, 5, 7], [4, 7, 6], // z+
+            [0, 1, 5], [0, 5, 4], // y-
+            [2, 6, 7], [2, 7, 3], // y+
+            [0, 4, 6], [0, 6, 2], // x-
+            [1, 3, 7], [1, 7, 5], // x+
+        ];
+        (verts, tris)
+    }
+
+    fn pseudo_mesh(n_verts: usize, n_tris: usize, seed: u32) -> (Vec<[f32; 4]>, Vec<[u16; 3]>) {
+        let mut x = seed;
+        let mut next = move || {
+            x = x.wrapping_mul(1664525).wrapping_add(1013904223);
+            x >> 8
+        };
+        let verts = (0..n_verts)
+            .map(|_| [(next() % 2000) as f32 * 0.1 - 100.0, (next() % 2000) as f32 * 0.1 - 100.0, (next() % 2000) as f32 * 0.1 - 100.0, 0.0])
+            .collect();
+        let tris = (0..n_tris)
+            .map(|_| [(next() as usize % n_verts) as u16, (next() as usize % n_verts) as u16, (next() as usize % n_verts) as u16])
+            .collect();
+        (verts, tris)
+    }
+
+    #[test]
+    fn test_cube_adjacency_is_closed() {
+        let (_, tris) = cube();
+        let edges = AliasEdges::from_triangles(&tris);
+        assert_eq!(edges.triangles().len(), 12);
+        assert_eq!(edges.edges().len(), 18);
+        assert_eq!(edges.open_edges(), 0);
+        assert_eq!(edges.nonmanifold_edges(), 0);
+    }
+
+    #[test]
+    fn test_degenerate_triangles_dropped() {
+        let edges = AliasEdges::from_triangles(&[[0, 1, 2], [3, 3, 4], [1, 2, 5]]);
+        assert_eq!(edges.triangles().len(), 2);
+        assert_eq!(edges.edges().len(), 5);
+        assert_eq!(edges.open_edges(), 4);
+    }
+
+    #[test]
+    fn test_cube_silhouette_from_corner_and_face() {
+        let (verts, tris) = cube();
+        let edges = AliasEdges::from_triangles(&tris);
+        let mut facing = Vec::new();
+        let mut out = Vec::new();
+
+        // Looking at a corner: three faces visible, silhouette is a hexagon.
+        triangle_facing(edges.triangles(), &verts, [10.0, 10.0, 10.0], &mut facing, SimdLevel::Scalar);
+        assert_eq!(facing.iter().filter(|&&f| f).count(), 6);
+        assert_eq!(silhouette_edges(edges.edges(), &facing, &mut out), 6);
+
+        // Looking straight at a face: its outline is the 4 border edges.
+        out.clear();
+        triangle_facing(edges.triangles(), &verts, [0.0, 0.0, 10.0], &mut facing, SimdLevel::Scalar);
+        assert_eq!(facing.iter().filter(|&&f| f).count(), 2);
+        assert_eq!(silhouette_edges(edges.edges(), &facing, &mut out), 4);
+        for e in &out {
+            assert!(verts[e[0] as usize][2] == 1.0 && verts[e[1] as usize][2] == 1.0);
+        }
+    }
+
+    #[test]
+    fn test_open_edges_of_front_faces_are_silhouette() {
+        let verts = vec![[0.0, 0.0, 0.0, 0.0], [1.0, 0.0, 0.0, 0.0], [0.0, 1.0, 0.0, 0.0]];
+        let edges = AliasEdges::from_triangles(&[[0, 1, 2]]);
+        let mut facing = Vec::new();
+        let mut out = Vec::new();
+        triangle_facing(edges.triangles(), &verts, [0.0, 0.0, 5.0], &mut facing, SimdLevel::Scalar);
+        assert_eq!(silhouette_edges(edges.edges(), &facing, &mut out), 3);
+        out.clear();
+        triangle_facing(edges.triangles(), &verts, [0.0, 0.0, -5.0], &mut facing, SimdLevel::Scalar);
+        assert_eq!(silhouette_edges(edges.edges(), &facing, &mut out), 0);
+    }
+
+    #[test]
+    fn test_facing_simd_matches_scalar() {
+        for n_tris in [0, 1, 3, 4, 5, 7, 8, 9, 17, 200, 1001] {
+            let (verts, tris) = pseudo_mesh(300, n_tris, 11 + n_tris as u32);
+            let eye = [37.5, -12.25, 80.0];
+            let mut reference = Vec::new();
+            triangle_facing(&tris, &verts, eye, &mut reference, SimdLevel::Scalar);
+            for level in SimdLevel::supported() {
+                let mut facing = Vec::new();
+                triangle_facing(&tris, &verts, eye, &mut facing, level);
+                assert_eq!(facing, reference, "{} n={}", level.name(), n_tris);
+            }
+        }
+    }
+
+    #[test]
+    fn test_project_shadow_matches_gl_drawaliasshadow() {
+        let lerped = vec![[10.0, 20.0, 5.0, 0.0], [-4.0, 2.0, 0.0, 0.0]];
+        let mut out = vec![[0.0f32; 4]; 2];
+        let sv = [0.5, -0.25, 1.0];
+        project_shadow(&lerped, sv, 24.0, -23.99, &mut out);
+        assert_eq!(out[0], [10.0 - 0.5 * 29.0, 20.0 + 0.25 * 29.0, -23.99, 0.0]);
+        assert_eq!(out[1], [-4.0 - 0.5 * 24.0, 2.0 + 0.25 * 24.0, -23.99, 0.0]);
+    }
+
+    #[test]
+    fn test_from_md2_reads_triangles() {
+        // header (68 bytes) followed by two dtriangle_t
+        let mut data = vec![0u8; 68 + 24];
+        data[24..28].copy_from_slice(&4i32.to_le_bytes()); // num_xyz
+        data[32..36].copy_from_slice(&2i32.to_le_bytes()); // num_tris
+        data[52..56].copy_from_slice(&68i32.to_le_bytes()); // ofs_tris
+        for (i, t) in [[0i16, 1, 2], [2, 1, 3]].iter().enumerate() {
+            for k in 0..3 {
+                data[68 + i * 12 + k * 2..][..2].copy_from_slice(&t[k].to_le_bytes());
+            }
+        }
+        let edges = AliasEdges::from_md2(&data).unwrap();
+        assert_eq!(edges.triangles(), &[[0, 1, 2], [2, 1, 3]]);
+        assert_eq!(edges.edges().len(), 5);
+        assert_eq!(edges.open_edges(), 4);
+
+        // out-of-range vertex index
+        data[68..70].copy_from_slice(&9i16.to_le_bytes());
+        assert!(AliasEdges::from_md2(&data).is_none());
+    }
+
+    /// Usage: MYQ2_BENCH_MD2=baseq2/players/male/tris.md2 \
+    ///        cargo test -p myq2-renderer --release report_md2_edges -- --ignored --nocapture
+    ///
+    /// Prints each model's edge counts and the silhouette edges emitted per
+    /// frame, averaged over all frames from eight eye positions, against the
+    /// 3 lines per triangle GL_DrawOutLine drew.
+    #[test]
+    #[ignore]
+    fn report_md2_edges() {
+        let Ok(paths) = std::env::var("MYQ2_BENCH_MD2") else {
+            eprintln!("MYQ2_BENCH_MD2 not set; skipping");
+            return;
+        };
+        for path in std::env::split_paths(&paths) {
+            let data = std::fs::read(&path).expect("read md2");
+            let frames = crate::vk_mesh_simd::AliasFrames::from_md2(&data).expect("not an MD2");
+            let edges = AliasEdges::from_md2(&data).expect("bad triangles");
+
+            let mut facing = Vec::new();
+            let mut out = Vec::new();
+            let mut emitted = 0usize;
+            let mut samples = 0usize;
+            for f in 0..frames.num_frames() {
+                let (verts, _) = frames.frame(f);
+                for k in 0..8 {
+                    let a = k as f32 * std::f32::consts::FRAC_PI_4;
+                    let eye = [a.cos() * 200.0, a.sin() * 200.0, 40.0];
+                    triangle_facing(edges.triangles(), verts, eye, &mut facing, crate::simd::level());
+                    out.clear();
+                    emitted += silhouette_edges(edges.edges(), &facing, &mut out);
+                    samples += 1;
+                }
+            }
+            println!(
+                "{}: {} tris, {} edges ({} open, {} non-manifold), {:.1} silhouette edges/frame vs {} outline lines",
+                path.display(),
+                edges.triangles().len(),
+                edges.edges().len(),
+                edges.open_edges(),
+                edges.nonmanifold_edges(),
+                emitted as f64 / samples.max(1) as f64,
+                edges.triangles().len() * 3
+            );
+        }
+    }
+}
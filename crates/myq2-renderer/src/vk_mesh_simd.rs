@@ -0,0 +1,641 @@
+// vk_mesh_simd.rs — Vectorized alias model (MD2) vertex interpolation
+//
+// GL_LerpVerts blends two frames of byte-packed dtrivertx_t vertices for every
+// visible alias model every frame. Two kernels are provided:
+//
+//   lerp_verts    the original byte path: move + ov*backv + v*frontv, with the
+//                 bytes unpacked to floats 4 (SSE2) or 8 (AVX2) vertices at a
+//                 time. Bit-identical to the scalar loop.
+//   lerp_frames   the same blend over frames decoded to floats once at load
+//                 (AliasFrames), so per frame there is no unpacking and no
+//                 per-frame scale/translate folding.
+//
+// Output vertices are [x, y, z, 0] so each one is a single 16-byte store
+// (s_lerped is padded the same way in the original).
+
+use crate::simd::SimdLevel;
+use myq2_common::common::BYTEDIRS;
+use myq2_common::qcommon::NUMVERTEXNORMALS;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+/// Distance the powerup shells are pushed out along the vertex normal.
+pub const POWERSUIT_SCALE: f32 = 4.0;
+
+/// Bytes per dtrivertx_t (v[3], lightnormalindex).
+pub const TRIVERTX_SIZE: usize = 4;
+
+/// Vertex normals padded to 16 bytes for vector loads.
+static NORMALS4: [[f32; 4]; NUMVERTEXNORMALS] = pad_normals();
+
+const fn pad_normals() -> [[f32; 4]; NUMVERTEXNORMALS] {
+    let mut out = [[0.0; 4]; NUMVERTEXNORMALS];
+    let mut i = 0;
+    while i < NUMVERTEXNORMALS {
+        out[i] = [BYTEDIRS[i][0], BYTEDIRS[i][1], BYTEDIRS[i][2], 0.0];
+        i += 1;
+    }
+    out
+}
+
+#[inline]
+fn normal4(index: u8) -> &'static [f32; 4] {
+    &NORMALS4[(index as usize).min(NUMVERTEXNORMALS - 1)]
+}
+
+// ============================================================
+// Float frames (built at Mod_LoadAliasModel)
+// ============================================================
+
+/// Every frame of an alias model decoded to model-space floats
+/// (v * scale + translate), plus each vertex's normal index.
+pub struct AliasFrames {
+    num_xyz: usize,
+    num_frames: usize,
+    positions: Vec<[f32; 4]>,
+    normals: Vec<u8>,
+}
+
+fn rd_i32(data: &[u8], ofs: usize) -> Option<i32> {
+    Some(i32::from_le_bytes(data.get(ofs..ofs + 4)?.try_into().ok()?))
+}
+
+fn rd_f32(data: &[u8], ofs: usize) -> Option<f32> {
+    Some(f32::from_le_bytes(data.get(ofs..ofs + 4)?.try_into().ok()?))
+}
+
+impl AliasFrames {
+    /// Decode the frames of an MD2 file. Returns None if the header or frame
+    /// block is malformed (the loader has already rejected such files).
+    pub fn from_md2(data: &[u8]) -> Option<Self> {
+        let framesize = rd_i32(data, 16)?;
+        let num_xyz = rd_i32(data, 24)?;
+        let num_frames = rd_i32(data, 40)?;
+        let ofs_frames = rd_i32(data, 56)?;
+        if num_xyz <= 0 || num_frames <= 0 || ofs_frames < 0 {
+            return None;
+        }
+        let (num_xyz, num_frames) = (num_xyz as usize, num_frames as usize);
+        let verts_ofs = 40; // scale[3], translate[3], name[16]
+        if (framesize as usize) < verts_ofs + num_xyz * TRIVERTX_SIZE {
+            return None;
+        }
+
+        let mut frames = Self {
+            num_xyz,
+            num_frames,
+            positions: Vec::with_capacity(num_xyz * num_frames),
+            normals: Vec::with_capacity(num_xyz * num_frames),
+        };
+        for f in 0..num_frames {
+            let ofs = ofs_frames as usize + f * framesize as usize;
+            let mut scale = [0.0f32; 3];
+            let mut translate = [0.0f32; 3];
+            for i in 0..3 {
+                scale[i] = rd_f32(data, ofs + i * 4)?;
+                translate[i] = rd_f32(data, ofs + 12 + i * 4)?;
+            }
+            let verts = data.get(ofs + verts_ofs..ofs + verts_ofs + num_xyz * TRIVERTX_SIZE)?;
+            for v in verts.chunks_exact(TRIVERTX_SIZE) {
+                frames.positions.push([
+                    v[0] as f32 * scale[0] + translate[0],
+                    v[1] as f32 * scale[1] + translate[1],
+                    v[2] as f32 * scale[2] + translate[2],
+                    0.0,
+                ]);
+                frames.normals.push(v[3]);
+            }
+        }
+        Some(frames)
+    }
+
+    pub fn num_xyz(&self) -> usize {
+        self.num_xyz
+    }
+
+    pub fn num_frames(&self) -> usize {
+        self.num_frames
+    }
+
+    /// Positions and normal indices of frame `f`.
+    pub fn frame(&self, f: usize) -> (&[[f32; 4]], &[u8]) {
+        let r = f * self.num_xyz..(f + 1) * self.num_xyz;
+        (&self.positions[r.clone()], &self.normals[r])
+    }
+
+    /// Heap bytes held (for modellist-style reporting).
+    pub fn size_bytes(&self) -> usize {
+        self.positions.len() * 16 + self.normals.len()
+    }
+}
+
+// ============================================================
+// Entry points (dispatch on SimdLevel)
+// ============================================================
+
+/// GL_LerpVerts over byte vertices. `v`/`ov` are the current and old frames'
+/// dtrivertx_t arrays (4 bytes per vertex). With `shell` set, every vertex is
+/// pushed out by that distance along the current frame's normal.
+pub fn lerp_verts(
+    v: &[u8],
+    ov: &[u8],
+    nverts: usize,
+    mv: [f32; 3],
+    frontv: [f32; 3],
+    backv: [f32; 3],
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+    level: SimdLevel,
+) {
+    assert!(v.len() >= nverts * TRIVERTX_SIZE && ov.len() >= nverts * TRIVERTX_SIZE && out.len() >= nverts);
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { lerp_verts_avx2(v, ov, nverts, mv, frontv, backv, shell, out) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { lerp_verts_sse2(v, ov, nverts, mv, frontv, backv, shell, out) },
+        _ => lerp_verts_scalar(v, ov, 0, nverts, mv, frontv, backv, shell, out),
+    }
+}
+
+/// Blend two float frames: move + back*backlerp + front*frontlerp, where
+/// `mv` is only the (rotated) origin delta scaled by backlerp. `normals` are
+/// the current frame's normal indices, used when `shell` is set.
+pub fn lerp_frames(
+    front: &[[f32; 4]],
+    back: &[[f32; 4]],
+    normals: &[u8],
+    mv: [f32; 3],
+    frontlerp: f32,
+    backlerp: f32,
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+    level: SimdLevel,
+) {
+    let n = front.len();
+    assert!(back.len() >= n && out.len() >= n && (shell.is_none() || normals.len() >= n));
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { lerp_frames_avx2(front, back, normals, mv, frontlerp, backlerp, shell, out) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { lerp_frames_sse2(front, back, normals, 0, mv, frontlerp, backlerp, shell, out) },
+        _ => lerp_frames_scalar(front, back, normals, 0, mv, frontlerp, backlerp, shell, out),
+    }
+}
+
+// ============================================================
+// Scalar reference
+// ============================================================
+
+fn lerp_verts_scalar(
+    v: &[u8],
+    ov: &[u8],
+    start: usize,
+    nverts: usize,
+    mv: [f32; 3],
+    frontv: [f32; 3],
+    backv: [f32; 3],
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+) {
+    for i in start..nverts {
+        let p = &v[i * TRIVERTX_SIZE..];
+        let op = &ov[i * TRIVERTX_SIZE..];
+        let o = &mut out[i];
+        for j in 0..3 {
+            o[j] = mv[j] + op[j] as f32 * backv[j] + p[j] as f32 * frontv[j];
+        }
+        o[3] = 0.0;
+        if let Some(scale) = shell {
+            let n = normal4(p[3]);
+            for j in 0..3 {
+                o[j] += n[j] * scale;
+            }
+        }
+    }
+}
+
+fn lerp_frames_scalar(
+    front: &[[f32; 4]],
+    back: &[[f32; 4]],
+    normals: &[u8],
+    start: usize,
+    mv: [f32; 3],
+    frontlerp: f32,
+    backlerp: f32,
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+) {
+    for i in start..front.len() {
+        let o = &mut out[i];
+        for j in 0..3 {
+            o[j] = mv[j] + back[i][j] * backlerp + front[i][j] * frontlerp;
+        }
+        o[3] = 0.0;
+        if let Some(scale) = shell {
+            let n = normal4(normals[i]);
+            for j in 0..3 {
+                o[j] += n[j] * scale;
+            }
+        }
+    }
+}
+
+// ============================================================
+// SSE2
+// ============================================================
+
+/// Widen 16 bytes (4 vertices) to four [x, y, z, n] float vectors.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn unpack4_sse2(p: *const u8) -> [__m128; 4] {
+    let bytes = _mm_loadu_si128(p as *const __m128i);
+    let zero = _mm_setzero_si128();
+    let lo = _mm_unpacklo_epi8(bytes, zero);
+    let hi = _mm_unpackhi_epi8(bytes, zero);
+    [
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)),
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)),
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)),
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)),
+    ]
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn lerp_verts_sse2(
+    v: &[u8],
+    ov: &[u8],
+    nverts: usize,
+    mv: [f32; 3],
+    frontv: [f32; 3],
+    backv: [f32; 3],
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+) {
+    let m = _mm_setr_ps(mv[0], mv[1], mv[2], 0.0);
+    let fv = _mm_setr_ps(frontv[0], frontv[1], frontv[2], 0.0);
+    let bv = _mm_setr_ps(backv[0], backv[1], backv[2], 0.0);
+    let body = nverts & !3;
+    let dst = out.as_mut_ptr() as *mut f32;
+
+    let mut i = 0;
+    while i < body {
+        let cur = unpack4_sse2(v.as_ptr().add(i * TRIVERTX_SIZE));
+        let old = unpack4_sse2(ov.as_ptr().add(i * TRIVERTX_SIZE));
+        for k in 0..4 {
+            let mut r = _mm_add_ps(_mm_add_ps(m, _mm_mul_ps(old[k], bv)), _mm_mul_ps(cur[k], fv));
+            if let Some(scale) = shell {
+                let n = _mm_loadu_ps(normal4(v[(i + k) * TRIVERTX_SIZE + 3]).as_ptr());
+                r = _mm_add_ps(r, _mm_mul_ps(n, _mm_set1_ps(scale)));
+            }
+            _mm_storeu_ps(dst.add((i + k) * 4), r);
+        }
+        i += 4;
+    }
+    lerp_verts_scalar(v, ov, body, nverts, mv, frontv, backv, shell, out);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn lerp_frames_sse2(
+    front: &[[f32; 4]],
+    back: &[[f32; 4]],
+    normals: &[u8],
+    start: usize,
+    mv: [f32; 3],
+    frontlerp: f32,
+    backlerp: f32,
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+) {
+    let m = _mm_setr_ps(mv[0], mv[1], mv[2], 0.0);
+    let fl = _mm_set1_ps(frontlerp);
+    let bl = _mm_set1_ps(backlerp);
+    let src_f = front.as_ptr() as *const f32;
+    let src_b = back.as_ptr() as *const f32;
+    let dst = out.as_mut_ptr() as *mut f32;
+
+    for i in start..front.len() {
+        let f = _mm_loadu_ps(src_f.add(i * 4));
+        let b = _mm_loadu_ps(src_b.add(i * 4));
+        let mut r = _mm_add_ps(_mm_add_ps(m, _mm_mul_ps(b, bl)), _mm_mul_ps(f, fl));
+        if let Some(scale) = shell {
+            let n = _mm_loadu_ps(normal4(normals[i]).as_ptr());
+            r = _mm_add_ps(r, _mm_mul_ps(n, _mm_set1_ps(scale)));
+        }
+        // Lane 3 is 0 in the frames, so it stays 0 here.
+        _mm_storeu_ps(dst.add(i * 4), r);
+    }
+}
+
+// ============================================================
+// AVX2
+// ============================================================
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn lerp_verts_avx2(
+    v: &[u8],
+    ov: &[u8],
+    nverts: usize,
+    mv: [f32; 3],
+    frontv: [f32; 3],
+    backv: [f32; 3],
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+) {
+    let m = _mm256_setr_ps(mv[0], mv[1], mv[2], 0.0, mv[0], mv[1], mv[2], 0.0);
+    let fv = _mm256_setr_ps(frontv[0], frontv[1], frontv[2], 0.0, frontv[0], frontv[1], frontv[2], 0.0);
+    let bv = _mm256_setr_ps(backv[0], backv[1], backv[2], 0.0, backv[0], backv[1], backv[2], 0.0);
+    let body = nverts & !7;
+    let dst = out.as_mut_ptr() as *mut f32;
+
+    let mut i = 0;
+    while i < body {
+        // 8 vertices = 32 bytes, widened two vertices per register.
+        let pv = v.as_ptr().add(i * TRIVERTX_SIZE);
+        let pov = ov.as_ptr().add(i * TRIVERTX_SIZE);
+        for k in 0..4 {
+            let cur = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(pv.add(k * 8) as *const __m128i)));
+            let old = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(pov.add(k * 8) as *const __m128i)));
+            let mut r = _mm256_add_ps(_mm256_add_ps(m, _mm256_mul_ps(old, bv)), _mm256_mul_ps(cur, fv));
+            if let Some(scale) = shell {
+                let j = (i + k * 2) * TRIVERTX_SIZE + 3;
+                let n = _mm256_loadu2_m128(normal4(v[j + TRIVERTX_SIZE]).as_ptr(), normal4(v[j]).as_ptr());
+                r = _mm256_add_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(scale)));
+            }
+            _mm256_storeu_ps(dst.add((i + k * 2) * 4), r);
+        }
+        i += 8;
+    }
+    lerp_verts_scalar(v, ov, body, nverts, mv, frontv, backv, shell, out);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn lerp_frames_avx2(
+    front: &[[f32; 4]],
+    back: &[[f32; 4]],
+    normals: &[u8],
+    mv: [f32; 3],
+    frontlerp: f32,
+    backlerp: f32,
+    shell: Option<f32>,
+    out: &mut [[f32; 4]],
+) {
+    let m = _mm256_setr_ps(mv[0], mv[1], mv[2], 0.0, mv[0], mv[1], mv[2], 0.0);
+    let fl = _mm256_set1_ps(frontlerp);
+    let bl = _mm256_set1_ps(backlerp);
+    let src_f = front.as_ptr() as *const f32;
+    let src_b = back.as_ptr() as *const f32;
+    let dst = out.as_mut_ptr() as *mut f32;
+    let n = front.len();
+    let body = n & !7;
+
+    let mut i = 0;
+    while i < body {
+        for k in (0..8).step_by(2) {
+            let f = _mm256_loadu_ps(src_f.add((i + k) * 4));
+            let b = _mm256_loadu_ps(src_b.add((i + k) * 4));
+            let mut r = _mm256_add_ps(_mm256_add_ps(m, _mm256_mul_ps(b, bl)), _mm256_mul_ps(f, fl));
+            if let Some(scale) = shell {
+                let nv = _mm256_loadu2_m128(normal4(normals[i + k + 1]).as_ptr(), normal4(normals[i + k]).as_ptr());
+                r = _mm256_add_ps(r, _mm256_mul_ps(nv, _mm256_set1_ps(scale)));
+            }
+            _mm256_storeu_ps(dst.add((i + k) * 4), r);
+        }
+        i += 8;
+    }
+    lerp_frames_scalar(front, back, normals, body, mv, frontlerp, backlerp, shell, out);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn levels() -> Vec<SimdLevel> {
+        SimdLevel::supported()
+    }
+
+    fn pseudo_bytes(n: usize, seed: u32) -> Vec<u8> {
+        let mut x = seed;
+        (0..n)
+            .map(|i| {
+                x = x.wrapping_mul(1664525).wrapping_add(1013904223);
+                let b = (x >> 24) as u8;
+                // lightnormalindex must stay in the table most of the time
+                if i % 4 == 3 { b % 170 } else { b }
+            })
+            .collect()
+    }
+
+    /// Build an MD2 image with `frames` of `num_xyz` vertices.
+    fn build_md2(num_xyz: usize, frames: &[([f32; 3], [f32; 3], Vec<u8>)]) -> Vec<u8> {
+        let framesize = 40 + num_xyz * 4;
+        let ofs_frames = 68;
+        let mut data = vec![0u8; ofs_frames + framesize * frames.len()];
+        let put = |ofs: usize, b: [u8; 4], data: &mut Vec<u8>| data[ofs..ofs + 4].copy_from_slice(&b);
+        put(0, myq2_common::qfiles::IDALIASHEADER.to_le_bytes(), &mut data);
+        put(4, 8i32.to_le_bytes(), &mut data);
+        put(16, (framesize as i32).to_le_bytes(), &mut data);
+        put(24, (num_xyz as i32).to_le_bytes(), &mut data);
+        put(40, (frames.len() as i32).to_le_bytes(), &mut data);
+        put(56, (ofs_frames as i32).to_le_bytes(), &mut data);
+        put(64, (data.len() as i32).to_le_bytes(), &mut data);
+        for (f, (scale, translate, verts)) in frames.iter().enumerate() {
+            let ofs = ofs_frames + f * framesize;
+            for i in 0..3 {
+                put(ofs + i * 4, scale[i].to_le_bytes(), &mut data);
+                put(ofs + 12 + i * 4, translate[i].to_le_bytes(), &mut data);
+            }
+            data[ofs + 40..ofs + 40 + num_xyz * 4].copy_from_slice(verts);
+        }
+        data
+    }
+
+    #[test]
+    fn test_normals_padded() {
+        for i in 0..NUMVERTEXNORMALS {
+            assert_eq!(&NORMALS4[i][..3], &BYTEDIRS[i][..]);
+            assert_eq!(NORMALS4[i][3], 0.0);
+        }
+        // out-of-range indices clamp instead of reading past the table
+        assert_eq!(normal4(255), &NORMALS4[NUMVERTEXNORMALS - 1]);
+    }
+
+    #[test]
+    fn test_lerp_verts_simd_matches_scalar() {
+        for nverts in [0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 100, 533] {
+            let v = pseudo_bytes(nverts * 4, 1 + nverts as u32);
+            let ov = pseudo_bytes(nverts * 4, 77 + nverts as u32);
+            for shell in [None, Some(POWERSUIT_SCALE)] {
+                let args = ([1.5, -2.25, 30.0], [0.19, 0.21, 0.23], [0.07, 0.05, 0.11]);
+                let mut reference = vec![[9.0f32; 4]; nverts];
+                lerp_verts(&v, &ov, nverts, args.0, args.1, args.2, shell, &mut reference, SimdLevel::Scalar);
+                for level in levels() {
+                    let mut out = vec![[9.0f32; 4]; nverts];
+                    lerp_verts(&v, &ov, nverts, args.0, args.1, args.2, shell, &mut out, level);
+                    let bits = |a: &[[f32; 4]]| a.iter().flatten().map(|f| f.to_bits()).collect::<Vec<_>>();
+                    assert_eq!(bits(&out), bits(&reference), "{} nverts={} shell={:?}", level.name(), nverts, shell);
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_lerp_verts_matches_gl_lerpverts() {
+        // One vertex worked by hand: move + ov*backv + v*frontv.
+        let v = [10u8, 20, 30, 0];
+        let ov = [2u8, 4, 6, 0];
+        let mut out = [[0.0f32; 4]];
+        lerp_verts(&v, &ov, 1, [1.0, 2.0, 3.0], [0.5, 0.5, 0.5], [0.25, 0.25, 0.25], None, &mut out, SimdLevel::Scalar);
+        assert_eq!(out[0], [1.0 + 0.5 + 5.0, 2.0 + 1.0 + 10.0, 3.0 + 1.5 + 15.0, 0.0]);
+    }
+
+    #[test]
+    fn test_lerp_frames_simd_matches_scalar() {
+        for n in [0, 1, 2, 7, 8, 9, 31, 64, 257] {
+            let bytes = pseudo_bytes(n * 4, 5 + n as u32);
+            let front: Vec<[f32; 4]> = bytes.chunks(4).map(|c| [c[0] as f32 * 0.3, c[1] as f32 * -0.7, c[2] as f32 + 0.5, 0.0]).collect();
+            let back: Vec<[f32; 4]> = front.iter().map(|p| [p[1], p[2], p[0], 0.0]).collect();
+            let normals: Vec<u8> = bytes.chunks(4).map(|c| c[3]).collect();
+            for shell in [None, Some(POWERSUIT_SCALE)] {
+                let mut reference = vec![[0.0f32; 4]; n];
+                lerp_frames(&front, &back, &normals, [0.5, -0.5, 2.0], 0.3, 0.7, shell, &mut reference, SimdLevel::Scalar);
+                for level in levels() {
+                    let mut out = vec![[1.0f32; 4]; n];
+                    lerp_frames(&front, &back, &normals, [0.5, -0.5, 2.0], 0.3, 0.7, shell, &mut out, level);
+                    let bits = |a: &[[f32; 4]]| a.iter().flatten().map(|f| f.to_bits()).collect::<Vec<_>>();
+                    assert_eq!(bits(&out), bits(&reference), "{} n={} shell={:?}", level.name(), n, shell);
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_alias_frames_from_md2() {
+        let verts0 = vec![0u8, 1, 2, 7, 255, 128, 64, 3];
+        let verts1 = vec![10u8, 20, 30, 5, 1, 1, 1, 6];
+        let md2 = build_md2(2, &[
+            ([1.0, 2.0, 0.5], [-8.0, 0.0, 4.0], verts0),
+            ([0.25, 0.25, 0.25], [1.0, 1.0, 1.0], verts1),
+        ]);
+        let frames = AliasFrames::from_md2(&md2).unwrap();
+        assert_eq!(frames.num_xyz(), 2);
+        assert_eq!(frames.num_frames(), 2);
+        let (p0, n0) = frames.frame(0);
+        assert_eq!(p0, &[[-8.0, 2.0, 5.0, 0.0], [247.0, 256.0, 36.0, 0.0]]);
+        assert_eq!(n0, &[7, 3]);
+        let (p1, n1) = frames.frame(1);
+        assert_eq!(p1, &[[3.5, 6.0, 8.5, 0.0], [1.25, 1.25, 1.25, 0.0]]);
+        assert_eq!(n1, &[5, 6]);
+        assert_eq!(frames.size_bytes(), 4 * 16 + 4);
+    }
+
+    #[test]
+    fn test_alias_frames_rejects_truncated() {
+        let md2 = build_md2(4, &[([1.0; 3], [0.0; 3], vec![0u8; 16])]);
+        assert!(AliasFrames::from_md2(&md2[..md2.len() - 1]).is_none());
+        assert!(AliasFrames::from_md2(&md2[..20]).is_none());
+    }
+
+    #[test]
+    fn test_float_frames_match_byte_lerp() {
+        // GL_DrawAliasFrameLerp folds translate into move and scale into
+        // frontv/backv; the float path blends pre-decoded positions. Same
+        // value up to rounding.
+        let n = 64;
+        let (fs, ft) = ([0.8, 0.9, 1.1], [-20.0, 5.0, -3.0]);
+        let (bs, bt) = ([1.2, 0.7, 0.6], [4.0, -9.0, 12.0]);
+        let v = pseudo_bytes(n * 4, 3);
+        let ov = pseudo_bytes(n * 4, 4);
+        let frames = AliasFrames::from_md2(&build_md2(n, &[(bs, bt, ov.clone()), (fs, ft, v.clone())])).unwrap();
+        let (back, _) = frames.frame(0);
+        let (front, normals) = frames.frame(1);
+
+        let (frontlerp, backlerp) = (0.375f32, 0.625f32);
+        let delta = [3.0f32, -1.0, 0.5];
+        let mut mv = [0.0f32; 3];
+        let mut frontv = [0.0f32; 3];
+        let mut backv = [0.0f32; 3];
+        for i in 0..3 {
+            mv[i] = backlerp * delta[i] + frontlerp * ft[i] + backlerp * bt[i];
+            frontv[i] = frontlerp * fs[i];
+            backv[i] = backlerp * bs[i];
+        }
+        let mut by_bytes = vec![[0.0f32; 4]; n];
+        lerp_verts(&v, &ov, n, mv, frontv, backv, Some(POWERSUIT_SCALE), &mut by_bytes, SimdLevel::Scalar);
+
+        let delta_move = [backlerp * delta[0], backlerp * delta[1], backlerp * delta[2]];
+        let mut by_frames = vec![[0.0f32; 4]; n];
+        lerp_frames(front, back, normals, delta_move, frontlerp, backlerp, Some(POWERSUIT_SCALE), &mut by_frames, crate::simd::level());
+
+        for (a, b) in by_bytes.iter().zip(&by_frames) {
+            for j in 0..4 {
+                assert!((a[j] - b[j]).abs() < 1e-3, "{:?} vs {:?}", a, b);
+            }
+        }
+    }
+
+    /// Usage: MYQ2_BENCH_MD2=baseq2/players/male/tris.md2:baseq2/models/monsters/tank/tris.md2 \
+    ///        cargo test -p myq2-renderer --release bench_lerp_md2 -- --ignored --nocapture
+    ///
+    /// Lerps every frame of each model into the next, with the byte path and
+    /// the float-frame path at every supported SIMD level.
+    #[test]
+    #[ignore]
+    fn bench_lerp_md2() {
+        let Ok(paths) = std::env::var("MYQ2_BENCH_MD2") else {
+            eprintln!("MYQ2_BENCH_MD2 not set; skipping");
+            return;
+        };
+        let iters: usize = std::env::var("MYQ2_BENCH_ITERS").ok().and_then(|s| s.parse().ok()).unwrap_or(200);
+
+        for path in std::env::split_paths(&paths) {
+            let data = std::fs::read(&path).expect("read md2");
+            let frames = AliasFrames::from_md2(&data).expect("not an MD2");
+            let (nxyz, nframes) = (frames.num_xyz(), frames.num_frames());
+            let framesize = rd_i32(&data, 16).unwrap() as usize;
+            let ofs_frames = rd_i32(&data, 56).unwrap() as usize;
+            let byte_frame = |f: usize| &data[ofs_frames + f * framesize + 40..][..nxyz * 4];
+            let verts = (nxyz * nframes * iters) as f64;
+            println!("{}: {} verts x {} frames, {} iterations", path.display(), nxyz, nframes, iters);
+
+            let mut out = vec![[0.0f32; 4]; nxyz];
+            for (label, float_frames) in [("bytes", false), ("frames", true)] {
+                let mut base: Option<f64> = None;
+                for level in levels() {
+                    let mut sink = 0.0f32;
+                    let start = std::time::Instant::now();
+                    for _ in 0..iters {
+                        for f in 0..nframes {
+                            let next = (f + 1) % nframes;
+                            if float_frames {
+                                let (front, normals) = frames.frame(next);
+                                let (back, _) = frames.frame(f);
+                                lerp_frames(front, back, normals, [0.0; 3], 0.4, 0.6, None, &mut out, level);
+                            } else {
+                                lerp_verts(byte_frame(next), byte_frame(f), nxyz, [1.0; 3], [0.4; 3], [0.6; 3], None, &mut out, level);
+                            }
+                            sink += out[f % nxyz][0];
+                        }
+                    }
+                    let secs = start.elapsed().as_secs_f64();
+                    let speedup = base.map(|b| format!("  ({:.2}x)", b / secs)).unwrap_or_default();
+                    base.get_or_insert(secs);
+                    println!(
+                        "  {:>6} {:>6}: {:8.3} ms/pass  {:8.1} Mvert/s{}  [{}]",
+                        label,
+                        level.name(),
+                        secs * 1000.0 / iters as f64,
+                        verts / secs / 1.0e6,
+                        speedup,
+                        sink.is_finite()
+                    );
+                }
+            }
+        }
+    }
+}
@@ -12,10 +12,13 @@ use myq2_common::q_shared::{
     CPlane, Vec3, dot_product, vector_length, little_float,
     CONTENTS_WATER, CONTENTS_SLIME, CONTENTS_LAVA,
     SURF_SKY, SURF_TRANS33, SURF_TRANS66, SURF_WARP,
-    MAX_QPATH, PRINT_ALL, ERR_DROP,
+    MAX_QPATH, PRINT_ALL, PRINT_DEVELOPER, ERR_DROP,
 };
 use myq2_common::common::com_error;
 use myq2_common::qfiles::*;
+use crate::vk_mesh_edges::AliasEdges;
+use crate::vk_mesh_simd::AliasFrames;
+use crate::vk_registry::{NameIndex, SlotPool};
 
 // little_short/little_long from q_shared (canonical location)
 use myq2_common::q_shared::{little_short, little_long};
@@ -24,7 +27,8 @@ use myq2_common::q_shared::{little_short, little_long};
 //  Constants
 // =============================================================
 
-pub const MAX_MOD_KNOWN: usize = 512;
+/// Upper bound on model slots; storage grows in chunks up to this.
+pub const MAX_MOD_KNOWN: usize = 4096;
 
 // =============================================================
 //  Module-level state (matches C globals)
@@ -37,15 +41,52 @@ static mut modfilelen: i32 = 0;
 static mut mod_novis: [u8; MAX_MAP_LEAFS / 8] = [0xFF; MAX_MAP_LEAFS / 8];
 
 /// All known models.
-static mut mod_known: [Model; MAX_MOD_KNOWN] = unsafe { std::mem::zeroed() };
+static mut mod_known: SlotPool<Model> = SlotPool::new();
 static mut mod_numknown: i32 = 0;
 
+/// Model name -> mod_known slot.
+static mut mod_known_index: NameIndex = NameIndex::new();
+
 /// Inline submodels from the current map, kept separate.
-static mut mod_inline: [Model; MAX_MOD_KNOWN] = unsafe { std::mem::zeroed() };
+static mut mod_inline: [Model; MAX_MAP_MODELS] = unsafe { std::mem::zeroed() };
+
+/// Float-decoded frames of each alias model, indexed like mod_known.
+static mut mod_alias_frames: Vec<Option<AliasFrames>> = Vec::new();
+
+/// Triangle edge adjacency of each alias model, for silhouette outlines.
+static mut mod_alias_edges: Vec<Option<AliasEdges>> = Vec::new();
 
 /// Registration sequence counter.
 pub static mut registration_sequence: i32 = 0;
 
+/// Where the last map load spent its time, in microseconds.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct MapLoadTimes {
+    /// Vertex, edge, surfedge, lighting, plane and texinfo lumps.
+    pub lumps_usec: u64,
+    /// mod_load_faces phases.
+    pub face_decode_usec: u64,
+    pub face_prepare_usec: u64,
+    pub face_threads: u32,
+    pub face_place_usec: u64,
+    pub lightmap_upload_usec: u64,
+    /// Leaf, node, visibility and submodel lumps.
+    pub tree_usec: u64,
+    /// Modern-path vertex buffers, water mesh and reflection planes.
+    pub geometry_usec: u64,
+}
+
+pub static mut MAP_LOAD_TIMES: MapLoadTimes = MapLoadTimes {
+    lumps_usec: 0,
+    face_decode_usec: 0,
+    face_prepare_usec: 0,
+    face_threads: 0,
+    face_place_usec: 0,
+    lightmap_upload_usec: 0,
+    tree_usec: 0,
+    geometry_usec: 0,
+};
+
 /// Raw base pointer for the currently-loading BSP.
 static mut mod_base: *const u8 = std::ptr::null();
 
@@ -106,16 +147,6 @@ unsafe fn fs_load_file(name: &[u8; MAX_QPATH]) -> Option<Vec<u8>> {
 //  GL stubs referenced by this module
 // =============================================================
 
-unsafe fn vk_build_polygon_from_surface(fa: *mut MSurface) {
-    // Delegates to the full implementation in vk_rsurf.rs
-    crate::vk_rsurf::vk_build_polygon_from_surface(&mut *fa);
-}
-
-unsafe fn vk_create_surface_lightmap(surf: *mut MSurface) {
-    // Delegates to the full implementation in vk_rsurf.rs
-    crate::vk_rsurf::vk_create_surface_lightmap(&mut *surf);
-}
-
 unsafe fn vk_create_surface_stainmap(surf: *mut MSurface) {
     // Delegates to the full implementation in vk_rsurf.rs
     crate::vk_rsurf::vk_create_surface_stainmap(&mut *surf);
@@ -296,8 +327,24 @@ pub unsafe fn mod_modellist_f() {
         if model_name_is_empty(&m.name) {
             continue;
         }
-        vid_printf(PRINT_ALL, &format!("{:8} : {}\n", m.extradatasize, model_name_str(&m.name)));
-        total += m.extradatasize;
+        let mut frames = mod_alias_frames[i as usize].as_ref().map_or(0, |f| f.size_bytes()) as i32;
+        match &mod_alias_edges[i as usize] {
+            Some(e) => {
+                frames += e.size_bytes() as i32;
+                vid_printf(
+                    PRINT_ALL,
+                    &format!(
+                        "{:8} : {} ({} edges, {} open)\n",
+                        m.extradatasize + frames,
+                        model_name_str(&m.name),
+                        e.edges().len(),
+                        e.open_edges()
+                    ),
+                );
+            }
+            None => vid_printf(PRINT_ALL, &format!("{:8} : {}\n", m.extradatasize + frames, model_name_str(&m.name))),
+        }
+        total += m.extradatasize + frames;
     }
     vid_printf(PRINT_ALL, &format!("Total resident: {}\n", total));
 }
@@ -312,6 +359,8 @@ pub unsafe fn mod_modellist_f() {
 /// Writes to global state.
 pub unsafe fn mod_init() {
     mod_novis = [0xFF; MAX_MAP_LEAFS / 8];
+    // slot 0 (the world) is checked before any model is loaded
+    mod_known.reserve_slots(1);
 }
 
 // =============================================================
@@ -337,10 +386,7 @@ pub unsafe fn mod_for_name(name: &str, crash: bool) -> *mut Model {
     }
 
     // search the currently loaded models
-    for i in 0..mod_numknown as usize {
-        if model_name_is_empty(&mod_known[i].name) {
-            continue;
-        }
+    if let Some(i) = mod_known_index.get(name) {
         if model_name_matches_str(&mod_known[i].name, name) {
             return &mut mod_known[i];
         }
@@ -359,6 +405,9 @@ pub unsafe fn mod_for_name(name: &str, crash: bool) -> *mut Model {
             com_error(ERR_DROP, "mod_numknown == MAX_MOD_KNOWN");
         }
         mod_numknown += 1;
+        mod_known.reserve_slots(mod_numknown as usize);
+        mod_alias_frames.resize_with(mod_numknown as usize, || None);
+        mod_alias_edges.resize_with(mod_numknown as usize, || None);
     }
     set_model_name(&mut mod_known[slot].name, name);
 
@@ -399,6 +448,7 @@ pub unsafe fn mod_for_name(name: &str, crash: bool) -> *mut Model {
     }
 
     (*loadmodel).extradatasize = hunk_end();
+    mod_known_index.insert(model_name_str(&mod_known[slot].name), slot);
 
     &mut mod_known[slot]
 }
@@ -629,19 +679,19 @@ unsafe fn mod_load_texinfo(l: *const Lump) {
 ///
 /// # Safety
 /// Dereferences raw model pointers.
-unsafe fn calc_surface_extents(s: *mut MSurface) {
+unsafe fn calc_surface_extents(model: *const Model, s: *mut MSurface) {
     let mut mins = [999999.0f32; 2];
     let mut maxs = [-99999.0f32; 2];
 
     let tex = (*s).texinfo;
 
     for i in 0..(*s).numedges {
-        let e = *(*loadmodel).surfedges.add(((*s).firstedge + i) as usize);
+        let e = *(*model).surfedges.add(((*s).firstedge + i) as usize);
         let v: *const MVertex;
         if e >= 0 {
-            v = (*loadmodel).vertexes.add((*(*loadmodel).edges.add(e as usize)).v[0] as usize);
+            v = (*model).vertexes.add((*(*model).edges.add(e as usize)).v[0] as usize);
         } else {
-            v = (*loadmodel).vertexes.add((*(*loadmodel).edges.add((-e) as usize)).v[1] as usize);
+            v = (*model).vertexes.add((*(*model).edges.add((-e) as usize)).v[1] as usize);
         }
 
         for j in 0..2usize {
@@ -662,11 +712,30 @@ unsafe fn calc_surface_extents(s: *mut MSurface) {
     }
 }
 
+/// Model and surfaces shared with the surface-preparation workers.
+#[derive(Clone, Copy)]
+struct FaceJobs {
+    model: *const Model,
+    surfaces: *mut MSurface,
+}
+
+// SAFETY: during the parallel phase of mod_load_faces the model is only
+// read, and each job writes only the surface at its own index.
+unsafe impl Send for FaceJobs {}
+unsafe impl Sync for FaceJobs {}
+
 /// Load faces lump from BSP.
 ///
+/// Three phases: decode the lump (serial), compute extents, lightmap texels
+/// and polygons per surface (parallel, vk_prepare_surface), then place the
+/// lightmaps, copy them in and link the polygons in surface order (serial,
+/// so pages come out exactly as a sequential load would lay them out).
+///
 /// # Safety
 /// Dereferences raw pointers, writes to loadmodel.
 unsafe fn mod_load_faces(l: *const Lump) {
+    use rayon::prelude::*;
+
     let in_size = std::mem::size_of::<DFace>();
     if !((*l).filelen as usize).is_multiple_of(in_size) {
         com_error(ERR_DROP, &format!("MOD_LoadBmodel: funny lump size in {}", model_name_str(&(*loadmodel).name)));
@@ -681,6 +750,7 @@ unsafe fn mod_load_faces(l: *const Lump) {
 
     vk_begin_building_lightmaps(loadmodel);
 
+    let start = std::time::Instant::now();
     let mut inp = (mod_base.add((*l).fileofs as usize)) as *const DFace;
     let mut outp = out;
     for _surfnum in 0..count {
@@ -703,8 +773,6 @@ unsafe fn mod_load_faces(l: *const Lump) {
         }
         (*outp).texinfo = (*loadmodel).texinfo.add(ti as usize);
 
-        calc_surface_extents(outp);
-
         // lighting info
         for i in 0..MAXLIGHTMAPS {
             (*outp).styles[i] = (*inp).styles[i];
@@ -720,28 +788,61 @@ unsafe fn mod_load_faces(l: *const Lump) {
         // set the drawing flags
         if (*(*outp).texinfo).flags & SURF_WARP != 0 {
             (*outp).flags |= SURF_DRAWTURB;
-            for i in 0..2 {
-                (*outp).extents[i] = 16384;
-                (*outp).texturemins[i] = -8192;
-            }
-            vk_subdivide_surface(outp); // cut up polygon for warps
         }
 
-        // create lightmaps and polygons
-        if (*(*outp).texinfo).flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP) == 0 {
-            vk_create_surface_lightmap(outp);
-            vk_create_surface_stainmap(outp);
+        inp = inp.add(1);
+        outp = outp.add(1);
+    }
+    let decoded = std::time::Instant::now();
+    MAP_LOAD_TIMES.face_decode_usec = (decoded - start).as_micros() as u64;
+
+    let ctx = crate::vk_rsurf::SurfacePrepContext::current();
+    let jobs = FaceJobs { model: loadmodel, surfaces: out };
+    let prepared: Vec<crate::vk_rsurf::PreparedSurface> = (0..count)
+        .into_par_iter()
+        .map_init(
+            || Box::new(crate::vk_light_simd::BlockLights::new()),
+            |bl, i| {
+                let jobs = jobs;
+                let surf = jobs.surfaces.add(i);
+                calc_surface_extents(jobs.model, surf);
+                if (*surf).flags & SURF_DRAWTURB != 0 {
+                    for j in 0..2 {
+                        (*surf).extents[j] = 16384;
+                        (*surf).texturemins[j] = -8192;
+                    }
+                }
+                crate::vk_rsurf::vk_prepare_surface(&*jobs.model, &*surf, &ctx, bl)
+            },
+        )
+        .collect();
+    let built = std::time::Instant::now();
+    MAP_LOAD_TIMES.face_prepare_usec = (built - decoded).as_micros() as u64;
+    MAP_LOAD_TIMES.face_threads = rayon::current_num_threads() as u32;
+
+    for (i, prep) in prepared.iter().enumerate() {
+        let surf = out.add(i);
+        if (*surf).flags & SURF_DRAWTURB != 0 {
+            vk_subdivide_surface(surf); // cut up polygon for warps
         }
 
-        if (*(*outp).texinfo).flags & SURF_WARP == 0 {
-            vk_build_polygon_from_surface(outp);
+        // create lightmaps and polygons
+        if prep.oversize {
+            vid_printf(ERR_DROP, "Bad s_blocklights size");
+        } else if !prep.texels.is_empty() {
+            crate::vk_rsurf::vk_create_surface_lightmap_from(&mut *surf, &prep.texels);
+            vk_create_surface_stainmap(surf);
         }
 
-        inp = inp.add(1);
-        outp = outp.add(1);
+        if !prep.verts.is_empty() {
+            crate::vk_rsurf::emit_surface_polygon(&mut *surf, &prep.verts);
+        }
     }
+    let placed = std::time::Instant::now();
+    MAP_LOAD_TIMES.face_place_usec = (placed - built).as_micros() as u64;
 
     vk_end_building_lightmaps();
+    MAP_LOAD_TIMES.lightmap_upload_usec = placed.elapsed().as_micros() as u64;
 }
 
 /// Recursively set parent pointers for BSP nodes.
@@ -947,7 +1048,7 @@ unsafe fn mod_load_planes(l: *const Lump) {
 /// Dereferences raw pointers, accesses global model state.
 unsafe fn mod_load_brush_model(model: *mut Model, buffer: *mut u8) {
     (*loadmodel).r#type = ModType::Brush;
-    if loadmodel != mod_known.as_mut_ptr() {
+    if loadmodel != &mut mod_known[0] as *mut Model {
         com_error(ERR_DROP, "Loaded a brush model after the world");
     }
 
@@ -972,18 +1073,22 @@ unsafe fn mod_load_brush_model(model: *mut Model, buffer: *mut u8) {
     }
 
     // load into heap
+    let start = std::time::Instant::now();
     mod_load_vertexes(&(*header).lumps[LUMP_VERTEXES]);
     mod_load_edges(&(*header).lumps[LUMP_EDGES]);
     mod_load_surfedges(&(*header).lumps[LUMP_SURFEDGES]);
     mod_load_lighting(&(*header).lumps[LUMP_LIGHTING]);
     mod_load_planes(&(*header).lumps[LUMP_PLANES]);
     mod_load_texinfo(&(*header).lumps[LUMP_TEXINFO]);
+    MAP_LOAD_TIMES.lumps_usec = start.elapsed().as_micros() as u64;
     mod_load_faces(&(*header).lumps[LUMP_FACES]);
+    let start = std::time::Instant::now();
     mod_load_marksurfaces(&(*header).lumps[LUMP_LEAFFACES]);
     mod_load_visibility(&(*header).lumps[LUMP_VISIBILITY]);
     mod_load_leafs(&(*header).lumps[LUMP_LEAFS]);
     mod_load_nodes(&(*header).lumps[LUMP_NODES]);
     mod_load_submodels(&(*header).lumps[LUMP_MODELS]);
+    MAP_LOAD_TIMES.tree_usec = start.elapsed().as_micros() as u64;
     (*model).numframes = 2; // regular and alternate animation
 
     // set up the submodels
@@ -1135,6 +1240,37 @@ unsafe fn mod_load_alias_model(model: *mut Model, buffer: *mut u8) {
 
     (*model).mins = [-32.0, -32.0, -32.0];
     (*model).maxs = [32.0, 32.0, 32.0];
+
+    // decode every frame to floats once, so the per-frame lerp skips the
+    // byte unpack and scale/translate
+    if let Some(slot) = mod_known_slot(model) {
+        let data = std::slice::from_raw_parts(buffer as *const u8, modfilelen as usize);
+        mod_alias_frames[slot] = AliasFrames::from_md2(data);
+        mod_alias_edges[slot] = AliasEdges::from_md2(data);
+    }
+}
+
+/// Index of `model` in mod_known, if it is one of them.
+unsafe fn mod_known_slot(model: *const Model) -> Option<usize> {
+    mod_known.index_of(model).filter(|&slot| slot < mod_numknown as usize)
+}
+
+/// Float frames of an alias model loaded by mod_load_alias_model.
+///
+/// # Safety
+/// Accesses global model state.
+pub unsafe fn mod_alias_frames_for(model: *const Model) -> Option<&'static AliasFrames> {
+    let slot = mod_known_slot(model)?;
+    (*std::ptr::addr_of!(mod_alias_frames))[slot].as_ref()
+}
+
+/// Edge adjacency of an alias model loaded by mod_load_alias_model.
+///
+/// # Safety
+/// Accesses global model state.
+pub unsafe fn mod_alias_edges_for(model: *const Model) -> Option<&'static AliasEdges> {
+    let slot = mod_known_slot(model)?;
+    (*std::ptr::addr_of!(mod_alias_edges))[slot].as_ref()
 }
 
 // ===============================================================
@@ -1218,7 +1354,22 @@ pub unsafe fn r_begin_registration(model_name: &str) {
     r_viewcluster = -1;
 
     // Build modern BSP geometry from loaded world model
+    let start = std::time::Instant::now();
     build_modern_bsp_geometry();
+
+    // Water geometry and reflective planes are fixed for the map
+    crate::vk_warp::r_build_water_mesh();
+    crate::vk_refl::r_build_water_planes();
+    MAP_LOAD_TIMES.geometry_usec = start.elapsed().as_micros() as u64;
+
+    let t = &MAP_LOAD_TIMES;
+    let ms = |usec: u64| usec as f64 / 1000.0;
+    vid_printf(PRINT_DEVELOPER, &format!(
+        "map load: lumps {:.1} ms, faces {:.1} decode + {:.1} prepare ({} threads) + {:.1} place + {:.1} lmupload, \
+         tree {:.1}, geometry {:.1}\n",
+        ms(t.lumps_usec), ms(t.face_decode_usec), ms(t.face_prepare_usec), t.face_threads,
+        ms(t.face_place_usec), ms(t.lightmap_upload_usec), ms(t.tree_usec), ms(t.geometry_usec),
+    ));
 }
 
 /// Walk all world model surfaces, extract vertices from GlPoly chains,
@@ -1306,6 +1457,7 @@ unsafe fn build_modern_bsp_geometry() {
                 texture_id,
                 lightmap_id,
                 flags,
+                surface: i as u32,
             });
 
             poly = (*poly).next;
@@ -1397,6 +1549,11 @@ pub unsafe fn r_end_registration() {
 /// Mutates the model struct.
 pub unsafe fn mod_free(model: *mut Model) {
     hunk_free((*model).extradata);
+    if let Some(slot) = mod_known_slot(model) {
+        mod_known_index.remove(model_name_str(&(*model).name), slot);
+        mod_alias_frames[slot] = None;
+        mod_alias_edges[slot] = None;
+    }
     // SAFETY: zeroing a repr(C) struct with raw pointers is valid (null pointers).
     std::ptr::write_bytes(model as *mut u8, 0, std::mem::size_of::<Model>());
 }
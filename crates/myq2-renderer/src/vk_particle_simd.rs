@@ -0,0 +1,322 @@
+// vk_particle_simd.rs — Vectorized particle billboard expansion
+//
+// R_DrawParticles drew every particle as its own immediate-mode quad, and the
+// instanced replacement still expanded the corners in the vertex shader one
+// particle at a time. Here the corners of every particle are built on the CPU
+// into one streamed vertex array, ordered by particle type, so the render
+// path issues a single draw per type (each type has its own texture).
+//
+// Sizing matches particle.vert.glsl before this change: the size grows with
+// distance from the view origin (1 + dist * 0.004 past 20 units), is clamped
+// to [min_size, max_size] and scaled by 0.667 for the half extent. Corners are
+// o -/+ right * h -/+ up * h in the order (-1,-1) (-1,1) (1,1) (1,-1), drawn
+// as two triangles through quad_indices.
+//
+// SSE2 computes the size of 4 particles at once (AVX2: 8) and writes each
+// vertex as one 16-byte store of position + s and one 8-byte store of
+// t + colour. All levels produce bit-identical vertices.
+
+use crate::simd::SimdLevel;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+/// One billboard corner. `color` is RGBA8 (R in the low byte).
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct ParticleVertex {
+    pub position: [f32; 3],
+    pub st: [f32; 2],
+    pub color: u32,
+}
+
+impl ParticleVertex {
+    /// Size in bytes.
+    pub const SIZE: usize = std::mem::size_of::<Self>();
+}
+
+/// Corners emitted per particle.
+pub const VERTS_PER_PARTICLE: usize = 4;
+/// Indices drawn per particle (two triangles).
+pub const INDICES_PER_PARTICLE: usize = 6;
+
+/// Corner offsets (right, up) and texture coordinates, in emission order.
+const CORNERS: [([f32; 2], [f32; 2]); VERTS_PER_PARTICLE] = [
+    ([-1.0, -1.0], [0.0, 0.0]),
+    ([-1.0, 1.0], [0.0, 1.0]),
+    ([1.0, 1.0], [1.0, 1.0]),
+    ([1.0, -1.0], [1.0, 0.0]),
+];
+
+/// View state the billboards are built against.
+#[derive(Clone, Copy, Debug)]
+pub struct Billboard {
+    pub view_origin: [f32; 3],
+    pub right: [f32; 3],
+    pub up: [f32; 3],
+    /// Size before distance scaling.
+    pub size: f32,
+    pub min_size: f32,
+    pub max_size: f32,
+}
+
+/// Index list drawing `count` particles as two triangles each.
+pub fn quad_indices(count: usize) -> Vec<u32> {
+    let mut out = Vec::with_capacity(count * INDICES_PER_PARTICLE);
+    for p in 0..count as u32 {
+        let base = p * VERTS_PER_PARTICLE as u32;
+        out.extend_from_slice(&[base, base + 1, base + 2, base, base + 2, base + 3]);
+    }
+    out
+}
+
+/// Expand particles into billboard corners. `origins` are [x, y, z, _];
+/// `colors` are RGBA8. Writes VERTS_PER_PARTICLE vertices per particle.
+pub fn expand_billboards(
+    origins: &[[f32; 4]],
+    colors: &[u32],
+    view: &Billboard,
+    out: &mut [ParticleVertex],
+    level: SimdLevel,
+) {
+    let n = origins.len();
+    assert!(colors.len() >= n && out.len() >= n * VERTS_PER_PARTICLE);
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { expand_avx2(origins, colors, view, out) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { expand_sse2(origins, colors, view, out) },
+        _ => expand_scalar(origins, colors, view, 0, out),
+    }
+}
+
+#[inline]
+fn half_extent(o: &[f32; 4], view: &Billboard) -> f32 {
+    let dx = o[0] - view.view_origin[0];
+    let dy = o[1] - view.view_origin[1];
+    let dz = o[2] - view.view_origin[2];
+    let dist = (dx * dx + dy * dy + dz * dz).sqrt();
+    let scale = if dist < 20.0 { 1.0 } else { 1.0 + dist * 0.004 };
+    (view.size * scale).max(view.min_size).min(view.max_size) * 0.667
+}
+
+#[inline]
+fn emit_scalar(o: &[f32; 4], h: f32, color: u32, view: &Billboard, out: &mut [ParticleVertex]) {
+    let r = [view.right[0] * h, view.right[1] * h, view.right[2] * h];
+    let u = [view.up[0] * h, view.up[1] * h, view.up[2] * h];
+    for (v, &([cr, cu], st)) in out.iter_mut().zip(CORNERS.iter()) {
+        let mut position = [0.0; 3];
+        for k in 0..3 {
+            let a = if cr < 0.0 { o[k] - r[k] } else { o[k] + r[k] };
+            position[k] = if cu < 0.0 { a - u[k] } else { a + u[k] };
+        }
+        *v = ParticleVertex { position, st, color };
+    }
+}
+
+fn expand_scalar(origins: &[[f32; 4]], colors: &[u32], view: &Billboard, start: usize, out: &mut [ParticleVertex]) {
+    for i in start..origins.len() {
+        let h = half_extent(&origins[i], view);
+        emit_scalar(&origins[i], h, colors[i], view, &mut out[i * VERTS_PER_PARTICLE..(i + 1) * VERTS_PER_PARTICLE]);
+    }
+}
+
+/// Write the four corners of one particle from its origin `o` ([x,y,z,0])
+/// and the already scaled `r` and `u` ([x,y,z,0]).
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[target_feature(enable = "sse2")]
+unsafe fn emit_sse2(o: __m128, r: __m128, u: __m128, color: u32, out: *mut ParticleVertex) {
+    let left = _mm_sub_ps(o, r);
+    let right = _mm_add_ps(o, r);
+    let corners = [_mm_sub_ps(left, u), _mm_add_ps(left, u), _mm_add_ps(right, u), _mm_sub_ps(right, u)];
+    let lane3 = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+    let xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    for (c, (pos, &(_, [s, t]))) in corners.iter().zip(CORNERS.iter()).enumerate() {
+        let v = out.add(c) as *mut f32;
+        let head = _mm_or_ps(_mm_and_ps(*pos, xyz), _mm_and_ps(_mm_set1_ps(s), lane3));
+        _mm_storeu_ps(v, head);
+        _mm_storel_epi64(v.add(4) as *mut __m128i, _mm_set_epi32(0, 0, color as i32, t.to_bits() as i32));
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn expand_sse2(origins: &[[f32; 4]], colors: &[u32], view: &Billboard, out: &mut [ParticleVertex]) {
+    let n = origins.len();
+    let (vx, vy, vz) = (_mm_set1_ps(view.view_origin[0]), _mm_set1_ps(view.view_origin[1]), _mm_set1_ps(view.view_origin[2]));
+    let right = _mm_set_ps(0.0, view.right[2], view.right[1], view.right[0]);
+    let up = _mm_set_ps(0.0, view.up[2], view.up[1], view.up[0]);
+    let (near, one, grow) = (_mm_set1_ps(20.0), _mm_set1_ps(1.0), _mm_set1_ps(0.004));
+    let (size, min, max, half) = (_mm_set1_ps(view.size), _mm_set1_ps(view.min_size), _mm_set1_ps(view.max_size), _mm_set1_ps(0.667));
+    let xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+    let mut i = 0;
+    while i + 4 <= n {
+        let o = [
+            _mm_and_ps(_mm_loadu_ps(origins[i].as_ptr()), xyz),
+            _mm_and_ps(_mm_loadu_ps(origins[i + 1].as_ptr()), xyz),
+            _mm_and_ps(_mm_loadu_ps(origins[i + 2].as_ptr()), xyz),
+            _mm_and_ps(_mm_loadu_ps(origins[i + 3].as_ptr()), xyz),
+        ];
+        // transpose to x, y, z of the 4 particles
+        let (mut r0, mut r1, mut r2, mut r3) = (o[0], o[1], o[2], o[3]);
+        _MM_TRANSPOSE4_PS(&mut r0, &mut r1, &mut r2, &mut r3);
+        let dx = _mm_sub_ps(r0, vx);
+        let dy = _mm_sub_ps(r1, vy);
+        let dz = _mm_sub_ps(r2, vz);
+        let dist = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        let far = _mm_add_ps(one, _mm_mul_ps(dist, grow));
+        let is_near = _mm_cmplt_ps(dist, near);
+        let scale = _mm_or_ps(_mm_and_ps(is_near, one), _mm_andnot_ps(is_near, far));
+        let h = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_mul_ps(size, scale), min), max), half);
+
+        let mut hs = [0.0f32; 4];
+        _mm_storeu_ps(hs.as_mut_ptr(), h);
+        for k in 0..4 {
+            let hk = _mm_set1_ps(hs[k]);
+            emit_sse2(o[k], _mm_mul_ps(right, hk), _mm_mul_ps(up, hk), colors[i + k], out.as_mut_ptr().add((i + k) * VERTS_PER_PARTICLE));
+        }
+        i += 4;
+    }
+    expand_scalar(origins, colors, view, i, out);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn expand_avx2(origins: &[[f32; 4]], colors: &[u32], view: &Billboard, out: &mut [ParticleVertex]) {
+    let n = origins.len();
+    let (vx, vy, vz) = (_mm256_set1_ps(view.view_origin[0]), _mm256_set1_ps(view.view_origin[1]), _mm256_set1_ps(view.view_origin[2]));
+    let right = _mm_set_ps(0.0, view.right[2], view.right[1], view.right[0]);
+    let up = _mm_set_ps(0.0, view.up[2], view.up[1], view.up[0]);
+    let (near, one, grow) = (_mm256_set1_ps(20.0), _mm256_set1_ps(1.0), _mm256_set1_ps(0.004));
+    let (size, min, max, half) =
+        (_mm256_set1_ps(view.size), _mm256_set1_ps(view.min_size), _mm256_set1_ps(view.max_size), _mm256_set1_ps(0.667));
+    let xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    // x, y, z of [x,y,z,_] at stride 4 floats
+    let xs = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    let ys = _mm256_add_epi32(xs, _mm256_set1_epi32(1));
+    let zs = _mm256_add_epi32(xs, _mm256_set1_epi32(2));
+
+    let mut i = 0;
+    while i + 8 <= n {
+        let base = origins[i].as_ptr();
+        let dx = _mm256_sub_ps(_mm256_i32gather_ps::<4>(base, xs), vx);
+        let dy = _mm256_sub_ps(_mm256_i32gather_ps::<4>(base, ys), vy);
+        let dz = _mm256_sub_ps(_mm256_i32gather_ps::<4>(base, zs), vz);
+        let dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+        let far = _mm256_add_ps(one, _mm256_mul_ps(dist, grow));
+        let scale = _mm256_blendv_ps(far, one, _mm256_cmp_ps::<_CMP_LT_OQ>(dist, near));
+        let h = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(size, scale), min), max), half);
+
+        let mut hs = [0.0f32; 8];
+        _mm256_storeu_ps(hs.as_mut_ptr(), h);
+        for k in 0..8 {
+            let o = _mm_and_ps(_mm_loadu_ps(origins[i + k].as_ptr()), xyz);
+            let hk = _mm_set1_ps(hs[k]);
+            emit_sse2(o, _mm_mul_ps(right, hk), _mm_mul_ps(up, hk), colors[i + k], out.as_mut_ptr().add((i + k) * VERTS_PER_PARTICLE));
+        }
+        i += 8;
+    }
+    expand_scalar(origins, colors, view, i, out);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn view() -> Billboard {
+        Billboard {
+            view_origin: [10.0, -20.0, 30.0],
+            right: [0.6, 0.8, 0.0],
+            up: [0.0, 0.0, 1.0],
+            size: 1.0,
+            min_size: 2.0,
+            max_size: 40.0,
+        }
+    }
+
+    /// Pseudo-random particles spread from the view origin out to ~12000 units.
+    fn particles(n: usize, seed: u32) -> (Vec<[f32; 4]>, Vec<u32>) {
+        let mut x = seed;
+        let mut next = || {
+            x = x.wrapping_mul(1664525).wrapping_add(1013904223);
+            x
+        };
+        let mut origins = Vec::with_capacity(n);
+        let mut colors = Vec::with_capacity(n);
+        for i in 0..n {
+            let spread = [4.0, 40.0, 400.0, 4000.0][i % 4];
+            let mut o = [0.0f32; 4];
+            for k in 0..3 {
+                o[k] = view().view_origin[k] + ((next() >> 8) as f32 / (1u32 << 24) as f32 - 0.5) * spread * 2.0;
+            }
+            o[3] = f32::from_bits(next()); // padding lane must be ignored
+            origins.push(o);
+            colors.push(next());
+        }
+        (origins, colors)
+    }
+
+    #[test]
+    fn test_corners_and_sizes() {
+        let v = view();
+        let origins = [[10.0, -20.0, 35.0, 0.0], [10.0, 480.0, 30.0, 0.0], [10.0, 20000.0, 30.0, 0.0]];
+        let mut out = vec![ParticleVertex::default(); 12];
+        expand_billboards(&origins, &[0x11223344, 5, 6], &v, &mut out, SimdLevel::Scalar);
+
+        // close particles clamp to min_size, far ones to max_size
+        let h0 = 2.0 * 0.667;
+        assert_eq!(out[0].position, [10.0 - 0.6 * h0, -20.0 - 0.8 * h0, 35.0 - h0]);
+        assert_eq!(out[2].position, [10.0 + 0.6 * h0, -20.0 + 0.8 * h0, 35.0 + h0]);
+        assert_eq!(out[1].st, [0.0, 1.0]);
+        assert!(out[..4].iter().all(|c| c.color == 0x11223344));
+        let h1 = (1.0 + 500.0 * 0.004f32) * 0.667;
+        assert!((out[6].position[2] - (30.0 + h1)).abs() < 1e-4);
+        let h2 = 40.0 * 0.667;
+        assert!((out[10].position[2] - (30.0 + h2)).abs() < 1e-4);
+
+        assert_eq!(quad_indices(2), vec![0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7]);
+    }
+
+    #[test]
+    fn test_simd_matches_scalar() {
+        for n in [0, 1, 3, 4, 7, 8, 9, 31, 1000] {
+            let (origins, colors) = particles(n, n as u32 + 1);
+            let mut reference = vec![ParticleVertex::default(); n * VERTS_PER_PARTICLE];
+            expand_billboards(&origins, &colors, &view(), &mut reference, SimdLevel::Scalar);
+            for level in SimdLevel::supported() {
+                let mut out = vec![ParticleVertex::default(); n * VERTS_PER_PARTICLE];
+                expand_billboards(&origins, &colors, &view(), &mut out, level);
+                for (a, b) in out.iter().zip(&reference) {
+                    assert_eq!(a.position.map(f32::to_bits), b.position.map(f32::to_bits), "{} n={}", level.name(), n);
+                    assert_eq!((a.st, a.color), (b.st, b.color));
+                }
+            }
+        }
+    }
+
+    /// Usage: cargo test -p myq2-renderer --release bench_particle_billboards -- --ignored --nocapture
+    ///
+    /// MYQ2_BENCH_PARTICLES sets the particle count (default 65536),
+    /// MYQ2_BENCH_ITERS the number of frames.
+    #[test]
+    #[ignore]
+    fn bench_particle_billboards() {
+        let n: usize = std::env::var("MYQ2_BENCH_PARTICLES").ok().and_then(|s| s.parse().ok()).unwrap_or(65536);
+        let iters: usize = std::env::var("MYQ2_BENCH_ITERS").ok().and_then(|s| s.parse().ok()).unwrap_or(200);
+        let (origins, colors) = particles(n, 7);
+        let mut out = vec![ParticleVertex::default(); n * VERTS_PER_PARTICLE];
+
+        println!("{} particles, {} frames", n, iters);
+        for level in SimdLevel::supported() {
+            let start = std::time::Instant::now();
+            for _ in 0..iters {
+                expand_billboards(&origins, &colors, &view(), &mut out, level);
+                std::hint::black_box(&out);
+            }
+            let per_frame = start.elapsed().as_secs_f64() * 1000.0 / iters as f64;
+            println!("  {:6}  {:7.3} ms/frame  {:6.1} Mparticles/s", level.name(), per_frame, n as f64 / per_frame / 1000.0);
+        }
+    }
+}
@@ -0,0 +1,308 @@
+// vk_refl.rs — Planar water reflections
+// Converted from: myq2-original/ref_gl/gl_refl.c (DO_REFLECTIVE_WATER)
+//
+// gl_refl.c ran the whole R_RenderView again for every reflective plane,
+// rediscovered the planes each frame with R_RecursiveFindRefl, and copied the
+// framebuffer back with glCopyTexSubImage2D. Here the water planes are
+// collected once per map at registration. Each frame, a plane whose water is
+// in view gets a reduced pass of its own:
+//
+//   - the current PVS is culled against the main frustum mirrored in the
+//     plane, plus the plane itself as a clip plane;
+//   - surfaces facing away from the mirrored eye and the water are dropped;
+//   - entities are limited to those near the mirrored eye (vk_reflection_entdist,
+//     0 for world only), first person weapons excluded;
+//   - particles are skipped.
+//
+// The modern path renders each view into the water reflection target with a
+// mirrored view matrix and an oblique near plane. Reflection-only surfaces
+// keep the lightmaps they were last built with. The CPU side is timed per
+// plane for r_speeds, so the cost shows up without a GPU.
+
+use crate::vk_local::*;
+use crate::vk_rmain::EntityLocal;
+use crate::vk_world_cull::CullPlane;
+use myq2_common::q_shared::*;
+
+/// Most reflective planes rendered per frame.
+pub const MAX_REFL_PLANES: usize = 8;
+/// Surfaces within this distance of a plane are merged into it.
+const REFL_PLANE_EPSILON: f32 = 1.0;
+/// Normals whose dot product exceeds this are the same orientation.
+const REFL_NORMAL_EPSILON: f32 = 0.999;
+/// How far below the water an entity's origin may be and still reflect.
+const REFL_ENTITY_SINK: f32 = 32.0;
+
+// ============================================================
+// Water planes
+// ============================================================
+
+/// A reflective plane and the water surfaces lying on it.
+#[derive(Debug, Clone)]
+pub struct WaterPlane {
+    /// Normal pointing out of the water.
+    pub normal: Vec3,
+    pub dist: f32,
+    /// World surface numbers on this plane.
+    pub surfaces: Vec<u32>,
+}
+
+impl WaterPlane {
+    /// Signed distance of `p` above the plane.
+    pub fn distance(&self, p: &Vec3) -> f32 {
+        dot_product(p, &self.normal) - self.dist
+    }
+
+    /// `p` reflected through the plane.
+    pub fn mirror_point(&self, p: &Vec3) -> Vec3 {
+        let d = 2.0 * self.distance(p);
+        [p[0] - d * self.normal[0], p[1] - d * self.normal[1], p[2] - d * self.normal[2]]
+    }
+
+    /// Direction `v` reflected through the plane.
+    pub fn mirror_vector(&self, v: &Vec3) -> Vec3 {
+        let d = 2.0 * dot_product(v, &self.normal);
+        [v[0] - d * self.normal[0], v[1] - d * self.normal[1], v[2] - d * self.normal[2]]
+    }
+
+    /// The plane as a culling plane keeping the side above the water.
+    pub fn cull_plane(&self) -> CullPlane {
+        [self.normal[0], self.normal[1], self.normal[2], self.dist]
+    }
+}
+
+/// Group water surfaces, given as (surface number, outward normal, dist),
+/// into planes.
+pub fn group_water_planes(surfaces: impl IntoIterator<Item = (u32, Vec3, f32)>) -> Vec<WaterPlane> {
+    let mut planes: Vec<WaterPlane> = Vec::new();
+    for (surfnum, normal, dist) in surfaces {
+        let existing = planes.iter_mut().find(|p| {
+            dot_product(&p.normal, &normal) > REFL_NORMAL_EPSILON && (p.dist - dist).abs() <= REFL_PLANE_EPSILON
+        });
+        match existing {
+            Some(plane) => plane.surfaces.push(surfnum),
+            None => planes.push(WaterPlane { normal, dist, surfaces: vec![surfnum] }),
+        }
+    }
+    planes
+}
+
+/// Water planes of the current world map, found at registration.
+pub static mut WATER_PLANES: Vec<WaterPlane> = Vec::new();
+
+/// Collect the reflective planes of the world model. Called once per map
+/// from r_begin_registration.
+///
+/// # Safety
+/// Dereferences world model pointers.
+pub unsafe fn r_build_water_planes() {
+    WATER_PLANES.clear();
+    if r_worldmodel.is_null() {
+        return;
+    }
+    let world = &*r_worldmodel;
+    if world.surfaces.is_null() {
+        return;
+    }
+
+    let water = (0..world.numsurfaces.max(0) as u32).filter_map(|s| {
+        let surf = &*world.surfaces.add(s as usize);
+        if surf.flags & SURF_DRAWTURB == 0 || surf.plane.is_null() || surf.texinfo.is_null() {
+            return None;
+        }
+        if (*surf.texinfo).flags & SURF_WARP == 0 {
+            return None;
+        }
+        let plane = &*surf.plane;
+        if surf.flags & SURF_PLANEBACK != 0 {
+            Some((s, [-plane.normal[0], -plane.normal[1], -plane.normal[2]], -plane.dist))
+        } else {
+            Some((s, plane.normal, plane.dist))
+        }
+    });
+    WATER_PLANES = group_water_planes(water);
+}
+
+// ============================================================
+// Reflection views
+// ============================================================
+
+/// One plane's reduced reflection pass.
+#[derive(Debug, Clone, Default)]
+pub struct ReflectionView {
+    /// Index into WATER_PLANES.
+    pub plane: usize,
+    pub normal: Vec3,
+    pub dist: f32,
+    /// The eye mirrored through the plane.
+    pub vieworg: Vec3,
+    /// World surfaces to draw.
+    pub surfaces: Vec<u32>,
+    /// Indices into the refdef entities to draw.
+    pub entities: Vec<usize>,
+}
+
+/// Per-frame reflection counters for r_speeds.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct ReflStats {
+    /// Planes given a pass.
+    pub planes: u32,
+    /// PVS leaves kept across all passes.
+    pub leaves: u32,
+    /// Surfaces collected across all passes.
+    pub surfaces: u32,
+    /// Entities collected across all passes.
+    pub entities: u32,
+    /// CPU time of all passes, in microseconds.
+    pub usec: u32,
+}
+
+pub static mut REFL_STATS: ReflStats = ReflStats { planes: 0, leaves: 0, surfaces: 0, entities: 0, usec: 0 };
+
+/// View pool; the first REFL_VIEW_COUNT entries are this frame's.
+static mut REFL_VIEWS: Vec<ReflectionView> = Vec::new();
+static mut REFL_VIEW_COUNT: usize = 0;
+
+/// This frame's reflection views.
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_reflection_views() -> &'static [ReflectionView] {
+    let views = &*std::ptr::addr_of!(REFL_VIEWS);
+    &views[..REFL_VIEW_COUNT]
+}
+
+/// Whether a water plane has a surface in this frame's visible set.
+unsafe fn plane_in_view(plane: &WaterPlane, surfaces: *const MSurface) -> bool {
+    plane.surfaces.iter().any(|&s| (*surfaces.add(s as usize)).visframe == r_framecount)
+}
+
+/// Build the reduced reflection pass of every water plane in view.
+/// Runs after vk_update_dynamic_lightmaps, which marks the visible surfaces
+/// and refreshes the PVS cache this reuses.
+///
+/// # Safety
+/// Accesses global renderer state and world model pointers.
+pub unsafe fn r_reflection_pass(entities: &[EntityLocal]) {
+    REFL_STATS = ReflStats::default();
+    REFL_VIEW_COUNT = 0;
+
+    let max_planes = myq2_common::cvar::cvar_variable_value("vk_reflection_max").max(0.0) as usize;
+    if !DO_REFLECTIVE_WATER
+        || myq2_common::cvar::cvar_variable_value("vk_reflection") == 0.0
+        || r_worldmodel.is_null()
+        || r_newrefdef.rdflags & RDF_NOWORLDMODEL != 0
+    {
+        return;
+    }
+    let entdist = myq2_common::cvar::cvar_variable_value("vk_reflection_entdist");
+    let surfaces = r_worldmodel_surfaces() as *const MSurface;
+    let frustum = &*std::ptr::addr_of!(crate::vk_rmain::FRUSTUM);
+    let planes = &*std::ptr::addr_of!(WATER_PLANES);
+    let views = &mut *std::ptr::addr_of_mut!(REFL_VIEWS);
+
+    for (index, plane) in planes.iter().enumerate() {
+        if REFL_VIEW_COUNT >= max_planes.min(MAX_REFL_PLANES) {
+            break;
+        }
+        // only from above the water, and only when some of it is in view
+        if plane.distance(&r_origin) <= 0.0 || !plane_in_view(plane, surfaces) {
+            continue;
+        }
+        let start = std::time::Instant::now();
+
+        if views.len() <= REFL_VIEW_COUNT {
+            views.push(ReflectionView::default());
+        }
+        let view = &mut views[REFL_VIEW_COUNT];
+        REFL_VIEW_COUNT += 1;
+        view.plane = index;
+        view.normal = plane.normal;
+        view.dist = plane.dist;
+        view.vieworg = plane.mirror_point(&r_origin);
+
+        // the main frustum planes all pass through the eye, so mirror their
+        // normals and re-anchor them on the mirrored eye; then clip at the water
+        let mut cull: [CullPlane; 5] = [[0.0; 4]; 5];
+        for (c, f) in cull.iter_mut().zip(frustum.iter()) {
+            let n = plane.mirror_vector(&f.normal);
+            *c = [n[0], n[1], n[2], dot_product(&view.vieworg, &n)];
+        }
+        cull[4] = plane.cull_plane();
+
+        let leaves = crate::vk_rsurf::r_cull_pvs_surfaces(&cull, &view.vieworg, &mut view.surfaces);
+        view.surfaces.retain(|&s| (*surfaces.add(s as usize)).flags & SURF_DRAWTURB == 0);
+
+        view.entities.clear();
+        if entdist > 0.0 {
+            for (i, e) in entities.iter().enumerate() {
+                if e.model.is_null() || e.flags & RF_WEAPONMODEL != 0 {
+                    continue;
+                }
+                if plane.distance(&e.origin) < -REFL_ENTITY_SINK {
+                    continue;
+                }
+                let d = [
+                    e.origin[0] - view.vieworg[0],
+                    e.origin[1] - view.vieworg[1],
+                    e.origin[2] - view.vieworg[2],
+                ];
+                if dot_product(&d, &d) <= entdist * entdist {
+                    view.entities.push(i);
+                }
+            }
+        }
+
+        REFL_STATS.planes += 1;
+        REFL_STATS.leaves += leaves;
+        REFL_STATS.surfaces += view.surfaces.len() as u32;
+        REFL_STATS.entities += view.entities.len() as u32;
+        REFL_STATS.usec += start.elapsed().as_micros() as u32;
+    }
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn approx(a: &Vec3, b: &Vec3) -> bool {
+        (0..3).all(|i| (a[i] - b[i]).abs() < 1e-4)
+    }
+
+    #[test]
+    fn test_group_water_planes() {
+        let up = [0.0, 0.0, 1.0];
+        let planes = group_water_planes(vec![
+            (3, up, 64.0),
+            (5, up, 64.5), // same plane, within epsilon
+            (7, up, -32.0),
+            (9, [0.0, 0.0, -1.0], -64.0), // underside of the first plane
+            (11, up, -32.0),
+        ]);
+        let grouped: Vec<(f32, f32, Vec<u32>)> =
+            planes.iter().map(|p| (p.normal[2], p.dist, p.surfaces.clone())).collect();
+        assert_eq!(
+            grouped,
+            vec![(1.0, 64.0, vec![3, 5]), (1.0, -32.0, vec![7, 11]), (-1.0, -64.0, vec![9])]
+        );
+    }
+
+    #[test]
+    fn test_mirror_through_plane() {
+        let plane = WaterPlane { normal: [0.0, 0.0, 1.0], dist: 16.0, surfaces: Vec::new() };
+        assert_eq!(plane.distance(&[5.0, 6.0, 40.0]), 24.0);
+        assert!(approx(&plane.mirror_point(&[5.0, 6.0, 40.0]), &[5.0, 6.0, -8.0]));
+        assert!(approx(&plane.mirror_vector(&[0.6, 0.0, -0.8]), &[0.6, 0.0, 0.8]));
+
+        let h = std::f32::consts::FRAC_1_SQRT_2;
+        let slope = WaterPlane { normal: [h, 0.0, h], dist: 0.0, surfaces: Vec::new() };
+        let p = [3.0, -2.0, 7.0];
+        let m = slope.mirror_point(&p);
+        assert!((slope.distance(&m) + slope.distance(&p)).abs() < 1e-4);
+        assert!(approx(&slope.mirror_point(&m), &p));
+    }
+}
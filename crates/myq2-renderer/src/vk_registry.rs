@@ -0,0 +1,156 @@
+// vk_registry.rs — Growable image/model slot storage and name indexes
+//
+// gltextures and mod_known used to be fixed arrays scanned with a string
+// compare per slot on every lookup. Slots now live in fixed-size chunks that
+// are allocated as the high-water mark grows, so an Image or Model never
+// moves once handed out (the rest of the renderer keeps raw pointers to
+// them), and names resolve through a hash index.
+
+use std::collections::HashMap;
+use std::ops::{Index, IndexMut};
+
+/// Slots per chunk.
+const SLOT_CHUNK: usize = 256;
+
+/// Slot storage with stable addresses, indexed like the array it replaces.
+pub struct SlotPool<T> {
+    chunks: Vec<Box<[T]>>,
+}
+
+impl<T: Default> SlotPool<T> {
+    pub const fn new() -> Self {
+        Self { chunks: Vec::new() }
+    }
+
+    /// Make slots `0..n` addressable. Existing slots do not move.
+    pub fn reserve_slots(&mut self, n: usize) {
+        while self.chunks.len() * SLOT_CHUNK < n {
+            self.chunks.push((0..SLOT_CHUNK).map(|_| T::default()).collect());
+        }
+    }
+
+    /// Number of addressable slots.
+    pub fn capacity(&self) -> usize {
+        self.chunks.len() * SLOT_CHUNK
+    }
+
+    /// Slot number of `p`, if it points at a slot of this pool.
+    pub fn index_of(&self, p: *const T) -> Option<usize> {
+        let size = std::mem::size_of::<T>();
+        for (c, chunk) in self.chunks.iter().enumerate() {
+            let ofs = (p as usize).wrapping_sub(chunk.as_ptr() as usize);
+            if ofs < SLOT_CHUNK * size && ofs % size == 0 {
+                return Some(c * SLOT_CHUNK + ofs / size);
+            }
+        }
+        None
+    }
+}
+
+impl<T> Index<usize> for SlotPool<T> {
+    type Output = T;
+    fn index(&self, i: usize) -> &T {
+        &self.chunks[i / SLOT_CHUNK][i % SLOT_CHUNK]
+    }
+}
+
+impl<T> IndexMut<usize> for SlotPool<T> {
+    fn index_mut(&mut self, i: usize) -> &mut T {
+        &mut self.chunks[i / SLOT_CHUNK][i % SLOT_CHUNK]
+    }
+}
+
+/// Name -> slot index. Names compare exactly, as the linear scans did.
+pub struct NameIndex {
+    map: Option<HashMap<Box<str>, u32>>,
+}
+
+impl NameIndex {
+    pub const fn new() -> Self {
+        Self { map: None }
+    }
+
+    pub fn get(&self, name: &str) -> Option<usize> {
+        self.map.as_ref()?.get(name).map(|&slot| slot as usize)
+    }
+
+    pub fn insert(&mut self, name: &str, slot: usize) {
+        self.map.get_or_insert_with(HashMap::new).insert(name.into(), slot as u32);
+    }
+
+    /// Remove `name` if it still maps to `slot`.
+    pub fn remove(&mut self, name: &str, slot: usize) {
+        if let Some(map) = self.map.as_mut() {
+            if map.get(name) == Some(&(slot as u32)) {
+                map.remove(name);
+            }
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.map = None;
+    }
+
+    pub fn len(&self) -> usize {
+        self.map.as_ref().map_or(0, |m| m.len())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[derive(Default)]
+    struct Slot {
+        value: u64,
+    }
+
+    #[test]
+    fn test_slots_do_not_move_when_growing() {
+        let mut pool: SlotPool<Slot> = SlotPool::new();
+        pool.reserve_slots(1);
+        assert_eq!(pool.capacity(), SLOT_CHUNK);
+        pool[3].value = 33;
+        let p = &pool[3] as *const Slot;
+
+        pool.reserve_slots(SLOT_CHUNK * 4 + 1);
+        assert_eq!(pool.capacity(), SLOT_CHUNK * 5);
+        assert_eq!(&pool[3] as *const Slot, p);
+        assert_eq!(pool[3].value, 33);
+        pool[SLOT_CHUNK * 4].value = 7;
+        assert_eq!(pool[SLOT_CHUNK * 4].value, 7);
+    }
+
+    #[test]
+    fn test_index_of_round_trips() {
+        let mut pool: SlotPool<Slot> = SlotPool::new();
+        pool.reserve_slots(SLOT_CHUNK * 3);
+        for i in [0, 1, SLOT_CHUNK - 1, SLOT_CHUNK, SLOT_CHUNK * 3 - 1] {
+            assert_eq!(pool.index_of(&pool[i]), Some(i));
+        }
+        let outside = Slot::default();
+        assert_eq!(pool.index_of(&outside), None);
+        let misaligned = (&pool[1] as *const Slot as usize + 1) as *const Slot;
+        assert_eq!(pool.index_of(misaligned), None);
+    }
+
+    #[test]
+    fn test_name_index() {
+        let mut index = NameIndex::new();
+        assert_eq!(index.get("pics/conback.pcx"), None);
+        index.insert("pics/conback.pcx", 4);
+        index.insert("models/a/tris.md2", 9);
+        assert_eq!(index.get("pics/conback.pcx"), Some(4));
+        assert_eq!(index.get("PICS/conback.pcx"), None);
+
+        // a stale remove for a reused slot keeps the newer mapping
+        index.insert("pics/conback.pcx", 5);
+        index.remove("pics/conback.pcx", 4);
+        assert_eq!(index.get("pics/conback.pcx"), Some(5));
+        index.remove("pics/conback.pcx", 5);
+        assert_eq!(index.get("pics/conback.pcx"), None);
+        assert_eq!(index.len(), 1);
+        index.clear();
+        assert_eq!(index.len(), 0);
+    }
+}
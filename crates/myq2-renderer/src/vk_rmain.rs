@@ -116,6 +116,8 @@ pub static mut VK_SHADOWS: CvarRef = CvarRef { value: 1.0, string: "", modified:
 pub static mut VK_MODE: CvarRef = CvarRef { value: 4.0, string: "", modified: false };
 pub static mut VK_DYNAMIC: CvarRef = CvarRef { value: 1.0, string: "", modified: false };
 pub static mut VK_MONOLIGHTMAP: CvarRef = CvarRef { value: 0.0, string: "", modified: false };
+/// Lightmap atlas page size (1024/2048); 0 = classic 128x128 blocks. Applied at map load.
+pub static mut VK_LIGHTMAP_ATLAS: CvarRef = CvarRef { value: 1024.0, string: "", modified: false };
 pub static mut VK_MODULATE_CVAR: CvarRef = CvarRef { value: 1.5, string: "", modified: false };
 pub static mut VK_PICMIP: CvarRef = CvarRef { value: 0.0, string: "", modified: false };
 pub static mut VK_SKYMIP: CvarRef = CvarRef { value: 0.0, string: "", modified: false };
@@ -358,6 +360,8 @@ pub static mut R_TURBSIN: [f32; 256] = [0.0f32; 256];
 unsafe fn r_light_point(p: &Vec3, color: &mut Vec3) { crate::vk_light::r_light_point(p, color); }
 unsafe fn r_push_dlights() { crate::vk_light::r_push_dlights(); }
 unsafe fn r_mark_leaves() { crate::vk_rsurf::r_mark_leaves(); }
+unsafe fn r_flush_stains() { crate::vk_light::r_flush_stains(); }
+unsafe fn vk_update_dynamic_lightmaps(entities: &[EntityLocal]) { crate::vk_rsurf::vk_update_dynamic_lightmaps(entities); }
 unsafe fn vk_init_images() { crate::vk_image::vk_init_images(); }
 unsafe fn vk_shutdown_images() { crate::vk_image::vk_shutdown_images(); }
 unsafe fn mod_init() { crate::vk_model::mod_init(); }
@@ -459,7 +463,19 @@ fn glimp_log_new_frame() {
     unsafe {
         if let Some(ref mut f) = VK_LOG_FP {
             use std::io::Write;
-            let _ = writeln!(f, "*** R_BeginFrame ***");
+            let gs = &crate::vk_glstate::GL_STATE_STATS;
+            let _ = writeln!(f, "*** R_BeginFrame *** (state calls: {} issued, {} filtered)",
+                gs.total_issued(), gs.total_filtered());
+        }
+    }
+}
+
+/// Log one GL call, as the qgl logging wrappers did, when vk_log is set.
+pub(crate) fn glimp_log_call(args: std::fmt::Arguments) {
+    unsafe {
+        if let Some(ref mut f) = VK_LOG_FP {
+            use std::io::Write;
+            let _ = writeln!(f, "{}", args);
         }
     }
 }
@@ -522,6 +538,9 @@ fn qvk_rotate_f(angle: f32, x: f32, y: f32, z: f32) { crate::vk_local::qvk_rotat
 fn qvk_enable(cap: u32) { crate::vk_local::qvk_enable(cap); }
 fn qvk_disable(cap: u32) { crate::vk_local::qvk_disable(cap); }
 fn qvk_color4f(r: f32, g: f32, b: f32, a: f32) { crate::vk_local::qvk_color4f(r, g, b, a); }
+fn qvk_depth_func(func: u32) { crate::vk_local::qvk_depth_func(func); }
+fn qvk_alpha_func(func: u32, ref_val: f32) { crate::vk_local::qvk_alpha_func(func, ref_val); }
+fn qvk_cull_face(mode: u32) { crate::vk_local::qvk_cull_face(mode); }
 
 // --- GL functions wired to crate::vk_bindings ---
 fn qvk_load_identity() {
@@ -548,22 +567,10 @@ fn qvk_scissor(x: i32, y: i32, w: i32, h: i32) {
     // SAFETY: Delegates to OpenGL.
     unsafe { crate::vk_bindings::Scissor(x, y, w, h); }
 }
-fn qvk_depth_func(func: u32) {
-    // SAFETY: Delegates to OpenGL.
-    unsafe { crate::vk_bindings::DepthFunc(func); }
-}
 fn qvk_depth_range(near: f64, far: f64) {
     // SAFETY: Delegates to OpenGL.
     unsafe { crate::vk_bindings::DepthRange(near, far); }
 }
-fn qvk_alpha_func(func: u32, ref_val: f32) {
-    // SAFETY: Delegates to OpenGL.
-    unsafe { crate::vk_bindings::AlphaFunc(func, ref_val); }
-}
-fn qvk_cull_face(mode: u32) {
-    // SAFETY: Delegates to OpenGL.
-    unsafe { crate::vk_bindings::CullFace(mode); }
-}
 fn qvk_clear_color(r: f32, g: f32, b: f32, a: f32) {
     // SAFETY: Delegates to OpenGL.
     unsafe { crate::vk_bindings::ClearColor(r, g, b, a); }
@@ -671,7 +678,20 @@ pub fn r_rotate_for_entity(e: &EntityLocal) {
 
 // r_draw_null_model — removed (legacy immediate-mode GL)
 
-// r_draw_entities_on_list — removed (legacy immediate-mode GL; modern renderer handles entities)
+// r_draw_entities_on_list — removed (legacy immediate-mode GL). Entities are
+// drawn from the sorted vk_sort queue in r_render_view through r_draw_entity.
+
+/// Draw one entity with the modern path. `entity.model` must be non-null.
+unsafe fn r_draw_entity(modern: &mut ModernRenderPath, entity: &EntityLocal) {
+    // SAFETY: entity.model points into mod_known for the frame.
+    let model = &*entity.model;
+    match model.r#type {
+        crate::vk_model_types::ModType::Alias => modern.draw_alias_model(entity),
+        crate::vk_model_types::ModType::Brush => modern.draw_brush_model(entity),
+        crate::vk_model_types::ModType::Sprite => modern.draw_sprite_model(entity),
+        _ => {}
+    }
+}
 
 // r_draw_particles — removed (legacy immediate-mode GL; modern renderer handles particles)
 
@@ -1044,6 +1064,9 @@ pub fn r_render_view(fd: &RefdefLocal) {
             crate::vk_local::c_brush_polys = 0;
             crate::vk_local::c_alias_polys = 0;
         }
+        crate::vk_light::LIGHT_POINT_STATS = Default::default();
+        crate::vk_light::DLIGHT_STATS = Default::default();
+        crate::vk_warp::WARP_STATS = Default::default();
 
         r_push_dlights();
 
@@ -1057,6 +1080,11 @@ pub fn r_render_view(fd: &RefdefLocal) {
         r_setup_gl();
         r_mark_leaves();
         r_setup_fog();
+        r_flush_stains();
+        vk_update_dynamic_lightmaps(&fd.entities);
+        crate::vk_warp::r_update_sky_visibility();
+        crate::vk_warp::r_warp_water(&*std::ptr::addr_of!(crate::vk_rsurf::R_VISIBLE_SURFACES));
+        crate::vk_refl::r_reflection_pass(&fd.entities);
 
         // Modern renderer: begin 3D pass with view parameters
         let params = FrameParams {
@@ -1074,38 +1102,38 @@ pub fn r_render_view(fd: &RefdefLocal) {
         let modern = MODERN.as_mut().unwrap();
         modern.begin_frame(&params);
 
+        // Reflections first, so the water can sample them
+        modern.draw_reflections(
+            myq2_common::cvar::cvar_variable_value("vk_reflection") != 0.0,
+            crate::vk_refl::r_reflection_views(),
+            &fd.entities,
+        );
+
         // World geometry
         if R_DRAWWORLD.value != 0.0 {
             modern.draw_world();
         }
 
-        // Entities
-        if R_DRAWENTITIES.value != 0.0 {
-            for entity in &fd.entities {
-                if entity.model.is_null() {
-                    // Beam entities (RF_BEAM flag) have null models and are
-                    // rendered as lines between origin and oldorigin. Skip for now
-                    // as they require specialized line/billboard rendering.
-                    continue;
-                }
-                // SAFETY: entity.model is *mut RefModel (opaque). Cast to
-                // the concrete renderer Model type for field access.
-                let model = &*(entity.model as *mut crate::vk_model_types::Model);
-                match model.r#type {
-                    crate::vk_model_types::ModType::Alias => {
-                        modern.draw_alias_model(entity);
-                    }
-                    crate::vk_model_types::ModType::Brush => {
-                        modern.draw_brush_model(entity);
-                    }
-                    crate::vk_model_types::ModType::Sprite => {
-                        modern.draw_sprite_model(entity);
-                    }
-                    _ => {}
-                }
+        // Entities and translucent world surfaces, sorted once: opaque
+        // entities grouped by state, then everything translucent back to front
+        let entities: &[EntityLocal] = if R_DRAWENTITIES.value != 0.0 { &fd.entities } else { &[] };
+        let visible: &[u32] = if R_DRAWWORLD.value != 0.0 {
+            &*std::ptr::addr_of!(crate::vk_rsurf::R_VISIBLE_SURFACES)
+        } else {
+            &[]
+        };
+        let queue = crate::vk_sort::r_build_render_queue(entities, visible);
+
+        for it in queue.opaque() {
+            if let crate::vk_sort::QueueItem::Entity(i) = it.item {
+                r_draw_entity(modern, &fd.entities[i as usize]);
             }
         }
 
+        if R_DRAWWORLD.value != 0.0 {
+            modern.draw_water();
+        }
+
         // Effects
         modern.render_dlights();
 
@@ -1120,7 +1148,24 @@ pub fn r_render_view(fd: &RefdefLocal) {
         }).collect();
         modern.draw_particles(&particle_data);
 
-        modern.draw_alpha_surfaces();
+        // Runs of consecutive alpha surfaces go down as one call
+        let mut alpha_run: Vec<u32> = Vec::new();
+        for it in queue.translucent() {
+            match it.item {
+                crate::vk_sort::QueueItem::AlphaSurface(surfnum) => alpha_run.push(surfnum),
+                crate::vk_sort::QueueItem::Entity(i) => {
+                    if !alpha_run.is_empty() {
+                        modern.draw_alpha_surfaces(&alpha_run);
+                        alpha_run.clear();
+                    }
+                    r_draw_entity(modern, &fd.entities[i as usize]);
+                }
+            }
+        }
+        if !alpha_run.is_empty() {
+            modern.draw_alpha_surfaces(&alpha_run);
+        }
+
         modern.draw_sky();
 
         r_flash();
@@ -1131,6 +1176,65 @@ pub fn r_render_view(fd: &RefdefLocal) {
                 crate::vk_local::c_brush_polys, crate::vk_local::c_alias_polys,
                 C_VISIBLE_TEXTURES, C_VISIBLE_LIGHTMAPS,
             ));
+            let lm = &crate::vk_rsurf::LM_UPLOAD_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:4} lmsurf {:4} lmup {:7} lmbytes {:3} lmpages\n",
+                lm.frame_surfaces, lm.frame_uploads, lm.frame_bytes, lm.frame_pages,
+            ));
+            let v = &crate::vk_rsurf::WORLD_VIS_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:4} leaves {:4} visleaves {:4} surfs {} pvsbuild\n",
+                v.leaves, v.leaves_visible, v.surfaces_emitted, v.cache_rebuilds,
+            ));
+            let w = &crate::vk_rsurf::WORLD_DRAW_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:4} wsurf {:3} draws {:3} texbinds {:3} lmbinds {:6} indices\n",
+                w.surfaces, w.draw_calls, w.texture_binds, w.lightmap_binds, w.indices,
+            ));
+            let st = &crate::vk_light::STAIN_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:3} stains {:3} dropped {:4} stsurf {:6} sttexels\n",
+                st.queued, st.dropped, st.surfaces, st.texels,
+            ));
+            let lp = &crate::vk_light::LIGHT_POINT_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:3} lpoint {:3} lptrace {:3}% lphit\n",
+                lp.hits + lp.misses, lp.misses,
+                if lp.hits + lp.misses > 0 { lp.hits * 100 / (lp.hits + lp.misses) } else { 0 },
+            ));
+            let wp = &crate::vk_warp::WARP_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:3} water {:5} wverts {:3} skysurf {:4} skyclip {:4} skypoly {} skybuild\n",
+                wp.water_surfaces, wp.water_verts, wp.sky_surfaces, wp.sky_clipped, wp.sky_polys, wp.sky_rebuilds,
+            ));
+            let rf = &crate::vk_refl::REFL_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:2} rplanes {:4} rleafs {:4} rsurfs {:3} rents {:5} us/rplane\n",
+                rf.planes, rf.leaves, rf.surfaces, rf.entities,
+                if rf.planes > 0 { rf.usec / rf.planes } else { 0 },
+            ));
+            // 2D is drawn after the scene, so these are the previous frame's
+            let d2 = &crate::vk_draw::DRAW2D_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:4} 2dquads {:3} 2ddraws {:2} 2dflush\n",
+                d2.quads, d2.batches, d2.flushes,
+            ));
+            // also a whole frame behind: counted from R_BeginFrame to R_BeginFrame
+            let gs = &crate::vk_glstate::GL_STATE_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:4} glstate {:4} glfiltered\n",
+                gs.total_issued(), gs.total_filtered(),
+            ));
+            let rq = &crate::vk_sort::FRAME_QUEUE.stats;
+            vid_printf(PRINT_ALL, &format!(
+                "{:3} opaque {:3} transl {:3} alphasurf {:3} statechg {} sortpass\n",
+                rq.opaque, rq.translucent, rq.alpha_surfaces, rq.state_changes, rq.passes,
+            ));
+            let dl = &crate::vk_light::DLIGHT_STATS;
+            vid_printf(PRINT_ALL, &format!(
+                "{:3} dlights {:4} dltest {:4} dlmark {:4} dlbuild\n",
+                dl.lights, dl.tested, dl.marked, dl.rebuilt,
+            ));
         }
     }
 }
@@ -1201,12 +1305,22 @@ pub fn r_set_light_level() {
 pub fn r_render_frame(fd: &RefdefLocal) {
     r_render_view(fd);
     r_set_light_level();
+    r_set_gl2d();
+}
+
+// ============================================================
+// R_EndFrame
+// ============================================================
+
+/// Finish the frame once the 2D pass has been drawn over the view: flush the
+/// 2D batches, post-process, capture and present (vk_imp_end_frame).
+pub fn r_end_frame() {
     // SAFETY: single-threaded engine access pattern
     unsafe {
-        // Flush 2D batches and apply post-processing before switching to 2D mode
-        MODERN.as_mut().unwrap().end_frame();
+        if let Some(modern) = MODERN.as_mut() {
+            modern.end_frame();
+        }
     }
-    r_set_gl2d();
 }
 
 // ============================================================
@@ -1244,6 +1358,7 @@ pub fn r_register() {
         VK_POLYBLEND = cvar_get("vk_polyblend", "1", CVAR_ARCHIVE);
         VK_FLASHBLEND = cvar_get("vk_flashblend", "0", CVAR_ARCHIVE);
         VK_MONOLIGHTMAP = cvar_get("vk_monolightmap", "0", CVAR_ZERO);
+        VK_LIGHTMAP_ATLAS = cvar_get("vk_lightmap_atlas", "1024", CVAR_ARCHIVE);
         VK_DRIVER = cvar_get("vk_driver", "opengl32", CVAR_ARCHIVE);
         VK_TEXTUREMODE = cvar_get("vk_texturemode", "VK_LINEAR_MIPMAP_LINEAR", CVAR_ARCHIVE);
         VK_TEXTUREALPHAMODE = cvar_get("vk_texturealphamode", "default", CVAR_ZERO);
@@ -1260,6 +1375,13 @@ pub fn r_register() {
 
         VK_EXT_TEXTURE_FILTER_ANISOTROPIC = cvar_get("vk_ext_texture_filter_anisotropic", "1", CVAR_ARCHIVE);
         VK_SGIS_GENERATE_MIPMAP = cvar_get("vk_sgis_generate_mipmap", "0", CVAR_ARCHIVE);
+        // Keep processed TGA/PNG/JPG mip chains under <gamedir>/texcache (read live by vk_texcache)
+        cvar_get("vk_texcache", "0", CVAR_ARCHIVE);
+        // Planar water reflections (read live by vk_refl): on/off, planes per frame,
+        // entity range (0 = world only)
+        cvar_get("vk_reflection", "0", CVAR_ARCHIVE);
+        cvar_get("vk_reflection_max", "2", CVAR_ARCHIVE);
+        cvar_get("vk_reflection_entdist", "1024", CVAR_ARCHIVE);
         R_CELSHADING = cvar_get("r_celshading", "0", CVAR_ARCHIVE);
         R_FOG = cvar_get("r_fog", "0", CVAR_ARCHIVE);
         R_TIMEBASEDFX = cvar_get("r_timebasedfx", "1", CVAR_ARCHIVE);
@@ -1292,6 +1414,10 @@ pub fn r_register() {
         VK_SCREENSHOT_FORMAT = cvar_get("vk_screenshot_format", "tga", CVAR_ARCHIVE);
         // vk_screenshot_quality: 0-100 (JPEG quality, only used for jpg format)
         VK_SCREENSHOT_QUALITY = cvar_get("vk_screenshot_quality", "85", CVAR_ARCHIVE);
+        // vk_capture: dump every frame to scrnshot/capNNNN/ while set;
+        // vk_capture_format as vk_screenshot_format (read live in vk_capture.rs)
+        cvar_get("vk_capture", "0", CVAR_ZERO);
+        cvar_get("vk_capture_format", "png", CVAR_ARCHIVE);
 
         // Initialize Vulkan render configuration with MSAA and anisotropy settings
         crate::modern::gpu_device::with_device(|ctx| {
@@ -1659,6 +1785,9 @@ pub fn r_shutdown() {
 
     // SAFETY: single-threaded engine shutdown sequence
     unsafe {
+        // Let queued screenshots finish writing
+        crate::vk_capture::r_capture_shutdown();
+
         // Shutdown modern renderer before releasing GL context
         if let Some(ref mut m) = MODERN {
             m.shutdown();
@@ -1691,6 +1820,7 @@ pub fn r_begin_frame(camera_separation: f32) {
             VK_LOG.modified = false;
         }
 
+        crate::vk_glstate::gl_state_new_frame();
         if VK_LOG.value != 0.0 {
             glimp_log_new_frame();
         }
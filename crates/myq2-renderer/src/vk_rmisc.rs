@@ -23,8 +23,7 @@ use crate::vk_local::{Image, ImageType,
 use crate::vk_rmain::{
     R_PARTICLETEXTURE, R_NOTEXTURE, VK_CONFIG, VK_STATE,
     VK_SWAPINTERVAL, VK_TEXTUREMODE, VK_TEXTUREALPHAMODE, VK_TEXTURESOLIDMODE,
-    VID, VID_GAMMA, vid_printf,
-    VK_SCREENSHOT_FORMAT, VK_SCREENSHOT_QUALITY,
+    vid_printf,
 };
 use myq2_common::q_shared::PRINT_ALL;
 
@@ -144,173 +143,20 @@ pub fn r_init_particle_texture() {
 
 // ============================================================
 // vk_screenshot_f - R1Q2/Q2Pro format selection support
-// Supports TGA, PNG, and JPG formats via gl_screenshot_format cvar
-// JPEG quality controlled by gl_screenshot_quality cvar (0-100)
+// Supports TGA, PNG, and JPG formats via vk_screenshot_format cvar
+// JPEG quality controlled by vk_screenshot_quality cvar (0-100)
+// Encoding and writing happen on the capture threads (vk_capture)
 // ============================================================
 pub fn vk_screen_shot_f() {
     // SAFETY: single-threaded engine access pattern
     unsafe {
-        use std::fs;
-        use std::path::Path;
-        use image::{ImageBuffer, Rgb, codecs::jpeg::JpegEncoder};
-
-        // Determine format from cvar
-        let format_str = VK_SCREENSHOT_FORMAT.string.to_lowercase();
-        let (ext, format) = match format_str.as_str() {
-            "png" => ("png", ScreenshotFormat::Png),
-            "jpg" | "jpeg" => ("jpg", ScreenshotFormat::Jpg),
-            _ => ("tga", ScreenshotFormat::Tga),
-        };
-
-        // JPEG quality (0-100), default 85
-        let jpeg_quality = (VK_SCREENSHOT_QUALITY.value as u8).clamp(1, 100);
-
-        // create the scrnshots directory if it doesn't exist
-        let gamedir = myq2_common::files::fs_gamedir();
-        let scrnshot_dir = format!("{}/scrnshot", gamedir);
-        let _ = fs::create_dir_all(&scrnshot_dir);
-
-        // find a file name to save it to
-        let mut picname = format!("quake00.{}", ext);
-        let mut checkname = String::new();
-        let mut found = false;
-
-        for i in 0..=99i32 {
-            let tens = (i / 10) as u8 + b'0';
-            let ones = (i % 10) as u8 + b'0';
-            picname = format!("quake{}{}.{}", tens as char, ones as char, ext);
-            checkname = format!("{}/{}", scrnshot_dir, picname);
-            if !Path::new(&checkname).exists() {
-                found = true;
-                break;
-            }
-        }
-
-        if !found {
-            vid_printf(PRINT_ALL, "SCR_ScreenShot_f: Couldn't create a file\n");
-            return;
-        }
-
-        let width = VID.width as usize;
-        let height = VID.height as usize;
-        let pixel_count = width * height * 3;
-
-        // Read pixels from framebuffer
-        let mut pixels = vec![0u8; pixel_count];
-        qvk_read_pixels(0, 0, width as i32, height as i32, &mut pixels);
-
-        // apply gamma correction if necessary
-        let vk_config = VK_CONFIG.as_ref();
-        if vk_config.is_some_and(|c| c.gammaramp != 0) {
-            let mut gamma_table = [0u8; 256];
-            for i in 0..256 {
-                let v = (255.0
-                    * ((i as f64 + 0.5) * 0.0039138943248532289628180039138943)
-                        .powf(VID_GAMMA.value as f64)
-                    + 0.5) as i32;
-                gamma_table[i] = v.clamp(0, 255) as u8;
-            }
-
-            for i in 0..pixel_count {
-                pixels[i] = gamma_table[pixels[i] as usize];
-            }
-        }
-
-        // Write based on format
-        match format {
-            ScreenshotFormat::Tga => {
-                // TGA format (original behavior)
-                use std::io::Write;
-
-                let buf_size = pixel_count + 18;
-                let mut buffer = vec![0u8; buf_size];
-
-                // TGA header
-                buffer[2] = 2; // uncompressed type
-                buffer[12] = (width & 0xFF) as u8;
-                buffer[13] = (width >> 8) as u8;
-                buffer[14] = (height & 0xFF) as u8;
-                buffer[15] = (height >> 8) as u8;
-                buffer[16] = 24; // pixel size
-
-                // Copy pixels and swap RGB to BGR for TGA
-                for i in 0..width * height {
-                    let src = i * 3;
-                    let dst = 18 + i * 3;
-                    buffer[dst] = pixels[src + 2];     // B
-                    buffer[dst + 1] = pixels[src + 1]; // G
-                    buffer[dst + 2] = pixels[src];     // R
-                }
-
-                match fs::File::create(&checkname) {
-                    Ok(mut f) => {
-                        if f.write_all(&buffer).is_err() {
-                            vid_printf(PRINT_ALL, "SCR_ScreenShot_f: Could not write file\n");
-                            return;
-                        }
-                    }
-                    Err(_) => {
-                        vid_printf(PRINT_ALL, "SCR_ScreenShot_f: Could not create file\n");
-                        return;
-                    }
-                }
-            }
-            ScreenshotFormat::Png | ScreenshotFormat::Jpg => {
-                // Create image buffer (flip vertically since GL reads bottom-up)
-                let mut img: ImageBuffer<Rgb<u8>, Vec<u8>> =
-                    ImageBuffer::new(width as u32, height as u32);
-
-                for y in 0..height {
-                    for x in 0..width {
-                        let src_y = height - 1 - y; // Flip vertically
-                        let idx = (src_y * width + x) * 3;
-                        let pixel = Rgb([pixels[idx], pixels[idx + 1], pixels[idx + 2]]);
-                        img.put_pixel(x as u32, y as u32, pixel);
-                    }
-                }
-
-                let write_ok = match format {
-                    ScreenshotFormat::Png => img.save(&checkname).is_ok(),
-                    ScreenshotFormat::Jpg => {
-                        // Use JPEG encoder with quality setting
-                        match fs::File::create(&checkname) {
-                            Ok(f) => {
-                                let mut encoder = JpegEncoder::new_with_quality(f, jpeg_quality);
-                                encoder.encode(
-                                    img.as_raw(),
-                                    width as u32,
-                                    height as u32,
-                                    image::ExtendedColorType::Rgb8,
-                                ).is_ok()
-                            }
-                            Err(_) => false,
-                        }
-                    }
-                    _ => unreachable!(),
-                };
-
-                if !write_ok {
-                    vid_printf(PRINT_ALL, "SCR_ScreenShot_f: Could not write file\n");
-                    return;
-                }
-            }
-        }
-
-        vid_printf(PRINT_ALL, &format!("Wrote {}\n", picname));
+        crate::vk_capture::r_capture_screenshot();
     }
 }
 
-/// Screenshot format enumeration
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
-enum ScreenshotFormat {
-    Tga,
-    Png,
-    Jpg,
-}
-
 /// qglReadPixels wrapper — reads pixel data from the framebuffer.
 /// In C: qglReadPixels(x, y, w, h, VK_RGB, VK_UNSIGNED_BYTE, pixels)
-fn qvk_read_pixels(x: i32, y: i32, w: i32, h: i32, pixels: &mut [u8]) {
+pub(crate) fn qvk_read_pixels(x: i32, y: i32, w: i32, h: i32, pixels: &mut [u8]) {
     // SAFETY: pixels buffer is allocated by caller with sufficient size (w*h*3).
     // GL call requires valid context which is guaranteed when screenshot is taken.
     unsafe {
@@ -356,6 +202,9 @@ pub fn vk_strings_f() {
 pub fn vk_set_default_state() {
     // SAFETY: single-threaded engine access pattern
     unsafe {
+        // new context: nothing the state filter remembers holds any more
+        crate::vk_glstate::gl_state_reset();
+
         qvk_enable(VK_TEXTURE_2D);
 
         // GL_ALPHA_TEST enable removed — alpha testing handled by GLSL discard
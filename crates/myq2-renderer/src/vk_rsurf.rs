@@ -2,11 +2,15 @@
 // Converted from: myq2-original/ref_gl/vk_rsurf.c
 
 use crate::vk_light::*;
+use crate::vk_light_simd::BlockLights;
+use crate::vk_lightmap_atlas::{LightmapAtlas, LightmapUploadStats, LmRect, LM_ATLAS_MIN_SIZE};
 use crate::vk_local::*;
 use crate::vk_rmain::vid_printf;
+use crate::modern::geometry::WorldDrawStats;
+use crate::vk_world_cull::{cull_boxes, CullPlane, PvsSurfaceCache, SurfaceStamps, WorldVisStats};
 use crate::vk_warp::*;
 use myq2_common::q_shared::*;
-use myq2_common::qfiles::MAX_MAP_LEAFS;
+use myq2_common::qfiles::{MAX_MAP_LEAFS, MAXLIGHTMAPS};
 use std::collections::HashMap;
 
 // ============================================================
@@ -60,6 +64,21 @@ static mut VK_LMS: VkLightmapState = VkLightmapState {
     lightmap_buffer: [0; 4 * BLOCK_WIDTH as usize * BLOCK_HEIGHT as usize],
 };
 
+/// Large-page atlas for the current map (vk_lightmap_atlas > 0). When None the
+/// classic 128x128 LM_AllocBlock blocks are used.
+static mut LM_ATLAS: Option<LightmapAtlas> = None;
+
+/// Lightmap upload counters, reported by r_speeds.
+pub static mut LM_UPLOAD_STATS: LightmapUploadStats = LightmapUploadStats::new();
+
+/// Edge length in texels of a lightmap page (atlas page or classic block).
+pub unsafe fn lm_page_size() -> i32 {
+    match LM_ATLAS {
+        Some(ref atlas) => atlas.size() as i32,
+        None => BLOCK_WIDTH,
+    }
+}
+
 // ============================================================
 // DEFERRED RENDER COMMAND BATCHING
 // ============================================================
@@ -587,6 +606,7 @@ unsafe fn lm_upload_block(dynamic: bool) {
             VK_UNSIGNED_BYTE,
             VK_LMS.lightmap_buffer.as_ptr(),
         );
+        LM_UPLOAD_STATS.record_upload(texture as u32, (BLOCK_WIDTH * height * LIGHTMAP_BYTES) as u64);
     } else {
         qvk_tex_image_2d(
             VK_TEXTURE_2D,
@@ -599,6 +619,7 @@ unsafe fn lm_upload_block(dynamic: bool) {
             VK_UNSIGNED_BYTE,
             VK_LMS.lightmap_buffer.as_ptr(),
         );
+        LM_UPLOAD_STATS.record_upload(texture as u32, (BLOCK_WIDTH * BLOCK_HEIGHT * LIGHTMAP_BYTES) as u64);
         VK_LMS.current_lightmap_texture += 1;
         if VK_LMS.current_lightmap_texture == MAX_LIGHTMAPS as i32 {
             vid_printf(ERR_DROP, "LM_UploadBlock() - MAX_LIGHTMAPS exceeded\n");
@@ -645,7 +666,52 @@ unsafe fn lm_alloc_block(w: i32, h: i32, x: &mut i32, y: &mut i32) -> bool {
 /// # Safety
 /// Accesses model data and allocates poly via hunk.
 pub unsafe fn vk_build_polygon_from_surface(fa: &mut MSurface) {
-    let lnumverts = fa.numedges;
+    let verts = surface_polygon_verts(&*currentmodel, fa);
+    emit_surface_polygon(fa, &verts);
+}
+
+/// The polygon of a surface, from its edges. Slots 5/6 hold the lightmap s/t
+/// relative to the surface's texturemins, before placement in a lightmap page
+/// (see emit_surface_polygon). Reads only `model` and `fa`.
+///
+/// # Safety
+/// `model`'s edge, surfedge and vertex arrays must cover the surface.
+pub unsafe fn surface_polygon_verts(model: &Model, fa: &MSurface) -> Vec<[f32; VERTEXSIZE]> {
+    let texinfo = &*fa.texinfo;
+    let (width, height) = ((*texinfo.image).width as f32, (*texinfo.image).height as f32);
+    let svec = [texinfo.vecs[0][0], texinfo.vecs[0][1], texinfo.vecs[0][2]];
+    let tvec = [texinfo.vecs[1][0], texinfo.vecs[1][1], texinfo.vecs[1][2]];
+
+    (0..fa.numedges)
+        .map(|i| {
+            let lindex = *model.surfedges.offset((fa.firstedge + i) as isize);
+            let vec = if lindex > 0 {
+                (*model.vertexes.add((*model.edges.add(lindex as usize)).v[0] as usize)).position
+            } else {
+                (*model.vertexes.add((*model.edges.add((-lindex) as usize)).v[1] as usize)).position
+            };
+
+            let s = dot_product(&vec, &svec) + texinfo.vecs[0][3];
+            let t = dot_product(&vec, &tvec) + texinfo.vecs[1][3];
+
+            let mut v = [0.0f32; VERTEXSIZE];
+            v[..3].copy_from_slice(&vec);
+            v[3] = s / width;
+            v[4] = t / height;
+            v[5] = s - fa.texturemins[0] as f32;
+            v[6] = t - fa.texturemins[1] as f32;
+            v
+        })
+        .collect()
+}
+
+/// Link a polygon built by surface_polygon_verts into the surface, finishing
+/// the lightmap coordinates for the surface's place in its lightmap page.
+///
+/// # Safety
+/// Allocates poly via hunk; reads the lightmap page size.
+pub unsafe fn emit_surface_polygon(fa: &mut MSurface, verts: &[[f32; VERTEXSIZE]]) {
+    let lnumverts = verts.len() as i32;
 
     let poly = hunk_alloc_glpoly(lnumverts as usize);
     (*poly).next = fa.polys;
@@ -653,55 +719,17 @@ pub unsafe fn vk_build_polygon_from_surface(fa: &mut MSurface) {
     fa.polys = poly;
     (*poly).numverts = lnumverts;
 
-    for i in 0..lnumverts {
-        let lindex = currentmodel_surfedge(fa.firstedge + i);
-
-        let vec = if lindex > 0 {
-            currentmodel_vertex_position(currentmodel_edge_v(lindex, 0))
-        } else {
-            currentmodel_vertex_position(currentmodel_edge_v(-lindex, 1))
-        };
-
-        let texinfo = &*fa.texinfo;
-
-        let mut s = dot_product(
-            &vec,
-            &[texinfo.vecs[0][0], texinfo.vecs[0][1], texinfo.vecs[0][2]],
-        ) + texinfo.vecs[0][3];
-        s /= (*texinfo.image).width as f32;
-
-        let mut t = dot_product(
-            &vec,
-            &[texinfo.vecs[1][0], texinfo.vecs[1][1], texinfo.vecs[1][2]],
-        ) + texinfo.vecs[1][3];
-        t /= (*texinfo.image).height as f32;
-
-        glpoly_set_vert(poly, i, &vec);
-        glpoly_set_st(poly, i, s, t);
+    let page = (lm_page_size() * 16) as f32;
+    for (i, v) in verts.iter().enumerate() {
+        let i = i as i32;
+        glpoly_set_vert(poly, i, &[v[0], v[1], v[2]]);
+        glpoly_set_st(poly, i, v[3], v[4]);
 
         // lightmap texture coordinates
-        let mut ls = dot_product(
-            &vec,
-            &[texinfo.vecs[0][0], texinfo.vecs[0][1], texinfo.vecs[0][2]],
-        ) + texinfo.vecs[0][3];
-        ls -= fa.texturemins[0] as f32;
-        ls += fa.light_s as f32 * 16.0;
-        ls += 8.0;
-        ls /= (BLOCK_WIDTH * 16) as f32;
-
-        let mut lt = dot_product(
-            &vec,
-            &[texinfo.vecs[1][0], texinfo.vecs[1][1], texinfo.vecs[1][2]],
-        ) + texinfo.vecs[1][3];
-        lt -= fa.texturemins[1] as f32;
-        lt += fa.light_t as f32 * 16.0;
-        lt += 8.0;
-        lt /= (BLOCK_HEIGHT * 16) as f32;
-
+        let ls = (v[5] + fa.light_s as f32 * 16.0 + 8.0) / page;
+        let lt = (v[6] + fa.light_t as f32 * 16.0 + 8.0) / page;
         glpoly_set_lm_st(poly, i, ls, lt);
     }
-
-    (*poly).numverts = lnumverts;
 }
 
 /// Create the lightmap texture for a surface.
@@ -712,10 +740,50 @@ pub unsafe fn vk_create_surface_lightmap(surf: &mut MSurface) {
     if surf.flags & (SURF_DRAWSKY | SURF_DRAWTURB) != 0 {
         return;
     }
+    let Some((base, stride)) = lm_place_surface(surf) else {
+        return;
+    };
+    r_set_cache_state(surf);
+    r_build_light_map(surf, base, stride);
+}
+
+/// Create a surface's lightmap from texels built by vk_prepare_surface.
+///
+/// # Safety
+/// Accesses lightmap allocation state.
+pub unsafe fn vk_create_surface_lightmap_from(surf: &mut MSurface, texels: &[u8]) {
+    let Some((base, stride)) = lm_place_surface(surf) else {
+        return;
+    };
+    r_set_cache_state(surf);
+
+    let row = (((surf.extents[0] as i32 >> 4) + 1) * LIGHTMAP_BYTES) as usize;
+    for (t, src) in texels.chunks_exact(row).enumerate() {
+        std::ptr::copy_nonoverlapping(src.as_ptr(), base.add(t * stride as usize), row);
+    }
+}
 
+/// LM_AllocBlock for a surface: place its lightmap in the atlas or the
+/// current block, uploading the block when full. Returns where its texels go.
+///
+/// # Safety
+/// Accesses lightmap allocation state.
+unsafe fn lm_place_surface(surf: &mut MSurface) -> Option<(*mut u8, i32)> {
     let smax = (surf.extents[0] as i32 >> 4) + 1;
     let tmax = (surf.extents[1] as i32 >> 4) + 1;
 
+    if let Some(ref mut atlas) = LM_ATLAS {
+        let Some((page, x, y)) = atlas.alloc(smax as u32, tmax as u32) else {
+            vid_printf(ERR_DROP, "LM_AllocBlock: lightmap atlas full\n");
+            return None;
+        };
+        surf.light_s = x as i32;
+        surf.light_t = y as i32;
+        // Texture 0 stays the dynamic block, pages start at 1 like LM_UploadBlock.
+        surf.lightmaptexturenum = page as i32 + 1;
+        return Some((atlas.texel_ptr(page, x, y), atlas.stride() as i32));
+    }
+
     if !lm_alloc_block(smax, tmax, &mut surf.light_s, &mut surf.light_t) {
         lm_upload_block(false);
         lm_init_block();
@@ -735,9 +803,78 @@ pub unsafe fn vk_create_surface_lightmap(surf: &mut MSurface) {
         .lightmap_buffer
         .as_mut_ptr()
         .offset(base_offset as isize);
+    Some((base, BLOCK_WIDTH * LIGHTMAP_BYTES))
+}
 
-    r_set_cache_state(surf);
-    r_build_light_map(surf, base, BLOCK_WIDTH * LIGHTMAP_BYTES);
+/// Per-load inputs of vk_prepare_surface, captured on the main thread.
+pub struct SurfacePrepContext {
+    /// vk_modulate times each light style's colour.
+    pub style_scale: [[f32; 3]; MAX_LIGHTSTYLES],
+    pub monolightmap: u8,
+    pub level: crate::simd::SimdLevel,
+}
+
+impl SurfacePrepContext {
+    /// # Safety
+    /// Reads the refdef light styles and cvars.
+    pub unsafe fn current() -> Self {
+        let modulate = crate::vk_rmain::VK_MODULATE_CVAR.value;
+        Self {
+            style_scale: std::array::from_fn(|i| {
+                let rgb = r_newrefdef.lightstyle(i).rgb;
+                [modulate * rgb[0], modulate * rgb[1], modulate * rgb[2]]
+            }),
+            monolightmap: vk_monolightmap_char(),
+            level: crate::simd::level(),
+        }
+    }
+}
+
+/// A surface's map-load work that needs no lightmap page or hunk: its
+/// lightmap texels and polygon.
+#[derive(Default)]
+pub struct PreparedSurface {
+    /// smax * tmax RGBA texels; empty for unlit surfaces.
+    pub texels: Vec<u8>,
+    /// From surface_polygon_verts; empty for warped surfaces.
+    pub verts: Vec<[f32; VERTEXSIZE]>,
+    /// The lightmap is larger than the blocklights buffer allows.
+    pub oversize: bool,
+}
+
+/// Build a surface's lightmap texels and polygon. Touches no renderer
+/// globals, so map loading runs it on worker threads, each with its own `bl`.
+///
+/// # Safety
+/// The surface's extents, texinfo and samples must be set, and `model`'s
+/// geometry arrays must cover it.
+pub unsafe fn vk_prepare_surface(
+    model: &Model,
+    surf: &MSurface,
+    ctx: &SurfacePrepContext,
+    bl: &mut BlockLights,
+) -> PreparedSurface {
+    let flags = (*surf.texinfo).flags;
+    let mut prep = PreparedSurface::default();
+
+    if flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP) == 0
+        && surf.flags & (SURF_DRAWSKY | SURF_DRAWTURB) == 0
+    {
+        if r_light_map_fits(surf) {
+            let smax = (surf.extents[0] as i32 >> 4) + 1;
+            let tmax = (surf.extents[1] as i32 >> 4) + 1;
+            r_accumulate_static_light(surf, bl, |style| ctx.style_scale[style], ctx.level);
+            prep.texels = vec![0u8; (smax * tmax * LIGHTMAP_BYTES) as usize];
+            r_store_light_map(bl, smax, tmax, prep.texels.as_mut_ptr(), smax * LIGHTMAP_BYTES, ctx.monolightmap, ctx.level);
+        } else {
+            prep.oversize = true;
+        }
+    }
+
+    if flags & SURF_WARP == 0 {
+        prep.verts = surface_polygon_verts(model, surf);
+    }
+    prep
 }
 
 /// Create the stain map buffer for a surface.
@@ -770,6 +907,18 @@ pub unsafe fn vk_begin_building_lightmaps(_m: *mut Model) {
         VK_LMS.allocated[i] = 0;
     }
 
+    let atlas_size = crate::vk_rmain::VK_LIGHTMAP_ATLAS.value as u32;
+    LM_ATLAS = if atlas_size >= LM_ATLAS_MIN_SIZE {
+        Some(LightmapAtlas::new(atlas_size, MAX_LIGHTMAPS - 1))
+    } else {
+        None
+    };
+
+    crate::vk_light::r_clear_stains();
+    crate::vk_light::r_clear_light_cache();
+    crate::vk_light::r_clear_surface_bounds();
+    r_invalidate_pvs_cache();
+
     r_framecount = 1; // no dlightcache
 
     vk_enable_multitexture(true);
@@ -836,10 +985,407 @@ pub unsafe fn vk_begin_building_lightmaps(_m: *mut Model) {
 /// # Safety
 /// Accesses GL state.
 pub unsafe fn vk_end_building_lightmaps() {
-    lm_upload_block(false);
+    if let Some(ref atlas) = LM_ATLAS {
+        // Whole pages go up once at load; later changes are dirty rectangles.
+        let size = atlas.size() as i32;
+        for page in 0..atlas.page_count() as u32 {
+            vk_bind(vk_state_lightmap_textures() + page as i32 + 1);
+            qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MIN_FILTER, VK_LINEAR as f32);
+            qvk_tex_parameterf(VK_TEXTURE_2D, VK_TEXTURE_MAG_FILTER, VK_LINEAR as f32);
+            qvk_tex_image_2d(
+                VK_TEXTURE_2D,
+                0,
+                VK_LMS.internal_format,
+                size,
+                size,
+                0,
+                VK_LIGHTMAP_FORMAT,
+                VK_UNSIGNED_BYTE,
+                atlas.page_pixels(page).as_ptr(),
+            );
+            LM_UPLOAD_STATS.record_upload(page, atlas.page_pixels(page).len() as u64);
+        }
+        VK_LMS.current_lightmap_texture = atlas.page_count() as i32 + 1;
+    } else {
+        lm_upload_block(false);
+    }
     vk_enable_multitexture(false);
 }
 
+// ============================================================
+// DYNAMIC LIGHTMAP UPDATES
+// ============================================================
+
+/// Cached-light marker that forces a rebuild on the next check. Set after a
+/// dlit build so the light is taken out again once the dlight moves on, and
+/// by r_flush_stains on every surface it stains.
+pub const LM_CACHE_DIRTY: f32 = -1.0;
+
+/// Rebuild a surface's lightmap if its lightstyles changed, a dlight touches
+/// it this frame, or it was stained (the dynamic half of R_RenderBrushPoly).
+///
+/// In atlas mode the texels are rebuilt in the page's CPU copy and a dirty
+/// rectangle is queued for `vk_flush_lightmap_uploads`; classic blocks get an
+/// immediate sub-image upload of just the surface.
+///
+/// # Safety
+/// Accesses global renderer state and surface data.
+pub unsafe fn vk_update_surface_lightmap(surf: &mut MSurface) {
+    if surf.samples.is_null() || surf.flags & (SURF_DRAWSKY | SURF_DRAWTURB) != 0 {
+        return;
+    }
+    if (*surf.texinfo).flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP) != 0 {
+        return;
+    }
+
+    let dlit = surf.dlightframe == r_framecount;
+    let mut dirty = dlit || surf.cached_light[0] == LM_CACHE_DIRTY;
+    for maps in 0..MAXLIGHTMAPS {
+        if dirty || surf.styles[maps] == 255 {
+            break;
+        }
+        if r_newrefdef.lightstyle(surf.styles[maps] as usize).white != surf.cached_light[maps] {
+            dirty = true;
+        }
+    }
+    if !dirty {
+        return;
+    }
+
+    let smax = (surf.extents[0] as i32 >> 4) + 1;
+    let tmax = (surf.extents[1] as i32 >> 4) + 1;
+
+    if let Some(ref mut atlas) = LM_ATLAS {
+        let page = (surf.lightmaptexturenum - 1) as u32;
+        let stride = atlas.stride() as i32;
+        let base = atlas.texel_ptr(page, surf.light_s as u32, surf.light_t as u32);
+        r_build_light_map(surf, base, stride);
+        atlas.mark_dirty(
+            page,
+            LmRect::new(surf.light_s as u32, surf.light_t as u32, smax as u32, tmax as u32),
+        );
+    } else {
+        static mut TEMP: [u32; 34 * 34] = [0; 34 * 34];
+        r_build_light_map(surf, TEMP.as_mut_ptr() as *mut u8, smax * LIGHTMAP_BYTES);
+        vk_bind(vk_state_lightmap_textures() + surf.lightmaptexturenum);
+        qvk_tex_sub_image_2d(
+            VK_TEXTURE_2D,
+            0,
+            surf.light_s,
+            surf.light_t,
+            smax,
+            tmax,
+            VK_LIGHTMAP_FORMAT,
+            VK_UNSIGNED_BYTE,
+            TEMP.as_ptr() as *const u8,
+        );
+        LM_UPLOAD_STATS.record_upload(surf.lightmaptexturenum as u32, (smax * tmax * LIGHTMAP_BYTES) as u64);
+    }
+    LM_UPLOAD_STATS.record_surface();
+
+    r_set_cache_state(surf);
+    if dlit {
+        surf.cached_light[0] = LM_CACHE_DIRTY;
+        DLIGHT_STATS.rebuilt += 1;
+    }
+}
+
+/// Upload the coalesced dirty rectangles of every atlas page.
+///
+/// # Safety
+/// Accesses global lightmap state.
+pub unsafe fn vk_flush_lightmap_uploads() {
+    let Some(ref mut atlas) = LM_ATLAS else {
+        return;
+    };
+    if !atlas.has_dirty() {
+        return;
+    }
+    atlas.flush(&mut LM_UPLOAD_STATS, |page, rect, texels| {
+        vk_bind(vk_state_lightmap_textures() + page as i32 + 1);
+        qvk_tex_sub_image_2d(
+            VK_TEXTURE_2D,
+            0,
+            rect.x as i32,
+            rect.y as i32,
+            rect.w as i32,
+            rect.h as i32,
+            VK_LIGHTMAP_FORMAT,
+            VK_UNSIGNED_BYTE,
+            texels.as_ptr(),
+        );
+    });
+}
+
+/// World surface numbers visible this frame, gathered by
+/// vk_update_dynamic_lightmaps for the batched world pass.
+pub static mut R_VISIBLE_SURFACES: Vec<u32> = Vec::new();
+
+/// Draw-call and state-change counters of the last batched world pass.
+pub static mut WORLD_DRAW_STATS: WorldDrawStats = WorldDrawStats::new();
+
+/// Leaves tested vs. surfaces emitted by the last world visibility pass.
+pub static mut WORLD_VIS_STATS: WorldVisStats = WorldVisStats::new();
+
+/// The current PVS as flat leaf bounds and surface lists.
+static mut PVS_CACHE: PvsSurfaceCache = PvsSurfaceCache::new();
+/// Scratch: cached leaves inside the frustum this frame.
+static mut PVS_VISIBLE: Vec<u32> = Vec::new();
+/// Surfaces already reached by this frame's lightmap walk.
+static mut LM_WALK_STAMPS: SurfaceStamps = SurfaceStamps::new();
+/// Scratch: surfaces of the brush entities in view, at rest and moved.
+static mut BMODEL_RESTING_SURFACES: Vec<u32> = Vec::new();
+static mut BMODEL_MOVED_SURFACES: Vec<u32> = Vec::new();
+
+/// Flatten the leaves marked by r_mark_leaves into PVS_CACHE.
+unsafe fn r_build_pvs_cache() {
+    let surfaces = r_worldmodel_surfaces();
+    PVS_CACHE.begin(r_worldmodel as usize, r_visframecount);
+
+    for i in 0..r_worldmodel_numleafs() {
+        let leaf = r_worldmodel_leaf(i);
+        if leaf.visframe != r_visframecount {
+            continue;
+        }
+        let marks = std::slice::from_raw_parts(leaf.firstmarksurface, leaf.nummarksurfaces.max(0) as usize);
+        PVS_CACHE.push_leaf(
+            i as u32,
+            leaf.area,
+            &leaf.minmaxs,
+            marks.iter().map(|&m| m.offset_from(surfaces) as u32),
+        );
+    }
+}
+
+/// Drop the cached PVS (map change).
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_invalidate_pvs_cache() {
+    PVS_CACHE.invalidate();
+}
+
+/// Find the visible world surfaces and rebuild their dirty lightmaps, then
+/// flush the uploads. Call once per frame after r_set_frustum and
+/// r_mark_leaves.
+///
+/// The PVS is flattened only when r_mark_leaves marks a new set; each frame
+/// the cached leaf bounds are frustum culled in one SIMD pass, then the
+/// surfaces of the surviving leaves in open areas are backface culled and
+/// recorded in R_VISIBLE_SURFACES. Dynamic lights are marked on that set
+/// alone, so only surfaces both lit and visible are rebuilt.
+///
+/// The surfaces of brush entities in the frustum get the same light style
+/// and stain updates. Dynamic lights are marked on them only while the
+/// entity is at rest, where their world-space bounds still hold.
+///
+/// # Safety
+/// Accesses global renderer state and BSP data.
+pub unsafe fn vk_update_dynamic_lightmaps(entities: &[crate::vk_rmain::EntityLocal]) {
+    LM_UPLOAD_STATS.begin_frame();
+    R_VISIBLE_SURFACES.clear();
+    WORLD_VIS_STATS = WorldVisStats::new();
+
+    if r_worldmodel.is_null() || r_newrefdef.rdflags & RDF_NOWORLDMODEL != 0 {
+        return;
+    }
+    let surfaces = r_worldmodel_surfaces();
+    let stamps = &mut *std::ptr::addr_of_mut!(LM_WALK_STAMPS);
+    stamps.begin((*r_worldmodel).numsurfaces as usize);
+
+    if !PVS_CACHE.is_valid(r_worldmodel as usize, r_visframecount) {
+        r_build_pvs_cache();
+        WORLD_VIS_STATS.cache_rebuilds = 1;
+    }
+
+    let frustum = &*std::ptr::addr_of!(crate::vk_rmain::FRUSTUM);
+    let planes: [CullPlane; 4] = std::array::from_fn(|i| {
+        [frustum[i].normal[0], frustum[i].normal[1], frustum[i].normal[2], frustum[i].dist]
+    });
+    let planes: &[CullPlane] = if crate::vk_rmain::R_NOCULL.value != 0.0 { &[] } else { &planes };
+
+    PVS_VISIBLE.clear();
+    cull_boxes(&PVS_CACHE.bounds, planes, &mut PVS_VISIBLE, crate::simd::level());
+    WORLD_VIS_STATS.leaves = PVS_CACHE.len() as u32;
+
+    for &i in PVS_VISIBLE.iter() {
+        let i = i as usize;
+
+        // check for door connected areas
+        if !area_open(PVS_CACHE.areas[i]) {
+            continue;
+        }
+        WORLD_VIS_STATS.leaves_visible += 1;
+
+        for &surfnum in PVS_CACHE.leaf_surfaces(i) {
+            if !stamps.mark(surfnum as usize) {
+                continue;
+            }
+            // still stamped for the reflection pass's visibility test
+            let surf = &mut *surfaces.add(surfnum as usize);
+            surf.visframe = r_framecount;
+
+            if !surface_faces(surf, &r_origin) {
+                continue;
+            }
+
+            R_VISIBLE_SURFACES.push(surfnum);
+        }
+    }
+    WORLD_VIS_STATS.surfaces_emitted = R_VISIBLE_SURFACES.len() as u32;
+
+    let resting = &mut *std::ptr::addr_of_mut!(BMODEL_RESTING_SURFACES);
+    let moved = &mut *std::ptr::addr_of_mut!(BMODEL_MOVED_SURFACES);
+    resting.clear();
+    moved.clear();
+    for e in entities {
+        if e.model.is_null() || (*e.model).r#type != crate::vk_model_types::ModType::Brush {
+            continue;
+        }
+        let model = &*e.model;
+        let rotated = e.angles != [0.0; 3];
+        let (mins, maxs) = if rotated {
+            let r = model.radius;
+            (
+                [e.origin[0] - r, e.origin[1] - r, e.origin[2] - r],
+                [e.origin[0] + r, e.origin[1] + r, e.origin[2] + r],
+            )
+        } else {
+            (
+                [e.origin[0] + model.mins[0], e.origin[1] + model.mins[1], e.origin[2] + model.mins[2]],
+                [e.origin[0] + model.maxs[0], e.origin[1] + model.maxs[1], e.origin[2] + model.maxs[2]],
+            )
+        };
+        if crate::vk_rmain::r_cull_box(&mins, &maxs) {
+            continue;
+        }
+        let list = if rotated || e.origin != [0.0; 3] { &mut *moved } else { &mut *resting };
+        let first = model.firstmodelsurface as usize;
+        for surfnum in first..first + model.nummodelsurfaces.max(0) as usize {
+            if stamps.mark(surfnum) {
+                list.push(surfnum as u32);
+            }
+        }
+    }
+
+    // only visible surfaces are lit, so only they can need a dynamic rebuild
+    let visible = &*std::ptr::addr_of!(R_VISIBLE_SURFACES);
+    r_mark_visible_dlights(visible);
+    r_mark_visible_dlights(resting);
+    for &surfnum in visible.iter().chain(resting.iter()).chain(moved.iter()) {
+        vk_update_surface_lightmap(&mut *surfaces.add(surfnum as usize));
+    }
+
+    vk_flush_lightmap_uploads();
+}
+
+/// Whether `area` is connected to the view by open doors this frame.
+#[inline]
+unsafe fn area_open(area: i32) -> bool {
+    r_newrefdef.areabits.is_null()
+        || *r_newrefdef.areabits.offset((area >> 3) as isize) & (1 << (area & 7)) != 0
+}
+
+/// Whether the front of `surf` faces `eye`.
+#[inline]
+unsafe fn surface_faces(surf: &MSurface, eye: &Vec3) -> bool {
+    let plane = &*surf.plane;
+    let dot = dot_product(eye, &plane.normal) - plane.dist;
+    if surf.flags & SURF_PLANEBACK != 0 {
+        dot < -BACKFACE_EPSILON
+    } else {
+        dot >= BACKFACE_EPSILON
+    }
+}
+
+/// Per-surface stamps for r_cull_pvs_surfaces, so a surface shared by
+/// several leaves is taken once without disturbing visframe.
+static mut SECONDARY_MARKS: Vec<u32> = Vec::new();
+static mut SECONDARY_STAMP: u32 = 0;
+
+/// Start a new SECONDARY_MARKS pass, sized to the world.
+unsafe fn next_secondary_stamp() -> (&'static mut Vec<u32>, u32) {
+    let marks = &mut *std::ptr::addr_of_mut!(SECONDARY_MARKS);
+    marks.resize((*r_worldmodel).numsurfaces.max(0) as usize, 0);
+    SECONDARY_STAMP = SECONDARY_STAMP.wrapping_add(1);
+    if SECONDARY_STAMP == 0 {
+        marks.fill(0);
+        SECONDARY_STAMP = 1;
+    }
+    (marks, SECONDARY_STAMP)
+}
+
+/// Collect every surface of the current PVS accepted by `keep`, regardless
+/// of frustum or facing, e.g. the sky a view cluster can see. Like
+/// r_cull_pvs_surfaces, valid after vk_update_dynamic_lightmaps.
+///
+/// # Safety
+/// Accesses global renderer state and BSP data.
+pub unsafe fn r_pvs_surfaces_where(keep: impl Fn(&MSurface) -> bool, out: &mut Vec<u32>) {
+    out.clear();
+    if r_worldmodel.is_null() || !PVS_CACHE.is_valid(r_worldmodel as usize, r_visframecount) {
+        return;
+    }
+    let surfaces = r_worldmodel_surfaces();
+    let (marks, stamp) = next_secondary_stamp();
+
+    let cache = &*std::ptr::addr_of!(PVS_CACHE);
+    for i in 0..cache.len() {
+        if !area_open(cache.areas[i]) {
+            continue;
+        }
+        for &surfnum in cache.leaf_surfaces(i) {
+            if marks[surfnum as usize] == stamp {
+                continue;
+            }
+            marks[surfnum as usize] = stamp;
+            if keep(&*surfaces.add(surfnum as usize)) {
+                out.push(surfnum);
+            }
+        }
+    }
+}
+
+/// Collect the surfaces of the current PVS inside `planes` that face `eye`,
+/// for a secondary view such as a water reflection. Reuses the PVS cache
+/// refreshed by vk_update_dynamic_lightmaps this frame, so it must run after
+/// it. Returns the number of leaves kept.
+///
+/// # Safety
+/// Accesses global renderer state and BSP data.
+pub unsafe fn r_cull_pvs_surfaces(planes: &[CullPlane], eye: &Vec3, out: &mut Vec<u32>) -> u32 {
+    out.clear();
+    if r_worldmodel.is_null() || !PVS_CACHE.is_valid(r_worldmodel as usize, r_visframecount) {
+        return 0;
+    }
+    let surfaces = r_worldmodel_surfaces();
+    let (marks, stamp) = next_secondary_stamp();
+
+    let cache = &*std::ptr::addr_of!(PVS_CACHE);
+    let leaves = &mut *std::ptr::addr_of_mut!(PVS_VISIBLE);
+    leaves.clear();
+    cull_boxes(&cache.bounds, planes, leaves, crate::simd::level());
+
+    let mut kept = 0;
+    for &i in leaves.iter() {
+        let i = i as usize;
+        if !area_open(cache.areas[i]) {
+            continue;
+        }
+        kept += 1;
+        for &surfnum in cache.leaf_surfaces(i) {
+            if marks[surfnum as usize] == stamp {
+                continue;
+            }
+            marks[surfnum as usize] = stamp;
+            if surface_faces(&*surfaces.add(surfnum as usize), eye) {
+                out.push(surfnum);
+            }
+        }
+    }
+    kept
+}
+
 // MAX_MAP_LEAFS imported from myq2_common::qfiles
 
 // =============================================================
@@ -1206,4 +1752,63 @@ mod tests {
         assert_eq!(queue.total_surfaces(), 0);
         assert!(queue.alpha_surfaces().is_empty());
     }
+
+    // ---------------------------------------------------------
+    //  Map-load surface preparation
+    // ---------------------------------------------------------
+
+    #[test]
+    fn test_prepare_surface_quad() {
+        unsafe {
+            let mut image: Image = std::mem::zeroed();
+            image.width = 64;
+            image.height = 32;
+            let mut texinfo: MTexInfo = std::mem::zeroed();
+            texinfo.vecs = [[1.0, 0.0, 0.0, 0.0], [0.0, 1.0, 0.0, 0.0]];
+            texinfo.image = &mut image;
+
+            let mut vertexes = [[0.0, 0.0, 0.0], [32.0, 0.0, 0.0], [32.0, 16.0, 0.0], [0.0, 16.0, 0.0]]
+                .map(|position| MVertex { position });
+            let mut edges = [[0, 0], [0, 1], [1, 2], [2, 3], [3, 0]].map(|v| MEdge { v, cachededgeoffset: 0 });
+            let mut surfedges = [1, 2, 3, 4];
+            let mut model: Model = std::mem::zeroed();
+            model.vertexes = vertexes.as_mut_ptr();
+            model.edges = edges.as_mut_ptr();
+            model.surfedges = surfedges.as_mut_ptr();
+
+            let mut samples = [100u8, 50, 25].repeat(6);
+            let mut surf: MSurface = std::mem::zeroed();
+            surf.numedges = 4;
+            surf.texinfo = &mut texinfo;
+            surf.extents = [32, 16]; // 3 x 2 lightmap texels
+            surf.styles = [0, 255, 255, 255];
+            surf.samples = samples.as_mut_ptr();
+
+            let ctx = SurfacePrepContext {
+                style_scale: [[1.0; 3]; MAX_LIGHTSTYLES],
+                monolightmap: b'0',
+                level: crate::simd::SimdLevel::Scalar,
+            };
+            let mut bl = BlockLights::new();
+            let prep = vk_prepare_surface(&model, &surf, &ctx, &mut bl);
+            assert!(!prep.oversize);
+            assert_eq!(prep.texels, [100u8, 50, 25, 100].repeat(6));
+            assert_eq!(prep.verts.len(), 4);
+            assert_eq!(&prep.verts[2][..5], &[32.0, 16.0, 0.0, 0.5, 0.5]);
+
+            // lightmap coordinates are finished once the surface is placed
+            surf.light_s = 2;
+            surf.light_t = 3;
+            emit_surface_polygon(&mut surf, &prep.verts);
+            let v = glpoly_vert_ptr(surf.polys, 2);
+            assert_eq!(*v.add(5), (32.0 + 2.0 * 16.0 + 8.0) / (BLOCK_WIDTH * 16) as f32);
+            assert_eq!(*v.add(6), (16.0 + 3.0 * 16.0 + 8.0) / (BLOCK_WIDTH * 16) as f32);
+
+            surf.extents = [1024, 256];
+            assert!(vk_prepare_surface(&model, &surf, &ctx, &mut bl).oversize);
+            texinfo.flags = SURF_WARP;
+            let warp = vk_prepare_surface(&model, &surf, &ctx, &mut bl);
+            assert!(warp.texels.is_empty() && warp.verts.is_empty() && !warp.oversize);
+        }
+    }
 }
@@ -0,0 +1,353 @@
+// vk_sort.rs — Per-frame render queue with radix-sorted keys
+//
+// R_DrawEntitiesOnList made two passes over r_newrefdef.entities, opaque then
+// translucent, and drew each pass in list order; R_DrawAlphaSurfaces then
+// walked the r_alpha_surfaces chain unsorted, so glass and water were never
+// ordered against each other or against translucent entities.
+//
+// Each frame the entities and the visible SURF_TRANS33/66 world surfaces are
+// now queued together with a 64-bit sort key and sorted once:
+//
+//   opaque:       0 | type:3 | model:16 | skin:24 | 0:20
+//   translucent:  1 | 0:31 | ~depth:32
+//
+// so opaque items come first grouped by model type, model and skin (fewest
+// shader/texture/buffer changes), followed by everything translucent back to
+// front. depth is the distance along the view direction, mapped to an
+// unsigned integer that sorts like the float. The sort is an LSD radix sort,
+// 8 bits per pass, which skips every byte that is the same in all keys, so
+// neither half pays for the bits only the other half uses. Equal keys keep
+// queue order.
+
+use crate::vk_local::*;
+use crate::vk_model_types::ModType;
+use crate::vk_rmain::EntityLocal;
+use myq2_common::q_shared::*;
+
+const TRANSLUCENT_BIT: u64 = 1 << 63;
+
+/// What a queue entry draws.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum QueueItem {
+    /// Index into the frame's entity list.
+    Entity(u32),
+    /// World surface number.
+    AlphaSurface(u32),
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct RenderItem {
+    pub key: u64,
+    pub item: QueueItem,
+}
+
+/// Sort key for an opaque item; fields are truncated to their widths.
+pub fn opaque_key(model_type: u32, model: u32, skin: u32) -> u64 {
+    ((model_type as u64 & 0x7) << 60) | ((model as u64 & 0xFFFF) << 44) | ((skin as u64 & 0xFF_FFFF) << 20)
+}
+
+/// Sort key for a translucent item `depth` units in front of the eye;
+/// larger depths sort first.
+pub fn translucent_key(depth: f32) -> u64 {
+    let bits = depth.to_bits();
+    // flip so unsigned order matches float order (NaN has been ruled out)
+    let ordered = if bits & 0x8000_0000 != 0 { !bits } else { bits | 0x8000_0000 };
+    TRANSLUCENT_BIT | (!ordered) as u64
+}
+
+/// Stable LSD radix sort of `items` by key, using `scratch` as the second
+/// buffer. Returns the number of passes that moved data.
+pub fn radix_sort(items: &mut Vec<RenderItem>, scratch: &mut Vec<RenderItem>) -> u32 {
+    if items.len() < 2 {
+        return 0;
+    }
+
+    // all eight histograms in one read of the keys
+    let mut counts = [[0u32; 256]; 8];
+    for it in items.iter() {
+        for (d, c) in counts.iter_mut().enumerate() {
+            c[(it.key >> (d * 8)) as usize & 0xFF] += 1;
+        }
+    }
+
+    let n = items.len() as u32;
+    let mut passes = 0;
+    scratch.clear();
+    scratch.resize(items.len(), items[0]);
+    for (d, c) in counts.iter().enumerate() {
+        // every key has the same byte here: the pass would not move anything
+        if c.iter().any(|&k| k == n) {
+            continue;
+        }
+        let mut offsets = [0u32; 256];
+        let mut sum = 0;
+        for (o, &k) in offsets.iter_mut().zip(c.iter()) {
+            *o = sum;
+            sum += k;
+        }
+        for it in items.iter() {
+            let b = (it.key >> (d * 8)) as usize & 0xFF;
+            scratch[offsets[b] as usize] = *it;
+            offsets[b] += 1;
+        }
+        std::mem::swap(items, scratch);
+        passes += 1;
+    }
+    passes
+}
+
+/// Counters for the last frame's queue (r_speeds).
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RenderQueueStats {
+    pub opaque: u32,
+    pub translucent: u32,
+    /// Translucent world surfaces among `translucent`.
+    pub alpha_surfaces: u32,
+    /// Radix passes that moved data.
+    pub passes: u32,
+    /// Opaque neighbours whose model or skin differs.
+    pub state_changes: u32,
+}
+
+impl RenderQueueStats {
+    pub const fn new() -> Self {
+        Self { opaque: 0, translucent: 0, alpha_surfaces: 0, passes: 0, state_changes: 0 }
+    }
+}
+
+/// One frame's sorted draws.
+pub struct RenderQueue {
+    items: Vec<RenderItem>,
+    scratch: Vec<RenderItem>,
+    /// Distinct models seen this frame, for compact model ids in the key.
+    /// There are few per frame, so a linear scan is enough.
+    models: Vec<usize>,
+    opaque_len: usize,
+    pub stats: RenderQueueStats,
+}
+
+impl RenderQueue {
+    pub const fn new() -> Self {
+        Self {
+            items: Vec::new(),
+            scratch: Vec::new(),
+            models: Vec::new(),
+            opaque_len: 0,
+            stats: RenderQueueStats::new(),
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.items.clear();
+        self.models.clear();
+        self.opaque_len = 0;
+        self.stats = RenderQueueStats::new();
+    }
+
+    /// Frame-local id for a model, in order of first use.
+    pub fn model_id(&mut self, model: usize) -> u32 {
+        match self.models.iter().position(|&m| m == model) {
+            Some(i) => i as u32,
+            None => {
+                self.models.push(model);
+                self.models.len() as u32 - 1
+            }
+        }
+    }
+
+    pub fn push_opaque(&mut self, key: u64, item: QueueItem) {
+        self.items.push(RenderItem { key: key & !TRANSLUCENT_BIT, item });
+    }
+
+    pub fn push_translucent(&mut self, depth: f32, item: QueueItem) {
+        let depth = if depth.is_nan() { 0.0 } else { depth };
+        self.items.push(RenderItem { key: translucent_key(depth), item });
+    }
+
+    /// Sort the queue and fill in the stats.
+    pub fn sort(&mut self) {
+        self.stats.passes = radix_sort(&mut self.items, &mut self.scratch);
+        self.opaque_len = self.items.partition_point(|it| it.key & TRANSLUCENT_BIT == 0);
+
+        let (opaque, translucent) = self.items.split_at(self.opaque_len);
+        self.stats.opaque = opaque.len() as u32;
+        self.stats.translucent = translucent.len() as u32;
+        self.stats.alpha_surfaces =
+            translucent.iter().filter(|it| matches!(it.item, QueueItem::AlphaSurface(_))).count() as u32;
+        self.stats.state_changes = opaque.windows(2).filter(|w| w[0].key != w[1].key).count() as u32;
+    }
+
+    /// Opaque items, grouped by state. Valid after sort().
+    pub fn opaque(&self) -> &[RenderItem] {
+        &self.items[..self.opaque_len]
+    }
+
+    /// Translucent items, back to front. Valid after sort().
+    pub fn translucent(&self) -> &[RenderItem] {
+        &self.items[self.opaque_len..]
+    }
+}
+
+impl Default for RenderQueue {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// This frame's queue, built by r_build_render_queue.
+pub static mut FRAME_QUEUE: RenderQueue = RenderQueue::new();
+
+/// Distance of `p` in front of the eye along the view direction.
+#[inline]
+unsafe fn view_depth(p: &Vec3) -> f32 {
+    (p[0] - r_origin[0]) * vpn[0] + (p[1] - r_origin[1]) * vpn[1] + (p[2] - r_origin[2]) * vpn[2]
+}
+
+/// Average of the first polygon's vertices.
+unsafe fn surface_center(surf: &MSurface) -> Option<Vec3> {
+    let poly = surf.polys;
+    if poly.is_null() || (*poly).numverts <= 0 {
+        return None;
+    }
+    let mut c = [0.0f32; 3];
+    for v in 0..(*poly).numverts {
+        let p = glpoly_vert_ptr(poly, v);
+        c[0] += *p;
+        c[1] += *p.add(1);
+        c[2] += *p.add(2);
+    }
+    let inv = 1.0 / (*poly).numverts as f32;
+    Some([c[0] * inv, c[1] * inv, c[2] * inv])
+}
+
+/// Queue `entities` and the translucent surfaces among `visible` (world
+/// surface numbers) into FRAME_QUEUE and sort it. Call after r_setup_frame.
+///
+/// # Safety
+/// Accesses global renderer state; model pointers must be valid.
+pub unsafe fn r_build_render_queue(entities: &[EntityLocal], visible: &[u32]) -> &'static RenderQueue {
+    let queue = &mut *std::ptr::addr_of_mut!(FRAME_QUEUE);
+    queue.clear();
+
+    for (i, e) in entities.iter().enumerate() {
+        // beams have no model and are not drawn yet
+        if e.model.is_null() {
+            continue;
+        }
+        let model = &*e.model;
+        let item = QueueItem::Entity(i as u32);
+
+        if e.flags & RF_TRANSLUCENT != 0 {
+            let mut center = e.origin;
+            if model.r#type == ModType::Brush {
+                for k in 0..3 {
+                    center[k] += (model.mins[k] + model.maxs[k]) * 0.5;
+                }
+            }
+            queue.push_translucent(view_depth(&center), item);
+            continue;
+        }
+
+        let skin = match model.r#type {
+            ModType::Alias | ModType::Sprite => {
+                let s = model.skins.get(e.skinnum.max(0) as usize).copied().unwrap_or(std::ptr::null_mut());
+                if s.is_null() { 0 } else { (*s).texnum as u32 }
+            }
+            _ => 0,
+        };
+        let id = queue.model_id(e.model as usize);
+        queue.push_opaque(opaque_key(model.r#type as u32, id, skin), item);
+    }
+
+    if !r_worldmodel.is_null() {
+        let surfaces = (*r_worldmodel).surfaces;
+        for &surfnum in visible {
+            let surf = &*surfaces.add(surfnum as usize);
+            if (*surf.texinfo).flags & (SURF_TRANS33 | SURF_TRANS66) == 0 {
+                continue;
+            }
+            if let Some(center) = surface_center(surf) {
+                queue.push_translucent(view_depth(&center), QueueItem::AlphaSurface(surfnum));
+            }
+        }
+    }
+
+    queue.sort();
+    queue
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn lcg(state: &mut u64) -> u64 {
+        *state = state.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        *state
+    }
+
+    #[test]
+    fn test_radix_sort_is_stable_sort() {
+        let mut seed = 1;
+        for n in [0, 1, 2, 17, 300, 5000] {
+            for mask in [u64::MAX, 0xFF00, 0xF000_0000_0000_00FF, 0] {
+                let mut items: Vec<RenderItem> = (0..n)
+                    .map(|i| RenderItem { key: lcg(&mut seed) & mask, item: QueueItem::Entity(i) })
+                    .collect();
+                let mut reference = items.clone();
+                reference.sort_by_key(|it| it.key);
+                radix_sort(&mut items, &mut Vec::new());
+                assert_eq!(items, reference, "n={} mask={:x}", n, mask);
+            }
+        }
+    }
+
+    #[test]
+    fn test_translucent_back_to_front() {
+        let mut q = RenderQueue::new();
+        let depths = [10.0, -5.0, 300.0, 0.0, -0.0, 2.5, 1.0e9, 64.0];
+        for (i, &d) in depths.iter().enumerate() {
+            if i % 2 == 0 {
+                q.push_translucent(d, QueueItem::Entity(i as u32));
+            } else {
+                q.push_translucent(d, QueueItem::AlphaSurface(i as u32));
+            }
+        }
+        q.push_opaque(opaque_key(3, 0, 0), QueueItem::Entity(99));
+        q.sort();
+
+        assert_eq!(q.opaque().len(), 1);
+        let order: Vec<f32> = q.translucent().iter().map(|it| match it.item {
+            QueueItem::Entity(i) | QueueItem::AlphaSurface(i) => depths[i as usize],
+        }).collect();
+        for w in order.windows(2) {
+            assert!(w[0] >= w[1], "{:?}", order);
+        }
+        assert_eq!(q.stats.translucent, 8);
+        assert_eq!(q.stats.alpha_surfaces, 4);
+    }
+
+    #[test]
+    fn test_opaque_grouped_by_state() {
+        let mut q = RenderQueue::new();
+        // interleaved models and skins, as they come out of the entity list
+        let ents = [(3, 0xA0, 1), (1, 0xB0, 0), (3, 0xA0, 2), (3, 0xC0, 1), (3, 0xA0, 1), (1, 0xB0, 0)];
+        for (i, &(ty, model, skin)) in ents.iter().enumerate() {
+            let id = q.model_id(model);
+            q.push_opaque(opaque_key(ty, id, skin), QueueItem::Entity(i as u32));
+        }
+        q.sort();
+
+        let order: Vec<u32> = q.opaque().iter().map(|it| match it.item {
+            QueueItem::Entity(i) => i,
+            QueueItem::AlphaSurface(_) => unreachable!(),
+        }).collect();
+        // brush first, then alias by model then skin; ties keep list order
+        assert_eq!(order, vec![1, 5, 0, 4, 2, 3]);
+        assert_eq!(q.stats.state_changes, 3);
+        assert!(q.translucent().is_empty());
+    }
+}
@@ -0,0 +1,356 @@
+// vk_texcache.rs — On-disk cache of processed texture mip chains
+//
+// With hi-res replacement packs most of the texture load time is PNG/TGA/JPG
+// decode plus prepare_upload32 (resample, gamma/intensity, mip chain), and
+// every launch repeats it. With vk_texcache set, the finished levels of each
+// true-colour texture are written under <gamedir>/texcache, keyed by where
+// the source resolves (path or pak + offset), its size and mtime, and every
+// setting that changes the output. Later loads map the entry and upload
+// straight from the mapping.
+//
+// Entry layout (little-endian, uncompressed so the levels can be used where
+// they lie in the mapping):
+//
+//   "Q2TC" version:u32 key:u64 name_len:u16 name
+//   src_width:i32 src_height:i32 width:i32 height:i32
+//   has_alpha:u8 direct:u8 levels:u16 level_bytes:u32 * levels
+//   zero padding to a 16-byte boundary, then the levels back to back
+
+use crate::vk_image::{LevelStore, UploadLevels, UploadParams};
+use myq2_common::files::FileStamp;
+use std::io;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU32, Ordering};
+
+const MAGIC: &[u8; 4] = b"Q2TC";
+/// Bump when the entry layout or the processing in prepare_upload32 changes.
+const VERSION: u32 = 1;
+
+static HITS: AtomicU32 = AtomicU32::new(0);
+static MISSES: AtomicU32 = AtomicU32::new(0);
+static STORES: AtomicU32 = AtomicU32::new(0);
+static STORE_FAILURES: AtomicU32 = AtomicU32::new(0);
+
+/// Cache activity since startup: (hits, misses, stores, failed stores).
+pub fn stats() -> (u32, u32, u32, u32) {
+    (
+        HITS.load(Ordering::Relaxed),
+        MISSES.load(Ordering::Relaxed),
+        STORES.load(Ordering::Relaxed),
+        STORE_FAILURES.load(Ordering::Relaxed),
+    )
+}
+
+// ============================================================
+// Entry files
+// ============================================================
+
+/// A read-only mapping of a cache entry. Mappings start on a page boundary,
+/// so levels at 16-byte offsets in the entry are 16-byte aligned in memory.
+pub struct CacheFile {
+    map: memmap2::Mmap,
+}
+
+impl CacheFile {
+    pub fn open(path: &Path) -> io::Result<Self> {
+        let file = std::fs::File::open(path)?;
+        if file.metadata()?.len() == 0 {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, "empty file"));
+        }
+        // SAFETY: entries are never written in place. store() renames a new
+        // file over the old name, so a mapped entry keeps its contents.
+        let map = unsafe { memmap2::Mmap::map(&file)? };
+        Ok(Self { map })
+    }
+
+    pub fn bytes(&self) -> &[u8] {
+        &self.map
+    }
+}
+
+// ============================================================
+// Cache
+// ============================================================
+
+/// A texture loaded from the cache.
+pub struct CachedTexture {
+    /// Size of the source image (what vk_load_pic records as width/height).
+    pub src_width: i32,
+    pub src_height: i32,
+    pub upload: UploadLevels,
+}
+
+/// FNV-1a, 64 bit.
+struct Fnv(u64);
+
+impl Fnv {
+    fn new() -> Self {
+        Self(0xcbf2_9ce4_8422_2325)
+    }
+    fn bytes(&mut self, data: &[u8]) -> &mut Self {
+        for &b in data {
+            self.0 = (self.0 ^ b as u64).wrapping_mul(0x0100_0000_01b3);
+        }
+        self
+    }
+}
+
+/// Cache key of a texture: its source, and everything prepare_upload32
+/// depends on besides the texels.
+pub fn cache_key(name: &str, stamp: &FileStamp, params: &UploadParams, mipmap: bool, light_scale: bool) -> u64 {
+    let mut h = Fnv::new();
+    h.bytes(&VERSION.to_le_bytes())
+        .bytes(name.as_bytes())
+        .bytes(&[0])
+        .bytes(stamp.source.as_bytes())
+        .bytes(&[0])
+        .bytes(&stamp.offset.to_le_bytes())
+        .bytes(&stamp.length.to_le_bytes())
+        .bytes(&stamp.mtime.to_le_bytes())
+        .bytes(&params.picmip.to_le_bytes())
+        .bytes(&[params.hw_mipmap as u8, mipmap as u8, light_scale as u8]);
+    if light_scale {
+        h.bytes(&params.gamma).bytes(&params.intensity_gamma);
+    }
+    h.0
+}
+
+/// Directory of cached textures.
+pub struct TexCache {
+    dir: PathBuf,
+}
+
+impl TexCache {
+    pub fn new(dir: impl Into<PathBuf>) -> Self {
+        Self { dir: dir.into() }
+    }
+
+    /// The cache under the game directory, if vk_texcache is set.
+    pub fn current() -> Option<Self> {
+        if myq2_common::cvar::cvar_variable_value("vk_texcache") == 0.0 {
+            return None;
+        }
+        Some(Self::new(format!("{}/texcache", myq2_common::files::fs_gamedir())))
+    }
+
+    fn path(&self, key: u64) -> PathBuf {
+        self.dir.join(format!("{:016x}.q2tc", key))
+    }
+
+    /// Map the entry for `name`/`key`, if present and intact.
+    pub fn load(&self, name: &str, key: u64) -> Option<CachedTexture> {
+        let hit = CacheFile::open(&self.path(key)).ok().and_then(|file| parse(file, name, key));
+        if hit.is_some() { &HITS } else { &MISSES }.fetch_add(1, Ordering::Relaxed);
+        hit
+    }
+
+    /// Write the entry for `name`/`key`. The file is renamed into place, so
+    /// concurrent loaders never see a partial entry.
+    pub fn store(&self, name: &str, key: u64, src_width: i32, src_height: i32, up: &UploadLevels) -> io::Result<()> {
+        let result = self.write(name, key, src_width, src_height, up);
+        if result.is_ok() { &STORES } else { &STORE_FAILURES }.fetch_add(1, Ordering::Relaxed);
+        result
+    }
+
+    fn write(&self, name: &str, key: u64, src_width: i32, src_height: i32, up: &UploadLevels) -> io::Result<()> {
+        let levels = up.levels.len();
+        if name.len() > u16::MAX as usize || levels > u16::MAX as usize {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "entry too large"));
+        }
+        let mut out = Vec::new();
+        out.extend_from_slice(MAGIC);
+        out.extend_from_slice(&VERSION.to_le_bytes());
+        out.extend_from_slice(&key.to_le_bytes());
+        out.extend_from_slice(&(name.len() as u16).to_le_bytes());
+        out.extend_from_slice(name.as_bytes());
+        for v in [src_width, src_height, up.width, up.height] {
+            out.extend_from_slice(&v.to_le_bytes());
+        }
+        out.extend_from_slice(&[up.has_alpha as u8, up.direct as u8]);
+        out.extend_from_slice(&(levels as u16).to_le_bytes());
+        for level in up.levels.iter() {
+            out.extend_from_slice(&(level.len() as u32).to_le_bytes());
+        }
+        out.resize((out.len() + 15) & !15, 0);
+        for level in up.levels.iter() {
+            out.extend_from_slice(level);
+        }
+
+        std::fs::create_dir_all(&self.dir)?;
+        let path = self.path(key);
+        let tmp = path.with_extension(format!("tmp{:?}", std::thread::current().id()).replace(|c: char| !c.is_ascii_alphanumeric(), ""));
+        std::fs::write(&tmp, &out)?;
+        std::fs::rename(&tmp, &path).inspect_err(|_| {
+            let _ = std::fs::remove_file(&tmp);
+        })
+    }
+}
+
+/// Little-endian field reader over an entry.
+struct Reader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn take(&mut self, n: usize) -> Option<&'a [u8]> {
+        let s = self.data.get(self.pos..self.pos.checked_add(n)?)?;
+        self.pos += n;
+        Some(s)
+    }
+    fn u16(&mut self) -> Option<u16> {
+        Some(u16::from_le_bytes(self.take(2)?.try_into().ok()?))
+    }
+    fn u32(&mut self) -> Option<u32> {
+        Some(u32::from_le_bytes(self.take(4)?.try_into().ok()?))
+    }
+    fn i32(&mut self) -> Option<i32> {
+        Some(i32::from_le_bytes(self.take(4)?.try_into().ok()?))
+    }
+    fn u64(&mut self) -> Option<u64> {
+        Some(u64::from_le_bytes(self.take(8)?.try_into().ok()?))
+    }
+}
+
+fn parse(file: CacheFile, name: &str, key: u64) -> Option<CachedTexture> {
+    let mut r = Reader { data: file.bytes(), pos: 0 };
+    if r.take(4)? != MAGIC || r.u32()? != VERSION || r.u64()? != key {
+        return None;
+    }
+    let name_len = r.u16()? as usize;
+    if r.take(name_len)? != name.as_bytes() {
+        return None;
+    }
+    let (src_width, src_height, width, height) = (r.i32()?, r.i32()?, r.i32()?, r.i32()?);
+    let flags = r.take(2)?;
+    let (has_alpha, direct) = (flags[0] != 0, flags[1] != 0);
+    let count = r.u16()? as usize;
+    let sizes: Vec<usize> = (0..count).map(|_| r.u32().map(|s| s as usize)).collect::<Option<_>>()?;
+
+    // level sizes must match the chain for width x height
+    let (mut w, mut h) = (width.max(0) as usize, height.max(0) as usize);
+    let mut pos = (r.pos + 15) & !15;
+    let mut ranges = Vec::with_capacity(count);
+    for &size in &sizes {
+        if size != w * h * 4 {
+            return None;
+        }
+        ranges.push(pos..pos + size);
+        pos += size;
+        w = (w >> 1).max(1);
+        h = (h >> 1).max(1);
+    }
+    if count == 0 || pos != file.bytes().len() {
+        return None;
+    }
+
+    Some(CachedTexture {
+        src_width,
+        src_height,
+        upload: UploadLevels { width, height, levels: LevelStore::Cached { file, ranges }, has_alpha, direct },
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::simd::SimdLevel;
+
+    fn params() -> UploadParams {
+        UploadParams {
+            picmip: 0,
+            gamma: std::array::from_fn(|i| i as u8),
+            intensity_gamma: std::array::from_fn(|i| (i * 2).min(255) as u8),
+            palette: [0; 256],
+            hw_mipmap: false,
+            level: SimdLevel::Scalar,
+        }
+    }
+
+    fn stamp() -> FileStamp {
+        FileStamp { source: "baseq2/textures/a.tga".into(), offset: 0, length: 1234, mtime: 1_700_000_000 }
+    }
+
+    fn temp_cache(tag: &str) -> TexCache {
+        let dir = std::env::temp_dir().join(format!("myq2_texcache_{}_{}", tag, std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        TexCache::new(dir)
+    }
+
+    fn sample_upload() -> UploadLevels {
+        let rgba: Vec<u8> = (0..100 * 30 * 4).map(|i| (i * 7 % 253) as u8).collect();
+        crate::vk_image::prepare_upload32(&rgba, 100, 30, true, 32, true, &params())
+    }
+
+    #[test]
+    fn test_round_trip() {
+        let cache = temp_cache("round_trip");
+        let up = sample_upload();
+        let key = cache_key("textures/a.tga", &stamp(), &params(), true, true);
+        assert!(cache.load("textures/a.tga", key).is_none());
+        cache.store("textures/a.tga", key, 100, 30, &up).unwrap();
+
+        let hit = cache.load("textures/a.tga", key).unwrap();
+        assert_eq!((hit.src_width, hit.src_height), (100, 30));
+        assert_eq!((hit.upload.width, hit.upload.height), (up.width, up.height));
+        assert_eq!(hit.upload.has_alpha, up.has_alpha);
+        assert_eq!(hit.upload.direct, up.direct);
+        assert!(hit.upload.levels == up.levels);
+        // the first level starts 16-byte aligned in memory
+        assert_eq!(hit.upload.levels[0].as_ptr() as usize % 16, 0);
+
+        // a different name under the same key is rejected
+        assert!(cache.load("textures/b.tga", key).is_none());
+        let _ = std::fs::remove_dir_all(&cache.dir);
+    }
+
+    #[test]
+    fn test_key_covers_source_and_settings() {
+        let base = cache_key("textures/a.tga", &stamp(), &params(), true, true);
+        let mut s = stamp();
+        s.mtime += 1;
+        assert_ne!(cache_key("textures/a.tga", &s, &params(), true, true), base);
+        let mut s = stamp();
+        s.length += 1;
+        assert_ne!(cache_key("textures/a.tga", &s, &params(), true, true), base);
+        let mut p = params();
+        p.picmip = 1;
+        assert_ne!(cache_key("textures/a.tga", &stamp(), &p, true, true), base);
+        let mut p = params();
+        p.intensity_gamma[10] ^= 1;
+        assert_ne!(cache_key("textures/a.tga", &stamp(), &p, true, true), base);
+        assert_ne!(cache_key("textures/a.tga", &stamp(), &params(), false, true), base);
+        // tables only matter when light scaling applies
+        let mut p = params();
+        p.gamma[3] ^= 1;
+        assert_eq!(
+            cache_key("textures/a.tga", &stamp(), &p, true, false),
+            cache_key("textures/a.tga", &stamp(), &params(), true, false)
+        );
+    }
+
+    #[test]
+    fn test_damaged_entries_rejected() {
+        let cache = temp_cache("damaged");
+        let up = sample_upload();
+        let key = 0x1234;
+        cache.store("textures/a.tga", key, 100, 30, &up).unwrap();
+        let path = cache.path(key);
+        let good = std::fs::read(&path).unwrap();
+
+        std::fs::write(&path, &good[..good.len() - 1]).unwrap();
+        assert!(cache.load("textures/a.tga", key).is_none());
+
+        let mut bad = good.clone();
+        bad[4] ^= 0xFF; // version
+        std::fs::write(&path, &bad).unwrap();
+        assert!(cache.load("textures/a.tga", key).is_none());
+
+        std::fs::write(&path, []).unwrap();
+        assert!(cache.load("textures/a.tga", key).is_none());
+
+        std::fs::write(&path, &good).unwrap();
+        assert!(cache.load("textures/a.tga", key).is_some());
+        let _ = std::fs::remove_dir_all(&cache.dir);
+    }
+}
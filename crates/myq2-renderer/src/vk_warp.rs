@@ -112,7 +112,7 @@ pub static R_TURBSIN: [f32; 256] = [
     -1.56072, -1.3677, -1.17384, -0.979285, -0.784137, -0.588517, -0.392541, -0.19633,
 ];
 
-const TURBSCALE: f32 = 256.0 / (2.0 * std::f32::consts::PI);
+pub const TURBSCALE: f32 = 256.0 / (2.0 * std::f32::consts::PI);
 
 // ============================================================
 // Sky clip planes
@@ -347,8 +347,215 @@ pub unsafe fn vk_subdivide_surface(fa: *mut MSurface) {
 // Water polygon emission
 // ============================================================
 
-// emit_water_polys: removed (legacy immediate-mode GL rendering).
-// Will be replaced by modern rendering pipeline.
+// EmitWaterPolys recomputed the turbsin coordinates of every vertex each
+// frame. The subdivided polys built at load are flattened once per map into
+// WATER_MESH (positions, fan indices and base coordinates); each frame only
+// the visible water is warped, in SIMD (vk_warp_simd), into its texcoords.
+
+/// Vertex and index range of one water surface in the mesh.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct WaterSurface {
+    /// World surface number.
+    pub surface: u32,
+    pub first_vertex: u32,
+    pub num_vertices: u32,
+    pub first_index: u32,
+    pub num_indices: u32,
+    /// SURF_FLOWING: scroll s with time.
+    pub flowing: bool,
+}
+
+/// Water geometry of the current map.
+pub struct WaterMesh {
+    /// Bumped whenever the static buffers change, so the renderer re-uploads.
+    pub generation: u32,
+    pub positions: Vec<[f32; 3]>,
+    /// Triangle list of every surface's fans.
+    pub indices: Vec<u32>,
+    /// Unwarped texture coordinates, one array per component.
+    os: Vec<f32>,
+    ot: Vec<f32>,
+    surfaces: Vec<WaterSurface>,
+    /// World surface number to index in `surfaces`, u32::MAX for non-water.
+    lookup: Vec<u32>,
+    /// Warped (s, t) per vertex; current for this frame's draws only.
+    pub texcoords: Vec<[f32; 2]>,
+    /// Surfaces warped this frame.
+    pub draws: Vec<WaterSurface>,
+}
+
+impl WaterMesh {
+    pub const fn new() -> Self {
+        Self {
+            generation: 0,
+            positions: Vec::new(),
+            indices: Vec::new(),
+            os: Vec::new(),
+            ot: Vec::new(),
+            surfaces: Vec::new(),
+            lookup: Vec::new(),
+            texcoords: Vec::new(),
+            draws: Vec::new(),
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.generation = self.generation.wrapping_add(1);
+        self.positions.clear();
+        self.indices.clear();
+        self.os.clear();
+        self.ot.clear();
+        self.surfaces.clear();
+        self.lookup.clear();
+        self.texcoords.clear();
+        self.draws.clear();
+    }
+
+    /// Append a water surface made of triangle fans (glpoly vertices:
+    /// x, y, z, s, t, ...).
+    pub fn push_surface(&mut self, surface: u32, flowing: bool, polys: &[&[[f32; VERTEXSIZE]]]) {
+        let first_vertex = self.positions.len() as u32;
+        let first_index = self.indices.len() as u32;
+        for poly in polys {
+            let base = self.positions.len() as u32;
+            for v in poly.iter() {
+                self.positions.push([v[0], v[1], v[2]]);
+                self.os.push(v[3]);
+                self.ot.push(v[4]);
+            }
+            for i in 1..poly.len().saturating_sub(1) as u32 {
+                self.indices.extend_from_slice(&[base, base + i, base + i + 1]);
+            }
+        }
+        self.texcoords.resize(self.positions.len(), [0.0; 2]);
+
+        if self.lookup.len() <= surface as usize {
+            self.lookup.resize(surface as usize + 1, u32::MAX);
+        }
+        self.lookup[surface as usize] = self.surfaces.len() as u32;
+        self.surfaces.push(WaterSurface {
+            surface,
+            first_vertex,
+            num_vertices: self.positions.len() as u32 - first_vertex,
+            first_index,
+            num_indices: self.indices.len() as u32 - first_index,
+            flowing,
+        });
+    }
+
+    /// Number of water surfaces.
+    pub fn len(&self) -> usize {
+        self.surfaces.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.surfaces.is_empty()
+    }
+
+    /// Warp the water among `visible` for `time` and record their draws.
+    /// Returns the number of vertices warped.
+    pub fn warp(&mut self, visible: &[u32], turbsin: &[f32; 256], time: f32, level: crate::simd::SimdLevel) -> u32 {
+        self.draws.clear();
+        let half = time * 0.5;
+        let scroll = -64.0 * (half - half.trunc());
+        let mut warped = 0;
+
+        for &s in visible {
+            let Some(&index) = self.lookup.get(s as usize) else { continue };
+            if index == u32::MAX {
+                continue;
+            }
+            let ws = self.surfaces[index as usize];
+            let range = ws.first_vertex as usize..(ws.first_vertex + ws.num_vertices) as usize;
+            crate::vk_warp_simd::warp_texcoords(
+                &self.os[range.clone()],
+                &self.ot[range.clone()],
+                turbsin,
+                time,
+                if ws.flowing { scroll } else { 0.0 },
+                &mut self.texcoords[range],
+                level,
+            );
+            warped += ws.num_vertices;
+            self.draws.push(ws);
+        }
+        warped
+    }
+}
+
+impl Default for WaterMesh {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+pub static mut WATER_MESH: WaterMesh = WaterMesh::new();
+
+/// Per-frame water and sky counters for r_speeds.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct WarpStats {
+    /// Water surfaces warped.
+    pub water_surfaces: u32,
+    /// Water vertices warped.
+    pub water_verts: u32,
+    /// Sky visibility recomputed (view cluster or open areas changed).
+    pub sky_rebuilds: u32,
+    /// Sky surfaces in the view cluster's PVS.
+    pub sky_surfaces: u32,
+    /// Sky polys split by ClipSkyPolygon.
+    pub sky_clipped: u32,
+    /// Clipped sky polys projected onto a face.
+    pub sky_polys: u32,
+}
+
+pub static mut WARP_STATS: WarpStats = WarpStats {
+    water_surfaces: 0,
+    water_verts: 0,
+    sky_rebuilds: 0,
+    sky_surfaces: 0,
+    sky_clipped: 0,
+    sky_polys: 0,
+};
+
+/// Flatten the world's warped surfaces into WATER_MESH. Called once per map
+/// from r_begin_registration.
+///
+/// # Safety
+/// Dereferences world model pointers.
+pub unsafe fn r_build_water_mesh() {
+    let mesh = &mut *std::ptr::addr_of_mut!(WATER_MESH);
+    mesh.clear();
+    if r_worldmodel.is_null() || (*r_worldmodel).surfaces.is_null() {
+        return;
+    }
+    let world = &*r_worldmodel;
+
+    let mut polys: Vec<&[[f32; VERTEXSIZE]]> = Vec::new();
+    for s in 0..world.numsurfaces.max(0) as usize {
+        let surf = &*world.surfaces.add(s);
+        if surf.flags & SURF_DRAWTURB == 0 {
+            continue;
+        }
+        polys.clear();
+        let mut p = surf.polys;
+        while !p.is_null() {
+            let verts = glpoly_vert_ptr(p, 0) as *const [f32; VERTEXSIZE];
+            polys.push(std::slice::from_raw_parts(verts, (*p).numverts.max(0) as usize));
+            p = (*p).next;
+        }
+        mesh.push_surface(s as u32, (*surf.texinfo).flags & SURF_FLOWING != 0, &polys);
+    }
+}
+
+/// Warp this frame's visible water. Runs after vk_update_dynamic_lightmaps.
+///
+/// # Safety
+/// Accesses global renderer state.
+pub unsafe fn r_warp_water(visible: &[u32]) {
+    let mesh = &mut *std::ptr::addr_of_mut!(WATER_MESH);
+    WARP_STATS.water_verts = mesh.warp(visible, &R_TURBSIN, r_newrefdef.time, crate::simd::level());
+    WARP_STATS.water_surfaces = mesh.draws.len() as u32;
+}
 
 // ============================================================
 // Sky polygon clipping and drawing
@@ -360,6 +567,7 @@ pub unsafe fn vk_subdivide_surface(fa: *mut MSurface) {
 /// Accesses global sky state.
 pub unsafe fn draw_sky_polygon(nump: usize, vecs: &[f32]) {
     c_sky += 1;
+    WARP_STATS.sky_polys += 1;
 
     // decide which face it maps to
     let mut v = [0.0f32; 3];
@@ -463,6 +671,7 @@ pub unsafe fn clip_sky_polygon(nump: usize, vecs: &[f32], stage: usize) {
     }
 
     // clip it
+    WARP_STATS.sky_clipped += 1;
     sides[nump] = sides[0];
     dists[nump] = dists[0];
 
@@ -534,15 +743,23 @@ pub unsafe fn clip_sky_polygon(nump: usize, vecs: &[f32], stage: usize) {
 /// # Safety
 /// Accesses global GL state and renderer globals.
 pub unsafe fn r_add_sky_surface(fa: &MSurface) {
+    r_add_sky_surface_from(fa, &r_origin);
+}
+
+/// Add a sky surface to the sky bounds as seen from `eye`.
+///
+/// # Safety
+/// Accesses global sky state.
+pub unsafe fn r_add_sky_surface_from(fa: &MSurface, eye: &Vec3) {
     let mut p = fa.polys;
     while !p.is_null() {
         let nv = (*p).numverts as usize;
         let mut verts = vec![0.0f32; nv * 3];
         for i in 0..nv {
             let pv = glpoly_vert_ptr(p, i as i32);
-            verts[i * 3] = *pv.offset(0) - r_origin[0];
-            verts[i * 3 + 1] = *pv.offset(1) - r_origin[1];
-            verts[i * 3 + 2] = *pv.offset(2) - r_origin[2];
+            verts[i * 3] = *pv.offset(0) - eye[0];
+            verts[i * 3 + 1] = *pv.offset(1) - eye[1];
+            verts[i * 3 + 2] = *pv.offset(2) - eye[2];
         }
         clip_sky_polygon(nv, &verts, 0);
         p = (*p).next;
@@ -559,6 +776,99 @@ pub unsafe fn r_clear_sky_box() {
     }
 }
 
+// ============================================================
+// Sky visibility per view cluster
+// ============================================================
+
+// ClipSkyPolygon used to run on every visible sky surface every frame. The
+// sky bounds are now computed when the view cluster (r_visframecount) or the
+// set of open areas changes: every sky surface in the cluster's PVS is
+// clipped as seen from each corner of the cluster's bounds, and the union is
+// kept. Frames in the same cluster just reload the cached bounds.
+
+/// (world surfaces, visframe, areabits hash) the cached bounds were built for.
+static mut SKY_VIS_KEY: Option<(usize, i32, u64)> = None;
+static mut SKY_VIS_MINS: [[f32; 6]; 2] = [[0.0; 6]; 2];
+static mut SKY_VIS_MAXS: [[f32; 6]; 2] = [[0.0; 6]; 2];
+static mut SKY_SURFACES: Vec<u32> = Vec::new();
+
+/// FNV-1a of the refdef's area bits, 0 when every area is open.
+unsafe fn areabits_hash() -> u64 {
+    if r_newrefdef.areabits.is_null() {
+        return 0;
+    }
+    let bits = std::slice::from_raw_parts(r_newrefdef.areabits, myq2_common::qfiles::MAX_MAP_AREAS / 8);
+    bits.iter().fold(0xcbf2_9ce4_8422_2325u64, |h, &b| (h ^ b as u64).wrapping_mul(0x0100_0000_01b3))
+}
+
+/// Bounds of the leaves in the view clusters, or the eye outside the map.
+unsafe fn view_cluster_bounds() -> [f32; 6] {
+    let mut mm = [f32::MAX, f32::MAX, f32::MAX, f32::MIN, f32::MIN, f32::MIN];
+    if r_viewcluster >= 0 {
+        for i in 0..r_worldmodel_numleafs() {
+            let leaf = r_worldmodel_leaf(i);
+            if leaf.cluster != r_viewcluster && leaf.cluster != r_viewcluster2 {
+                continue;
+            }
+            for j in 0..3 {
+                mm[j] = mm[j].min(leaf.minmaxs[j]);
+                mm[3 + j] = mm[3 + j].max(leaf.minmaxs[3 + j]);
+            }
+        }
+    }
+    if mm[0] > mm[3] {
+        mm = [r_origin[0], r_origin[1], r_origin[2], r_origin[0], r_origin[1], r_origin[2]];
+    }
+    mm
+}
+
+/// Load this frame's sky bounds, recomputing them on a view cluster or area
+/// change. Runs after vk_update_dynamic_lightmaps.
+///
+/// # Safety
+/// Accesses global renderer state and world model pointers.
+pub unsafe fn r_update_sky_visibility() {
+    if r_worldmodel.is_null() || r_newrefdef.rdflags & RDF_NOWORLDMODEL != 0 {
+        r_clear_sky_box();
+        return;
+    }
+    let key = (r_worldmodel_surfaces() as usize, r_visframecount, areabits_hash());
+    if SKY_VIS_KEY != Some(key) {
+        let list = &mut *std::ptr::addr_of_mut!(SKY_SURFACES);
+        crate::vk_rsurf::r_pvs_surfaces_where(|s| (*s.texinfo).flags & SURF_SKY != 0, list);
+
+        r_clear_sky_box();
+        let surfaces = r_worldmodel_surfaces();
+        let mm = view_cluster_bounds();
+        for corner in 0..8 {
+            let eye = [mm[(corner & 1) * 3], mm[1 + (corner >> 1 & 1) * 3], mm[2 + (corner >> 2 & 1) * 3]];
+            for &s in list.iter() {
+                r_add_sky_surface_from(&*surfaces.add(s as usize), &eye);
+            }
+        }
+
+        SKY_VIS_MINS = skymins;
+        SKY_VIS_MAXS = skymaxs;
+        SKY_VIS_KEY = Some(key);
+        WARP_STATS.sky_rebuilds = 1;
+        WARP_STATS.sky_surfaces = list.len() as u32;
+    }
+    skymins = SKY_VIS_MINS;
+    skymaxs = SKY_VIS_MAXS;
+}
+
+/// Bit mask of the sky box faces with any visible area.
+///
+/// # Safety
+/// Accesses global sky state.
+pub unsafe fn r_visible_sky_faces() -> u8 {
+    if skyrotate != 0.0 {
+        // a rotating sky can bring any face into view
+        return 0x3f;
+    }
+    (0..6).filter(|&i| skymins[0][i] < skymaxs[0][i] && skymins[1][i] < skymaxs[1][i]).fold(0, |m, i| m | 1 << i)
+}
+
 // make_sky_vec: removed (legacy immediate-mode GL rendering).
 // Will be replaced by modern rendering pipeline.
 
@@ -872,4 +1182,80 @@ mod tests {
             }
         }
     }
+
+    // ============================================================
+    // Water mesh
+    // ============================================================
+
+    /// A fan of `n` rim vertices around a centre, closed like subdivide_polygon.
+    fn fan(n: usize, x: f32) -> Vec<[f32; VERTEXSIZE]> {
+        let mut v = vec![[x, 0.0, 0.0, x, 0.0, 0.0, 0.0]];
+        for i in 0..n {
+            let a = i as f32 * std::f32::consts::TAU / n as f32;
+            v.push([x + 16.0 * a.cos(), 16.0 * a.sin(), 0.0, x + 16.0 * a.cos(), 16.0 * a.sin(), 0.0, 0.0]);
+        }
+        v.push(v[1]);
+        v
+    }
+
+    #[test]
+    fn test_water_mesh_fans_and_warp() {
+        let (a, b, c) = (fan(3, 0.0), fan(4, 64.0), fan(5, 128.0));
+        let mut mesh = WaterMesh::new();
+        mesh.push_surface(7, false, &[&a, &b]);
+        mesh.push_surface(2, true, &[&c]);
+        assert_eq!(mesh.len(), 2);
+        assert_eq!(mesh.positions.len(), 5 + 6 + 7);
+        // a closed fan of n rim vertices has n triangles
+        assert_eq!(mesh.indices.len(), (3 + 4 + 5) * 3);
+        assert_eq!(&mesh.indices[..6], &[0, 1, 2, 0, 2, 3]);
+        assert_eq!(&mesh.indices[9..12], &[5, 6, 7]);
+
+        let time = 3.3;
+        let warped = mesh.warp(&[1, 2, 3], &R_TURBSIN, time, crate::simd::SimdLevel::Scalar);
+        assert_eq!(warped, 7);
+        assert_eq!(mesh.draws.len(), 1);
+        let d = mesh.draws[0];
+        assert_eq!((d.surface, d.first_vertex, d.num_vertices, d.first_index, d.num_indices), (2, 11, 7, 21, 15));
+
+        // flowing water scrolls s by -64 * frac(time / 2) before the 1/64 scale
+        let v = c[3];
+        let scroll = -64.0 * (time * 0.5 - (time * 0.5).trunc());
+        let s = v[3] + R_TURBSIN[((v[4] * 0.125 + time) * TURBSCALE) as i32 as usize & 255] + scroll;
+        assert_eq!(mesh.texcoords[11 + 3][0], s * (1.0 / 64.0));
+
+        mesh.warp(&[7], &R_TURBSIN, time, crate::simd::level());
+        assert_eq!(mesh.draws.iter().map(|d| d.surface).collect::<Vec<_>>(), vec![7]);
+
+        let generation = mesh.generation;
+        mesh.clear();
+        assert!(mesh.is_empty() && mesh.generation != generation);
+        assert_eq!(mesh.warp(&[7], &R_TURBSIN, time, crate::simd::level()), 0);
+    }
+
+    // ============================================================
+    // Sky bounds
+    // ============================================================
+
+    #[test]
+    fn test_sky_faces_and_clip_counter() {
+        unsafe {
+            r_clear_sky_box();
+            assert_eq!(r_visible_sky_faces(), 0);
+
+            // straight overhead: split by the diagonal planes, but all on "up"
+            WARP_STATS = WarpStats::default();
+            let up = [-10.0, -10.0, 100.0, 10.0, -10.0, 100.0, 10.0, 10.0, 100.0, -10.0, 10.0, 100.0];
+            clip_sky_polygon(4, &up, 0);
+            assert_eq!(r_visible_sky_faces(), 1 << 4);
+            assert!(WARP_STATS.sky_clipped > 0);
+            assert!(WARP_STATS.sky_polys >= 2);
+
+            // a wall ahead along +x lands on face 0
+            let ahead = [100.0, -10.0, -10.0, 100.0, 10.0, -10.0, 100.0, 10.0, 10.0, 100.0, -10.0, 10.0];
+            clip_sky_polygon(4, &ahead, 0);
+            assert_eq!(r_visible_sky_faces(), 1 << 4 | 1 << 0);
+            r_clear_sky_box();
+        }
+    }
 }
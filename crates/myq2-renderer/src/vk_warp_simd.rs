@@ -0,0 +1,207 @@
+// vk_warp_simd.rs — Vectorized water texture coordinate warp
+//
+// EmitWaterPolys warped each vertex of each visible water poly through the
+// turbsin table every frame, one vertex at a time:
+//
+//   s = (os + turbsin[(int)((ot * 0.125 + time) * TURBSCALE) & 255] + scroll) / 64
+//   t = (ot + turbsin[(int)((os * 0.125 + time) * TURBSCALE) & 255]) / 64
+//
+// The base coordinates now live in a structure-of-arrays built once per map
+// (vk_warp's WaterMesh), and warp_texcoords runs the formula over a whole
+// surface 4 (SSE2) or 8 (AVX2) vertices at a time, writing interleaved (s, t)
+// pairs ready for upload. The table index is truncated like the C cast
+// (cvttps) and every level evaluates in the same order, so all levels agree
+// bit for bit with the scalar path.
+
+use crate::simd::SimdLevel;
+use crate::vk_warp::TURBSCALE;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+/// Warp base texture coordinates `os`/`ot` into `out` as (s, t) pairs.
+/// `scroll` is the SURF_FLOWING offset (0 for still water).
+pub fn warp_texcoords(
+    os: &[f32],
+    ot: &[f32],
+    turbsin: &[f32; 256],
+    time: f32,
+    scroll: f32,
+    out: &mut [[f32; 2]],
+    level: SimdLevel,
+) {
+    let n = os.len().min(ot.len()).min(out.len());
+    let (os, ot, out) = (&os[..n], &ot[..n], &mut out[..n]);
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { warp_avx2(os, ot, turbsin, time, scroll, out) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { warp_sse2(os, ot, turbsin, time, scroll, out) },
+        _ => warp_scalar(os, ot, turbsin, time, scroll, out, 0),
+    }
+}
+
+#[inline]
+fn turb_index(base: f32, time: f32) -> usize {
+    ((base * 0.125 + time) * TURBSCALE) as i32 as usize & 255
+}
+
+fn warp_scalar(os: &[f32], ot: &[f32], turbsin: &[f32; 256], time: f32, scroll: f32, out: &mut [[f32; 2]], start: usize) {
+    for i in start..out.len() {
+        let s = os[i] + turbsin[turb_index(ot[i], time)] + scroll;
+        let t = ot[i] + turbsin[turb_index(os[i], time)];
+        out[i] = [s * (1.0 / 64.0), t * (1.0 / 64.0)];
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn warp_sse2(os: &[f32], ot: &[f32], turbsin: &[f32; 256], time: f32, scroll: f32, out: &mut [[f32; 2]]) {
+    let n = out.len();
+    let body = n & !3;
+    let eighth = _mm_set1_ps(0.125);
+    let vtime = _mm_set1_ps(time);
+    let vscale = _mm_set1_ps(TURBSCALE);
+    let vscroll = _mm_set1_ps(scroll);
+    let inv64 = _mm_set1_ps(1.0 / 64.0);
+    let mask = _mm_set1_epi32(255);
+    let dst = out.as_mut_ptr() as *mut f32;
+
+    // no gather before AVX2: spill the indices and load the table entries
+    let lookup = |idx: __m128i| -> __m128 {
+        let mut lanes = [0i32; 4];
+        _mm_storeu_si128(lanes.as_mut_ptr() as *mut __m128i, idx);
+        _mm_setr_ps(
+            turbsin[lanes[0] as usize],
+            turbsin[lanes[1] as usize],
+            turbsin[lanes[2] as usize],
+            turbsin[lanes[3] as usize],
+        )
+    };
+
+    let mut i = 0;
+    while i < body {
+        let vs = _mm_loadu_ps(os.as_ptr().add(i));
+        let vt = _mm_loadu_ps(ot.as_ptr().add(i));
+        let si = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(vt, eighth), vtime), vscale)), mask);
+        let ti = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(vs, eighth), vtime), vscale)), mask);
+        let s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(vs, lookup(si)), vscroll), inv64);
+        let t = _mm_mul_ps(_mm_add_ps(vt, lookup(ti)), inv64);
+        _mm_storeu_ps(dst.add(i * 2), _mm_unpacklo_ps(s, t));
+        _mm_storeu_ps(dst.add(i * 2 + 4), _mm_unpackhi_ps(s, t));
+        i += 4;
+    }
+    warp_scalar(os, ot, turbsin, time, scroll, out, body);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn warp_avx2(os: &[f32], ot: &[f32], turbsin: &[f32; 256], time: f32, scroll: f32, out: &mut [[f32; 2]]) {
+    let n = out.len();
+    let body = n & !7;
+    let eighth = _mm256_set1_ps(0.125);
+    let vtime = _mm256_set1_ps(time);
+    let vscale = _mm256_set1_ps(TURBSCALE);
+    let vscroll = _mm256_set1_ps(scroll);
+    let inv64 = _mm256_set1_ps(1.0 / 64.0);
+    let mask = _mm256_set1_epi32(255);
+    let table = turbsin.as_ptr();
+    let dst = out.as_mut_ptr() as *mut f32;
+
+    let mut i = 0;
+    while i < body {
+        let vs = _mm256_loadu_ps(os.as_ptr().add(i));
+        let vt = _mm256_loadu_ps(ot.as_ptr().add(i));
+        let si = _mm256_and_si256(
+            _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(vt, eighth), vtime), vscale)),
+            mask,
+        );
+        let ti = _mm256_and_si256(
+            _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(vs, eighth), vtime), vscale)),
+            mask,
+        );
+        let s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(vs, _mm256_i32gather_ps::<4>(table, si)), vscroll), inv64);
+        let t = _mm256_mul_ps(_mm256_add_ps(vt, _mm256_i32gather_ps::<4>(table, ti)), inv64);
+        // unpack works per 128-bit lane: lo = s0 t0 s1 t1 | s4 t4 s5 t5
+        let lo = _mm256_unpacklo_ps(s, t);
+        let hi = _mm256_unpackhi_ps(s, t);
+        _mm256_storeu_ps(dst.add(i * 2), _mm256_permute2f128_ps::<0x20>(lo, hi));
+        _mm256_storeu_ps(dst.add(i * 2 + 8), _mm256_permute2f128_ps::<0x31>(lo, hi));
+        i += 8;
+    }
+    warp_scalar(os, ot, turbsin, time, scroll, out, body);
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::vk_warp::R_TURBSIN;
+
+    fn coords(n: usize, seed: u32) -> (Vec<f32>, Vec<f32>) {
+        let mut state = seed;
+        let mut next = || {
+            state = state.wrapping_mul(1664525).wrapping_add(1013904223);
+            (state >> 8) as f32 / (1u32 << 24) as f32 * 4096.0 - 2048.0
+        };
+        let os = (0..n).map(|_| next()).collect();
+        let ot = (0..n).map(|_| next()).collect();
+        (os, ot)
+    }
+
+    #[test]
+    fn test_warp_matches_emit_water_polys() {
+        let (os, ot) = (vec![0.0, 32.0, -100.0], vec![0.0, 8.0, 77.5]);
+        let time = 1.25;
+        let mut out = vec![[0.0; 2]; 3];
+        warp_texcoords(&os, &ot, &R_TURBSIN, time, 0.0, &mut out, SimdLevel::Scalar);
+        for i in 0..3 {
+            let s = os[i] + R_TURBSIN[((ot[i] * 0.125 + time) * TURBSCALE) as i32 as usize & 255];
+            let t = ot[i] + R_TURBSIN[((os[i] * 0.125 + time) * TURBSCALE) as i32 as usize & 255];
+            assert_eq!(out[i], [s * (1.0 / 64.0), t * (1.0 / 64.0)]);
+        }
+    }
+
+    #[test]
+    fn test_simd_matches_scalar() {
+        for n in [0, 1, 3, 4, 7, 8, 9, 31, 1000] {
+            let (os, ot) = coords(n, n as u32 + 1);
+            for (time, scroll) in [(0.0, 0.0), (12.345, -17.5), (1000.0, 0.0)] {
+                let mut reference = vec![[0.0; 2]; n];
+                warp_texcoords(&os, &ot, &R_TURBSIN, time, scroll, &mut reference, SimdLevel::Scalar);
+                for level in SimdLevel::supported() {
+                    let mut out = vec![[f32::NAN; 2]; n];
+                    warp_texcoords(&os, &ot, &R_TURBSIN, time, scroll, &mut out, level);
+                    assert_eq!(out, reference, "{} n={} time={}", level.name(), n, time);
+                }
+            }
+        }
+    }
+
+    /// Usage: cargo test -p myq2-renderer --release bench_water_warp -- --ignored --nocapture
+    ///
+    /// MYQ2_BENCH_WATER sets the vertex count (default 65536),
+    /// MYQ2_BENCH_ITERS the number of frames.
+    #[test]
+    #[ignore]
+    fn bench_water_warp() {
+        let n: usize = std::env::var("MYQ2_BENCH_WATER").ok().and_then(|s| s.parse().ok()).unwrap_or(65536);
+        let iters: usize = std::env::var("MYQ2_BENCH_ITERS").ok().and_then(|s| s.parse().ok()).unwrap_or(200);
+        let (os, ot) = coords(n, 7);
+        let mut out = vec![[0.0; 2]; n];
+
+        println!("{} vertices, {} frames", n, iters);
+        for level in SimdLevel::supported() {
+            let start = std::time::Instant::now();
+            for frame in 0..iters {
+                warp_texcoords(&os, &ot, &R_TURBSIN, frame as f32 * 0.016, 0.0, &mut out, level);
+                std::hint::black_box(&out);
+            }
+            let per_frame = start.elapsed().as_secs_f64() * 1000.0 / iters as f64;
+            println!("  {:6}  {:7.3} ms/frame  {:6.1} Mverts/s", level.name(), per_frame, n as f64 / per_frame / 1000.0);
+        }
+    }
+}
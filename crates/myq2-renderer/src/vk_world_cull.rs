@@ -0,0 +1,639 @@
+// vk_world_cull.rs — Cached PVS surface lists and SIMD frustum culling
+//
+// R_MarkLeaves only re-marks when the view cluster changes, but the world walk
+// used to revisit every leaf each frame. Instead, when the PVS changes we
+// flatten it once into a PvsSurfaceCache: the potentially visible leaves, their
+// bounds as structure-of-arrays, their areas, and their marksurface lists as
+// world surface numbers. Each frame only the cached leaves are tested against
+// the four frustum planes, 4 (SSE2) or 8 (AVX2) boxes per instruction.
+//
+// The box test is box_on_plane_side's "entirely behind" case: the corner
+// furthest along the plane normal is dotted with the normal in the same order
+// as the scalar code, so every path culls exactly the same leaves.
+//
+// boxes_touching_sphere is the same batching applied to dynamic lights: the
+// visible surfaces' bounds against one light sphere per call.
+
+use crate::simd::SimdLevel;
+
+#[cfg(target_arch = "x86_64")]
+use std::arch::x86_64::*;
+
+/// A culling plane as (normal x, y, z, dist).
+pub type CullPlane = [f32; 4];
+
+// ============================================================
+// Bounds
+// ============================================================
+
+/// Axis-aligned boxes stored as one array per component.
+#[derive(Debug, Default, Clone)]
+pub struct BoundsSoA {
+    pub min: [Vec<f32>; 3],
+    pub max: [Vec<f32>; 3],
+}
+
+impl BoundsSoA {
+    pub const fn new() -> Self {
+        Self {
+            min: [Vec::new(), Vec::new(), Vec::new()],
+            max: [Vec::new(), Vec::new(), Vec::new()],
+        }
+    }
+
+    /// Append a box in MNode/MLeaf `minmaxs` layout.
+    pub fn push(&mut self, minmaxs: &[f32; 6]) {
+        for i in 0..3 {
+            self.min[i].push(minmaxs[i]);
+            self.max[i].push(minmaxs[3 + i]);
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.min[0].len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    pub fn clear(&mut self) {
+        for i in 0..3 {
+            self.min[i].clear();
+            self.max[i].clear();
+        }
+    }
+}
+
+/// Append to `out` the index of every box not entirely behind one of
+/// `planes`. With no planes every box is visible.
+pub fn cull_boxes(bounds: &BoundsSoA, planes: &[CullPlane], out: &mut Vec<u32>, level: SimdLevel) {
+    let n = bounds.len();
+    if planes.is_empty() {
+        out.extend(0..n as u32);
+        return;
+    }
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { cull_boxes_avx2(bounds, planes, out) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { cull_boxes_sse2(bounds, planes, out) },
+        _ => cull_boxes_scalar(bounds, planes, 0, out),
+    }
+}
+
+/// The box corner furthest along the plane normal, per axis.
+#[inline]
+fn far_corner<'a>(bounds: &'a BoundsSoA, plane: &CullPlane) -> [&'a [f32]; 3] {
+    let pick = |i: usize| if plane[i] < 0.0 { &bounds.min[i][..] } else { &bounds.max[i][..] };
+    [pick(0), pick(1), pick(2)]
+}
+
+fn cull_boxes_scalar(bounds: &BoundsSoA, planes: &[CullPlane], start: usize, out: &mut Vec<u32>) {
+    'boxes: for i in start..bounds.len() {
+        for p in planes {
+            let c = far_corner(bounds, p);
+            if p[0] * c[0][i] + p[1] * c[1][i] + p[2] * c[2][i] < p[3] {
+                continue 'boxes;
+            }
+        }
+        out.push(i as u32);
+    }
+}
+
+/// Push the indices of the set bits of `mask`, offset by `base`.
+#[inline]
+fn push_mask(mut mask: u32, base: usize, out: &mut Vec<u32>) {
+    while mask != 0 {
+        out.push(base as u32 + mask.trailing_zeros());
+        mask &= mask - 1;
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn cull_boxes_sse2(bounds: &BoundsSoA, planes: &[CullPlane], out: &mut Vec<u32>) {
+    let n = bounds.len();
+    let body = n & !3;
+    let corners: Vec<[&[f32]; 3]> = planes.iter().map(|p| far_corner(bounds, p)).collect();
+
+    let mut i = 0;
+    while i < body {
+        let mut outside = _mm_setzero_ps();
+        for (p, c) in planes.iter().zip(&corners) {
+            let x = _mm_loadu_ps(c[0].as_ptr().add(i));
+            let y = _mm_loadu_ps(c[1].as_ptr().add(i));
+            let z = _mm_loadu_ps(c[2].as_ptr().add(i));
+            let d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), x), _mm_mul_ps(_mm_set1_ps(p[1]), y)),
+                _mm_mul_ps(_mm_set1_ps(p[2]), z),
+            );
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_set1_ps(p[3])));
+        }
+        push_mask(!_mm_movemask_ps(outside) as u32 & 0xf, i, out);
+        i += 4;
+    }
+    cull_boxes_scalar(bounds, planes, body, out);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn cull_boxes_avx2(bounds: &BoundsSoA, planes: &[CullPlane], out: &mut Vec<u32>) {
+    let n = bounds.len();
+    let body = n & !7;
+    let corners: Vec<[&[f32]; 3]> = planes.iter().map(|p| far_corner(bounds, p)).collect();
+
+    let mut i = 0;
+    while i < body {
+        let mut outside = _mm256_setzero_ps();
+        for (p, c) in planes.iter().zip(&corners) {
+            let x = _mm256_loadu_ps(c[0].as_ptr().add(i));
+            let y = _mm256_loadu_ps(c[1].as_ptr().add(i));
+            let z = _mm256_loadu_ps(c[2].as_ptr().add(i));
+            let d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p[0]), x), _mm256_mul_ps(_mm256_set1_ps(p[1]), y)),
+                _mm256_mul_ps(_mm256_set1_ps(p[2]), z),
+            );
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps::<_CMP_LT_OQ>(d, _mm256_set1_ps(p[3])));
+        }
+        push_mask(!_mm256_movemask_ps(outside) as u32 & 0xff, i, out);
+        i += 8;
+    }
+    cull_boxes_scalar(bounds, planes, body, out);
+}
+
+// ============================================================
+// Sphere tests
+// ============================================================
+
+/// Append to `out` the index of every box within `radius` of `center`.
+///
+/// Per axis the gap is max(min - c, c - max, 0); a box is touched when the
+/// summed squared gaps are <= radius². Every path computes the same
+/// expression in the same order, so all levels agree bit for bit.
+pub fn boxes_touching_sphere(bounds: &BoundsSoA, center: [f32; 3], radius: f32, out: &mut Vec<u32>, level: SimdLevel) {
+    match level {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { sphere_boxes_avx2(bounds, center, radius, out) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { sphere_boxes_sse2(bounds, center, radius, out) },
+        _ => sphere_boxes_scalar(bounds, center, radius, 0, out),
+    }
+}
+
+fn sphere_boxes_scalar(bounds: &BoundsSoA, center: [f32; 3], radius: f32, start: usize, out: &mut Vec<u32>) {
+    let r2 = radius * radius;
+    for i in start..bounds.len() {
+        let gap = |a: usize| (bounds.min[a][i] - center[a]).max(center[a] - bounds.max[a][i]).max(0.0);
+        let (x, y, z) = (gap(0), gap(1), gap(2));
+        if x * x + y * y + z * z <= r2 {
+            out.push(i as u32);
+        }
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn sphere_boxes_sse2(bounds: &BoundsSoA, center: [f32; 3], radius: f32, out: &mut Vec<u32>) {
+    let n = bounds.len();
+    let body = n & !3;
+    let zero = _mm_setzero_ps();
+    let r2 = _mm_set1_ps(radius * radius);
+
+    let mut i = 0;
+    while i < body {
+        let mut d2 = zero;
+        for a in 0..3 {
+            let c = _mm_set1_ps(center[a]);
+            let lo = _mm_sub_ps(_mm_loadu_ps(bounds.min[a].as_ptr().add(i)), c);
+            let hi = _mm_sub_ps(c, _mm_loadu_ps(bounds.max[a].as_ptr().add(i)));
+            let g = _mm_max_ps(_mm_max_ps(lo, hi), zero);
+            d2 = _mm_add_ps(d2, _mm_mul_ps(g, g));
+        }
+        push_mask(_mm_movemask_ps(_mm_cmple_ps(d2, r2)) as u32, i, out);
+        i += 4;
+    }
+    sphere_boxes_scalar(bounds, center, radius, body, out);
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn sphere_boxes_avx2(bounds: &BoundsSoA, center: [f32; 3], radius: f32, out: &mut Vec<u32>) {
+    let n = bounds.len();
+    let body = n & !7;
+    let zero = _mm256_setzero_ps();
+    let r2 = _mm256_set1_ps(radius * radius);
+
+    let mut i = 0;
+    while i < body {
+        let mut d2 = zero;
+        for a in 0..3 {
+            let c = _mm256_set1_ps(center[a]);
+            let lo = _mm256_sub_ps(_mm256_loadu_ps(bounds.min[a].as_ptr().add(i)), c);
+            let hi = _mm256_sub_ps(c, _mm256_loadu_ps(bounds.max[a].as_ptr().add(i)));
+            let g = _mm256_max_ps(_mm256_max_ps(lo, hi), zero);
+            d2 = _mm256_add_ps(d2, _mm256_mul_ps(g, g));
+        }
+        push_mask(_mm256_movemask_ps(_mm256_cmp_ps::<_CMP_LE_OQ>(d2, r2)) as u32, i, out);
+        i += 8;
+    }
+    sphere_boxes_scalar(bounds, center, radius, body, out);
+}
+
+// ============================================================
+// PVS surface cache
+// ============================================================
+
+/// The current PVS flattened into leaf bounds and surface lists.
+///
+/// Rebuilt only when R_MarkLeaves starts a new visframe or the world changes.
+pub struct PvsSurfaceCache {
+    /// World model the cache was built for (pointer identity).
+    world: usize,
+    /// r_visframecount the cache was built for.
+    visframe: i32,
+    /// World leaf number of each cached leaf.
+    pub leaves: Vec<u32>,
+    /// Area of each cached leaf (for areabits checks).
+    pub areas: Vec<i32>,
+    /// Bounds of each cached leaf.
+    pub bounds: BoundsSoA,
+    /// Start of each leaf's run in `surfaces` (one extra trailing entry).
+    leaf_first: Vec<u32>,
+    /// World surface numbers, leaf by leaf.
+    surfaces: Vec<u32>,
+}
+
+impl PvsSurfaceCache {
+    pub const fn new() -> Self {
+        Self {
+            world: 0,
+            visframe: 0,
+            leaves: Vec::new(),
+            areas: Vec::new(),
+            bounds: BoundsSoA::new(),
+            leaf_first: Vec::new(),
+            surfaces: Vec::new(),
+        }
+    }
+
+    /// Whether the cache matches `world` at `visframe`.
+    pub fn is_valid(&self, world: usize, visframe: i32) -> bool {
+        self.world != 0 && self.world == world && self.visframe == visframe
+    }
+
+    /// Start a rebuild for `world` at `visframe`.
+    pub fn begin(&mut self, world: usize, visframe: i32) {
+        self.world = world;
+        self.visframe = visframe;
+        self.leaves.clear();
+        self.areas.clear();
+        self.bounds.clear();
+        self.leaf_first.clear();
+        self.leaf_first.push(0);
+        self.surfaces.clear();
+    }
+
+    /// Add a potentially visible leaf and its surfaces.
+    pub fn push_leaf(&mut self, leaf: u32, area: i32, minmaxs: &[f32; 6], surfaces: impl IntoIterator<Item = u32>) {
+        self.leaves.push(leaf);
+        self.areas.push(area);
+        self.bounds.push(minmaxs);
+        self.surfaces.extend(surfaces);
+        self.leaf_first.push(self.surfaces.len() as u32);
+    }
+
+    /// Drop the cache (map change).
+    pub fn invalidate(&mut self) {
+        self.world = 0;
+    }
+
+    /// Number of cached leaves.
+    pub fn len(&self) -> usize {
+        self.leaves.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.leaves.is_empty()
+    }
+
+    /// World surface numbers of cached leaf `i`.
+    pub fn leaf_surfaces(&self, i: usize) -> &[u32] {
+        &self.surfaces[self.leaf_first[i] as usize..self.leaf_first[i + 1] as usize]
+    }
+
+    /// Total surface references across all cached leaves.
+    pub fn surface_refs(&self) -> usize {
+        self.surfaces.len()
+    }
+}
+
+impl Default for PvsSurfaceCache {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Per-surface frame stamps: which surfaces a walk has already reached.
+///
+/// The lightmap walk keeps its own stamps instead of msurface_t visframe,
+/// which the recursive world walk also writes for the same frame.
+pub struct SurfaceStamps {
+    stamps: Vec<u32>,
+    frame: u32,
+}
+
+impl SurfaceStamps {
+    pub const fn new() -> Self {
+        Self { stamps: Vec::new(), frame: 0 }
+    }
+
+    /// Start a walk over `numsurfaces` surfaces; every surface is unmarked.
+    pub fn begin(&mut self, numsurfaces: usize) {
+        if self.stamps.len() != numsurfaces {
+            self.stamps.clear();
+            self.stamps.resize(numsurfaces, 0);
+            self.frame = 0;
+        }
+        self.frame = self.frame.wrapping_add(1);
+        if self.frame == 0 {
+            self.stamps.fill(0);
+            self.frame = 1;
+        }
+    }
+
+    /// Mark surface `s`; false if this walk already reached it.
+    #[inline]
+    pub fn mark(&mut self, s: usize) -> bool {
+        if self.stamps[s] == self.frame {
+            return false;
+        }
+        self.stamps[s] = self.frame;
+        true
+    }
+}
+
+impl Default for SurfaceStamps {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Per-frame world visibility counters for r_speeds.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct WorldVisStats {
+    /// 1 if the PVS cache was rebuilt this frame.
+    pub cache_rebuilds: u32,
+    /// Cached PVS leaves tested against the frustum.
+    pub leaves: u32,
+    /// Leaves inside the frustum and a visible area.
+    pub leaves_visible: u32,
+    /// Surfaces emitted to the world pass.
+    pub surfaces_emitted: u32,
+}
+
+impl WorldVisStats {
+    pub const fn new() -> Self {
+        Self {
+            cache_rebuilds: 0,
+            leaves: 0,
+            leaves_visible: 0,
+            surfaces_emitted: 0,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use myq2_common::q_shared::{box_on_plane_side, CPlane};
+
+    struct Lcg(u32);
+    impl Lcg {
+        fn next(&mut self) -> f32 {
+            self.0 = self.0.wrapping_mul(1664525).wrapping_add(1013904223);
+            (self.0 >> 8) as f32 / (1u32 << 24) as f32
+        }
+        fn range(&mut self, lo: f32, hi: f32) -> f32 {
+            lo + (hi - lo) * self.next()
+        }
+    }
+
+    fn random_boxes(rng: &mut Lcg, n: usize) -> (BoundsSoA, Vec<[f32; 6]>) {
+        let mut bounds = BoundsSoA::new();
+        let mut raw = Vec::new();
+        for _ in 0..n {
+            let mut mm = [0.0f32; 6];
+            for i in 0..3 {
+                let c = rng.range(-2048.0, 2048.0);
+                let e = rng.range(8.0, 256.0);
+                mm[i] = (c - e).floor();
+                mm[3 + i] = (c + e).floor();
+            }
+            bounds.push(&mm);
+            raw.push(mm);
+        }
+        (bounds, raw)
+    }
+
+    /// Four planes of a 90-degree frustum at `org` looking along a random direction.
+    fn random_frustum(rng: &mut Lcg) -> Vec<CPlane> {
+        let org = [rng.range(-512.0, 512.0), rng.range(-512.0, 512.0), rng.range(-64.0, 64.0)];
+        let yaw = rng.range(0.0, std::f32::consts::TAU);
+        let f = [yaw.cos(), yaw.sin(), 0.0];
+        let r = [yaw.sin(), -yaw.cos(), 0.0];
+        let u = [0.0, 0.0, 1.0];
+        let h = std::f32::consts::FRAC_1_SQRT_2;
+        let normals = [
+            [h * (f[0] + r[0]), h * (f[1] + r[1]), h * (f[2] + r[2])],
+            [h * (f[0] - r[0]), h * (f[1] - r[1]), h * (f[2] - r[2])],
+            [h * (f[0] + u[0]), h * (f[1] + u[1]), h * (f[2] + u[2])],
+            [h * (f[0] - u[0]), h * (f[1] - u[1]), h * (f[2] - u[2])],
+        ];
+        normals
+            .iter()
+            .map(|n| {
+                let mut p = CPlane::default();
+                p.normal = *n;
+                p.dist = n[0] * org[0] + n[1] * org[1] + n[2] * org[2];
+                p.plane_type = 5;
+                p.signbits = (0..3).filter(|&j| n[j] < 0.0).map(|j| 1u8 << j).sum();
+                p
+            })
+            .collect()
+    }
+
+    fn cull_planes(planes: &[CPlane]) -> Vec<CullPlane> {
+        planes.iter().map(|p| [p.normal[0], p.normal[1], p.normal[2], p.dist]).collect()
+    }
+
+    #[test]
+    fn test_scalar_matches_box_on_plane_side() {
+        let mut rng = Lcg(7);
+        let (mut kept, mut culled) = (0, 0);
+        for _ in 0..20 {
+            let (bounds, raw) = random_boxes(&mut rng, 500);
+            let planes = random_frustum(&mut rng);
+            let mut out = Vec::new();
+            cull_boxes(&bounds, &cull_planes(&planes), &mut out, SimdLevel::Scalar);
+
+            let expected: Vec<u32> = raw
+                .iter()
+                .enumerate()
+                .filter(|(_, mm)| {
+                    let mins = [mm[0], mm[1], mm[2]];
+                    let maxs = [mm[3], mm[4], mm[5]];
+                    !planes.iter().any(|p| box_on_plane_side(&mins, &maxs, p) == 2)
+                })
+                .map(|(i, _)| i as u32)
+                .collect();
+            assert_eq!(out, expected);
+            kept += out.len();
+            culled += raw.len() - out.len();
+        }
+        assert!(kept > 0 && culled > 0);
+    }
+
+    #[test]
+    fn test_simd_matches_scalar() {
+        let mut rng = Lcg(99);
+        for n in [0, 1, 3, 4, 7, 8, 9, 31, 1000] {
+            let (bounds, _) = random_boxes(&mut rng, n);
+            let planes = cull_planes(&random_frustum(&mut rng));
+            let mut reference = Vec::new();
+            cull_boxes(&bounds, &planes, &mut reference, SimdLevel::Scalar);
+            for level in SimdLevel::supported() {
+                let mut out = Vec::new();
+                cull_boxes(&bounds, &planes, &mut out, level);
+                assert_eq!(out, reference, "{} n={}", level.name(), n);
+            }
+        }
+    }
+
+    #[test]
+    fn test_no_planes_keeps_everything() {
+        let mut rng = Lcg(1);
+        let (bounds, _) = random_boxes(&mut rng, 13);
+        let mut out = Vec::new();
+        cull_boxes(&bounds, &[], &mut out, crate::simd::level());
+        assert_eq!(out, (0..13).collect::<Vec<u32>>());
+    }
+
+    #[test]
+    fn test_box_touching_plane_is_kept() {
+        let mut bounds = BoundsSoA::new();
+        bounds.push(&[-10.0, -10.0, -10.0, 0.0, 10.0, 10.0]); // max x on the plane
+        bounds.push(&[-10.0, -10.0, -10.0, -1.0, 10.0, 10.0]); // behind
+        let planes = [[1.0, 0.0, 0.0, 0.0]];
+        for level in SimdLevel::supported() {
+            let mut out = Vec::new();
+            cull_boxes(&bounds, &planes, &mut out, level);
+            assert_eq!(out, vec![0], "{}", level.name());
+        }
+    }
+
+    #[test]
+    fn test_sphere_simd_matches_scalar() {
+        let mut rng = Lcg(5);
+        let mut touched = 0;
+        for n in [0, 1, 3, 4, 7, 8, 9, 31, 1000] {
+            let (bounds, raw) = random_boxes(&mut rng, n);
+            let center = [rng.range(-2048.0, 2048.0), rng.range(-2048.0, 2048.0), rng.range(-2048.0, 2048.0)];
+            let radius = rng.range(64.0, 1024.0);
+            let mut reference = Vec::new();
+            boxes_touching_sphere(&bounds, center, radius, &mut reference, SimdLevel::Scalar);
+
+            // against a straightforward closest-point distance
+            let expected: Vec<u32> = raw
+                .iter()
+                .enumerate()
+                .filter(|(_, mm)| {
+                    let d2: f32 = (0..3)
+                        .map(|a| {
+                            let p = center[a].clamp(mm[a], mm[3 + a]);
+                            (p - center[a]) * (p - center[a])
+                        })
+                        .sum();
+                    d2 <= radius * radius
+                })
+                .map(|(i, _)| i as u32)
+                .collect();
+            assert_eq!(reference, expected, "n={}", n);
+            touched += reference.len();
+
+            for level in SimdLevel::supported() {
+                let mut out = Vec::new();
+                boxes_touching_sphere(&bounds, center, radius, &mut out, level);
+                assert_eq!(out, reference, "{} n={}", level.name(), n);
+            }
+        }
+        assert!(touched > 0);
+    }
+
+    #[test]
+    fn test_sphere_touching_box_edge() {
+        let mut bounds = BoundsSoA::new();
+        bounds.push(&[10.0, -5.0, -5.0, 20.0, 5.0, 5.0]); // face 10 units away
+        bounds.push(&[6.0, 8.0, -5.0, 20.0, 20.0, 5.0]); // corner edge at distance 10
+        bounds.push(&[11.0, -5.0, -5.0, 20.0, 5.0, 5.0]); // just out of reach
+        bounds.push(&[-5.0, -5.0, -5.0, 5.0, 5.0, 5.0]); // contains the centre
+        for level in SimdLevel::supported() {
+            let mut out = Vec::new();
+            boxes_touching_sphere(&bounds, [0.0; 3], 10.0, &mut out, level);
+            assert_eq!(out, vec![0, 1, 3], "{}", level.name());
+        }
+    }
+
+    #[test]
+    fn test_cache_validity_and_leaf_surfaces() {
+        let mut cache = PvsSurfaceCache::new();
+        assert!(!cache.is_valid(0, 0));
+        assert!(!cache.is_valid(0x1000, 1));
+
+        cache.begin(0x1000, 1);
+        cache.push_leaf(4, 0, &[0.0; 6], [1, 2, 3]);
+        cache.push_leaf(9, 1, &[0.0; 6], []);
+        cache.push_leaf(12, 2, &[0.0; 6], [3, 7]);
+        assert!(cache.is_valid(0x1000, 1));
+        assert!(!cache.is_valid(0x1000, 2));
+        assert!(!cache.is_valid(0x2000, 1));
+
+        assert_eq!(cache.len(), 3);
+        assert_eq!(cache.bounds.len(), 3);
+        assert_eq!(cache.leaf_surfaces(0), &[1, 2, 3]);
+        assert!(cache.leaf_surfaces(1).is_empty());
+        assert_eq!(cache.leaf_surfaces(2), &[3, 7]);
+        assert_eq!(cache.surface_refs(), 5);
+
+        cache.invalidate();
+        assert!(!cache.is_valid(0x1000, 1));
+
+        cache.begin(0x1000, 2);
+        assert!(cache.is_empty());
+        assert_eq!(cache.surface_refs(), 0);
+    }
+
+    #[test]
+    fn test_surface_stamps() {
+        let mut stamps = SurfaceStamps::new();
+        stamps.begin(4);
+        assert!(stamps.mark(1));
+        assert!(!stamps.mark(1));
+        assert!(stamps.mark(3));
+
+        // a new walk forgets the last one
+        stamps.begin(4);
+        assert!(stamps.mark(1));
+
+        // the counter wrapping does not leave stale marks behind
+        stamps.frame = u32::MAX;
+        stamps.mark(2);
+        stamps.begin(4);
+        assert_eq!(stamps.frame, 1);
+        assert!(stamps.mark(2));
+
+        // a different world starts over
+        stamps.begin(6);
+        assert!(stamps.mark(5));
+    }
+}
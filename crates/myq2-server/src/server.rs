@@ -7,6 +7,7 @@
 use myq2_common::cvar::CvarContext;
 use myq2_common::q_shared::*;
 use myq2_common::qcommon::*;
+use myq2_common::msg_bits::EntityQuant;
 use myq2_common::qfiles::MAX_MAP_AREAS;
 
 use crate::sv_game::{GameExport, GameModule};
@@ -211,6 +212,9 @@ pub struct Client {
     pub challenge: i32, // challenge of this user, randomly generated
 
     pub netchan: NetChan,
+
+    /// Bit-packed packet entities profile ("be=" at connect), if any
+    pub entity_quant: Option<EntityQuant>,
 }
 
 // A client can leave the server in one of four ways:
@@ -249,6 +253,7 @@ impl Default for Client {
             lastconnect: 0,
             challenge: 0,
             netchan: NetChan::new(),
+            entity_quant: None,
         }
     }
 }
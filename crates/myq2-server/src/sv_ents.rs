@@ -11,6 +11,7 @@ use myq2_common::common::{
     com_dprintf, msg_write_angle16, msg_write_byte, msg_write_char, msg_write_delta_entity,
     msg_write_long, msg_write_short,
 };
+use myq2_common::msg_bits::{EntityQuant, PackedEntityWriter};
 use myq2_common::q_shared::*;
 use myq2_common::qcommon::*;
 
@@ -23,7 +24,9 @@ use std::io::Write;
 
 /// Writes a delta update of an entity_state_t list to the message.
 ///
-/// Corresponds to `SV_EmitPacketEntities` in the original C code.
+/// Corresponds to `SV_EmitPacketEntities` in the original C code. With
+/// `quant` (negotiated at connect) the list goes out bit-packed as
+/// svc_packetentities_bits.
 pub fn sv_emit_packet_entities(
     svs: &ServerStatic,
     from: Option<&ClientFrame>,
@@ -31,8 +34,18 @@ pub fn sv_emit_packet_entities(
     msg: &mut SizeBuf,
     maxclients_value: f32,
     baselines: &[EntityState],
+    quant: Option<EntityQuant>,
 ) {
-    msg_write_byte(msg, SvcOps::PacketEntities as i32);
+    let mut packed = match quant {
+        Some(quant) => {
+            msg_write_byte(msg, SVC_PACKETENTITIES_BITS);
+            Some(PackedEntityWriter::new(msg, quant))
+        }
+        None => {
+            msg_write_byte(msg, SvcOps::PacketEntities as i32);
+            None
+        }
+    };
 
     let from_num_entities = match from {
         Some(f) => f.num_entities,
@@ -70,13 +83,11 @@ pub fn sv_emit_packet_entities(
             // oldorigin always and prevents warping
             let oldent = &svs.client_entities[oldent_idx.unwrap()];
             let newent = &svs.client_entities[newent_idx.unwrap()];
-            msg_write_delta_entity(
-                oldent,
-                newent,
-                msg,
-                false,
-                newent.number <= maxclients_value as i32,
-            );
+            let newentity = newent.number <= maxclients_value as i32;
+            match packed.as_mut() {
+                Some(packed) => packed.delta(oldent, newent, false, newentity),
+                None => msg_write_delta_entity(oldent, newent, msg, false, newentity),
+            }
             oldindex += 1;
             newindex += 1;
             continue;
@@ -85,13 +96,21 @@ pub fn sv_emit_packet_entities(
         if newnum < oldnum {
             // this is a new entity, send it from the baseline
             let newent = &svs.client_entities[newent_idx.unwrap()];
-            msg_write_delta_entity(&baselines[newnum as usize], newent, msg, true, true);
+            match packed.as_mut() {
+                Some(packed) => packed.delta(&baselines[newnum as usize], newent, true, true),
+                None => msg_write_delta_entity(&baselines[newnum as usize], newent, msg, true, true),
+            }
             newindex += 1;
             continue;
         }
 
         if newnum > oldnum {
             // the old entity isn't present in the new message
+            if let Some(packed) = packed.as_mut() {
+                packed.remove(oldnum);
+                oldindex += 1;
+                continue;
+            }
             let mut bits = U_REMOVE;
             if oldnum >= 256 {
                 bits |= U_NUMBER16 | U_MOREBITS1;
@@ -113,7 +132,10 @@ pub fn sv_emit_packet_entities(
         }
     }
 
-    msg_write_short(msg, 0); // end of packetentities
+    match packed {
+        Some(packed) => packed.finish(msg),
+        None => msg_write_short(msg, 0), // end of packetentities
+    }
 }
 
 /// Write playerstate delta to client message.
@@ -373,6 +395,7 @@ pub fn sv_write_frame_to_client(
         msg,
         maxclients_value,
         &sv.baselines,
+        client.entity_quant,
     );
 }
 
@@ -1406,7 +1429,7 @@ mod tests {
         let mut msg = SizeBuf::new(4096);
         let baselines = vec![EntityState::default(); MAX_EDICTS];
 
-        sv_emit_packet_entities(&svs, None, &to, &mut msg, 1.0, &baselines);
+        sv_emit_packet_entities(&svs, None, &to, &mut msg, 1.0, &baselines, None);
 
         // Should write: 1 byte (PacketEntities opcode) + 2 bytes (terminator short 0)
         assert_eq!(msg.cursize, 3, "Empty packet entities should be 3 bytes");
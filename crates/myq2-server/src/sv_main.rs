@@ -11,6 +11,7 @@ use crate::server::*;
 use crate::sv_game::{SVF_NOCLIENT, Solid};
 use myq2_common::cmd::CmdContext;
 use myq2_common::common::{com_printf, com_dprintf, msg_read_string_line};
+use myq2_common::msg_bits::EntityQuant;
 use myq2_common::q_shared::*;
 use myq2_common::qcommon::*;
 
@@ -428,8 +429,23 @@ pub fn svc_direct_connect(ctx: &mut ServerContext, cmd_argv: &dyn Fn(usize) -> S
     ctx.svs.clients[newcl_index].userinfo = userinfo;
     sv_userinfo_changed(ctx, newcl_index);
 
+    // Windowed reliable netchan: offered by the client as "nc=1" after the
+    // userinfo, only meaningful where fragmentation is available
+    let windowed = version >= PROTOCOL_Q2PRO && (5..8).any(|i| cmd_argv(i) == "nc=1");
+
+    // Bit-packed packet entities: "be=<profile>", capped at what we know;
+    // offered on the same protocol as the windowed netchan
+    let entity_quant = (5..8)
+        .filter(|_| version >= PROTOCOL_Q2PRO)
+        .find_map(|i| cmd_argv(i).strip_prefix("be=").and_then(|p| p.parse::<i32>().ok()))
+        .and_then(|p| EntityQuant::from_i32(p.min(EntityQuant::BEST as i32)));
+
     // send the connect packet to the client
-    netchan_out_of_band_print(NetSrc::Server, &adr, "client_connect");
+    netchan_out_of_band_print(
+        NetSrc::Server,
+        &adr,
+        if windowed { "client_connect nc=1" } else { "client_connect" },
+    );
 
     // Netchan_Setup (NS_SERVER, &newcl->netchan, adr, qport);
     myq2_common::net_chan::netchan_setup(
@@ -446,6 +462,7 @@ pub fn svc_direct_connect(ctx: &mut ServerContext, cmd_argv: &dyn Fn(usize) -> S
         &mut ctx.svs.clients[newcl_index].netchan,
         version,
     );
+    myq2_common::net_chan::netchan_set_windowed(&mut ctx.svs.clients[newcl_index].netchan, windowed);
 
     if version >= PROTOCOL_R1Q2 {
         let proto_name = if version == PROTOCOL_Q2PRO { "Q2Pro" } else { "R1Q2" };
@@ -458,6 +475,7 @@ pub fn svc_direct_connect(ctx: &mut ServerContext, cmd_argv: &dyn Fn(usize) -> S
         ));
     }
 
+    ctx.svs.clients[newcl_index].entity_quant = entity_quant;
     ctx.svs.clients[newcl_index].state = ClientState::Connected;
 
     ctx.svs.clients[newcl_index].datagram = SizeBuf::new(MAX_MSGLEN as i32);
@@ -9,6 +9,7 @@ use rayon::prelude::*;
 use myq2_common::common::{
     com_printf, msg_write_byte, msg_write_long, msg_write_string,
 };
+use myq2_common::net_chan::MAX_FRAGMENTED_MSGLEN;
 use myq2_common::q_shared::*;
 use myq2_common::qcommon::*;
 
@@ -242,7 +243,10 @@ pub fn sv_multicast(ctx: &mut ServerContext, origin: Option<Vec3>, to: Multicast
 pub fn sv_send_client_datagram(ctx: &mut ServerContext, client_idx: usize) -> bool {
     sv_build_client_frame(ctx, client_idx);
 
-    let mut msg = SizeBuf::new(MAX_MSGLEN as i32);
+    // Protocol 36 channels fragment what does not fit in one packet, so a
+    // big frame goes out whole instead of overflowing and being dropped
+    let maxsize = myq2_common::net_chan::netchan_max_datagram(&ctx.svs.clients[client_idx].netchan);
+    let mut msg = SizeBuf::new(maxsize as i32);
     msg.allow_overflow = true;
 
     // Send over all the relevant entity_state_t and the player_state_t
@@ -335,7 +339,8 @@ enum ClientSendAction {
 /// SV_SendClientMessages.
 pub fn sv_send_client_messages(ctx: &mut ServerContext) {
     let mut msglen: usize = 0;
-    let mut msgbuf = vec![0u8; MAX_MSGLEN];
+    // demo blocks hold whole protocol 36 frames, reassembled from fragments
+    let mut msgbuf = vec![0u8; MAX_FRAGMENTED_MSGLEN];
 
     // Read the next demo message if needed
     if ctx.sv.state == ServerState::Demo && ctx.sv.demofile.is_some() {
@@ -348,8 +353,8 @@ pub fn sv_send_client_messages(ctx: &mut ServerContext) {
                         sv_demo_completed(ctx);
                         return;
                     }
-                    if len > MAX_MSGLEN {
-                        panic!("SV_SendClientMessages: msglen > MAX_MSGLEN");
+                    if len > MAX_FRAGMENTED_MSGLEN {
+                        panic!("SV_SendClientMessages: msglen > MAX_FRAGMENTED_MSGLEN");
                     }
                     msglen = len;
                     msgbuf[..len].copy_from_slice(&data[..len]);
@@ -516,6 +521,7 @@ fn sv_write_frame_to_client(ctx: &ServerContext, client_idx: usize, msg: &mut Si
         msg,
         ctx.maxclients_value,
         &ctx.sv.baselines,
+        client.entity_quant,
     );
 }
 
@@ -1032,6 +1038,35 @@ mod tests {
         assert_eq!(&data[..5], b"hello");
     }
 
+    #[test]
+    fn demo_read_message_reassembled_frame() {
+        // a frame recorded from protocol 36 fragments exceeds MAX_MSGLEN
+        let temp_dir = std::env::temp_dir();
+        let temp_file_path = temp_dir.join("myq2_test_demo_reassembled.dem");
+        let msg_data: Vec<u8> = (0..MAX_MSGLEN * 3 + 17).map(|i| (i % 251) as u8).collect();
+
+        {
+            use std::io::Write;
+            let mut f = std::fs::File::create(&temp_file_path).unwrap();
+            f.write_all(&(msg_data.len() as i32).to_le_bytes()).unwrap();
+            f.write_all(&msg_data).unwrap();
+            f.write_all(&(-1i32).to_le_bytes()).unwrap();
+        }
+
+        let mut sv = Server::default();
+        sv.demofile = Some(std::fs::File::open(&temp_file_path).unwrap());
+
+        let first = sv_demo_read_message(&mut sv);
+        let second = sv_demo_read_message(&mut sv);
+
+        let _ = std::fs::remove_file(&temp_file_path);
+
+        let (len, data) = first.expect("reassembled frame should be readable");
+        assert!(len > MAX_MSGLEN && len <= MAX_FRAGMENTED_MSGLEN);
+        assert_eq!(data, msg_data);
+        assert_eq!(second.map(|(len, _)| len as i32), Some(-1));
+    }
+
     #[test]
     fn demo_read_message_empty_file() {
         let temp_dir = std::env::temp_dir();
@@ -176,6 +176,7 @@ fn bridge_r_add_stain(org: &[f32; 3], intensity: f32, r: f32, g: f32, b: f32, a:
 }
 
 fn bridge_vk_imp_end_frame() {
+    vk_rmain::r_end_frame();
     crate::platform_register::with_platform(|s| {
         s.vk_imp.glimp_end_frame();
     });